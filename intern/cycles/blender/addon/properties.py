@@ -284,6 +284,33 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 min=0.0, max=1.0,
                 default=0.01,
                 )
+        cls.use_light_tree = BoolProperty(
+                name="Light Tree",
+                description="Pick lights by their estimated contribution to the shading point using a tree of all lights, "
+                            "rather than by area (less noise in scenes with many lights, but slower to sample)",
+                default=False,
+                )
+
+        cls.use_adaptive_sampling = BoolProperty(
+                name="Adaptive Sampling",
+                description="Stop rendering pixels once their noise is below the threshold, "
+                            "samples is the maximum then (only supported for CPU final renders)",
+                default=False,
+                )
+        cls.adaptive_threshold = FloatProperty(
+                name="Noise Threshold",
+                description="Noise level at which pixels stop receiving samples, lower values give less noise",
+                min=0.0001, max=1.0,
+                default=0.01,
+                precision=4,
+                )
+        cls.adaptive_min_samples = IntProperty(
+                name="Min Samples",
+                description="Minimum number of samples before pixels can stop, zero picks a value "
+                            "based on the noise threshold",
+                min=0, max=4096,
+                default=0,
+                )
 
         cls.caustics_reflective = BoolProperty(
                 name="Reflective Caustics",
@@ -500,6 +527,25 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 description="Use special type BVH optimized for hair (uses more ram but renders faster)",
                 default=True,
                 )
+        cls.debug_use_bvh_parallel_build = BoolProperty(
+                name="Use Parallel BVH Build",
+                description="Gather primitives and bin the upper levels of the BVH using all threads, "
+                            "speeds up builds of scenes with many objects",
+                default=False,
+                )
+        cls.debug_use_bvh_refit = BoolProperty(
+                name="Refit BVH",
+                description="Refit BVH instead of rebuilding it when only positions of deforming geometry changed, "
+                            "falling back to a full rebuild when quality degrades too much "
+                            "(speeds up animation renders with persistent data)",
+                default=False,
+                )
+        cls.debug_use_bvh_cache = BoolProperty(
+                name="Cache BVH",
+                description="Store built BVH in the cache directory on disk and load it from there "
+                            "when rendering the same geometry again",
+                default=False,
+                )
         cls.debug_bvh_time_steps = IntProperty(
                 name="BVH Time Steps",
                 description="Split BVH primitives by this number of time steps to speed up render time in cost of memory",
@@ -610,6 +656,21 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
             items=enum_texture_limit
             )
 
+        cls.texture_cache_size = IntProperty(
+            name="Texture Cache Size",
+            description="Read image textures on demand in tiles, keeping at most this many megabytes "
+                        "of tiles in memory, instead of loading whole images (CPU only, 0 disables the cache)",
+            min=0, max=1 << 20,
+            default=0,
+            )
+
+        cls.use_texture_auto_convert = BoolProperty(
+            name="Auto Convert Textures",
+            description="Convert image textures which are not tiled and mipmapped yet to tiled textures "
+                        "in the cache directory before rendering, so they are read faster from the texture cache",
+            default=False,
+            )
+
         cls.ao_bounces = IntProperty(
             name="AO Bounces",
             default=0,
@@ -638,6 +699,30 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         cls.debug_use_cpu_sse2 = BoolProperty(name="SSE2", default=True)
         cls.debug_use_qbvh = BoolProperty(name="QBVH", default=True)
         cls.debug_use_cpu_split_kernel = BoolProperty(name="Split Kernel", default=False)
+        cls.debug_use_cpu_ray_packets = BoolProperty(
+                name="Ray Packets",
+                description="Trace camera rays of neighbour pixels together, "
+                            "uses QBVH even when wider BVH is supported",
+                default=False,
+                )
+        cls.debug_use_cpu_shader_sort = BoolProperty(
+                name="Shader Sort",
+                description="Intersect camera rays of a tile first and integrate paths "
+                            "in order of the shader they hit",
+                default=False,
+                )
+        cls.debug_use_cpu_timing = BoolProperty(
+                name="Timing",
+                description="Measure time spent in ray traversal and shader evaluation, "
+                            "printed to the log (only in builds with Cycles debug enabled)",
+                default=False,
+                )
+        cls.debug_use_cpu_numa = BoolProperty(
+                name="NUMA",
+                description="Bind render threads to NUMA nodes, "
+                            "threads steal work from threads of the same node first",
+                default=False,
+                )
 
         cls.debug_use_cuda_adaptive_compile = BoolProperty(name="Adaptive Compile", default=False)
         cls.debug_use_cuda_split_kernel = BoolProperty(name="Split Kernel", default=False)
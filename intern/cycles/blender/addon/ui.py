@@ -172,6 +172,7 @@ class CYCLES_RENDER_PT_sampling(CyclesButtonsPanel, Panel):
         sub.prop(cscene, "sample_clamp_direct")
         sub.prop(cscene, "sample_clamp_indirect")
         sub.prop(cscene, "light_sampling_threshold")
+        sub.prop(cscene, "use_light_tree")
 
         if cscene.progressive == 'PATH' or use_branched_path(context) is False:
             col = split.column()
@@ -204,6 +205,14 @@ class CYCLES_RENDER_PT_sampling(CyclesButtonsPanel, Panel):
             col.prop(cscene, "sample_all_lights_indirect")
 
         layout.row().prop(cscene, "sampling_pattern", text="Pattern")
+
+        row = layout.row(align=True)
+        row.prop(cscene, "use_adaptive_sampling")
+        sub = row.row(align=True)
+        sub.active = cscene.use_adaptive_sampling
+        sub.prop(cscene, "adaptive_threshold", text="Threshold")
+        sub.prop(cscene, "adaptive_min_samples", text="Min Samples")
+
         draw_samples_info(layout, context)
 
 
@@ -413,9 +422,20 @@ class CYCLES_RENDER_PT_performance(CyclesButtonsPanel, Panel):
 
         col.separator()
 
+        col.label(text="Texture Cache:")
+        col.prop(cscene, "texture_cache_size", text="Size (MB)")
+        sub = col.column()
+        sub.active = cscene.texture_cache_size > 0
+        sub.prop(cscene, "use_texture_auto_convert")
+
+        col.separator()
+
         col.label(text="Acceleration structure:")
         col.prop(cscene, "debug_use_spatial_splits")
         col.prop(cscene, "debug_use_hair_bvh")
+        col.prop(cscene, "debug_use_bvh_parallel_build")
+        col.prop(cscene, "debug_use_bvh_refit")
+        col.prop(cscene, "debug_use_bvh_cache")
 
         row = col.row()
         row.active = not cscene.debug_use_spatial_splits
@@ -1555,6 +1575,10 @@ class CYCLES_RENDER_PT_debug(CyclesButtonsPanel, Panel):
         row.prop(cscene, "debug_use_cpu_avx2", toggle=True)
         col.prop(cscene, "debug_use_qbvh")
         col.prop(cscene, "debug_use_cpu_split_kernel")
+        col.prop(cscene, "debug_use_cpu_ray_packets")
+        col.prop(cscene, "debug_use_cpu_shader_sort")
+        col.prop(cscene, "debug_use_cpu_timing")
+        col.prop(cscene, "debug_use_cpu_numa")
 
         col.separator()
 
@@ -70,6 +70,10 @@ bool debug_flags_sync_from_scene(BL::Scene b_scene)
 	flags.cpu.sse2 = get_boolean(cscene, "debug_use_cpu_sse2");
 	flags.cpu.qbvh = get_boolean(cscene, "debug_use_qbvh");
 	flags.cpu.split_kernel = get_boolean(cscene, "debug_use_cpu_split_kernel");
+	flags.cpu.ray_packets = get_boolean(cscene, "debug_use_cpu_ray_packets");
+	flags.cpu.shader_sort = get_boolean(cscene, "debug_use_cpu_shader_sort");
+	flags.cpu.timing = get_boolean(cscene, "debug_use_cpu_timing");
+	flags.cpu.numa = get_boolean(cscene, "debug_use_cpu_numa");
 	/* Synchronize CUDA flags. */
 	flags.cuda.adaptive_compile = get_boolean(cscene, "debug_use_cuda_adaptive_compile");
 	flags.cuda.split_kernel = get_boolean(cscene, "debug_use_cuda_split_kernel");
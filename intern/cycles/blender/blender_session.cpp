@@ -431,6 +431,12 @@ void BlenderSession::render()
 		session->params.denoising_feature_strength = get_float(crl, "denoising_feature_strength");
 		session->params.denoising_relative_pca = get_boolean(crl, "denoising_relative_pca");
 
+		/* Pixels can only stop early when rendering on the CPU. */
+		PointerRNA cscene = RNA_pointer_get(&b_scene.ptr, "cycles");
+		buffer_params.adaptive_sampling = get_boolean(cscene, "use_adaptive_sampling") &&
+		                                  session_params.device.type == DEVICE_CPU;
+		scene->film->adaptive_sampling_pass = buffer_params.adaptive_sampling;
+
 		scene->film->pass_alpha_threshold = b_layer_iter->pass_alpha_threshold();
 		scene->film->tag_passes_update(scene, passes);
 		scene->film->tag_update(scene);
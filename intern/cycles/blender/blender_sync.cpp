@@ -292,6 +292,15 @@ void BlenderSync::sync_integrator()
 	integrator->sample_all_lights_indirect = get_boolean(cscene, "sample_all_lights_indirect");
 	integrator->light_sampling_threshold = get_float(cscene, "light_sampling_threshold");
 
+	bool use_light_tree = get_boolean(cscene, "use_light_tree");
+	if(integrator->use_light_tree != use_light_tree) {
+		scene->light_manager->tag_update(scene);
+	}
+	integrator->use_light_tree = use_light_tree;
+
+	integrator->adaptive_threshold = get_float(cscene, "adaptive_threshold");
+	integrator->adaptive_min_samples = get_int(cscene, "adaptive_min_samples");
+
 	int diffuse_samples = get_int(cscene, "diffuse_samples");
 	int glossy_samples = get_int(cscene, "glossy_samples");
 	int transmission_samples = get_int(cscene, "transmission_samples");
@@ -620,6 +629,9 @@ SceneParams BlenderSync::get_scene_params(BL::Scene& b_scene,
 
 	params.use_bvh_spatial_split = RNA_boolean_get(&cscene, "debug_use_spatial_splits");
 	params.use_bvh_unaligned_nodes = RNA_boolean_get(&cscene, "debug_use_hair_bvh");
+	params.use_bvh_parallel_build = RNA_boolean_get(&cscene, "debug_use_bvh_parallel_build");
+	params.use_bvh_refit = RNA_boolean_get(&cscene, "debug_use_bvh_refit");
+	params.use_bvh_cache = RNA_boolean_get(&cscene, "debug_use_bvh_cache");
 	params.num_bvh_time_steps = RNA_int_get(&cscene, "debug_bvh_time_steps");
 
 	if(background && params.shadingsystem != SHADINGSYSTEM_OSL)
@@ -641,6 +653,9 @@ SceneParams BlenderSync::get_scene_params(BL::Scene& b_scene,
 		params.texture_limit = 0;
 	}
 
+	params.texture_cache_size = RNA_int_get(&cscene, "texture_cache_size");
+	params.texture_auto_convert = RNA_boolean_get(&cscene, "use_texture_auto_convert");
+
 	params.use_qbvh = DebugFlags().cpu.qbvh;
 
 	return params;
@@ -22,10 +22,13 @@
 
 #include "bvh/bvh2.h"
 #include "bvh/bvh4.h"
+#include "bvh/bvh8.h"
 #include "bvh/bvh_build.h"
+#include "bvh/bvh_cache.h"
 #include "bvh/bvh_node.h"
 
 #include "util/util_foreach.h"
+#include "util/util_logging.h"
 #include "util/util_progress.h"
 
 CCL_NAMESPACE_BEGIN
@@ -45,13 +48,25 @@ int BVHStackEntry::encodeIdx() const
 /* BVH */
 
 BVH::BVH(const BVHParams& params_, const vector<Object*>& objects_)
-: params(params_), objects(objects_)
+: params(params_),
+  objects(objects_),
+  build_root(NULL),
+  build_sah_cost(0.0f)
 {
 }
 
+BVH::~BVH()
+{
+	if(build_root != NULL) {
+		build_root->deleteSubtree();
+	}
+}
+
 BVH *BVH::create(const BVHParams& params, const vector<Object*>& objects)
 {
-	if(params.use_qbvh)
+	if(params.use_obvh)
+		return new BVH8(params, objects);
+	else if(params.use_qbvh)
 		return new BVH4(params, objects);
 	else
 		return new BVH2(params, objects);
@@ -61,6 +76,23 @@ BVH *BVH::create(const BVHParams& params, const vector<Object*>& objects)
 
 void BVH::build(Progress& progress)
 {
+	string cache_key;
+	const bool use_cache = params.use_cache && BVHCache::supported(objects);
+	if(use_cache) {
+		progress.set_substatus("Loading BVH from cache");
+		cache_key = BVHCache::key(params, objects);
+		if(BVHCache::read(cache_key, &pack)) {
+			VLOG(1) << "Loaded BVH " << cache_key << " from cache.";
+			progress.add_bvh_cache_hit();
+			if(build_root != NULL) {
+				build_root->deleteSubtree();
+				build_root = NULL;
+			}
+			return;
+		}
+		progress.add_bvh_cache_miss();
+	}
+
 	progress.set_substatus("Building BVH");
 
 	/* build nodes */
@@ -78,6 +110,27 @@ void BVH::build(Progress& progress)
 		return;
 	}
 
+	if(build_root != NULL) {
+		build_root->deleteSubtree();
+		build_root = NULL;
+	}
+
+	/* Bounds of unaligned nodes are stored in their own space which refit
+	 * does not support, such BVH is always built from scratch.
+	 */
+	const bool keep_build_nodes =
+	        params.keep_build_nodes &&
+	        root->getSubtreeSize(BVH_STAT_UNALIGNED_COUNT) == 0;
+	if(keep_build_nodes) {
+		/* Packing modifies references of the top level BVH, keep them as
+		 * they were created by the builder.
+		 */
+		build_prim_type = pack.prim_type;
+		build_prim_index = pack.prim_index;
+		build_prim_object = pack.prim_object;
+		build_prim_time = pack.prim_time;
+	}
+
 	/* pack triangles */
 	progress.set_substatus("Packing BVH triangles and strands");
 	pack_primitives();
@@ -91,24 +144,122 @@ void BVH::build(Progress& progress)
 	progress.set_substatus("Packing BVH nodes");
 	pack_nodes(root);
 
-	/* free build nodes */
-	root->deleteSubtree();
+	if(keep_build_nodes) {
+		build_root = root;
+		build_sah_cost = root->computeSubtreeSAHCost(params);
+	}
+	else {
+		/* free build nodes */
+		root->deleteSubtree();
+	}
+
+	if(use_cache && !progress.get_cancel()) {
+		progress.set_substatus("Writing BVH to cache");
+		BVHCache::write(cache_key, pack);
+	}
 }
 
 /* Refitting */
 
-void BVH::refit(Progress& progress)
+bool BVH::refit(Progress& progress)
 {
+	if(build_root != NULL) {
+		return refit_build_nodes(progress);
+	}
+
+	/* Instances are merged into packed nodes of the top level BVH, so those
+	 * can not be refitted in place.
+	 */
+	if(params.top_level) {
+		return false;
+	}
+
 	progress.set_substatus("Packing BVH primitives");
 	pack_primitives();
 
-	if(progress.get_cancel()) return;
+	if(progress.get_cancel()) return true;
 
 	progress.set_substatus("Refitting BVH nodes");
 	refit_nodes();
+
+	return true;
+}
+
+bool BVH::refit_build_nodes(Progress& progress)
+{
+	/* Start from references as they were created by the builder, packing
+	 * will offset them and merge instances again.
+	 */
+	pack.prim_type = build_prim_type;
+	pack.prim_index = build_prim_index;
+	pack.prim_object = build_prim_object;
+	pack.prim_time = build_prim_time;
+
+	progress.set_substatus("Refitting BVH nodes");
+	refit_build_node(build_root);
+
+	/* Topology of the tree might be far from optimal for the new primitive
+	 * positions, in which case it's cheaper to build new tree than to trace
+	 * rays through the refitted one.
+	 */
+	const float sah_cost = build_root->computeSubtreeSAHCost(params);
+	const float sah_cost_ratio = (build_sah_cost > 0.0f)
+	                                     ? sah_cost / build_sah_cost
+	                                     : 1.0f;
+	VLOG(1) << "BVH refit SAH cost ratio: " << sah_cost_ratio;
+	if(sah_cost_ratio > params.refit_max_sah_cost_ratio) {
+		VLOG(1) << "BVH quality degraded too much after refit, rebuilding.";
+		return false;
+	}
+
+	if(progress.get_cancel()) return true;
+
+	progress.set_substatus("Packing BVH triangles and strands");
+	pack_primitives();
+
+	if(progress.get_cancel()) return true;
+
+	progress.set_substatus("Packing BVH nodes");
+	pack_nodes(build_root);
+
+	return true;
+}
+
+void BVH::refit_build_node(BVHNode *node)
+{
+	BoundBox bbox = BoundBox::empty;
+	uint visibility = 0;
+
+	if(node->is_leaf()) {
+		const LeafNode *leaf = reinterpret_cast<const LeafNode*>(node);
+		refit_primitives(leaf->lo, leaf->hi, false, bbox, visibility);
+	}
+	else {
+		for(int i = 0; i < node->num_children(); i++) {
+			BVHNode *child = node->get_child(i);
+			refit_build_node(child);
+			bbox.grow(child->bounds);
+			visibility |= child->visibility;
+		}
+	}
+
+	node->bounds = bbox;
+	node->visibility = visibility;
 }
 
 void BVH::refit_primitives(int start, int end, BoundBox& bbox, uint& visibility)
+{
+	/* Primitive indices of the packed top level BVH are offset by the
+	 * mesh offsets in the global arrays.
+	 */
+	refit_primitives(start, end, params.top_level, bbox, visibility);
+}
+
+void BVH::refit_primitives(int start,
+                           int end,
+                           bool use_mesh_offsets,
+                           BoundBox& bbox,
+                           uint& visibility)
 {
 	/* Refit range of primitives. */
 	for(int prim = start; prim < end; prim++) {
@@ -126,7 +277,7 @@ void BVH::refit_primitives(int start, int end, BoundBox& bbox, uint& visibility)
 
 			if(pack.prim_type[prim] & PRIMITIVE_ALL_CURVE) {
 				/* Curves. */
-				int str_offset = (params.top_level)? mesh->curve_offset: 0;
+				int str_offset = (use_mesh_offsets)? mesh->curve_offset: 0;
 				Mesh::Curve curve = mesh->get_curve(pidx - str_offset);
 				int k = PRIMITIVE_UNPACK_SEGMENT(pack.prim_type[prim]);
 
@@ -150,7 +301,7 @@ void BVH::refit_primitives(int start, int end, BoundBox& bbox, uint& visibility)
 			}
 			else {
 				/* Triangles. */
-				int tri_offset = (params.top_level)? mesh->tri_offset: 0;
+				int tri_offset = (use_mesh_offsets)? mesh->tri_offset: 0;
 				Mesh::Triangle triangle = mesh->get_triangle(pidx - tri_offset);
 				const float3 *vpos = &mesh->verts[0];
 
@@ -249,6 +400,7 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 	 * top level BVH, adjusting indexes and offsets where appropriate.
 	 */
 	const bool use_qbvh = params.use_qbvh;
+	const bool use_obvh = params.use_obvh;
 
 	/* Adjust primitive index to point to the triangle in the global array, for
 	 * meshes with transform applied and already in the top level BVH.
@@ -424,7 +576,17 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 
 			for(size_t i = 0, j = 0; i < bvh_nodes_size; j++) {
 				size_t nsize, nsize_bbox;
-				if(bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) {
+				if(use_obvh) {
+					if(bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) {
+						nsize = BVH_UNALIGNED_ONODE_SIZE;
+						nsize_bbox = 25;
+					}
+					else {
+						nsize = BVH_ONODE_SIZE;
+						nsize_bbox = 13;
+					}
+				}
+				else if(bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) {
 					nsize = use_qbvh
 					            ? BVH_UNALIGNED_QNODE_SIZE
 					            : BVH_UNALIGNED_NODE_SIZE;
@@ -445,19 +607,33 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 				data.z += (data.z < 0)? -noffset_leaf: noffset;
 				data.w += (data.w < 0)? -noffset_leaf: noffset;
 
-				if(use_qbvh) {
+				if(use_qbvh || use_obvh) {
 					data.x += (data.x < 0)? -noffset_leaf: noffset;
 					data.y += (data.y < 0)? -noffset_leaf: noffset;
 				}
 
 				pack_nodes[pack_nodes_offset + nsize_bbox] = data;
 
+				/* Octo nodes have children 4-7 stored in the next int4. */
+				size_t nsize_children = 1;
+				if(use_obvh) {
+					int4 data = bvh_nodes[i + nsize_bbox + 1];
+
+					data.x += (data.x < 0)? -noffset_leaf: noffset;
+					data.y += (data.y < 0)? -noffset_leaf: noffset;
+					data.z += (data.z < 0)? -noffset_leaf: noffset;
+					data.w += (data.w < 0)? -noffset_leaf: noffset;
+
+					pack_nodes[pack_nodes_offset + nsize_bbox + 1] = data;
+					nsize_children = 2;
+				}
+
 				/* Usually this copies nothing, but we better
 				 * be prepared for possible node size extension.
 				 */
-				memcpy(&pack_nodes[pack_nodes_offset + nsize_bbox+1],
-				       &bvh_nodes[i + nsize_bbox+1],
-				       sizeof(int4) * (nsize - (nsize_bbox+1)));
+				memcpy(&pack_nodes[pack_nodes_offset + nsize_bbox+nsize_children],
+				       &bvh_nodes[i + nsize_bbox+nsize_children],
+				       sizeof(int4) * (nsize - (nsize_bbox+nsize_children)));
 
 				pack_nodes_offset += nsize;
 				i += nsize;
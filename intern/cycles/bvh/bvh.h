@@ -83,16 +83,43 @@ public:
 	vector<Object*> objects;
 
 	static BVH *create(const BVHParams& params, const vector<Object*>& objects);
-	virtual ~BVH() {}
+	virtual ~BVH();
 
 	void build(Progress& progress);
-	void refit(Progress& progress);
+
+	/* Update bounds of the BVH for the new primitive positions. Returns false
+	 * when the BVH is to be built from scratch instead, which happens when
+	 * refitted build nodes degraded too much in quality.
+	 */
+	bool refit(Progress& progress);
+
+	/* Whether build nodes were kept, see BVHParams::keep_build_nodes. */
+	bool has_build_nodes() const { return build_root != NULL; }
 
 protected:
 	BVH(const BVHParams& params, const vector<Object*>& objects);
 
+	/* Build nodes and primitive references as they were created by the
+	 * builder, only kept when BVHParams::keep_build_nodes is set.
+	 */
+	BVHNode *build_root;
+	float build_sah_cost;
+	array<int> build_prim_type;
+	array<int> build_prim_index;
+	array<int> build_prim_object;
+	array<float2> build_prim_time;
+
 	/* Refit range of primitives. */
 	void refit_primitives(int start, int end, BoundBox& bbox, uint& visibility);
+	void refit_primitives(int start,
+	                      int end,
+	                      bool use_mesh_offsets,
+	                      BoundBox& bbox,
+	                      uint& visibility);
+
+	/* Refit kept build nodes and pack them again. */
+	bool refit_build_nodes(Progress& progress);
+	void refit_build_node(BVHNode *node);
 
 	/* triangles and strands */
 	void pack_primitives();
@@ -23,6 +23,8 @@
 
 #include "util/util_algorithm.h"
 #include "util/util_boundbox.h"
+#include "util/util_foreach.h"
+#include "util/util_task.h"
 #include "util/util_types.h"
 
 CCL_NAMESPACE_BEGIN
@@ -52,16 +54,36 @@ __forceinline int get_best_dimension(const float4& bestSAH)
 
 /* BVH Object Binning */
 
+void BVHObjectBinning::Bins::reset(size_t num_bins)
+{
+	for(size_t i = 0; i < num_bins; i++) {
+		count[i] = make_int4(0);
+		bounds[i][0] = bounds[i][1] = bounds[i][2] = BoundBox::empty;
+	}
+}
+
+void BVHObjectBinning::Bins::merge(const Bins& other, size_t num_bins)
+{
+	for(size_t i = 0; i < num_bins; i++) {
+		count[i] = count[i] + other.count[i];
+		bounds[i][0].grow(other.bounds[i][0]);
+		bounds[i][1].grow(other.bounds[i][1]);
+		bounds[i][2].grow(other.bounds[i][2]);
+	}
+}
+
 BVHObjectBinning::BVHObjectBinning(const BVHRange& job,
                                    BVHReference *prims,
                                    const BVHUnaligned *unaligned_heuristic,
-                                   const Transform *aligned_space)
+                                   const Transform *aligned_space,
+                                   bool use_parallel_binning)
 : BVHRange(job),
   splitSAH(FLT_MAX),
   dim(0),
   pos(0),
   unaligned_heuristic_(unaligned_heuristic),
-  aligned_space_(aligned_space)
+  aligned_space_(aligned_space),
+  use_parallel_binning_(use_parallel_binning)
 {
 	if(aligned_space_ == NULL) {
 		bounds_ = bounds();
@@ -82,57 +104,19 @@ BVHObjectBinning::BVHObjectBinning(const BVHRange& job,
 	num_bins = min(size_t(MAX_BINS), size_t(4.0f + 0.05f*size()));
 	scale = rcp(cent_bounds_.size()) * make_float3((float)num_bins);
 
-	/* initialize binning counter and bounds */
-	BoundBox bin_bounds[MAX_BINS][4];	/* bounds for every bin in every dimension */
-	int4 bin_count[MAX_BINS];			/* number of primitives mapped to bin */
-
-	for(size_t i = 0; i < num_bins; i++) {
-		bin_count[i] = make_int4(0);
-		bin_bounds[i][0] = bin_bounds[i][1] = bin_bounds[i][2] = BoundBox::empty;
+	/* map geometry to bins */
+	Bins bins;
+	if(use_parallel_binning_ && size() > PARALLEL_BINNING_SIZE) {
+		bin_primitives_parallel(prims, &bins);
 	}
-
-	/* map geometry to bins, unrolled once */
-	{
-		ssize_t i;
-
-		for(i = 0; i < ssize_t(size()) - 1; i += 2) {
-			prefetch_L2(&prims[start() + i + 8]);
-
-			/* map even and odd primitive to bin */
-			const BVHReference& prim0 = prims[start() + i + 0];
-			const BVHReference& prim1 = prims[start() + i + 1];
-
-			BoundBox bounds0 = get_prim_bounds(prim0);
-			BoundBox bounds1 = get_prim_bounds(prim1);
-
-			int4 bin0 = get_bin(bounds0);
-			int4 bin1 = get_bin(bounds1);
-
-			/* increase bounds for bins for even primitive */
-			int b00 = (int)extract<0>(bin0); bin_count[b00][0]++; bin_bounds[b00][0].grow(bounds0);
-			int b01 = (int)extract<1>(bin0); bin_count[b01][1]++; bin_bounds[b01][1].grow(bounds0);
-			int b02 = (int)extract<2>(bin0); bin_count[b02][2]++; bin_bounds[b02][2].grow(bounds0);
-
-			/* increase bounds of bins for odd primitive */
-			int b10 = (int)extract<0>(bin1); bin_count[b10][0]++; bin_bounds[b10][0].grow(bounds1);
-			int b11 = (int)extract<1>(bin1); bin_count[b11][1]++; bin_bounds[b11][1].grow(bounds1);
-			int b12 = (int)extract<2>(bin1); bin_count[b12][2]++; bin_bounds[b12][2].grow(bounds1);
-		}
-
-		/* for uneven number of primitives */
-		if(i < ssize_t(size())) {
-			/* map primitive to bin */
-			const BVHReference& prim0 = prims[start() + i];
-			BoundBox bounds0 = get_prim_bounds(prim0);
-			int4 bin0 = get_bin(bounds0);
-
-			/* increase bounds of bins */
-			int b00 = (int)extract<0>(bin0); bin_count[b00][0]++; bin_bounds[b00][0].grow(bounds0);
-			int b01 = (int)extract<1>(bin0); bin_count[b01][1]++; bin_bounds[b01][1].grow(bounds0);
-			int b02 = (int)extract<2>(bin0); bin_count[b02][2]++; bin_bounds[b02][2].grow(bounds0);
-		}
+	else {
+		bins.reset(num_bins);
+		bin_primitives(prims, 0, size(), &bins);
 	}
 
+	BoundBox (*bin_bounds)[4] = bins.bounds;
+	const int4 *bin_count = bins.count;
+
 	/* sweep from right to left and compute parallel prefix of merged bounds */
 	float4 r_area[MAX_BINS];	/* area of bounds of primitives on the right */
 	float4 r_count[MAX_BINS];	/* number of primitives on the right */
@@ -188,6 +172,85 @@ BVHObjectBinning::BVHObjectBinning(const BVHRange& job,
 	leafSAH = bounds_.half_area() * blocks(size());
 }
 
+void BVHObjectBinning::bin_primitives(const BVHReference *prims,
+                                      size_t begin,
+                                      size_t end,
+                                      Bins *bins) const
+{
+	BoundBox (*bin_bounds)[4] = bins->bounds;
+	int4 *bin_count = bins->count;
+
+	/* map geometry to bins, unrolled once */
+	ssize_t i;
+
+	for(i = begin; i < ssize_t(end) - 1; i += 2) {
+		prefetch_L2(&prims[start() + i + 8]);
+
+		/* map even and odd primitive to bin */
+		const BVHReference& prim0 = prims[start() + i + 0];
+		const BVHReference& prim1 = prims[start() + i + 1];
+
+		BoundBox bounds0 = get_prim_bounds(prim0);
+		BoundBox bounds1 = get_prim_bounds(prim1);
+
+		int4 bin0 = get_bin(bounds0);
+		int4 bin1 = get_bin(bounds1);
+
+		/* increase bounds for bins for even primitive */
+		int b00 = (int)extract<0>(bin0); bin_count[b00][0]++; bin_bounds[b00][0].grow(bounds0);
+		int b01 = (int)extract<1>(bin0); bin_count[b01][1]++; bin_bounds[b01][1].grow(bounds0);
+		int b02 = (int)extract<2>(bin0); bin_count[b02][2]++; bin_bounds[b02][2].grow(bounds0);
+
+		/* increase bounds of bins for odd primitive */
+		int b10 = (int)extract<0>(bin1); bin_count[b10][0]++; bin_bounds[b10][0].grow(bounds1);
+		int b11 = (int)extract<1>(bin1); bin_count[b11][1]++; bin_bounds[b11][1].grow(bounds1);
+		int b12 = (int)extract<2>(bin1); bin_count[b12][2]++; bin_bounds[b12][2].grow(bounds1);
+	}
+
+	/* for uneven number of primitives */
+	if(i < ssize_t(end)) {
+		/* map primitive to bin */
+		const BVHReference& prim0 = prims[start() + i];
+		BoundBox bounds0 = get_prim_bounds(prim0);
+		int4 bin0 = get_bin(bounds0);
+
+		/* increase bounds of bins */
+		int b00 = (int)extract<0>(bin0); bin_count[b00][0]++; bin_bounds[b00][0].grow(bounds0);
+		int b01 = (int)extract<1>(bin0); bin_count[b01][1]++; bin_bounds[b01][1].grow(bounds0);
+		int b02 = (int)extract<2>(bin0); bin_count[b02][2]++; bin_bounds[b02][2].grow(bounds0);
+	}
+}
+
+void BVHObjectBinning::bin_primitives_parallel(const BVHReference *prims,
+                                               Bins *bins) const
+{
+	/* Every chunk is binned into its own storage, so tasks don't need any
+	 * synchronization. Bins are merged afterwards, which gives exactly the
+	 * same result as the single threaded binning.
+	 */
+	const size_t num_chunks = divide_up(size(), PARALLEL_BINNING_SIZE);
+	vector<Bins> chunk_bins(num_chunks);
+
+	TaskPool pool;
+	for(size_t chunk = 0; chunk < num_chunks; chunk++) {
+		const size_t begin = chunk * PARALLEL_BINNING_SIZE;
+		const size_t end = min(begin + PARALLEL_BINNING_SIZE, size_t(size()));
+		chunk_bins[chunk].reset(num_bins);
+		pool.push(function_bind(&BVHObjectBinning::bin_primitives,
+		                        this,
+		                        prims,
+		                        begin,
+		                        end,
+		                        &chunk_bins[chunk]));
+	}
+	pool.wait_work();
+
+	bins->reset(num_bins);
+	foreach(const Bins& chunk, chunk_bins) {
+		bins->merge(chunk, num_bins);
+	}
+}
+
 void BVHObjectBinning::split(BVHReference* prims,
                              BVHObjectBinning& left_o,
                              BVHObjectBinning& right_o) const
@@ -224,8 +287,10 @@ void BVHObjectBinning::split(BVHReference* prims,
 	}
 	/* finish */
 	if(l != 0 && N-1-r != 0) {
-		right_o = BVHObjectBinning(BVHRange(rgeom_bounds, rcent_bounds, start() + l, N-1-r), prims);
-		left_o  = BVHObjectBinning(BVHRange(lgeom_bounds, lcent_bounds, start(), l), prims);
+		right_o = BVHObjectBinning(BVHRange(rgeom_bounds, rcent_bounds, start() + l, N-1-r),
+		                           prims, NULL, NULL, use_parallel_binning_);
+		left_o  = BVHObjectBinning(BVHRange(lgeom_bounds, lcent_bounds, start(), l),
+		                           prims, NULL, NULL, use_parallel_binning_);
 		return;
 	}
 
@@ -246,8 +311,10 @@ void BVHObjectBinning::split(BVHReference* prims,
 		rcent_bounds.grow(prims[start()+i].bounds().center2());
 	}
 
-	right_o = BVHObjectBinning(BVHRange(rgeom_bounds, rcent_bounds, start() + N/2, N/2 + N%2), prims);
-	left_o  = BVHObjectBinning(BVHRange(lgeom_bounds, lcent_bounds, start(), N/2), prims);
+	right_o = BVHObjectBinning(BVHRange(rgeom_bounds, rcent_bounds, start() + N/2, N/2 + N%2),
+	                           prims, NULL, NULL, use_parallel_binning_);
+	left_o  = BVHObjectBinning(BVHRange(lgeom_bounds, lcent_bounds, start(), N/2),
+	                           prims, NULL, NULL, use_parallel_binning_);
 }
 
 CCL_NAMESPACE_END
@@ -22,27 +22,33 @@
 #include "bvh/bvh_unaligned.h"
 
 #include "util/util_types.h"
+#include "util/util_vector.h"
 
 CCL_NAMESPACE_BEGIN
 
 class BVHBuild;
 
-/* Single threaded object binner. Finds the split with the best SAH heuristic
+/* Object binner. Finds the split with the best SAH heuristic
  * by testing for each dimension multiple partitionings for regular spaced
  * partition locations. A partitioning for a partition location is computed,
  * by putting primitives whose centroid is on the left and right of the split
  * location to different sets. The SAH is evaluated by computing the number of
- * blocks occupied by the primitives in the partitions. */
+ * blocks occupied by the primitives in the partitions.
+ *
+ * Big ranges (which are the upper levels of the tree) can optionally be binned
+ * in chunks from all threads of the task scheduler. */
 
 class BVHObjectBinning : public BVHRange
 {
 public:
-	__forceinline BVHObjectBinning() : leafSAH(FLT_MAX) {}
+	__forceinline BVHObjectBinning()
+	: leafSAH(FLT_MAX), use_parallel_binning_(false) {}
 
 	BVHObjectBinning(const BVHRange& job,
 	                 BVHReference *prims,
 	                 const BVHUnaligned *unaligned_heuristic = NULL,
-	                 const Transform *aligned_space = NULL);
+	                 const Transform *aligned_space = NULL,
+	                 bool use_parallel_binning = false);
 
 	void split(BVHReference *prims,
 	           BVHObjectBinning& left_o,
@@ -66,9 +72,33 @@ protected:
 	const BVHUnaligned *unaligned_heuristic_;
 	const Transform *aligned_space_;
 
+	/* Bin primitives of big ranges from multiple threads. */
+	bool use_parallel_binning_;
+
 	enum { MAX_BINS = 32 };
 	enum { LOG_BLOCK_SIZE = 2 };
 
+	/* Ranges smaller than this are always binned from the calling thread,
+	 * the size of a chunk which is binned by a single task otherwise.
+	 */
+	enum { PARALLEL_BINNING_SIZE = 65536 };
+
+	/* Bounds and primitive counters of all bins in every dimension. */
+	struct Bins {
+		BoundBox bounds[MAX_BINS][4];
+		int4 count[MAX_BINS];
+
+		void reset(size_t num_bins);
+		void merge(const Bins& other, size_t num_bins);
+	};
+
+	/* Map primitives from the given sub-range of the job into the bins. */
+	void bin_primitives(const BVHReference *prims,
+	                    size_t begin,
+	                    size_t end,
+	                    Bins *bins) const;
+	void bin_primitives_parallel(const BVHReference *prims, Bins *bins) const;
+
 	/* computes the bin numbers for each dimension for a box. */
 	__forceinline int4 get_bin(const BoundBox& box) const
 	{
@@ -116,7 +116,11 @@ BVHBuild::~BVHBuild()
 
 /* Adding References */
 
-void BVHBuild::add_reference_triangles(BoundBox& root, BoundBox& center, Mesh *mesh, int i)
+void BVHBuild::add_reference_triangles(vector<BVHReference>& refs,
+                                       BoundBox& root,
+                                       BoundBox& center,
+                                       Mesh *mesh,
+                                       int i)
 {
 	const Attribute *attr_mP = NULL;
 	if(mesh->has_motion_blur()) {
@@ -130,10 +134,10 @@ void BVHBuild::add_reference_triangles(BoundBox& root, BoundBox& center, Mesh *m
 			BoundBox bounds = BoundBox::empty;
 			t.bounds_grow(verts, bounds);
 			if(bounds.valid() && t.valid(verts)) {
-				references.push_back(BVHReference(bounds,
-				                                  j,
-				                                  i,
-				                                  PRIMITIVE_TRIANGLE));
+				refs.push_back(BVHReference(bounds,
+				                            j,
+				                            i,
+				                            PRIMITIVE_TRIANGLE));
 				root.grow(bounds);
 				center.grow(bounds.center2());
 			}
@@ -153,7 +157,7 @@ void BVHBuild::add_reference_triangles(BoundBox& root, BoundBox& center, Mesh *m
 				t.bounds_grow(vert_steps + step*num_verts, bounds);
 			}
 			if(bounds.valid()) {
-				references.push_back(
+				refs.push_back(
 				        BVHReference(bounds,
 				                     j,
 				                     i,
@@ -205,7 +209,7 @@ void BVHBuild::add_reference_triangles(BoundBox& root, BoundBox& center, Mesh *m
 				bounds.grow(curr_bounds);
 				if(bounds.valid()) {
 					const float prev_time = (float)(bvh_step - 1) * num_bvh_steps_inv_1;
-					references.push_back(
+					refs.push_back(
 					        BVHReference(bounds,
 					                     j,
 					                     i,
@@ -224,7 +228,11 @@ void BVHBuild::add_reference_triangles(BoundBox& root, BoundBox& center, Mesh *m
 	}
 }
 
-void BVHBuild::add_reference_curves(BoundBox& root, BoundBox& center, Mesh *mesh, int i)
+void BVHBuild::add_reference_curves(vector<BVHReference>& refs,
+                                    BoundBox& root,
+                                    BoundBox& center,
+                                    Mesh *mesh,
+                                    int i)
 {
 	const Attribute *curve_attr_mP = NULL;
 	if(mesh->has_motion_blur()) {
@@ -241,7 +249,7 @@ void BVHBuild::add_reference_curves(BoundBox& root, BoundBox& center, Mesh *mesh
 				curve.bounds_grow(k, &mesh->curve_keys[0], curve_radius, bounds);
 				if(bounds.valid()) {
 					int packed_type = PRIMITIVE_PACK_SEGMENT(PRIMITIVE_CURVE, k);
-					references.push_back(BVHReference(bounds, j, i, packed_type));
+					refs.push_back(BVHReference(bounds, j, i, packed_type));
 					root.grow(bounds);
 					center.grow(bounds.center2());
 				}
@@ -265,10 +273,10 @@ void BVHBuild::add_reference_curves(BoundBox& root, BoundBox& center, Mesh *mesh
 				}
 				if(bounds.valid()) {
 					int packed_type = PRIMITIVE_PACK_SEGMENT(PRIMITIVE_MOTION_CURVE, k);
-					references.push_back(BVHReference(bounds,
-					                                  j,
-					                                  i,
-					                                  packed_type));
+					refs.push_back(BVHReference(bounds,
+					                            j,
+					                            i,
+					                            packed_type));
 					root.grow(bounds);
 					center.grow(bounds.center2());
 				}
@@ -318,12 +326,12 @@ void BVHBuild::add_reference_curves(BoundBox& root, BoundBox& center, Mesh *mesh
 					if(bounds.valid()) {
 						const float prev_time = (float)(bvh_step - 1) * num_bvh_steps_inv_1;
 						int packed_type = PRIMITIVE_PACK_SEGMENT(PRIMITIVE_MOTION_CURVE, k);
-						references.push_back(BVHReference(bounds,
-						                                  j,
-						                                  i,
-						                                  packed_type,
-						                                  prev_time,
-						                                  curr_time));
+						refs.push_back(BVHReference(bounds,
+						                            j,
+						                            i,
+						                            packed_type,
+						                            prev_time,
+						                            curr_time));
 						root.grow(bounds);
 						center.grow(bounds.center2());
 					}
@@ -337,19 +345,27 @@ void BVHBuild::add_reference_curves(BoundBox& root, BoundBox& center, Mesh *mesh
 	}
 }
 
-void BVHBuild::add_reference_mesh(BoundBox& root, BoundBox& center, Mesh *mesh, int i)
+void BVHBuild::add_reference_mesh(vector<BVHReference>& refs,
+                                  BoundBox& root,
+                                  BoundBox& center,
+                                  Mesh *mesh,
+                                  int i)
 {
 	if(params.primitive_mask & PRIMITIVE_ALL_TRIANGLE) {
-		add_reference_triangles(root, center, mesh, i);
+		add_reference_triangles(refs, root, center, mesh, i);
 	}
 	if(params.primitive_mask & PRIMITIVE_ALL_CURVE) {
-		add_reference_curves(root, center, mesh, i);
+		add_reference_curves(refs, root, center, mesh, i);
 	}
 }
 
-void BVHBuild::add_reference_object(BoundBox& root, BoundBox& center, Object *ob, int i)
+void BVHBuild::add_reference_object(vector<BVHReference>& refs,
+                                    BoundBox& root,
+                                    BoundBox& center,
+                                    Object *ob,
+                                    int i)
 {
-	references.push_back(BVHReference(ob->bounds, -1, i, 0));
+	refs.push_back(BVHReference(ob->bounds, -1, i, 0));
 	root.grow(ob->bounds);
 	center.grow(ob->bounds.center2());
 }
@@ -364,60 +380,125 @@ static size_t count_curve_segments(Mesh *mesh)
 	return num;
 }
 
+void BVHBuild::add_references_object(vector<BVHReference>& refs,
+                                     BoundBox& root,
+                                     BoundBox& center,
+                                     int i)
+{
+	Object *ob = objects[i];
+	if(params.top_level) {
+		if(!ob->is_traceable()) {
+			return;
+		}
+		if(!ob->mesh->is_instanced())
+			add_reference_mesh(refs, root, center, ob->mesh, i);
+		else
+			add_reference_object(refs, root, center, ob, i);
+	}
+	else
+		add_reference_mesh(refs, root, center, ob->mesh, i);
+}
+
+void BVHBuild::thread_add_references(BVHReferencesChunk *chunk)
+{
+	if(progress.get_cancel())
+		return;
+
+	for(int i = chunk->object_start; i < chunk->object_end; i++) {
+		add_references_object(chunk->references, chunk->bounds, chunk->center, i);
+	}
+}
+
 void BVHBuild::add_references(BVHRange& root)
 {
 	/* reserve space for references */
 	size_t num_alloc_references = 0;
 
+	/* Chunks of objects used for the parallel references gathering, split
+	 * so every chunk has roughly THREAD_TASK_SIZE primitives.
+	 */
+	vector<BVHReferencesChunk> chunks;
+	size_t num_chunk_references = 0;
+	int i = 0;
+
 	foreach(Object *ob, objects) {
+		size_t num_object_references = 0;
 		if(params.top_level) {
 			if(!ob->is_traceable()) {
+				++i;
 				continue;
 			}
 			if(!ob->mesh->is_instanced()) {
 				if(params.primitive_mask & PRIMITIVE_ALL_TRIANGLE) {
-					num_alloc_references += ob->mesh->num_triangles();
+					num_object_references += ob->mesh->num_triangles();
 				}
 				if(params.primitive_mask & PRIMITIVE_ALL_CURVE) {
-					num_alloc_references += count_curve_segments(ob->mesh);
+					num_object_references += count_curve_segments(ob->mesh);
 				}
 			}
 			else
-				num_alloc_references++;
+				num_object_references++;
 		}
 		else {
 			if(params.primitive_mask & PRIMITIVE_ALL_TRIANGLE) {
-				num_alloc_references += ob->mesh->num_triangles();
+				num_object_references += ob->mesh->num_triangles();
 			}
 			if(params.primitive_mask & PRIMITIVE_ALL_CURVE) {
-				num_alloc_references += count_curve_segments(ob->mesh);
+				num_object_references += count_curve_segments(ob->mesh);
 			}
 		}
+		num_alloc_references += num_object_references;
+
+		if(params.use_parallel_build) {
+			if(chunks.size() == 0 || num_chunk_references >= THREAD_TASK_SIZE) {
+				chunks.push_back(BVHReferencesChunk());
+				chunks.back().object_start = i;
+				num_chunk_references = 0;
+			}
+			chunks.back().object_end = i + 1;
+			num_chunk_references += num_object_references;
+		}
+
+		++i;
 	}
 
 	references.reserve(num_alloc_references);
 
 	/* add references from objects */
 	BoundBox bounds = BoundBox::empty, center = BoundBox::empty;
-	int i = 0;
 
-	foreach(Object *ob, objects) {
-		if(params.top_level) {
-			if(!ob->is_traceable()) {
-				++i;
-				continue;
-			}
-			if(!ob->mesh->is_instanced())
-				add_reference_mesh(bounds, center, ob->mesh, i);
-			else
-				add_reference_object(bounds, center, ob, i);
+	if(chunks.size() > 1) {
+		/* Gather references of every chunk in its own storage, and append
+		 * them in the order of objects afterwards, so the result is exactly
+		 * the same as with the single threaded gathering below.
+		 */
+		TaskPool pool;
+		foreach(BVHReferencesChunk& chunk, chunks) {
+			chunk.bounds = BoundBox::empty;
+			chunk.center = BoundBox::empty;
+			pool.push(function_bind(&BVHBuild::thread_add_references,
+			                        this,
+			                        &chunk));
 		}
-		else
-			add_reference_mesh(bounds, center, ob->mesh, i);
-
-		i++;
+		pool.wait_work();
 
 		if(progress.get_cancel()) return;
+
+		foreach(BVHReferencesChunk& chunk, chunks) {
+			references.insert(references.end(),
+			                  chunk.references.begin(),
+			                  chunk.references.end());
+			chunk.references.free_memory();
+			bounds.grow(chunk.bounds);
+			center.grow(chunk.center);
+		}
+	}
+	else {
+		for(i = 0; i < (int)objects.size(); i++) {
+			add_references_object(references, bounds, center, i);
+
+			if(progress.get_cancel()) return;
+		}
 	}
 
 	/* happens mostly on empty meshes */
@@ -498,7 +579,11 @@ BVHNode* BVHBuild::run()
 	}
 	else {
 		/* Perform multithreaded binning build. */
-		BVHObjectBinning rootbin(root, (references.size())? &references[0]: NULL);
+		BVHObjectBinning rootbin(root,
+		                         (references.size())? &references[0]: NULL,
+		                         NULL,
+		                         NULL,
+		                         params.use_parallel_build);
 		rootnode = build_node(rootbin, 0);
 		task_pool.wait_work();
 	}
@@ -662,7 +747,8 @@ BVHNode* BVHBuild::build_node(const BVHObjectBinning& range, int level)
 		unaligned_range = BVHObjectBinning(range,
 		                                   &references[0],
 		                                   &unaligned_heuristic,
-		                                   &aligned_space);
+		                                   &aligned_space,
+		                                   params.use_parallel_build);
 		unalignedSplitSAH = params.sah_node_cost * unaligned_range.unaligned_bounds().half_area() +
 		                    params.sah_primitive_cost * unaligned_range.splitSAH;
 		unalignedLeafSAH = params.sah_primitive_cost * unaligned_range.leafSAH;
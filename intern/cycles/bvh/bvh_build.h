@@ -63,11 +63,41 @@ protected:
 	friend class BVHSpatialSplitBuildTask;
 	friend class BVHObjectBinning;
 
+	/* Range of objects for which references are gathered by a single task,
+	 * used by the parallel build.
+	 */
+	struct BVHReferencesChunk {
+		int object_start, object_end;
+		vector<BVHReference> references;
+		BoundBox bounds;
+		BoundBox center;
+	};
+
 	/* Adding references. */
-	void add_reference_triangles(BoundBox& root, BoundBox& center, Mesh *mesh, int i);
-	void add_reference_curves(BoundBox& root, BoundBox& center, Mesh *mesh, int i);
-	void add_reference_mesh(BoundBox& root, BoundBox& center, Mesh *mesh, int i);
-	void add_reference_object(BoundBox& root, BoundBox& center, Object *ob, int i);
+	void add_reference_triangles(vector<BVHReference>& refs,
+	                             BoundBox& root,
+	                             BoundBox& center,
+	                             Mesh *mesh,
+	                             int i);
+	void add_reference_curves(vector<BVHReference>& refs,
+	                          BoundBox& root,
+	                          BoundBox& center,
+	                          Mesh *mesh,
+	                          int i);
+	void add_reference_mesh(vector<BVHReference>& refs,
+	                        BoundBox& root,
+	                        BoundBox& center,
+	                        Mesh *mesh,
+	                        int i);
+	void add_reference_object(vector<BVHReference>& refs,
+	                          BoundBox& root,
+	                          BoundBox& center,
+	                          Object *ob,
+	                          int i);
+	void add_references_object(vector<BVHReference>& refs,
+	                           BoundBox& root,
+	                           BoundBox& center,
+	                           int i);
 	void add_references(BVHRange& root);
 
 	/* Building. */
@@ -95,6 +125,7 @@ protected:
 	                                     vector<BVHReference> *references,
 	                                     int level,
 	                                     int thread_id);
+	void thread_add_references(BVHReferencesChunk *chunk);
 	thread_mutex build_mutex;
 
 	/* Progress. */
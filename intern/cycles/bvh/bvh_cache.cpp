@@ -0,0 +1,366 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bvh/bvh_cache.h"
+
+#include <stdio.h>
+
+#include "bvh/bvh.h"
+#include "bvh/bvh_params.h"
+
+#include "render/attribute.h"
+#include "render/mesh.h"
+#include "render/object.h"
+
+#include "util/util_foreach.h"
+#include "util/util_logging.h"
+#include "util/util_md5.h"
+#include "util/util_path.h"
+#include "util/util_thread.h"
+#include "util/util_time.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Increase when layout of the packed BVH or of the cache file changes. */
+#define BVH_CACHE_VERSION 1
+
+/* Size of the cache directory, least recently used files are removed when it
+ * is exceeded. */
+#define BVH_CACHE_MAX_SIZE ((size_t)4 << 30)
+
+static const char bvh_cache_magic[8] = {'C', 'Y', 'C', 'L', 'B', 'V', 'H', '\0'};
+
+/* Hashing */
+
+static void hash_data(MD5Hash& md5, const void *data, size_t size)
+{
+	/* MD5Hash only takes int sizes, feed big arrays in pieces. */
+	const uint8_t *bytes = (const uint8_t*)data;
+	const size_t max_chunk_size = 1 << 30;
+	while(size > 0) {
+		const size_t chunk_size = min(size, max_chunk_size);
+		md5.append(bytes, (int)chunk_size);
+		bytes += chunk_size;
+		size -= chunk_size;
+	}
+}
+
+template<typename T>
+static void hash_array(MD5Hash& md5, const array<T>& data)
+{
+	const uint64_t size = data.size();
+	hash_data(md5, &size, sizeof(size));
+	hash_data(md5, data.data(), data.size() * sizeof(T));
+}
+
+static void hash_float3(MD5Hash& md5, const float3 *data, size_t size)
+{
+	/* Padding of float3 is not initialized, only hash actual coordinates. */
+	const size_t block_size = 1024;
+	float block[block_size * 3];
+	for(size_t i = 0; i < size; i += block_size) {
+		const size_t num = min(block_size, size - i);
+		for(size_t j = 0; j < num; j++) {
+			block[j*3 + 0] = data[i + j].x;
+			block[j*3 + 1] = data[i + j].y;
+			block[j*3 + 2] = data[i + j].z;
+		}
+		hash_data(md5, block, num * 3 * sizeof(float));
+	}
+}
+
+static void hash_float3_array(MD5Hash& md5, const array<float3>& data)
+{
+	const uint64_t size = data.size();
+	hash_data(md5, &size, sizeof(size));
+	hash_float3(md5, data.data(), data.size());
+}
+
+static void hash_motion_attribute(MD5Hash& md5,
+                                  const AttributeSet& attributes,
+                                  size_t num_elements,
+                                  size_t num_steps)
+{
+	const Attribute *attr_mP = attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
+	const int has_motion = (attr_mP != NULL);
+	hash_data(md5, &has_motion, sizeof(has_motion));
+	if(attr_mP != NULL && num_steps > 1) {
+		hash_float3(md5,
+		            ((Attribute*)attr_mP)->data_float3(),
+		            num_elements * (num_steps - 1));
+	}
+}
+
+static void hash_mesh(MD5Hash& md5, const Mesh *mesh)
+{
+	const int settings[] = {(int)mesh->motion_steps,
+	                        mesh->use_motion_blur,
+	                        mesh->has_motion_blur(),
+	                        mesh->is_instanced(),
+	                        (int)mesh->tri_offset,
+	                        (int)mesh->curve_offset};
+	hash_data(md5, settings, sizeof(settings));
+
+	hash_float3_array(md5, mesh->verts);
+	hash_array(md5, mesh->triangles);
+	hash_float3_array(md5, mesh->curve_keys);
+	hash_array(md5, mesh->curve_radius);
+	hash_array(md5, mesh->curve_first_key);
+
+	if(mesh->has_motion_blur()) {
+		hash_motion_attribute(md5,
+		                      mesh->attributes,
+		                      mesh->verts.size(),
+		                      mesh->motion_steps);
+		hash_motion_attribute(md5,
+		                      mesh->curve_attributes,
+		                      mesh->curve_keys.size(),
+		                      mesh->motion_steps);
+	}
+}
+
+static void hash_params(MD5Hash& md5, const BVHParams& params)
+{
+	/* NOTE: use_parallel_build and keep_build_nodes are not affecting
+	 * the packed BVH, so they are not hashed.
+	 */
+	const int settings[] = {BVH_CACHE_VERSION,
+	                        params.use_spatial_split,
+	                        params.min_leaf_size,
+	                        params.max_triangle_leaf_size,
+	                        params.max_motion_triangle_leaf_size,
+	                        params.max_curve_leaf_size,
+	                        params.max_motion_curve_leaf_size,
+	                        params.top_level,
+	                        params.use_qbvh,
+	                        params.use_obvh,
+	                        params.primitive_mask,
+	                        params.use_unaligned_nodes,
+	                        params.num_motion_curve_steps,
+	                        params.num_motion_triangle_steps};
+	const float factors[] = {params.spatial_split_alpha,
+	                         params.unaligned_split_threshold,
+	                         params.sah_node_cost,
+	                         params.sah_primitive_cost};
+	hash_data(md5, settings, sizeof(settings));
+	hash_data(md5, factors, sizeof(factors));
+}
+
+/* Reading and writing */
+
+template<typename T>
+static bool write_array(FILE *f, const array<T>& data)
+{
+	const uint64_t size = data.size();
+	if(fwrite(&size, sizeof(size), 1, f) != 1) {
+		return false;
+	}
+	if(size == 0) {
+		return true;
+	}
+	return fwrite(data.data(), sizeof(T), data.size(), f) == data.size();
+}
+
+/* Remaining is the number of bytes left in the file, so sizes of truncated or
+ * corrupt files are detected before allocating memory for them. */
+template<typename T>
+static bool read_array(FILE *f, array<T>& data, size_t *remaining)
+{
+	uint64_t size;
+	if(*remaining < sizeof(size) || fread(&size, sizeof(size), 1, f) != 1) {
+		return false;
+	}
+	*remaining -= sizeof(size);
+	if(size > *remaining / sizeof(T)) {
+		return false;
+	}
+	*remaining -= size * sizeof(T);
+	data.resize(size);
+	if(size == 0) {
+		return true;
+	}
+	if(data.data() == NULL) {
+		return false;
+	}
+	return fread(data.data(), sizeof(T), data.size(), f) == data.size();
+}
+
+static bool write_pack(FILE *f, const PackedBVH& pack)
+{
+	const int version = BVH_CACHE_VERSION;
+	return fwrite(bvh_cache_magic, sizeof(bvh_cache_magic), 1, f) == 1 &&
+	       fwrite(&version, sizeof(version), 1, f) == 1 &&
+	       fwrite(&pack.root_index, sizeof(pack.root_index), 1, f) == 1 &&
+	       write_array(f, pack.nodes) &&
+	       write_array(f, pack.leaf_nodes) &&
+	       write_array(f, pack.object_node) &&
+	       write_array(f, pack.prim_tri_index) &&
+	       write_array(f, pack.prim_tri_verts) &&
+	       write_array(f, pack.prim_type) &&
+	       write_array(f, pack.prim_visibility) &&
+	       write_array(f, pack.prim_index) &&
+	       write_array(f, pack.prim_object) &&
+	       write_array(f, pack.prim_time);
+}
+
+static bool read_pack(FILE *f, size_t file_size, PackedBVH *pack)
+{
+	char magic[sizeof(bvh_cache_magic)];
+	int version;
+	const size_t header_size = sizeof(magic) + sizeof(version) + sizeof(pack->root_index);
+	if(file_size < header_size) {
+		return false;
+	}
+	size_t remaining = file_size - header_size;
+	if(fread(magic, sizeof(magic), 1, f) != 1 ||
+	   memcmp(magic, bvh_cache_magic, sizeof(magic)) != 0 ||
+	   fread(&version, sizeof(version), 1, f) != 1 ||
+	   version != BVH_CACHE_VERSION)
+	{
+		return false;
+	}
+	return fread(&pack->root_index, sizeof(pack->root_index), 1, f) == 1 &&
+	       read_array(f, pack->nodes, &remaining) &&
+	       read_array(f, pack->leaf_nodes, &remaining) &&
+	       read_array(f, pack->object_node, &remaining) &&
+	       read_array(f, pack->prim_tri_index, &remaining) &&
+	       read_array(f, pack->prim_tri_verts, &remaining) &&
+	       read_array(f, pack->prim_type, &remaining) &&
+	       read_array(f, pack->prim_visibility, &remaining) &&
+	       read_array(f, pack->prim_index, &remaining) &&
+	       read_array(f, pack->prim_object, &remaining) &&
+	       read_array(f, pack->prim_time, &remaining);
+}
+
+/* BVH Cache */
+
+string BVHCache::path()
+{
+	/* Mesh BVHs are built from multiple threads, while cache directory is
+	 * lazily initialized on first access.
+	 */
+	static thread_mutex path_mutex;
+	thread_scoped_lock lock(path_mutex);
+	return path_cache_get("bvh");
+}
+
+string BVHCache::key(const BVHParams& params, const vector<Object*>& objects)
+{
+	MD5Hash md5;
+
+	hash_params(md5, params);
+
+	foreach(Object *ob, objects) {
+		const int settings[] = {ob->is_traceable(),
+		                        (int)ob->visibility_for_tracing()};
+		hash_data(md5, settings, sizeof(settings));
+
+		/* Instances are only referenced by their bounds from the top level
+		 * BVH, but their own BVH is merged into it as well.
+		 */
+		if(params.top_level && ob->mesh->is_instanced()) {
+			hash_float3(md5, &ob->bounds.min, 1);
+			hash_float3(md5, &ob->bounds.max, 1);
+		}
+
+		hash_mesh(md5, ob->mesh);
+	}
+
+	return md5.get_hex();
+}
+
+bool BVHCache::read(const string& key, PackedBVH *pack)
+{
+	const string filepath = path_join(path(), key);
+
+	FILE *f = path_fopen(filepath, "rb");
+	if(!f) {
+		return false;
+	}
+
+	const bool success = read_pack(f, path_file_size(filepath), pack);
+	fclose(f);
+
+	if(success) {
+		/* Modification time is used as access time, for removing least
+		 * recently used files when the cache is full. */
+		path_touch(filepath);
+	}
+	else {
+		VLOG(1) << "Failed to read BVH cache file " << filepath << ".";
+		*pack = PackedBVH();
+	}
+
+	return success;
+}
+
+bool BVHCache::write(const string& key, const PackedBVH& pack)
+{
+	const string filepath = path_join(path(), key);
+
+	/* Write to a temporary file first, so other processes sharing the cache
+	 * never read partially written file.
+	 */
+	const string tmp_filepath = string_printf("%s.%p.%.0f.tmp",
+	                                          filepath.c_str(),
+	                                          (const void*)&pack,
+	                                          time_dt() * 1e6);
+
+	path_create_directories(tmp_filepath);
+	FILE *f = path_fopen(tmp_filepath, "wb");
+	if(!f) {
+		VLOG(1) << "Failed to create BVH cache file " << tmp_filepath << ".";
+		return false;
+	}
+
+	bool success = write_pack(f, pack);
+	success &= (fclose(f) == 0);
+
+	if(success) {
+		/* Renaming fails when another process already wrote the same file,
+		 * which is fine since its content is identical.
+		 */
+		path_remove(filepath);
+		success = (rename(tmp_filepath.c_str(), filepath.c_str()) == 0);
+	}
+
+	if(!success) {
+		VLOG(1) << "Failed to write BVH cache file " << filepath << ".";
+		path_remove(tmp_filepath);
+	}
+
+	return success;
+}
+
+void BVHCache::trim()
+{
+	path_cache_trim(path(), BVH_CACHE_MAX_SIZE);
+}
+
+bool BVHCache::supported(const vector<Object*>& objects)
+{
+	/* Deforming geometry gets a new key on every frame, caching it would only
+	 * fill the cache with files that are never read again. Motion blur is
+	 * used as the indication of that. */
+	foreach(Object *ob, objects) {
+		if(ob->mesh->has_motion_blur() || ob->use_motion) {
+			return false;
+		}
+	}
+	return true;
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BVH_CACHE_H__
+#define __BVH_CACHE_H__
+
+#include "util/util_string.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class BVHParams;
+class Object;
+struct PackedBVH;
+
+/* BVH Cache
+ *
+ * Packed BVH arrays stored on disk, so BVH of static geometry is only built
+ * once and is loaded by all the following renders of the same geometry. Every
+ * BVH is stored in its own file in the cache directory, named by the hash of
+ * all the data the BVH depends on: build parameters, primitives of the meshes
+ * and objects settings. */
+
+class BVHCache {
+public:
+	/* Directory where the cache files are stored. */
+	static string path();
+
+	/* Hash of everything the packed BVH depends on. */
+	static string key(const BVHParams& params, const vector<Object*>& objects);
+
+	/* Read packed BVH for the given key, returns false on cache miss. */
+	static bool read(const string& key, PackedBVH *pack);
+
+	/* Write packed BVH to the cache, returns false if writing failed. */
+	static bool write(const string& key, const PackedBVH& pack);
+
+	/* Remove least recently used files when the cache exceeds its size. Scans
+	 * the whole directory, called once after all BVH of an update are written
+	 * rather than after every write. */
+	static void trim();
+
+	/* Whether the BVH of these objects is worth caching. */
+	static bool supported(const vector<Object*>& objects);
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __BVH_CACHE_H__ */
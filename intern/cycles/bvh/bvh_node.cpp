@@ -126,6 +126,36 @@ int BVHNode::getSubtreeSize(BVH_STAT stat) const
 				cnt += has_unaligned? 1: 0;
 			}
 			return cnt;
+		case BVH_STAT_ONODE_COUNT:
+			{
+				cnt = 1;
+				if(!is_leaf()) {
+					const BVHNode *children[8];
+					const int num = get_onode_children(children);
+					for(int i = 0; i < num; i++) {
+						cnt += children[i]->getSubtreeSize(stat);
+					}
+				}
+			}
+			return cnt;
+		case BVH_STAT_ALIGNED_INNER_ONODE_COUNT:
+		case BVH_STAT_UNALIGNED_INNER_ONODE_COUNT:
+			if(!is_leaf()) {
+				const BVHNode *children[8];
+				const int num = get_onode_children(children);
+				bool has_unaligned = false;
+				for(int i = 0; i < num; i++) {
+					cnt += children[i]->getSubtreeSize(stat);
+					has_unaligned |= children[i]->is_unaligned;
+				}
+				if(stat == BVH_STAT_UNALIGNED_INNER_ONODE_COUNT) {
+					cnt += has_unaligned? 1: 0;
+				}
+				else {
+					cnt += has_unaligned? 0: 1;
+				}
+			}
+			return cnt;
 		case BVH_STAT_ALIGNED_LEAF_COUNT:
 			cnt = (is_leaf() && !is_unaligned) ? 1 : 0;
 			break;
@@ -154,6 +184,29 @@ int BVHNode::getSubtreeSize(BVH_STAT stat) const
 	return cnt;
 }
 
+int BVHNode::get_onode_children(const BVHNode *children[8]) const
+{
+	int num = 0;
+	for(int i = 0; i < num_children(); i++) {
+		const BVHNode *child = get_child(i);
+		if(child->is_leaf()) {
+			children[num++] = child;
+			continue;
+		}
+		for(int j = 0; j < child->num_children(); j++) {
+			const BVHNode *grandchild = child->get_child(j);
+			if(grandchild->is_leaf()) {
+				children[num++] = grandchild;
+				continue;
+			}
+			for(int k = 0; k < grandchild->num_children(); k++) {
+				children[num++] = grandchild->get_child(k);
+			}
+		}
+	}
+	return num;
+}
+
 void BVHNode::deleteSubtree()
 {
 	for(int i = 0; i < num_children(); i++)
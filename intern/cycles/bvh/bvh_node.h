@@ -36,6 +36,9 @@ enum BVH_STAT {
 	BVH_STAT_UNALIGNED_INNER_COUNT,
 	BVH_STAT_ALIGNED_INNER_QNODE_COUNT,
 	BVH_STAT_UNALIGNED_INNER_QNODE_COUNT,
+	BVH_STAT_ONODE_COUNT,
+	BVH_STAT_ALIGNED_INNER_ONODE_COUNT,
+	BVH_STAT_UNALIGNED_INNER_ONODE_COUNT,
 	BVH_STAT_ALIGNED_LEAF_COUNT,
 	BVH_STAT_UNALIGNED_LEAF_COUNT,
 	BVH_STAT_DEPTH,
@@ -83,6 +86,11 @@ public:
 		return *aligned_space;
 	}
 
+	/* Children of the node in 8-wide BVH, collected from up to three levels
+	 * of the binary tree. Returns number of the children.
+	 */
+	int get_onode_children(const BVHNode *children[8]) const;
+
 	// Subtree functions
 	int getSubtreeSize(BVH_STAT stat=BVH_STAT_NODE_COUNT) const;
 	float computeSubtreeSAHCost(const BVHParams& p, float probability = 1.0f) const;
@@ -50,9 +50,37 @@ public:
 	/* object or mesh level bvh */
 	bool top_level;
 
+	/* Gather primitive references and bin the upper levels of the tree using
+	 * all threads of the task scheduler, instead of doing it from the calling
+	 * thread only.
+	 */
+	bool use_parallel_build;
+
 	/* QBVH */
 	bool use_qbvh;
 
+	/* OBVH, only used together with QBVH when AVX2 kernel is available. */
+	bool use_obvh;
+
+	/* Keep build nodes after packing, so the BVH can be refitted by updating
+	 * bounds of the nodes when only positions of primitives changed.
+	 *
+	 * Build nodes and a copy of the primitive references take about as much
+	 * memory as the packed BVH, so they are only kept for BVH which are
+	 * expected to be refitted.
+	 */
+	bool keep_build_nodes;
+
+	/* Refitted BVH is rebuilt from scratch when its SAH cost becomes this
+	 * many times higher than the cost of the BVH right after the build.
+	 */
+	float refit_max_sah_cost_ratio;
+
+	/* Load packed BVH from the on-disk cache when it was already built for
+	 * the same primitives and parameters, and store newly built BVH there.
+	 */
+	bool use_cache;
+
 	/* Mask of primitives to be included into the BVH. */
 	int primitive_mask;
 
@@ -98,9 +126,16 @@ public:
 		max_motion_curve_leaf_size = 4;
 
 		top_level = false;
+		use_parallel_build = false;
 		use_qbvh = false;
+		use_obvh = false;
 		use_unaligned_nodes = false;
 
+		keep_build_nodes = false;
+		refit_max_sah_cost_ratio = 1.5f;
+
+		use_cache = false;
+
 		primitive_mask = PRIMITIVE_ALL;
 
 		num_motion_curve_steps = 0;
@@ -507,6 +507,7 @@ DeviceInfo Device::get_multi_device(const vector<DeviceInfo>& subdevices, int th
 	info.has_half_images = true;
 	info.has_volume_decoupled = true;
 	info.has_qbvh = true;
+	info.has_obvh = true;
 	info.has_osl = true;
 
 	foreach(const DeviceInfo &device, subdevices) {
@@ -544,6 +545,7 @@ DeviceInfo Device::get_multi_device(const vector<DeviceInfo>& subdevices, int th
 		info.has_half_images &= device.has_half_images;
 		info.has_volume_decoupled &= device.has_volume_decoupled;
 		info.has_qbvh &= device.has_qbvh;
+		info.has_obvh &= device.has_obvh;
 		info.has_osl &= device.has_osl;
 	}
 
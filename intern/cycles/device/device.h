@@ -34,6 +34,7 @@ CCL_NAMESPACE_BEGIN
 
 class Progress;
 class RenderTile;
+class TextureCache;
 
 /* Device Types */
 
@@ -58,6 +59,7 @@ public:
 	bool has_half_images;        /* Support half-float textures. */
 	bool has_volume_decoupled;   /* Decoupled volume shading. */
 	bool has_qbvh;               /* Supports both BVH2 and BVH4 raytracing. */
+	bool has_obvh;               /* Supports BVH8 raytracing in addition to BVH4. */
 	bool has_osl;                /* Support Open Shading Language. */
 	bool use_split_kernel;       /* Use split or mega kernel. */
 	int cpu_threads;
@@ -75,6 +77,7 @@ public:
 		has_half_images = false;
 		has_volume_decoupled = false;
 		has_qbvh = false;
+		has_obvh = false;
 		has_osl = false;
 		use_split_kernel = false;
 	}
@@ -307,6 +310,9 @@ public:
 	/* open shading language, only for CPU device */
 	virtual void *osl_memory() { return NULL; }
 
+	/* image textures read on demand, only for CPU device */
+	virtual TextureCache *get_texture_cache() { return NULL; }
+
 	/* load/compile kernels, must be called before adding tasks */ 
 	virtual bool load_kernels(
 	        const DeviceRequestedFeatures& /*requested_features*/)
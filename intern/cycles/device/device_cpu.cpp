@@ -34,6 +34,7 @@
 #include "kernel/kernel_types.h"
 #include "kernel/split/kernel_split_data.h"
 #include "kernel/kernel_globals.h"
+#include "kernel/bvh/bvh_types.h"
 
 #include "kernel/filter/filter.h"
 
@@ -51,6 +52,7 @@
 #include "util/util_optimization.h"
 #include "util/util_progress.h"
 #include "util/util_system.h"
+#include "util/util_texture_cache.h"
 #include "util/util_thread.h"
 
 CCL_NAMESPACE_BEGIN
@@ -60,6 +62,18 @@ class CPUDevice;
 /* Has to be outside of the class to be shared across template instantiations. */
 static const char *logged_architecture = "";
 
+/* BVH8 traversal is only compiled into AVX2 kernels, so it can only be used
+ * when those kernels are going to be picked up by the functions below.
+ */
+static bool device_cpu_has_obvh()
+{
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+	return system_cpu_support_avx2();
+#else
+	return false;
+#endif
+}
+
 template<typename F>
 class KernelFunctions {
 public:
@@ -170,11 +184,26 @@ public:
 	OSLGlobals osl_globals;
 #endif
 
+	TextureCache texture_cache;
+
 	bool use_split_kernel;
+	bool use_ray_packets;
+	bool use_shader_sort;
+
+	/* Traversal and shading time of all threads, when measured. */
+	bool use_timing;
+	KernelTiming timing;
+	thread_mutex timing_mutex;
 
 	DeviceRequestedFeatures requested_features;
 
 	KernelFunctions<void(*)(KernelGlobals *, float *, int, int, int, int, int)>             path_trace_kernel;
+	KernelFunctions<void(*)(KernelGlobals *, float *, int, int, int, int, int, int)>        path_trace_packet_kernel;
+	KernelFunctions<void(*)(KernelGlobals *, float *, int, int, int, int, int, int, int)>   path_trace_sorted_kernel;
+	KernelFunctions<void(*)(KernelGlobals *, float *, int, int, int, int)>                  adaptive_stopping_kernel;
+	KernelFunctions<bool(*)(KernelGlobals *, float *, int, int, int, int, int)>             adaptive_filter_x_kernel;
+	KernelFunctions<bool(*)(KernelGlobals *, float *, int, int, int, int, int)>             adaptive_filter_y_kernel;
+	KernelFunctions<void(*)(KernelGlobals *, float *, int, int, int, int, int)>             adaptive_adjust_samples_kernel;
 	KernelFunctions<void(*)(KernelGlobals *, uchar4 *, float *, float, int, int, int, int)> convert_to_half_float_kernel;
 	KernelFunctions<void(*)(KernelGlobals *, uchar4 *, float *, float, int, int, int, int)> convert_to_byte_kernel;
 	KernelFunctions<void(*)(KernelGlobals *, uint4 *, float4 *, int, int, int, int, int)>   shader_kernel;
@@ -212,6 +241,12 @@ public:
 	  texture_info(this, "__texture_info", MEM_TEXTURE),
 #define REGISTER_KERNEL(name) name ## _kernel(KERNEL_FUNCTIONS(name))
 	  REGISTER_KERNEL(path_trace),
+	  REGISTER_KERNEL(path_trace_packet),
+	  REGISTER_KERNEL(path_trace_sorted),
+	  REGISTER_KERNEL(adaptive_stopping),
+	  REGISTER_KERNEL(adaptive_filter_x),
+	  REGISTER_KERNEL(adaptive_filter_y),
+	  REGISTER_KERNEL(adaptive_adjust_samples),
 	  REGISTER_KERNEL(convert_to_half_float),
 	  REGISTER_KERNEL(convert_to_byte),
 	  REGISTER_KERNEL(shader),
@@ -234,9 +269,37 @@ public:
 			info.cpu_threads = TaskScheduler::num_threads();
 		}
 
+		/* Instruction sets might have been disabled since devices were
+		 * enumerated, make sure BVH layout matches the kernels in use.
+		 */
+		info.has_obvh = info.has_obvh && device_cpu_has_obvh();
+
+		/* Packet traversal is only implemented for QBVH. */
+		use_ray_packets = DebugFlags().cpu.ray_packets;
+		if(use_ray_packets) {
+			VLOG(1) << "Will be tracing camera rays in packets.";
+			info.has_obvh = false;
+		}
+
+		use_shader_sort = DebugFlags().cpu.shader_sort;
+		if(use_shader_sort) {
+			VLOG(1) << "Will be integrating paths in order of camera ray shader.";
+		}
+
+		use_timing = DebugFlags().cpu.timing;
+#ifndef WITH_CYCLES_DEBUG
+		if(use_timing) {
+			VLOG(1) << "Timing is only available in builds with WITH_CYCLES_DEBUG.";
+			use_timing = false;
+		}
+#endif
+		memset(&timing, 0, sizeof(timing));
+
 #ifdef WITH_OSL
 		kernel_globals.osl = &osl_globals;
 #endif
+		kernel_globals.texture_cache = &texture_cache;
+		kernel_globals.texture_cache_thread_info = NULL;
 		use_split_kernel = DebugFlags().cpu.split_kernel;
 		if(use_split_kernel) {
 			VLOG(1) << "Will be using split kernel.";
@@ -270,6 +333,14 @@ public:
 	{
 		task_pool.stop();
 		texture_info.free();
+
+		if(use_timing) {
+			VLOG(1) << "Kernel timing:\n"
+			        << "  Traversal: " << timing.traversal_time << "s, "
+			        << timing.num_traversal << " rays\n"
+			        << "  Shading  : " << timing.shading_time << "s, "
+			        << timing.num_shading << " evaluations";
+		}
 	}
 
 	virtual bool show_samples() const
@@ -439,6 +510,11 @@ public:
 #endif
 	}
 
+	TextureCache *get_texture_cache()
+	{
+		return &texture_cache;
+	}
+
 	void thread_run(DeviceTask *task)
 	{
 		if(task->type == DeviceTask::RENDER) {
@@ -698,17 +774,89 @@ public:
 					break;
 			}
 
-			for(int y = tile.y; y < tile.y + tile.h; y++) {
-				for(int x = tile.x; x < tile.x + tile.w; x++) {
-					path_trace_kernel()(kg, render_buffer,
-					                    sample, x, y, tile.offset, tile.stride);
+			if(use_shader_sort) {
+				path_trace_sorted_kernel()(kg, render_buffer,
+				                           sample, tile.x, tile.y, tile.w, tile.h,
+				                           tile.offset, tile.stride);
+			}
+			else {
+				for(int y = tile.y; y < tile.y + tile.h; y++) {
+					if(use_ray_packets) {
+						for(int x = tile.x; x < tile.x + tile.w; x += BVH_PACKET_SIZE) {
+							const int num = min(BVH_PACKET_SIZE, tile.x + tile.w - x);
+							path_trace_packet_kernel()(kg, render_buffer,
+							                           sample, x, y, num,
+							                           tile.offset, tile.stride);
+						}
+						continue;
+					}
+					for(int x = tile.x; x < tile.x + tile.w; x++) {
+						path_trace_kernel()(kg, render_buffer,
+						                    sample, x, y, tile.offset, tile.stride);
+					}
 				}
 			}
 
 			tile.sample = sample + 1;
 
+			/* Sample count of the buffer, which starts at zero for sample ranges. */
+			const int num_samples = tile.sample - kg->__data.integrator.start_sample;
+			if(task.adaptive_sampling.need_filter(num_samples) &&
+			   adaptive_sampling_filter(kg, tile))
+			{
+				/* All pixels converged, remaining samples are done. */
+				task.update_progress(&tile, tile.w*tile.h*(end_sample - sample));
+				tile.sample = end_sample;
+				tile.converged = true;
+				break;
+			}
+
 			task.update_progress(&tile, tile.w*tile.h);
 		}
+
+		if(task.adaptive_sampling.use) {
+			adaptive_sampling_post(kg, tile);
+		}
+	}
+
+	/* Mark pixels of the tile whose error is below the threshold as converged,
+	 * returns true when all of them are. */
+	bool adaptive_sampling_filter(KernelGlobals *kg, RenderTile &tile)
+	{
+		float *render_buffer = (float*)tile.buffer;
+
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			for(int x = tile.x; x < tile.x + tile.w; x++) {
+				adaptive_stopping_kernel()(kg, render_buffer, x, y, tile.offset, tile.stride);
+			}
+		}
+
+		bool any = false;
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			any |= adaptive_filter_x_kernel()(kg, render_buffer, y, tile.x, tile.w, tile.offset, tile.stride);
+		}
+		if(!any) {
+			return true;
+		}
+
+		for(int x = tile.x; x < tile.x + tile.w; x++) {
+			adaptive_filter_y_kernel()(kg, render_buffer, x, tile.y, tile.h, tile.offset, tile.stride);
+		}
+		return false;
+	}
+
+	/* Scale pixels which stopped early to the sample count of the tile. */
+	void adaptive_sampling_post(KernelGlobals *kg, RenderTile &tile)
+	{
+		float *render_buffer = (float*)tile.buffer;
+		const int num_samples = tile.sample - kg->__data.integrator.start_sample;
+
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			for(int x = tile.x; x < tile.x + tile.w; x++) {
+				adaptive_adjust_samples_kernel()(kg, render_buffer, num_samples,
+				                                 x, y, tile.offset, tile.stride);
+			}
+		}
 	}
 
 	void denoise(DeviceTask &task, DenoisingTask& denoising, RenderTile &tile)
@@ -818,6 +966,7 @@ public:
 	void thread_shader(DeviceTask& task)
 	{
 		KernelGlobals kg = kernel_globals;
+		kg.texture_cache_thread_info = texture_cache.thread_info();
 
 #ifdef WITH_OSL
 		OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
@@ -891,6 +1040,10 @@ protected:
 			kg.decoupled_volume_steps[i] = NULL;
 		}
 		kg.decoupled_volume_steps_index = 0;
+		kg.path_trace_batch = NULL;
+		kg.texture_cache_thread_info = texture_cache.thread_info();
+		memset(&kg.timing, 0, sizeof(kg.timing));
+		kg.timing.enabled = use_timing;
 #ifdef WITH_OSL
 		OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
 #endif
@@ -913,6 +1066,16 @@ protected:
 				free(kg->decoupled_volume_steps[i]);
 			}
 		}
+		if(kg->path_trace_batch != NULL) {
+			free(kg->path_trace_batch);
+		}
+		if(kg->timing.enabled) {
+			thread_scoped_lock lock(timing_mutex);
+			timing.traversal_time += kg->timing.traversal_time;
+			timing.shading_time += kg->timing.shading_time;
+			timing.num_traversal += kg->timing.num_traversal;
+			timing.num_shading += kg->timing.num_shading;
+		}
 #ifdef WITH_OSL
 		OSLShader::thread_free(kg);
 #endif
@@ -1047,6 +1210,7 @@ void device_cpu_info(vector<DeviceInfo>& devices)
 	info.num = 0;
 	info.advanced_shading = true;
 	info.has_qbvh = system_cpu_support_sse2();
+	info.has_obvh = device_cpu_has_obvh();
 	info.has_volume_decoupled = true;
 	info.has_osl = true;
 	info.has_half_images = true;
@@ -26,6 +26,20 @@
 
 CCL_NAMESPACE_BEGIN
 
+/* Adaptive Sampling */
+
+AdaptiveSampling::AdaptiveSampling()
+: use(false), min_samples(0), step(4)
+{
+}
+
+bool AdaptiveSampling::need_filter(int num_samples) const
+{
+	return use &&
+	       num_samples >= min_samples &&
+	       num_samples % step == 0;
+}
+
 /* Device Task */
 
 DeviceTask::DeviceTask(Type type_)
@@ -32,6 +32,24 @@ class RenderBuffers;
 class RenderTile;
 class Tile;
 
+/* Adaptive Sampling
+ *
+ * When pixels are checked for convergence, only done after an even number
+ * of samples so the error estimate compares equally weighted halves. */
+
+class AdaptiveSampling {
+public:
+	AdaptiveSampling();
+
+	/* Whether to check for convergence once the buffer has the given number
+	 * of samples. */
+	bool need_filter(int num_samples) const;
+
+	bool use;
+	int min_samples;
+	int step;
+};
+
 class DeviceTask : public Task {
 public:
 	typedef enum { RENDER, FILM_CONVERT, SHADER } Type;
@@ -76,6 +94,8 @@ public:
 	int pass_denoising_data;
 	int pass_denoising_clean;
 
+	AdaptiveSampling adaptive_sampling;
+
 	bool need_finish_queue;
 	bool integrator_branched;
 	int2 requested_tile_size;
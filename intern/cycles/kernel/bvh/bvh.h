@@ -34,6 +34,11 @@ CCL_NAMESPACE_BEGIN
 #  include "kernel/bvh/qbvh_nodes.h"
 #endif
 
+/* Common OBVH functions. */
+#ifdef __OBVH__
+#  include "kernel/bvh/obvh_nodes.h"
+#endif
+
 /* Regular BVH traversal */
 
 #include "kernel/bvh/bvh_nodes.h"
@@ -152,6 +157,20 @@ CCL_NAMESPACE_BEGIN
 #  endif
 #endif  /* __VOLUME_RECORD_ALL__ */
 
+/* Packet traversal of coherent rays */
+
+#if defined(__BVH_PACKET__)
+#  define BVH_FUNCTION_NAME bvh_intersect_packet
+#  define BVH_FUNCTION_FEATURES 0
+#  include "kernel/bvh/qbvh_packet.h"
+
+#  if defined(__INSTANCING__)
+#    define BVH_FUNCTION_NAME bvh_intersect_packet_instancing
+#    define BVH_FUNCTION_FEATURES BVH_INSTANCING
+#    include "kernel/bvh/qbvh_packet.h"
+#  endif
+#endif  /* __BVH_PACKET__ */
+
 #undef BVH_FEATURE
 #undef BVH_NAME_JOIN
 #undef BVH_NAME_EVAL
@@ -201,6 +220,44 @@ ccl_device_intersect bool scene_intersect(KernelGlobals *kg,
 #endif /* __KERNEL_CPU__ */
 }
 
+#ifdef __BVH_PACKET__
+/* Packet traversal is only implemented for the QBVH layout with triangles
+ * and static objects, other scenes use regular traversal of every ray.
+ */
+ccl_device_inline bool scene_intersect_packet_supported(KernelGlobals *kg)
+{
+	return kernel_data.bvh.use_qbvh &&
+	       !kernel_data.bvh.use_obvh &&
+	       !kernel_data.bvh.have_motion &&
+	       !kernel_data.bvh.have_curves;
+}
+
+/* Find closest intersections of up to BVH_PACKET_SIZE coherent rays. */
+ccl_device_intersect void scene_intersect_packet(KernelGlobals *kg,
+                                                 const Ray *rays,
+                                                 const uint visibility,
+                                                 Intersection *isects,
+                                                 const int num_rays)
+{
+	if(!scene_intersect_packet_supported(kg)) {
+		for(int i = 0; i < num_rays; i++) {
+			uint lcg_state = 0;
+			scene_intersect(kg, rays[i], visibility, &isects[i], &lcg_state, 0.0f, 0.0f);
+		}
+		return;
+	}
+
+#  ifdef __INSTANCING__
+	if(kernel_data.bvh.have_instancing) {
+		QBVH_bvh_intersect_packet_instancing(kg, rays, isects, num_rays, visibility);
+		return;
+	}
+#  endif /* __INSTANCING__ */
+
+	QBVH_bvh_intersect_packet(kg, rays, isects, num_rays, visibility);
+}
+#endif  /* __BVH_PACKET__ */
+
 #ifdef __BVH_LOCAL__
 /* Note: ray is passed by value to work around a possible CUDA compiler bug. */
 ccl_device_intersect void scene_intersect_local(KernelGlobals *kg,
@@ -21,6 +21,18 @@ struct QBVHStackItem {
 	float dist;
 };
 
+#ifdef __BVH_PACKET__
+/* Stack item of the packet traversal, which keeps entry distance of every
+ * ray of the packet and mask of rays which are to visit the node.
+ */
+struct QBVHPacketStackItem {
+	ssef dist;
+	int addr;
+	int mask;
+	float key;
+};
+#endif
+
 ccl_device_inline void qbvh_near_far_idx_calc(const float3& idir,
                                               int *ccl_restrict near_x,
                                               int *ccl_restrict near_y,
@@ -181,6 +193,45 @@ ccl_device_inline int qbvh_aligned_node_intersect_robust(
 	return (int)movemask(vmask);
 }
 
+#ifdef __BVH_PACKET__
+/* Intersection of the child of axis-aligned node with a packet of rays,
+ * every lane of the vectors is a separate ray. Sides which become lower and
+ * upper bounds are selected per ray, so empty children which have inverted
+ * bounds are never hit, same as in qbvh_aligned_node_intersect().
+ */
+ccl_device_inline int qbvh_packet_aligned_node_intersect(
+        const ssef& isect_near,
+        const ssef& isect_far,
+        const sse3f& org,
+        const sse3f& idir,
+        const sseb& neg_x,
+        const sseb& neg_y,
+        const sseb& neg_z,
+        const ssef *ccl_restrict bounds,
+        const int child,
+        ssef *ccl_restrict dist)
+{
+	const ssef tmin_x = (ssef(bounds[0][child]) - org.x) * idir.x;
+	const ssef tmax_x = (ssef(bounds[1][child]) - org.x) * idir.x;
+	const ssef tmin_y = (ssef(bounds[2][child]) - org.y) * idir.y;
+	const ssef tmax_y = (ssef(bounds[3][child]) - org.y) * idir.y;
+	const ssef tmin_z = (ssef(bounds[4][child]) - org.z) * idir.z;
+	const ssef tmax_z = (ssef(bounds[5][child]) - org.z) * idir.z;
+
+	const ssef tnear = max4(isect_near,
+	                        select(neg_x, tmax_x, tmin_x),
+	                        select(neg_y, tmax_y, tmin_y),
+	                        select(neg_z, tmax_z, tmin_z));
+	const ssef tfar = min4(isect_far,
+	                       select(neg_x, tmin_x, tmax_x),
+	                       select(neg_y, tmin_y, tmax_y),
+	                       select(neg_z, tmin_z, tmax_z));
+	const sseb vmask = tnear <= tfar;
+	*dist = tnear;
+	return (int)movemask(vmask);
+}
+#endif  /* __BVH_PACKET__ */
+
 /* Unaligned nodes intersection */
 
 ccl_device_inline int qbvh_unaligned_node_intersect(
@@ -0,0 +1,323 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* This is a template BVH traversal function for a packet of coherent rays,
+ * such as camera rays of neighbour pixels. Every visited node of the QBVH is
+ * intersected with all the rays of the packet at once, each SSE lane holding
+ * a separate ray, so the node data is fetched once for the whole packet.
+ *
+ * Only axis-aligned nodes and triangles are supported, scene_intersect_packet()
+ * falls back to regular traversal for motion blur and hair.
+ *
+ * BVH_INSTANCING: object instancing
+ *
+ */
+
+ccl_device void BVH_FUNCTION_FULL_NAME(QBVH)(KernelGlobals *kg,
+                                             const Ray *rays,
+                                             Intersection *isects,
+                                             const int num_rays,
+                                             const uint visibility)
+{
+	kernel_assert(num_rays > 0 && num_rays <= BVH_PACKET_SIZE);
+
+	/* Traversal stack in CUDA thread-local memory. */
+	QBVHPacketStackItem traversal_stack[BVH_QSTACK_SIZE];
+	traversal_stack[0].addr = ENTRYPOINT_SENTINEL;
+	traversal_stack[0].dist = ssef(-FLT_MAX);
+	traversal_stack[0].mask = 0;
+
+	/* Traversal variables in registers. */
+	int stack_ptr = 0;
+	int node_addr = kernel_data.bvh.root;
+	ssef node_dist(0.0f);
+
+	/* Ray parameters, both per ray and as vectors with a ray per lane. */
+	float3 P[BVH_PACKET_SIZE], dir[BVH_PACKET_SIZE], idir[BVH_PACKET_SIZE];
+	ssef tfar(-FLT_MAX);
+	int object = OBJECT_NONE;
+
+	/* Mask of the rays which are still traversed. */
+	int ray_mask = 0;
+
+	for(int i = 0; i < num_rays; i++) {
+		Intersection *isect = &isects[i];
+		isect->t = rays[i].t;
+		isect->u = 0.0f;
+		isect->v = 0.0f;
+		isect->prim = PRIM_NONE;
+		isect->object = OBJECT_NONE;
+
+		BVH_DEBUG_INIT();
+
+		P[i] = rays[i].P;
+		dir[i] = bvh_clamp_direction(rays[i].D);
+		idir[i] = bvh_inverse_direction(dir[i]);
+		tfar[i] = isect->t;
+
+		if(isfinite(P[i].x)) {
+			ray_mask |= (1 << i);
+		}
+	}
+	/* Unused lanes are filled with the first ray to avoid NaN in math. */
+	for(int i = num_rays; i < BVH_PACKET_SIZE; i++) {
+		P[i] = P[0];
+		dir[i] = dir[0];
+		idir[i] = idir[0];
+	}
+
+	sse3f org4(ssef(P[0].x, P[1].x, P[2].x, P[3].x),
+	           ssef(P[0].y, P[1].y, P[2].y, P[3].y),
+	           ssef(P[0].z, P[1].z, P[2].z, P[3].z));
+	sse3f idir4(ssef(idir[0].x, idir[1].x, idir[2].x, idir[3].x),
+	            ssef(idir[0].y, idir[1].y, idir[2].y, idir[3].y),
+	            ssef(idir[0].z, idir[1].z, idir[2].z, idir[3].z));
+
+	/* Per ray selection of the side that becomes the lower or upper bound. */
+	sseb neg_x = idir4.x < ssef(0.0f);
+	sseb neg_y = idir4.y < ssef(0.0f);
+	sseb neg_z = idir4.z < ssef(0.0f);
+
+	int node_mask = ray_mask;
+#if BVH_FEATURE(BVH_INSTANCING)
+	int instance_mask = 0;
+#endif
+
+	/* Traversal loop. */
+	do {
+		do {
+			/* Traverse internal nodes. */
+			while(node_addr >= 0 && node_addr != ENTRYPOINT_SENTINEL) {
+				float4 inodes = kernel_tex_fetch(__bvh_nodes, node_addr+0);
+				(void)inodes;
+
+				/* Rays which did not hit anything closer since the node
+				 * was pushed to the stack.
+				 */
+				const int active_mask = node_mask & ray_mask &
+				                        (int)movemask(node_dist <= tfar);
+
+				if(active_mask == 0
+#ifdef __VISIBILITY_FLAG__
+				   || (__float_as_uint(inodes.x) & visibility) == 0
+#endif
+				 )
+				{
+					/* Pop. */
+					node_addr = traversal_stack[stack_ptr].addr;
+					node_dist = traversal_stack[stack_ptr].dist;
+					node_mask = traversal_stack[stack_ptr].mask;
+					--stack_ptr;
+					continue;
+				}
+
+				const ssef bounds[6] = {
+					kernel_tex_fetch_ssef(__bvh_nodes, node_addr+1),
+					kernel_tex_fetch_ssef(__bvh_nodes, node_addr+2),
+					kernel_tex_fetch_ssef(__bvh_nodes, node_addr+3),
+					kernel_tex_fetch_ssef(__bvh_nodes, node_addr+4),
+					kernel_tex_fetch_ssef(__bvh_nodes, node_addr+5),
+					kernel_tex_fetch_ssef(__bvh_nodes, node_addr+6)};
+				const float4 cnodes = kernel_tex_fetch(__bvh_nodes, node_addr+7);
+
+#ifdef __KERNEL_DEBUG__
+				for(int mask = active_mask; mask != 0; ) {
+					Intersection *isect = &isects[__bscf(mask)];
+					BVH_DEBUG_NEXT_NODE();
+				}
+#endif
+
+				/* Push all children hit by any of the rays. */
+				int num_children = 0;
+				for(int i = 0; i < 4; i++) {
+					ssef dist;
+					const int child_mask = active_mask &
+					        qbvh_packet_aligned_node_intersect(ssef(0.0f),
+					                                           tfar,
+					                                           org4,
+					                                           idir4,
+					                                           neg_x, neg_y, neg_z,
+					                                           bounds,
+					                                           i,
+					                                           &dist);
+					if(child_mask == 0) {
+						continue;
+					}
+					++stack_ptr;
+					++num_children;
+					kernel_assert(stack_ptr < BVH_QSTACK_SIZE);
+					QBVHPacketStackItem *item = &traversal_stack[stack_ptr];
+					item->addr = __float_as_int(cnodes[i]);
+					item->dist = dist;
+					item->mask = child_mask;
+					item->key = reduce_min(select(child_mask, dist, ssef(FLT_MAX)));
+				}
+
+				/* Sort pushed children so the closest one is visited first,
+				 * using the distance of the closest ray as a key.
+				 */
+				QBVHPacketStackItem *children = &traversal_stack[stack_ptr - num_children + 1];
+				for(int i = 1; i < num_children; i++) {
+					for(int j = i; j > 0 && children[j].key > children[j - 1].key; j--) {
+						QBVHPacketStackItem tmp = children[j];
+						children[j] = children[j - 1];
+						children[j - 1] = tmp;
+					}
+				}
+
+				node_addr = traversal_stack[stack_ptr].addr;
+				node_dist = traversal_stack[stack_ptr].dist;
+				node_mask = traversal_stack[stack_ptr].mask;
+				--stack_ptr;
+			}
+
+			/* If node is leaf, fetch triangle list. */
+			if(node_addr < 0) {
+				float4 leaf = kernel_tex_fetch(__bvh_leaf_nodes, (-node_addr-1));
+				int active_mask = node_mask & ray_mask &
+				                  (int)movemask(node_dist <= tfar);
+
+#ifdef __VISIBILITY_FLAG__
+				if(UNLIKELY((active_mask == 0) ||
+				            ((__float_as_uint(leaf.z) & visibility) == 0)))
+#else
+				if(UNLIKELY(active_mask == 0))
+#endif
+				{
+					/* Pop. */
+					node_addr = traversal_stack[stack_ptr].addr;
+					node_dist = traversal_stack[stack_ptr].dist;
+					node_mask = traversal_stack[stack_ptr].mask;
+					--stack_ptr;
+					continue;
+				}
+
+				int prim_addr = __float_as_int(leaf.x);
+
+#if BVH_FEATURE(BVH_INSTANCING)
+				if(prim_addr >= 0) {
+#endif
+					int prim_addr2 = __float_as_int(leaf.y);
+					const uint type = __float_as_int(leaf.w);
+
+					/* Pop. */
+					node_addr = traversal_stack[stack_ptr].addr;
+					node_dist = traversal_stack[stack_ptr].dist;
+					node_mask = traversal_stack[stack_ptr].mask;
+					--stack_ptr;
+
+					/* Primitive intersection, one ray at a time. */
+					kernel_assert((type & PRIMITIVE_ALL) == PRIMITIVE_TRIANGLE);
+					(void)type;
+					for(; prim_addr < prim_addr2; prim_addr++) {
+						int mask = active_mask;
+						while(mask != 0) {
+							const int i = __bscf(mask);
+							Intersection *isect = &isects[i];
+							BVH_DEBUG_NEXT_INTERSECTION();
+							if(triangle_intersect(kg,
+							                      isect,
+							                      P[i],
+							                      dir[i],
+							                      visibility,
+							                      object,
+							                      prim_addr)) {
+								tfar[i] = isect->t;
+								/* Shadow ray early termination. */
+								if(visibility & PATH_RAY_SHADOW_OPAQUE) {
+									ray_mask &= ~(1 << i);
+									active_mask &= ~(1 << i);
+								}
+							}
+						}
+					}
+					if(ray_mask == 0) {
+						return;
+					}
+				}
+#if BVH_FEATURE(BVH_INSTANCING)
+				else {
+					/* Instance push, all rays are transformed so they are
+					 * restored together on pop.
+					 */
+					object = kernel_tex_fetch(__prim_object, -prim_addr-1);
+					instance_mask = ray_mask;
+
+					int mask = instance_mask;
+					while(mask != 0) {
+						const int i = __bscf(mask);
+						float t1 = -FLT_MAX;
+						qbvh_instance_push(kg, object, &rays[i], &P[i], &dir[i], &idir[i], &isects[i].t, &t1);
+						tfar[i] = isects[i].t;
+						org4.x[i] = P[i].x; org4.y[i] = P[i].y; org4.z[i] = P[i].z;
+						idir4.x[i] = idir[i].x; idir4.y[i] = idir[i].y; idir4.z[i] = idir[i].z;
+					}
+					neg_x = idir4.x < ssef(0.0f);
+					neg_y = idir4.y < ssef(0.0f);
+					neg_z = idir4.z < ssef(0.0f);
+
+					++stack_ptr;
+					kernel_assert(stack_ptr < BVH_QSTACK_SIZE);
+					traversal_stack[stack_ptr].addr = ENTRYPOINT_SENTINEL;
+					traversal_stack[stack_ptr].dist = ssef(-FLT_MAX);
+					traversal_stack[stack_ptr].mask = 0;
+
+					/* Only rays which hit the instance bounds enter it. */
+					node_addr = kernel_tex_fetch(__object_node, object);
+					node_dist = ssef(0.0f);
+					node_mask = active_mask;
+
+#ifdef __KERNEL_DEBUG__
+					for(mask = active_mask; mask != 0; ) {
+						Intersection *isect = &isects[__bscf(mask)];
+						BVH_DEBUG_NEXT_INSTANCE();
+					}
+#endif
+				}
+			}
+#endif  /* FEATURE(BVH_INSTANCING) */
+		} while(node_addr != ENTRYPOINT_SENTINEL);
+
+#if BVH_FEATURE(BVH_INSTANCING)
+		if(stack_ptr >= 0) {
+			kernel_assert(object != OBJECT_NONE);
+
+			/* Instance pop. */
+			int mask = instance_mask;
+			while(mask != 0) {
+				const int i = __bscf(mask);
+				isects[i].t = bvh_instance_pop(kg, object, &rays[i], &P[i], &dir[i], &idir[i], isects[i].t);
+				tfar[i] = isects[i].t;
+				org4.x[i] = P[i].x; org4.y[i] = P[i].y; org4.z[i] = P[i].z;
+				idir4.x[i] = idir[i].x; idir4.y[i] = idir[i].y; idir4.z[i] = idir[i].z;
+			}
+			neg_x = idir4.x < ssef(0.0f);
+			neg_y = idir4.y < ssef(0.0f);
+			neg_z = idir4.z < ssef(0.0f);
+
+			object = OBJECT_NONE;
+			instance_mask = 0;
+			node_addr = traversal_stack[stack_ptr].addr;
+			node_dist = traversal_stack[stack_ptr].dist;
+			node_mask = traversal_stack[stack_ptr].mask;
+			--stack_ptr;
+		}
+#endif  /* FEATURE(BVH_INSTANCING) */
+	} while(node_addr != ENTRYPOINT_SENTINEL);
+}
+
+#undef BVH_FUNCTION_NAME
+#undef BVH_FUNCTION_FEATURES
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+CCL_NAMESPACE_BEGIN
+
+/* Adaptive Sampling
+ *
+ * Pixels stop receiving samples once their error estimate is below the
+ * threshold. The error is estimated from the difference between the image
+ * of all samples and the image of every second sample, as described in
+ * "A Hierarchical Automatic Stopping Condition for Monte Carlo Global
+ * Illumination" by Dammertz et al., 2010. Converged pixels are dilated by
+ * one pixel in both directions, so isolated pixels in noisy regions don't
+ * stop too early.
+ *
+ * The buffer of every pixel holds the sums of its own number of samples,
+ * before the passes are read they are scaled to the number of samples of the
+ * tile by kernel_adaptive_post_adjust(). Samples without a camera ray count
+ * as well, they contribute nothing, so pixels outside of the camera converge
+ * and partially covered pixels keep their coverage. */
+
+ccl_device_inline ccl_global float *kernel_adaptive_pass(KernelGlobals *kg,
+                                                        ccl_global float *buffer,
+                                                        int x, int y,
+                                                        int offset, int stride)
+{
+	int index = offset + x + y*stride;
+	return buffer + index*kernel_data.film.pass_stride + kernel_data.film.pass_adaptive_sampling;
+}
+
+/* Buffer of the pixel, as passed to kernel_write_result(). */
+ccl_device_inline bool kernel_adaptive_pixel_converged(KernelGlobals *kg,
+                                                       ccl_global float *buffer)
+{
+	return kernel_data.film.pass_adaptive_sampling &&
+	       buffer[kernel_data.film.pass_adaptive_sampling + ADAPTIVE_PASS_CONVERGED] != 0.0f;
+}
+
+/* Count a sample of the pixel for which no camera ray was traced. */
+ccl_device_inline void kernel_adaptive_write_empty_sample(KernelGlobals *kg,
+                                                          ccl_global float *buffer)
+{
+	if(kernel_data.film.pass_adaptive_sampling) {
+		kernel_write_pass_float(buffer + kernel_data.film.pass_adaptive_sampling + ADAPTIVE_PASS_SAMPLE_COUNT, 1.0f);
+	}
+}
+
+/* Mark the pixel as converged if its error is below the threshold. Only
+ * called with an even number of samples, so both halves have equal weight. */
+ccl_device void kernel_adaptive_stopping(KernelGlobals *kg,
+                                         ccl_global float *buffer,
+                                         int x, int y,
+                                         int offset, int stride)
+{
+	ccl_global float *adaptive = kernel_adaptive_pass(kg, buffer, x, y, offset, stride);
+	ccl_global float *combined = adaptive - kernel_data.film.pass_adaptive_sampling;
+
+	const float num_samples = adaptive[ADAPTIVE_PASS_SAMPLE_COUNT];
+	if(adaptive[ADAPTIVE_PASS_CONVERGED] != 0.0f || num_samples == 0.0f) {
+		return;
+	}
+
+	const float inv_num_samples = 1.0f/num_samples;
+	const float3 I = make_float3(combined[0], combined[1], combined[2])*inv_num_samples;
+	const float3 A = make_float3(adaptive[ADAPTIVE_PASS_HALF_COLOR + 0],
+	                             adaptive[ADAPTIVE_PASS_HALF_COLOR + 1],
+	                             adaptive[ADAPTIVE_PASS_HALF_COLOR + 2])*(2.0f*inv_num_samples);
+
+	/* Relative to the square root of the intensity, since noise is perceived
+	 * less in bright regions. */
+	const float error = (fabsf(I.x - A.x) + fabsf(I.y - A.y) + fabsf(I.z - A.z)) /
+	                    sqrtf(max(I.x + I.y + I.z, 1e-4f));
+
+	if(error < kernel_data.integrator.adaptive_threshold) {
+		adaptive[ADAPTIVE_PASS_CONVERGED] = 1.0f;
+	}
+}
+
+/* Dilate unconverged pixels along a row, returns whether any pixel of the
+ * row is not converged. */
+ccl_device bool kernel_adaptive_filter_x(KernelGlobals *kg,
+                                         ccl_global float *buffer,
+                                         int y, int x, int w,
+                                         int offset, int stride)
+{
+	bool any = false;
+	bool prev = false;
+
+	for(int i = x; i < x + w; i++) {
+		ccl_global float *adaptive = kernel_adaptive_pass(kg, buffer, i, y, offset, stride);
+
+		if(adaptive[ADAPTIVE_PASS_CONVERGED] == 0.0f) {
+			any = true;
+			if(i > x && !prev) {
+				kernel_adaptive_pass(kg, buffer, i - 1, y, offset, stride)[ADAPTIVE_PASS_CONVERGED] = 0.0f;
+			}
+			prev = true;
+		}
+		else {
+			if(prev) {
+				adaptive[ADAPTIVE_PASS_CONVERGED] = 0.0f;
+			}
+			prev = false;
+		}
+	}
+
+	return any;
+}
+
+/* Same as kernel_adaptive_filter_x(), along a column. */
+ccl_device bool kernel_adaptive_filter_y(KernelGlobals *kg,
+                                         ccl_global float *buffer,
+                                         int x, int y, int h,
+                                         int offset, int stride)
+{
+	bool any = false;
+	bool prev = false;
+
+	for(int i = y; i < y + h; i++) {
+		ccl_global float *adaptive = kernel_adaptive_pass(kg, buffer, x, i, offset, stride);
+
+		if(adaptive[ADAPTIVE_PASS_CONVERGED] == 0.0f) {
+			any = true;
+			if(i > y && !prev) {
+				kernel_adaptive_pass(kg, buffer, x, i - 1, offset, stride)[ADAPTIVE_PASS_CONVERGED] = 0.0f;
+			}
+			prev = true;
+		}
+		else {
+			if(prev) {
+				adaptive[ADAPTIVE_PASS_CONVERGED] = 0.0f;
+			}
+			prev = false;
+		}
+	}
+
+	return any;
+}
+
+#ifdef __DENOISING_FEATURES__
+/* Sum of squares of num_samples values with the given mean, after scaling it
+ * along with its sum to scaled_samples. The spread around the mean is scaled
+ * up further, so the denoiser which assumes scaled_samples estimates the
+ * variance of the mean of the samples the pixel actually received. */
+ccl_device_inline float kernel_adaptive_variance_adjust(float sum_sq,
+                                                        float mean,
+                                                        float num_samples,
+                                                        float scaled_samples)
+{
+	if(num_samples == 0.0f) {
+		return sum_sq;
+	}
+
+	const float deviation = max(0.0f, sum_sq*(num_samples/scaled_samples) - mean*mean*num_samples);
+	return mean*mean*scaled_samples +
+	       deviation*(scaled_samples*(scaled_samples - 1.0f))/(num_samples*max(num_samples - 1.0f, 1.0f));
+}
+
+ccl_device void kernel_adaptive_denoising_adjust(ccl_global float *denoising,
+                                                 float num_samples,
+                                                 float scaled_samples)
+{
+	const int passes[4] = {DENOISING_PASS_NORMAL, DENOISING_PASS_ALBEDO, DENOISING_PASS_DEPTH, DENOISING_PASS_COLOR};
+	const int components[4] = {3, 3, 1, 3};
+
+	for(int p = 0; p < 4; p++) {
+		ccl_global float *sum = denoising + passes[p];
+		ccl_global float *sum_sq = sum + components[p];
+		for(int i = 0; i < components[p]; i++) {
+			sum_sq[i] = kernel_adaptive_variance_adjust(sum_sq[i], sum[i]/scaled_samples, num_samples, scaled_samples);
+		}
+	}
+
+	/* Shadow halves are written by even and odd samples, their variance is of
+	 * the ratio of shaded and total light. */
+	const float num_half[2] = {floorf((num_samples + 1.0f)*0.5f), floorf(num_samples*0.5f)};
+	const float scaled_half[2] = {floorf((scaled_samples + 1.0f)*0.5f), floorf(scaled_samples*0.5f)};
+	const int shadow[2] = {DENOISING_PASS_SHADOW_A, DENOISING_PASS_SHADOW_B};
+
+	for(int h = 0; h < 2; h++) {
+		ccl_global float *half = denoising + shadow[h];
+		if(scaled_half[h] == 0.0f) {
+			continue;
+		}
+		const float ratio = half[1]/max(half[0], 1e-7f);
+		half[2] = kernel_adaptive_variance_adjust(half[2], ratio, num_half[h], scaled_half[h]);
+	}
+}
+#endif  /* __DENOISING_FEATURES__ */
+
+/* Scale the accumulated passes of a pixel which stopped early, as if it had
+ * received the given number of samples. Safe to call repeatedly, the sample
+ * count is updated as well. Variances of the denoising passes stay those of
+ * the samples the pixel received. */
+ccl_device void kernel_adaptive_post_adjust(KernelGlobals *kg,
+                                            ccl_global float *buffer,
+                                            int sample,
+                                            int x, int y,
+                                            int offset, int stride)
+{
+	ccl_global float *adaptive = kernel_adaptive_pass(kg, buffer, x, y, offset, stride);
+	ccl_global float *pixel = adaptive - kernel_data.film.pass_adaptive_sampling;
+
+	const float num_samples = adaptive[ADAPTIVE_PASS_SAMPLE_COUNT];
+	if(num_samples == 0.0f || num_samples >= (float)sample) {
+		return;
+	}
+
+	const float scale = (float)sample/num_samples;
+
+	/* Passes which are only written by the first sample are not sums. */
+	int flag = kernel_data.film.pass_flag;
+	float depth = (flag & PASSMASK(DEPTH))? pixel[kernel_data.film.pass_depth]: 0.0f;
+	float object_id = (flag & PASSMASK(OBJECT_ID))? pixel[kernel_data.film.pass_object_id]: 0.0f;
+	float material_id = (flag & PASSMASK(MATERIAL_ID))? pixel[kernel_data.film.pass_material_id]: 0.0f;
+
+	for(int i = 0; i < kernel_data.film.pass_adaptive_sampling; i++) {
+		pixel[i] *= scale;
+	}
+
+	if(flag & PASSMASK(DEPTH))
+		pixel[kernel_data.film.pass_depth] = depth;
+	if(flag & PASSMASK(OBJECT_ID))
+		pixel[kernel_data.film.pass_object_id] = object_id;
+	if(flag & PASSMASK(MATERIAL_ID))
+		pixel[kernel_data.film.pass_material_id] = material_id;
+
+#ifdef __DENOISING_FEATURES__
+	if(kernel_data.film.pass_denoising_data) {
+		kernel_adaptive_denoising_adjust(pixel + kernel_data.film.pass_denoising_data,
+		                                 num_samples,
+		                                 (float)sample);
+	}
+#endif
+
+	for(int i = 0; i < 3; i++) {
+		adaptive[ADAPTIVE_PASS_HALF_COLOR + i] *= scale;
+	}
+	adaptive[ADAPTIVE_PASS_SAMPLE_COUNT] = (float)sample;
+}
+
+CCL_NAMESPACE_END
@@ -212,6 +212,9 @@ ccl_device_noinline float3 indirect_primitive_emission(KernelGlobals *kg, Shader
 		/* multiple importance sampling, get triangle light pdf,
 		 * and compute weight with respect to BSDF pdf */
 		float pdf = triangle_light_pdf(kg, sd, t);
+		if(kernel_data.integrator.use_light_tree) {
+			pdf *= light_tree_triangle_pdf_scale(kg, sd->P + sd->I * t, sd->object, sd->prim);
+		}
 		float mis_weight = power_heuristic(bsdf_pdf, pdf);
 
 		return L*mis_weight;
@@ -273,7 +276,11 @@ ccl_device_noinline bool indirect_lamp_emission(KernelGlobals *kg,
 		if(!(state->flag & PATH_RAY_MIS_SKIP)) {
 			/* multiple importance sampling, get regular light pdf,
 			 * and compute weight with respect to BSDF pdf */
-			float mis_weight = power_heuristic(state->ray_pdf, ls.pdf);
+			float pdf = ls.pdf;
+			if(kernel_data.integrator.use_light_tree && !(state->flag & PATH_RAY_ALL_LIGHTS)) {
+				pdf *= light_tree_lamp_pdf_scale(kg, ray->P, lamp);
+			}
+			float mis_weight = power_heuristic(state->ray_pdf, pdf);
 			L *= mis_weight;
 		}
 
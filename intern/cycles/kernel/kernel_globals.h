@@ -44,6 +44,19 @@ struct OSLShadingSystem;
 
 struct Intersection;
 struct VolumeStep;
+struct PathTraceBatch;
+class TextureCache;
+
+/* Time spent in ray traversal and shader evaluation by a thread, only
+ * measured when enabled since reading the clock is not free. */
+typedef struct KernelTiming {
+	bool enabled;
+
+	double traversal_time;
+	double shading_time;
+	uint64_t num_traversal;
+	uint64_t num_shading;
+} KernelTiming;
 
 typedef struct KernelGlobals {
 #  define KERNEL_TEX(type, name) texture<type> name;
@@ -60,6 +73,11 @@ typedef struct KernelGlobals {
 	OSLThreadData *osl_tdata;
 #  endif
 
+	/* Images read on demand in tiles, instead of being loaded as a whole. */
+	TextureCache *texture_cache;
+	/* Texture system data of the thread, see TextureCache::thread_info(). */
+	void *texture_cache_thread_info;
+
 	/* **** Run-time data ****  */
 
 	/* Heap-allocated storage for transparent shadows intersections. */
@@ -69,6 +87,11 @@ typedef struct KernelGlobals {
 	VolumeStep *decoupled_volume_steps[2];
 	int decoupled_volume_steps_index;
 
+	/* Heap-allocated storage for camera rays integrated in order of shader. */
+	PathTraceBatch *path_trace_batch;
+
+	KernelTiming timing;
+
 	/* split kernel */
 	SplitData split_data;
 	SplitParams split_param_data;
@@ -1062,6 +1062,185 @@ ccl_device int light_distribution_sample(KernelGlobals *kg, float *randu)
 	return index;
 }
 
+/* Light Tree
+ *
+ * Emitters are picked by descending the tree built by the light manager,
+ * choosing children by their estimated contribution to the shading point:
+ * energy, distance, and emission directions towards it. The importance does
+ * not depend on the receiver normal, so the same probabilities can be
+ * computed from the ray origin when an emitter is hit for MIS. */
+
+ccl_device float light_tree_node_importance(KernelGlobals *kg, int node, float3 P)
+{
+	float4 data0 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 0);
+	float4 data1 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 1);
+	float4 data2 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 2);
+	float4 data3 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 3);
+
+	float energy = data0.w;
+	if(energy == 0.0f) {
+		return 0.0f;
+	}
+
+	float3 bbox_min = float4_to_float3(data0);
+	float3 bbox_max = float4_to_float3(data1);
+	float3 axis = float4_to_float3(data2);
+	float theta_o = data1.w;
+	float theta_e = data2.w;
+	int flags = __float_as_int(data3.w);
+
+	/* Bounding sphere of the node. */
+	float3 centroid = 0.5f*(bbox_min + bbox_max);
+	float radius_squared = 0.25f*len_squared(bbox_max - bbox_min);
+	float3 D = P - centroid;
+	float distance_squared = len_squared(D);
+
+	/* Angle subtended by the bounding sphere, all directions if inside. */
+	float theta_u = M_PI_F;
+	if(distance_squared > radius_squared) {
+		theta_u = safe_asinf(sqrtf(radius_squared/distance_squared));
+	}
+
+	/* Smallest angle between the emission bounds and the shading point. */
+	float cos_theta = (distance_squared > 0.0f)? dot(axis, D)/sqrtf(distance_squared): 1.0f;
+	if(flags & LIGHT_TREE_NODE_TWO_SIDED) {
+		cos_theta = fabsf(cos_theta);
+	}
+	float theta_prime = max(safe_acosf(cos_theta) - theta_o - theta_u, 0.0f);
+
+	if(theta_prime >= theta_e) {
+		return 0.0f;
+	}
+
+	return energy*cosf(theta_prime)/max(max(distance_squared, radius_squared), 1e-12f);
+}
+
+/* Probability of picking the first child of an inner node. */
+ccl_device float light_tree_child_probability(KernelGlobals *kg, int node, float3 P)
+{
+	float4 data3 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 3);
+	int child0 = __float_as_int(data3.x);
+	int child1 = __float_as_int(data3.y);
+
+	float energy0 = kernel_tex_fetch(__light_tree_nodes, child0*LIGHT_TREE_NODE_SIZE).w;
+	float energy1 = kernel_tex_fetch(__light_tree_nodes, child1*LIGHT_TREE_NODE_SIZE).w;
+	float importance0 = energy0, importance1 = energy1;
+
+	if(!(__float_as_int(data3.w) & LIGHT_TREE_NODE_ENERGY_SPLIT)) {
+		importance0 = light_tree_node_importance(kg, child0, P);
+		importance1 = light_tree_node_importance(kg, child1, P);
+
+		/* Both bounds are conservative, fall back to energy. */
+		if(importance0 == 0.0f && importance1 == 0.0f) {
+			importance0 = energy0;
+			importance1 = energy1;
+		}
+	}
+
+	float total = importance0 + importance1;
+	return (total > 0.0f)? importance0/total: 0.5f;
+}
+
+/* Pick distribution index of an emitter, rescaling randu for reuse. */
+ccl_device int light_tree_sample(KernelGlobals *kg, float3 P, float *randu, float *pdf)
+{
+	float r = *randu;
+	float tree_pdf = 1.0f;
+	int node = 0;
+
+	for(;;) {
+		float4 data3 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 3);
+		int child0 = __float_as_int(data3.x);
+
+		if(child0 < 0) {
+			*randu = r;
+			*pdf = tree_pdf;
+			return __float_as_int(data3.y);
+		}
+
+		float prob0 = light_tree_child_probability(kg, node, P);
+
+		if(r < prob0) {
+			r = r/prob0;
+			tree_pdf *= prob0;
+			node = child0;
+		}
+		else {
+			r = (prob0 < 1.0f)? (r - prob0)/(1.0f - prob0): 0.0f;
+			tree_pdf *= 1.0f - prob0;
+			node = __float_as_int(data3.y);
+		}
+	}
+}
+
+/* Probability of picking the emitter with the given distribution index. */
+ccl_device float light_tree_pdf(KernelGlobals *kg, float3 P, int index)
+{
+	uint leaf = kernel_tex_fetch(__light_tree_emitters, index);
+	if(leaf == ~0u) {
+		return 0.0f;
+	}
+
+	int node = (int)leaf;
+	int parent = __float_as_int(kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 3).z);
+	float pdf = 1.0f;
+
+	while(parent >= 0) {
+		float4 data3 = kernel_tex_fetch(__light_tree_nodes, parent*LIGHT_TREE_NODE_SIZE + 3);
+		float prob0 = light_tree_child_probability(kg, parent, P);
+
+		pdf *= (__float_as_int(data3.x) == node)? prob0: 1.0f - prob0;
+		node = parent;
+		parent = __float_as_int(data3.z);
+	}
+
+	return pdf;
+}
+
+/* Emitter pdfs are computed for the flat distribution, this is the factor
+ * to convert them to the light tree. */
+ccl_device float light_tree_pdf_scale(KernelGlobals *kg, float3 P, int index, float tree_pdf)
+{
+	float distr_min = kernel_tex_fetch(__light_distribution, index).x;
+	float distr_max = kernel_tex_fetch(__light_distribution, index+1).x;
+	float distr_pdf = distr_max - distr_min;
+
+	return (distr_pdf > 0.0f)? tree_pdf/distr_pdf: 0.0f;
+}
+
+/* Distribution index of a triangle hit by a ray, or -1 if not an emitter. */
+ccl_device int light_tree_triangle_index(KernelGlobals *kg, int object, int prim)
+{
+	int object_offset = kernel_data.integrator.num_distribution + object*2;
+	uint start = kernel_tex_fetch(__light_tree_emitters, object_offset + 0);
+	if(start == ~0u) {
+		return -1;
+	}
+
+	uint tri_offset = kernel_tex_fetch(__light_tree_emitters, object_offset + 1);
+	uint index = kernel_tex_fetch(__light_tree_emitters, start + (uint)prim - tri_offset);
+
+	return (index == ~0u)? -1: (int)index;
+}
+
+/* Factor to convert MIS pdfs of triangles and lamps hit by a ray. */
+ccl_device float light_tree_triangle_pdf_scale(KernelGlobals *kg, float3 P, int object, int prim)
+{
+	int index = light_tree_triangle_index(kg, object, prim);
+	if(index < 0) {
+		return 0.0f;
+	}
+
+	return light_tree_pdf_scale(kg, P, index, light_tree_pdf(kg, P, index));
+}
+
+ccl_device float light_tree_lamp_pdf_scale(KernelGlobals *kg, float3 P, int lamp)
+{
+	int index = kernel_data.integrator.num_distribution - kernel_data.integrator.num_all_lights + lamp;
+
+	return light_tree_pdf_scale(kg, P, index, light_tree_pdf(kg, P, index));
+}
+
 /* Generic Light */
 
 ccl_device bool light_select_reached_max_bounces(KernelGlobals *kg, int index, int bounce)
@@ -1079,7 +1258,17 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
                                       LightSample *ls)
 {
 	/* sample index */
-	int index = light_distribution_sample(kg, &randu);
+	int index;
+	float pdf_scale = 1.0f;
+
+	if(kernel_data.integrator.use_light_tree) {
+		float tree_pdf;
+		index = light_tree_sample(kg, P, &randu, &tree_pdf);
+		pdf_scale = light_tree_pdf_scale(kg, P, index, tree_pdf);
+	}
+	else {
+		index = light_distribution_sample(kg, &randu);
+	}
 
 	/* fetch light data */
 	float4 l = kernel_tex_fetch(__light_distribution, index);
@@ -1091,6 +1280,7 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
 
 		triangle_light_sample(kg, prim, object, randu, randv, time, ls, P);
 		ls->shader |= shader_flag;
+		ls->pdf *= pdf_scale;
 		return (ls->pdf > 0.0f);
 	}
 	else {
@@ -1100,10 +1290,47 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
 			return false;
 		}
 
-		return lamp_light_sample(kg, lamp, randu, randv, P, ls);
+		if(!lamp_light_sample(kg, lamp, randu, randv, P, ls)) {
+			return false;
+		}
+
+		ls->pdf *= pdf_scale;
+		return (ls->pdf > 0.0f);
 	}
 }
 
+/* Sample only mesh lights, for sampling all lights where lamps are sampled
+ * separately. */
+ccl_device_inline bool light_sample_triangles(KernelGlobals *kg,
+                                              float randu,
+                                              float randv,
+                                              float time,
+                                              float3 P,
+                                              int bounce,
+                                              LightSample *ls)
+{
+	if(kernel_data.integrator.use_light_tree) {
+		/* The tree can't be restricted to triangles, lamps it selects are
+		 * rejected. The pdf of triangles is the regular tree pdf then. */
+		return light_sample(kg, randu, randv, time, P, bounce, ls) &&
+		       ls->type == LIGHT_TRIANGLE;
+	}
+
+	/* Triangles are the first half of the distribution. */
+	if(kernel_data.integrator.num_all_lights)
+		randu = 0.5f*randu;
+
+	if(!light_sample(kg, randu, randv, time, P, bounce, ls))
+		return false;
+
+	/* Probability needs to be corrected since the sampling was forced to
+	 * select a mesh light. */
+	if(kernel_data.integrator.num_all_lights)
+		ls->pdf *= 2.0f;
+
+	return true;
+}
+
 ccl_device int light_select_num_samples(KernelGlobals *kg, int index)
 {
 	float4 data3 = kernel_tex_fetch(__light_data, index*LIGHT_SIZE + 3);
@@ -385,6 +385,16 @@ ccl_device_inline void kernel_write_result(KernelGlobals *kg,
 	}
 #endif  /* __DENOISING_FEATURES__ */
 
+	if(kernel_data.film.pass_adaptive_sampling) {
+		ccl_global float *adaptive = buffer + kernel_data.film.pass_adaptive_sampling;
+		if(sample & 1) {
+			float3 color = ensure_finite3(L_sum);
+			kernel_write_pass_float(adaptive + ADAPTIVE_PASS_HALF_COLOR + 0, color.x);
+			kernel_write_pass_float(adaptive + ADAPTIVE_PASS_HALF_COLOR + 1, color.y);
+			kernel_write_pass_float(adaptive + ADAPTIVE_PASS_HALF_COLOR + 2, color.z);
+		}
+		kernel_write_pass_float(adaptive + ADAPTIVE_PASS_SAMPLE_COUNT, 1.0f);
+	}
 
 #ifdef __KERNEL_DEBUG__
 	kernel_write_debug_passes(kg, buffer, L);
@@ -31,6 +31,7 @@
 #include "kernel/kernel_shader.h"
 #include "kernel/kernel_light.h"
 #include "kernel/kernel_passes.h"
+#include "kernel/kernel_adaptive_sampling.h"
 
 #ifdef __SUBSURFACE__
 #  include "kernel/kernel_subsurface.h"
@@ -50,12 +51,28 @@
 
 CCL_NAMESPACE_BEGIN
 
-ccl_device_forceinline bool kernel_path_scene_intersect(
+#ifdef __KERNEL_DEBUG__
+ccl_device_forceinline void kernel_path_scene_intersect_debug(
+	ccl_addr_space PathState *state,
+	const Intersection *isect,
+	PathRadiance *L)
+{
+	if(state->flag & PATH_RAY_CAMERA) {
+		L->debug_data.num_bvh_traversed_nodes += isect->num_traversed_nodes;
+		L->debug_data.num_bvh_traversed_instances += isect->num_traversed_instances;
+		L->debug_data.num_bvh_intersections += isect->num_intersections;
+	}
+	L->debug_data.num_ray_bounces++;
+}
+#endif  /* __KERNEL_DEBUG__ */
+
+/* Trace the ray without recording debug data, for rays whose intersection is
+ * passed on to kernel_path_integrate() which records it. */
+ccl_device_forceinline bool kernel_path_scene_intersect_ray(
 	KernelGlobals *kg,
 	ccl_addr_space PathState *state,
 	Ray *ray,
-	Intersection *isect,
-	PathRadiance *L)
+	Intersection *isect)
 {
 	uint visibility = path_state_ray_visibility(kg, state);
 
@@ -64,6 +81,8 @@ ccl_device_forceinline bool kernel_path_scene_intersect(
 		ray->t = kernel_data.background.ao_distance;
 	}
 
+	KERNEL_TIMING_BEGIN(kg);
+
 #ifdef __HAIR__
 	float difl = 0.0f, extmax = 0.0f;
 	uint lcg_state = 0;
@@ -84,13 +103,22 @@ ccl_device_forceinline bool kernel_path_scene_intersect(
 	bool hit = scene_intersect(kg, *ray, visibility, isect, NULL, 0.0f, 0.0f);
 #endif  /* __HAIR__ */
 
+	KERNEL_TIMING_END(kg, traversal);
+
+	return hit;
+}
+
+ccl_device_forceinline bool kernel_path_scene_intersect(
+	KernelGlobals *kg,
+	ccl_addr_space PathState *state,
+	Ray *ray,
+	Intersection *isect,
+	PathRadiance *L)
+{
+	bool hit = kernel_path_scene_intersect_ray(kg, state, ray, isect);
+
 #ifdef __KERNEL_DEBUG__
-	if(state->flag & PATH_RAY_CAMERA) {
-		L->debug_data.num_bvh_traversed_nodes += isect->num_traversed_nodes;
-		L->debug_data.num_bvh_traversed_instances += isect->num_traversed_instances;
-		L->debug_data.num_bvh_intersections += isect->num_intersections;
-	}
-	L->debug_data.num_ray_bounces++;
+	kernel_path_scene_intersect_debug(state, isect, L);
 #endif  /* __KERNEL_DEBUG__ */
 
 	return hit;
@@ -542,7 +570,8 @@ ccl_device_forceinline void kernel_path_integrate(
 	Ray *ray,
 	PathRadiance *L,
 	ccl_global float *buffer,
-	ShaderData *emission_sd)
+	ShaderData *emission_sd,
+	const Intersection *first_isect)
 {
 	/* Shader data memory used for both volumes and surfaces, saves stack space. */
 	ShaderData sd;
@@ -558,7 +587,22 @@ ccl_device_forceinline void kernel_path_integrate(
 	for(;;) {
 		/* Find intersection with objects in scene. */
 		Intersection isect;
-		bool hit = kernel_path_scene_intersect(kg, state, ray, &isect, L);
+		bool hit;
+#ifdef __KERNEL_CPU__
+		if(first_isect != NULL) {
+			/* Camera ray was already traced together with other pixels. */
+			isect = *first_isect;
+			hit = (isect.prim != PRIM_NONE);
+			first_isect = NULL;
+#ifdef __KERNEL_DEBUG__
+			kernel_path_scene_intersect_debug(state, &isect, L);
+#endif  /* __KERNEL_DEBUG__ */
+		}
+		else
+#endif
+		{
+			hit = kernel_path_scene_intersect(kg, state, ray, &isect, L);
+		}
 
 		/* Find intersection with lamps and compute emission for MIS. */
 		kernel_path_lamp_emission(kg, state, ray, throughput, &isect, &sd, L);
@@ -690,6 +734,10 @@ ccl_device void kernel_path_trace(KernelGlobals *kg,
 
 	buffer += index*pass_stride;
 
+	if(kernel_adaptive_pixel_converged(kg, buffer)) {
+		return;
+	}
+
 	/* Initialize random numbers and sample ray. */
 	uint rng_hash;
 	Ray ray;
@@ -697,6 +745,7 @@ ccl_device void kernel_path_trace(KernelGlobals *kg,
 	kernel_path_trace_setup(kg, sample, x, y, &rng_hash, &ray);
 
 	if(ray.t == 0.0f) {
+		kernel_adaptive_write_empty_sample(kg, buffer);
 		return;
 	}
 
@@ -719,11 +768,236 @@ ccl_device void kernel_path_trace(KernelGlobals *kg,
 	                      &ray,
 	                      &L,
 	                      buffer,
-	                      emission_sd);
+	                      emission_sd,
+	                      NULL);
 
 	kernel_write_result(kg, buffer, sample, &L);
 }
 
+#ifdef __BVH_PACKET__
+/* Same as kernel_path_trace(), for a row of up to BVH_PACKET_SIZE pixels
+ * starting at x. Camera rays of all pixels are traced together by packet
+ * traversal, after which paths are integrated one pixel at a time.
+ */
+ccl_device void kernel_path_trace_packet(KernelGlobals *kg,
+	ccl_global float *buffer,
+	int sample, int x, int y, int num, int offset, int stride)
+{
+	kernel_assert(num <= BVH_PACKET_SIZE);
+
+	if(!scene_intersect_packet_supported(kg)) {
+		for(int i = 0; i < num; i++) {
+			kernel_path_trace(kg, buffer, sample, x + i, y, offset, stride);
+		}
+		return;
+	}
+
+	int pass_stride = kernel_data.film.pass_stride;
+
+	/* Initialize random numbers and sample rays, pixels without camera ray
+	 * or which converged already are left out of the packet.
+	 */
+	int pixel_x[BVH_PACKET_SIZE];
+	uint rng_hash[BVH_PACKET_SIZE];
+	Ray rays[BVH_PACKET_SIZE];
+	int num_rays = 0;
+
+	for(int i = 0; i < num; i++) {
+		int index = offset + x + i + y*stride;
+		if(kernel_adaptive_pixel_converged(kg, buffer + index*pass_stride)) {
+			continue;
+		}
+
+		kernel_path_trace_setup(kg, sample, x + i, y, &rng_hash[num_rays], &rays[num_rays]);
+
+		if(rays[num_rays].t != 0.0f) {
+			pixel_x[num_rays++] = x + i;
+		}
+		else {
+			kernel_adaptive_write_empty_sample(kg, buffer + index*pass_stride);
+		}
+	}
+
+	if(num_rays == 0) {
+		return;
+	}
+
+	/* Initialize states. */
+	ShaderDataTinyStorage emission_sd_storage;
+	ShaderData *emission_sd = AS_SHADER_DATA(&emission_sd_storage);
+
+	PathState state[BVH_PACKET_SIZE];
+	for(int i = 0; i < num_rays; i++) {
+		path_state_init(kg, emission_sd, &state[i], rng_hash[i], sample, &rays[i]);
+	}
+
+	/* Trace camera rays, visibility is the same for all of them. */
+	Intersection isect[BVH_PACKET_SIZE];
+	KERNEL_TIMING_BEGIN(kg);
+	scene_intersect_packet(kg,
+	                       rays,
+	                       path_state_ray_visibility(kg, &state[0]),
+	                       isect,
+	                       num_rays);
+	KERNEL_TIMING_END(kg, traversal);
+
+	/* Integrate. */
+	for(int i = 0; i < num_rays; i++) {
+		int index = offset + pixel_x[i] + y*stride;
+		ccl_global float *pixel_buffer = buffer + index*pass_stride;
+
+		float3 throughput = make_float3(1.0f, 1.0f, 1.0f);
+
+		PathRadiance L;
+		path_radiance_init(&L, kernel_data.film.use_light_pass);
+
+		kernel_path_integrate(kg,
+		                      &state[i],
+		                      throughput,
+		                      &rays[i],
+		                      &L,
+		                      pixel_buffer,
+		                      emission_sd,
+		                      &isect[i]);
+
+		kernel_write_result(kg, pixel_buffer, sample, &L);
+	}
+}
+#endif  /* __BVH_PACKET__ */
+
+#ifdef __KERNEL_CPU__
+/* Camera rays are intersected for a batch of pixels first, then their paths
+ * are integrated in order of the shader they hit. Neighbouring paths then run
+ * the same shader program on similar data, which makes better use of caches
+ * and branch prediction. Pixels with equal shader stay in scanline order. */
+
+#define PATH_TRACE_BATCH_BITS 8
+#define PATH_TRACE_BATCH_SIZE (1 << PATH_TRACE_BATCH_BITS)
+
+typedef struct PathTraceBatch {
+	Ray rays[PATH_TRACE_BATCH_SIZE];
+	PathState state[PATH_TRACE_BATCH_SIZE];
+	Intersection isect[PATH_TRACE_BATCH_SIZE];
+	int pixel[PATH_TRACE_BATCH_SIZE];
+
+	/* Shader in the high bits, index in the batch in the low bits. */
+	uint keys[PATH_TRACE_BATCH_SIZE];
+	uint keys_tmp[PATH_TRACE_BATCH_SIZE];
+} PathTraceBatch;
+
+/* Bottom-up merge sort, returns either keys or tmp, whichever holds the
+ * sorted keys. */
+ccl_device uint *kernel_path_trace_sort_keys(uint *keys, uint *tmp, int num)
+{
+	for(int width = 1; width < num; width *= 2) {
+		for(int start = 0; start < num; start += 2*width) {
+			const int mid = min(start + width, num);
+			const int end = min(start + 2*width, num);
+			int i = start, j = mid, k = start;
+
+			while(i < mid && j < end) {
+				tmp[k++] = (keys[i] <= keys[j])? keys[i++]: keys[j++];
+			}
+			while(i < mid) {
+				tmp[k++] = keys[i++];
+			}
+			while(j < end) {
+				tmp[k++] = keys[j++];
+			}
+		}
+
+		uint *swap = keys;
+		keys = tmp;
+		tmp = swap;
+	}
+
+	return keys;
+}
+
+ccl_device void kernel_path_trace_sorted(KernelGlobals *kg,
+	ccl_global float *buffer,
+	int sample, int x, int y, int w, int h, int offset, int stride)
+{
+	if(kg->path_trace_batch == NULL) {
+		kg->path_trace_batch = (PathTraceBatch*)malloc(sizeof(PathTraceBatch));
+	}
+	PathTraceBatch *batch = kg->path_trace_batch;
+
+	const int pass_stride = kernel_data.film.pass_stride;
+	const int max_shader = (0x7FFFFFFF >> PATH_TRACE_BATCH_BITS);
+
+	ShaderDataTinyStorage emission_sd_storage;
+	ShaderData *emission_sd = AS_SHADER_DATA(&emission_sd_storage);
+
+	const int num_pixels = w*h;
+
+	for(int batch_start = 0; batch_start < num_pixels; batch_start += PATH_TRACE_BATCH_SIZE) {
+		const int batch_end = min(batch_start + PATH_TRACE_BATCH_SIZE, num_pixels);
+		int num = 0;
+
+		/* Initialize random numbers, sample and intersect camera rays. Pixels
+		 * without camera ray or which converged already are left out. */
+		for(int p = batch_start; p < batch_end; p++) {
+			const int px = x + p % w;
+			const int py = y + p / w;
+			const int index = offset + px + py*stride;
+
+			if(kernel_adaptive_pixel_converged(kg, buffer + index*pass_stride)) {
+				continue;
+			}
+
+			uint rng_hash;
+			Ray *ray = &batch->rays[num];
+			kernel_path_trace_setup(kg, sample, px, py, &rng_hash, ray);
+
+			if(ray->t == 0.0f) {
+				kernel_adaptive_write_empty_sample(kg, buffer + index*pass_stride);
+				continue;
+			}
+
+			PathState *state = &batch->state[num];
+			Intersection *isect = &batch->isect[num];
+			path_state_init(kg, emission_sd, state, rng_hash, sample, ray);
+
+			int shader = max_shader;
+			/* Debug data of the camera ray is added to the path radiance
+			 * by kernel_path_integrate(). */
+			if(kernel_path_scene_intersect_ray(kg, state, ray, isect)) {
+				shader = min(shader_from_intersection(kg, isect), max_shader - 1);
+			}
+
+			batch->pixel[num] = index;
+			batch->keys[num] = ((uint)shader << PATH_TRACE_BATCH_BITS) | (uint)num;
+			num++;
+		}
+
+		const uint *keys = kernel_path_trace_sort_keys(batch->keys, batch->keys_tmp, num);
+
+		/* Integrate, misses come last. */
+		for(int k = 0; k < num; k++) {
+			const int i = keys[k] & (PATH_TRACE_BATCH_SIZE - 1);
+			ccl_global float *pixel_buffer = buffer + batch->pixel[i]*pass_stride;
+
+			float3 throughput = make_float3(1.0f, 1.0f, 1.0f);
+
+			PathRadiance L;
+			path_radiance_init(&L, kernel_data.film.use_light_pass);
+
+			kernel_path_integrate(kg,
+			                      &batch->state[i],
+			                      throughput,
+			                      &batch->rays[i],
+			                      &L,
+			                      pixel_buffer,
+			                      emission_sd,
+			                      &batch->isect[i]);
+
+			kernel_write_result(kg, pixel_buffer, sample, &L);
+		}
+	}
+}
+#endif  /* __KERNEL_CPU__ */
+
 #endif  /* __SPLIT_KERNEL__ */
 
 CCL_NAMESPACE_END
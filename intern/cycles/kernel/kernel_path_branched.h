@@ -582,6 +582,10 @@ ccl_device void kernel_branched_path_trace(KernelGlobals *kg,
 
 	buffer += index*pass_stride;
 
+	if(kernel_adaptive_pixel_converged(kg, buffer)) {
+		return;
+	}
+
 	/* initialize random numbers and ray */
 	uint rng_hash;
 	Ray ray;
@@ -595,6 +599,9 @@ ccl_device void kernel_branched_path_trace(KernelGlobals *kg,
 		kernel_branched_path_integrate(kg, rng_hash, sample, ray, buffer, &L);
 		kernel_write_result(kg, buffer, sample, &L);
 	}
+	else {
+		kernel_adaptive_write_empty_sample(kg, buffer);
+	}
 }
 
 #endif  /* __SPLIT_KERNEL__ */
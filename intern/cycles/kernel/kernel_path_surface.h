@@ -29,6 +29,12 @@ ccl_device_noinline void kernel_branched_path_surface_connect_light(
         int sample_all_lights)
 {
 #ifdef __EMISSION__
+	/* lamps are sampled without the light tree, emission MIS must match */
+	if(sample_all_lights)
+		state->flag |= PATH_RAY_ALL_LIGHTS;
+	else
+		state->flag &= ~PATH_RAY_ALL_LIGHTS;
+
 	/* sample illumination from lights to find path contribution */
 	if(!(sd->flag & SD_BSDF_HAS_EVAL))
 		return;
@@ -90,15 +96,8 @@ ccl_device_noinline void kernel_branched_path_surface_connect_light(
 				float terminate = path_branched_rng_light_termination(kg, state->rng_hash, state, j, num_samples);
 
 				/* only sample triangle lights */
-				if(kernel_data.integrator.num_all_lights)
-					light_u = 0.5f*light_u;
-
 				LightSample ls;
-				if(light_sample(kg, light_u, light_v, sd->time, sd->P, state->bounce, &ls)) {
-					/* Same as above, probability needs to be corrected since the sampling was forced to select a mesh light. */
-					if(kernel_data.integrator.num_all_lights)
-						ls.pdf *= 2.0f;
-
+				if(light_sample_triangles(kg, light_u, light_v, sd->time, sd->P, state->bounce, &ls)) {
 					if(direct_emission(kg, sd, emission_sd, &ls, state, &light_ray, &L_light, &is_lamp, terminate)) {
 						/* trace shadow ray */
 						float3 shadow;
@@ -218,6 +217,8 @@ ccl_device_inline void kernel_path_surface_connect_light(KernelGlobals *kg,
 	PathRadiance *L)
 {
 #ifdef __EMISSION__
+	state->flag &= ~PATH_RAY_ALL_LIGHTS;
+
 	if(!(kernel_data.integrator.use_direct_light && (sd->flag & SD_BSDF_HAS_EVAL)))
 		return;
 
@@ -27,6 +27,8 @@ ccl_device_inline void kernel_path_volume_connect_light(
         PathRadiance *L)
 {
 #ifdef __EMISSION__
+	state->flag &= ~PATH_RAY_ALL_LIGHTS;
+
 	if(!kernel_data.integrator.use_direct_light)
 		return;
 
@@ -125,6 +127,12 @@ ccl_device void kernel_branched_path_volume_connect_light(
         const VolumeSegment *segment)
 {
 #ifdef __EMISSION__
+	/* lamps are sampled without the light tree, emission MIS must match */
+	if(sample_all_lights)
+		state->flag |= PATH_RAY_ALL_LIGHTS;
+	else
+		state->flag &= ~PATH_RAY_ALL_LIGHTS;
+
 	if(!kernel_data.integrator.use_direct_light)
 		return;
 
@@ -192,11 +200,9 @@ ccl_device void kernel_branched_path_volume_connect_light(
 				path_branched_rng_2D(kg, state->rng_hash, state, j, num_samples, PRNG_LIGHT_U, &light_u, &light_v);
 
 				/* only sample triangle lights */
-				if(kernel_data.integrator.num_all_lights)
-					light_u = 0.5f*light_u;
-
 				LightSample ls;
-				light_sample(kg, light_u, light_v, sd->time, ray->P, state->bounce, &ls);
+				if(!light_sample_triangles(kg, light_u, light_v, sd->time, ray->P, state->bounce, &ls))
+					continue;
 
 				float3 tp = throughput;
 
@@ -209,10 +215,7 @@ ccl_device void kernel_branched_path_volume_connect_light(
 					
 				/* todo: split up light_sample so we don't have to call it again with new position */
 				if(result == VOLUME_PATH_SCATTERED &&
-				   light_sample(kg, light_u, light_v, sd->time, sd->P, state->bounce, &ls)) {
-					if(kernel_data.integrator.num_all_lights)
-						ls.pdf *= 2.0f;
-
+				   light_sample_triangles(kg, light_u, light_v, sd->time, sd->P, state->bounce, &ls)) {
 					float terminate = path_branched_rng_light_termination(kg, state->rng_hash, state, j, num_samples);
 					if(direct_emission(kg, sd, emission_sd, &ls, state, &light_ray, &L_light, &is_lamp, terminate)) {
 						/* trace shadow ray */
@@ -31,6 +31,8 @@
 
 #include "kernel/svm/svm.h"
 
+#include "kernel/kernel_timing.h"
+
 CCL_NAMESPACE_BEGIN
 
 /* ShaderData setup from incoming ray */
@@ -962,6 +964,8 @@ ccl_device float3 shader_holdout_eval(KernelGlobals *kg, ShaderData *sd)
 ccl_device void shader_eval_surface(KernelGlobals *kg, ShaderData *sd,
 	ccl_addr_space PathState *state, int path_flag, int max_closure)
 {
+	KERNEL_TIMING_BEGIN(kg);
+
 	sd->num_closure = 0;
 	sd->num_closure_left = max_closure;
 
@@ -985,6 +989,8 @@ ccl_device void shader_eval_surface(KernelGlobals *kg, ShaderData *sd,
 	if(sd->flag & SD_BSDF_NEEDS_LCG) {
 		sd->lcg_state = lcg_state_init_addrspace(state, 0xb4bc3953);
 	}
+
+	KERNEL_TIMING_END(kg, shading);
 }
 
 /* Background Evaluation */
@@ -1206,10 +1212,9 @@ ccl_device void shader_eval_displacement(KernelGlobals *kg, ShaderData *sd, ccl_
 #endif
 }
 
-/* Transparent Shadows */
+/* Shader of the intersected primitive, without setting up shader data. */
 
-#ifdef __TRANSPARENT_SHADOWS__
-ccl_device bool shader_transparent_shadow(KernelGlobals *kg, Intersection *isect)
+ccl_device_inline int shader_from_intersection(KernelGlobals *kg, const Intersection *isect)
 {
 	int prim = kernel_tex_fetch(__prim_index, isect->prim);
 	int shader = 0;
@@ -1225,7 +1230,17 @@ ccl_device bool shader_transparent_shadow(KernelGlobals *kg, Intersection *isect
 		shader = __float_as_int(str.z);
 	}
 #endif
-	int flag = kernel_tex_fetch(__shader_flag, (shader & SHADER_MASK)*SHADER_SIZE);
+
+	return shader & SHADER_MASK;
+}
+
+/* Transparent Shadows */
+
+#ifdef __TRANSPARENT_SHADOWS__
+ccl_device bool shader_transparent_shadow(KernelGlobals *kg, Intersection *isect)
+{
+	int shader = shader_from_intersection(kg, isect);
+	int flag = kernel_tex_fetch(__shader_flag, shader*SHADER_SIZE);
 
 	return (flag & SD_HAS_TRANSPARENT_SHADOW) != 0;
 }
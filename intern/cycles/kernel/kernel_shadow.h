@@ -111,12 +111,14 @@ ccl_device bool shadow_blocked_opaque(KernelGlobals *kg,
                                       Intersection *isect,
                                       float3 *shadow)
 {
+	KERNEL_TIMING_BEGIN(kg);
 	const bool blocked = scene_intersect(kg,
 	                                     *ray,
 	                                     visibility & PATH_RAY_SHADOW_OPAQUE,
 	                                     isect,
 	                                     NULL,
 	                                     0.0f, 0.0f);
+	KERNEL_TIMING_END(kg, traversal);
 #ifdef __VOLUME__
 	if(!blocked && state->volume_stack[0].shader != SHADER_NONE) {
 		/* Apply attenuation from current volume shader. */
@@ -174,12 +176,14 @@ ccl_device bool shadow_blocked_transparent_all_loop(KernelGlobals *kg,
 	 * surface hits.
 	 */
 	uint num_hits;
+	KERNEL_TIMING_BEGIN(kg);
 	const bool blocked = scene_intersect_shadow_all(kg,
 	                                                ray,
 	                                                hits,
 	                                                visibility,
 	                                                max_hits,
 	                                                &num_hits);
+	KERNEL_TIMING_END(kg, traversal);
 #    ifdef __VOLUME__
 	VolumeState volume_state;
 #    endif
@@ -357,13 +361,15 @@ ccl_device bool shadow_blocked_transparent_stepped_loop(
 			if(bounce >= kernel_data.integrator.transparent_max_bounce) {
 				return true;
 			}
-			if(!scene_intersect(kg,
-			                    *ray,
-			                    visibility & PATH_RAY_SHADOW_TRANSPARENT,
-			                    isect,
-			                    NULL,
-			                    0.0f, 0.0f))
-			{
+			KERNEL_TIMING_BEGIN(kg);
+			const bool hit = scene_intersect(kg,
+			                                 *ray,
+			                                 visibility & PATH_RAY_SHADOW_TRANSPARENT,
+			                                 isect,
+			                                 NULL,
+			                                 0.0f, 0.0f);
+			KERNEL_TIMING_END(kg, traversal);
+			if(!hit) {
 				break;
 			}
 			if(!shader_transparent_shadow(kg, isect)) {
@@ -425,12 +431,14 @@ ccl_device bool shadow_blocked_transparent_stepped(
         Intersection *isect,
         float3 *shadow)
 {
+	KERNEL_TIMING_BEGIN(kg);
 	bool blocked = scene_intersect(kg,
 	                               *ray,
 	                               visibility & PATH_RAY_SHADOW_OPAQUE,
 	                               isect,
 	                               NULL,
 	                               0.0f, 0.0f);
+	KERNEL_TIMING_END(kg, traversal);
 	bool is_transparent_isect = blocked
 		? shader_transparent_shadow(kg, isect)
 		: false;
@@ -60,6 +60,8 @@ KERNEL_TEX(uchar4, __attributes_uchar4)
 
 /* lights */
 KERNEL_TEX(float4, __light_distribution)
+KERNEL_TEX(float4, __light_tree_nodes)
+KERNEL_TEX(uint, __light_tree_emitters)
 KERNEL_TEX(float4, __light_data)
 KERNEL_TEX(float2, __light_background_marginal_cdf)
 KERNEL_TEX(float2, __light_background_conditional_cdf)
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Timing
+ *
+ * Time spent in ray traversal and surface shader evaluation, accumulated in
+ * the KernelGlobals of the thread. Only compiled into CPU kernels of builds
+ * with WITH_CYCLES_DEBUG, where it is used when enabled by the debug flag.
+ * Elsewhere these compile to nothing, so regular builds don't have the check
+ * around every intersection and shader evaluation.
+ *
+ * Rays traced from inside shaders, such as by the ambient occlusion and bevel
+ * nodes, count as shading time. */
+
+#if defined(__KERNEL_CPU__) && defined(__KERNEL_DEBUG__)
+#  include "util/util_time.h"
+
+#  define KERNEL_TIMING_BEGIN(kg) \
+	const double kernel_timing_start = ((kg)->timing.enabled)? time_dt(): 0.0
+#  define KERNEL_TIMING_END(kg, name) \
+	do { \
+		if((kg)->timing.enabled) { \
+			(kg)->timing.name##_time += time_dt() - kernel_timing_start; \
+			(kg)->timing.num_##name++; \
+		} \
+	} while(0)
+#else
+#  define KERNEL_TIMING_BEGIN(kg)
+#  define KERNEL_TIMING_END(kg, name)
+#endif
@@ -38,6 +38,7 @@ CCL_NAMESPACE_BEGIN
 #define OBJECT_SIZE 		12
 #define OBJECT_VECTOR_SIZE	6
 #define LIGHT_SIZE		11
+#define LIGHT_TREE_NODE_SIZE	4
 #define FILTER_TABLE_SIZE	1024
 #define RAMP_TABLE_SIZE		256
 #define SHUTTER_TABLE_SIZE		256
@@ -82,6 +83,10 @@ CCL_NAMESPACE_BEGIN
 #ifdef __KERNEL_CPU__
 #  ifdef __KERNEL_SSE2__
 #    define __QBVH__
+#    define __BVH_PACKET__
+#  endif
+#  ifdef __KERNEL_AVX2__
+#    define __OBVH__
 #  endif
 #  define __KERNEL_SHADING__
 #  define __KERNEL_ADV_SHADING__
@@ -351,6 +356,8 @@ enum PathRayFlag {
 	PATH_RAY_SINGLE_PASS_DONE    = (1 << 17),
 	PATH_RAY_SHADOW_CATCHER      = (1 << 18),
 	PATH_RAY_STORE_SHADOW_INFO   = (1 << 19),
+	/* Direct light of the last vertex sampled all lights, not using the light tree. */
+	PATH_RAY_ALL_LIGHTS          = (1 << 20),
 };
 
 /* Closure Label */
@@ -438,6 +445,16 @@ typedef enum DenoisingPassOffsets {
 	DENOISING_PASS_SIZE_CLEAN         = 3,
 } DenoisingPassOffsets;
 
+/* Adaptive sampling stores the sum of every second sample to estimate the
+ * error, whether the pixel converged and how many samples it received. */
+typedef enum AdaptiveSamplingPassOffsets {
+	ADAPTIVE_PASS_HALF_COLOR          = 0,
+	ADAPTIVE_PASS_CONVERGED           = 3,
+	ADAPTIVE_PASS_SAMPLE_COUNT        = 4,
+
+	ADAPTIVE_PASS_SIZE                = 5,
+} AdaptiveSamplingPassOffsets;
+
 typedef enum eBakePassFilter {
 	BAKE_FILTER_NONE = 0,
 	BAKE_FILTER_DIRECT = (1 << 0),
@@ -626,6 +643,16 @@ typedef enum LightType {
 	LIGHT_TRIANGLE
 } LightType;
 
+/* Light Tree Node Flags */
+
+enum LightTreeNodeFlag {
+	/* Children are picked by their energy only, not by their importance
+	 * for the shading point. */
+	LIGHT_TREE_NODE_ENERGY_SPLIT = (1 << 0),
+	/* Emitters emit in both directions of the orientation bounds. */
+	LIGHT_TREE_NODE_TWO_SIDED = (1 << 1),
+};
+
 /* Camera Type */
 
 enum CameraType {
@@ -1243,7 +1270,8 @@ typedef struct KernelFilm {
 	int pass_denoising_clean;
 	int denoising_flags;
 
-	int pad1, pad2, pad3;
+	int pass_adaptive_sampling;
+	int pad1, pad2;
 
 #ifdef __KERNEL_DEBUG__
 	int pass_bvh_traversed_nodes;
@@ -1339,6 +1367,13 @@ typedef struct KernelIntegrator {
 	int start_sample;
 
 	int max_closures;
+
+	/* light tree */
+	int use_light_tree;
+
+	/* adaptive sampling */
+	float adaptive_threshold;
+	int pad1, pad2;
 } KernelIntegrator;
 static_assert_align(KernelIntegrator, 16);
 
@@ -1349,8 +1384,9 @@ typedef struct KernelBVH {
 	int have_curves;
 	int have_instancing;
 	int use_qbvh;
+	int use_obvh;
 	int use_bvh_steps;
-	int pad1, pad2;
+	int pad1;
 } KernelBVH;
 static_assert_align(KernelBVH, 16);
 
@@ -23,6 +23,47 @@ void KERNEL_FUNCTION_FULL_NAME(path_trace)(KernelGlobals *kg,
                                            int offset,
                                            int stride);
 
+void KERNEL_FUNCTION_FULL_NAME(path_trace_packet)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int sample,
+                                                  int x, int y,
+                                                  int num,
+                                                  int offset,
+                                                  int stride);
+
+void KERNEL_FUNCTION_FULL_NAME(path_trace_sorted)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int sample,
+                                                  int x, int y,
+                                                  int w, int h,
+                                                  int offset,
+                                                  int stride);
+
+void KERNEL_FUNCTION_FULL_NAME(adaptive_stopping)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int x, int y,
+                                                  int offset,
+                                                  int stride);
+
+bool KERNEL_FUNCTION_FULL_NAME(adaptive_filter_x)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int y, int x, int w,
+                                                  int offset,
+                                                  int stride);
+
+bool KERNEL_FUNCTION_FULL_NAME(adaptive_filter_y)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int x, int y, int h,
+                                                  int offset,
+                                                  int stride);
+
+void KERNEL_FUNCTION_FULL_NAME(adaptive_adjust_samples)(KernelGlobals *kg,
+                                                        float *buffer,
+                                                        int sample,
+                                                        int x, int y,
+                                                        int offset,
+                                                        int stride);
+
 void KERNEL_FUNCTION_FULL_NAME(convert_to_byte)(KernelGlobals *kg,
                                                 uchar4 *rgba,
                                                 float *buffer,
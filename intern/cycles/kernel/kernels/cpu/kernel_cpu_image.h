@@ -17,6 +17,8 @@
 #ifndef __KERNEL_CPU_IMAGE_H__
 #define __KERNEL_CPU_IMAGE_H__
 
+#include "util/util_texture_cache.h"
+
 CCL_NAMESPACE_BEGIN
 
 template<typename T> struct TextureInterpolator  {
@@ -474,6 +476,11 @@ template<typename T> struct TextureInterpolator  {
 
 ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, float y)
 {
+	/* Images which are read on demand in tiles. */
+	if(UNLIKELY(kg->texture_cache->is_cached(id))) {
+		return kg->texture_cache->lookup(kg->texture_cache_thread_info, id, x, y);
+	}
+
 	const TextureInfo& info = kernel_tex_fetch(__texture_info, id);
 
 	switch(kernel_tex_type(id)) {
@@ -100,6 +100,119 @@ void KERNEL_FUNCTION_FULL_NAME(path_trace)(KernelGlobals *kg,
 #endif /* KERNEL_STUB */
 }
 
+void KERNEL_FUNCTION_FULL_NAME(path_trace_packet)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int sample,
+                                                  int x, int y,
+                                                  int num,
+                                                  int offset,
+                                                  int stride)
+{
+#ifdef KERNEL_STUB
+	STUB_ASSERT(KERNEL_ARCH, path_trace_packet);
+#else
+#  ifdef __BVH_PACKET__
+	if(!kernel_data.integrator.branched) {
+		kernel_path_trace_packet(kg, buffer, sample, x, y, num, offset, stride);
+		return;
+	}
+#  endif
+	for(int i = 0; i < num; i++) {
+		KERNEL_FUNCTION_FULL_NAME(path_trace)(kg,
+		                                      buffer,
+		                                      sample,
+		                                      x + i, y,
+		                                      offset,
+		                                      stride);
+	}
+#endif /* KERNEL_STUB */
+}
+
+void KERNEL_FUNCTION_FULL_NAME(path_trace_sorted)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int sample,
+                                                  int x, int y,
+                                                  int w, int h,
+                                                  int offset,
+                                                  int stride)
+{
+#ifdef KERNEL_STUB
+	STUB_ASSERT(KERNEL_ARCH, path_trace_sorted);
+#else
+	if(!kernel_data.integrator.branched) {
+		kernel_path_trace_sorted(kg, buffer, sample, x, y, w, h, offset, stride);
+		return;
+	}
+	for(int j = y; j < y + h; j++) {
+		for(int i = x; i < x + w; i++) {
+			KERNEL_FUNCTION_FULL_NAME(path_trace)(kg,
+			                                      buffer,
+			                                      sample,
+			                                      i, j,
+			                                      offset,
+			                                      stride);
+		}
+	}
+#endif /* KERNEL_STUB */
+}
+
+/* Adaptive Sampling */
+
+void KERNEL_FUNCTION_FULL_NAME(adaptive_stopping)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int x, int y,
+                                                  int offset,
+                                                  int stride)
+{
+#ifdef KERNEL_STUB
+	STUB_ASSERT(KERNEL_ARCH, adaptive_stopping);
+#else
+	kernel_adaptive_stopping(kg, buffer, x, y, offset, stride);
+#endif /* KERNEL_STUB */
+}
+
+bool KERNEL_FUNCTION_FULL_NAME(adaptive_filter_x)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int y, int x, int w,
+                                                  int offset,
+                                                  int stride)
+{
+#ifdef KERNEL_STUB
+	STUB_ASSERT(KERNEL_ARCH, adaptive_filter_x);
+	return false;
+#else
+	return kernel_adaptive_filter_x(kg, buffer, y, x, w, offset, stride);
+#endif /* KERNEL_STUB */
+}
+
+bool KERNEL_FUNCTION_FULL_NAME(adaptive_filter_y)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int x, int y, int h,
+                                                  int offset,
+                                                  int stride)
+{
+#ifdef KERNEL_STUB
+	STUB_ASSERT(KERNEL_ARCH, adaptive_filter_y);
+	return false;
+#else
+	return kernel_adaptive_filter_y(kg, buffer, x, y, h, offset, stride);
+#endif /* KERNEL_STUB */
+}
+
+void KERNEL_FUNCTION_FULL_NAME(adaptive_adjust_samples)(KernelGlobals *kg,
+                                                        float *buffer,
+                                                        int sample,
+                                                        int x, int y,
+                                                        int offset,
+                                                        int stride)
+{
+#ifdef KERNEL_STUB
+	STUB_ASSERT(KERNEL_ARCH, adaptive_adjust_samples);
+#else
+	kernel_adaptive_post_adjust(kg, buffer, sample, x, y, offset, stride);
+#endif /* KERNEL_STUB */
+}
+
 /* Film */
 
 void KERNEL_FUNCTION_FULL_NAME(convert_to_byte)(KernelGlobals *kg,
@@ -65,6 +65,9 @@ ccl_device void kernel_direct_lighting(KernelGlobals *kg,
 		bool flag = (kernel_data.integrator.use_direct_light &&
 		             (sd->flag & SD_BSDF_HAS_EVAL));
 
+		/* Set again when the branched path samples all lights. */
+		state->flag &= ~PATH_RAY_ALL_LIGHTS;
+
 #  ifdef __BRANCHED_PATH__
 		if(flag && kernel_data.integrator.branched) {
 			flag = false;
@@ -256,6 +256,9 @@ ccl_device_noinline void svm_eval_nodes(KernelGlobals *kg, ShaderData *sd, ccl_a
 			case NODE_VALUE_V:
 				svm_node_value_v(kg, sd, stack, node.y, &offset);
 				break;
+			case NODE_VALUES:
+				svm_node_values(kg, stack, node.y, node.z, &offset);
+				break;
 			case NODE_ATTR:
 				svm_node_attr(kg, sd, stack, node);
 				break;
@@ -32,5 +32,25 @@ ccl_device void svm_node_value_v(KernelGlobals *kg, ShaderData *sd, float *stack
 	stack_store_float3(stack, out_offset, p);
 }
 
+/* Constant inputs of a node loaded together, saves dispatching a value node
+ * for each of them. Floats are stored in pairs of value and offset, vectors
+ * with the offset in the last component. */
+ccl_device void svm_node_values(KernelGlobals *kg, float *stack, uint num_floats, uint num_vectors, int *offset)
+{
+	for(uint i = 0; i < num_floats; i += 2) {
+		uint4 node1 = read_node(kg, offset);
+		stack_store_float(stack, node1.y, __uint_as_float(node1.x));
+		if(i + 1 < num_floats) {
+			stack_store_float(stack, node1.w, __uint_as_float(node1.z));
+		}
+	}
+
+	for(uint i = 0; i < num_vectors; i++) {
+		uint4 node1 = read_node(kg, offset);
+		float3 p = make_float3(__uint_as_float(node1.x), __uint_as_float(node1.y), __uint_as_float(node1.z));
+		stack_store_float3(stack, node1.w, p);
+	}
+}
+
 CCL_NAMESPACE_END
 
@@ -44,6 +44,7 @@ BufferParams::BufferParams()
 
 	denoising_data_pass = false;
 	denoising_clean_pass = false;
+	adaptive_sampling = false;
 
 	Pass::add(PASS_COMBINED, passes);
 }
@@ -62,6 +63,7 @@ bool BufferParams::modified(const BufferParams& params)
 		&& height == params.height
 		&& full_width == params.full_width
 		&& full_height == params.full_height
+		&& adaptive_sampling == params.adaptive_sampling
 		&& Pass::equals(passes, params.passes));
 }
 
@@ -77,6 +79,10 @@ int BufferParams::get_passes_size()
 		if(denoising_clean_pass) size += DENOISING_PASS_SIZE_CLEAN;
 	}
 
+	if(adaptive_sampling) {
+		size += ADAPTIVE_PASS_SIZE;
+	}
+
 	return align_up(size, 4);
 }
 
@@ -103,6 +109,7 @@ RenderTile::RenderTile()
 	start_sample = 0;
 	num_samples = 0;
 	resolution = 0;
+	converged = false;
 
 	offset = 0;
 	stride = 0;
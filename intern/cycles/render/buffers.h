@@ -54,6 +54,8 @@ public:
 	bool denoising_data_pass;
 	/* If only some light path types should be denoised, an additional pass is needed. */
 	bool denoising_clean_pass;
+	/* Error estimate and sample count per pixel, to stop converged pixels early. */
+	bool adaptive_sampling;
 
 	/* functions */
 	BufferParams();
@@ -136,6 +138,8 @@ public:
 	int offset;
 	int stride;
 	int tile_index;
+	/* All pixels converged with adaptive sampling, no more samples needed. */
+	bool converged;
 
 	device_ptr buffer;
 
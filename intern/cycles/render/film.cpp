@@ -281,6 +281,8 @@ NODE_DEFINE(Film)
 	SOCKET_BOOLEAN(denoising_clean_pass, "Generate Denoising Clean Pass", false);
 	SOCKET_INT(denoising_flags, "Denoising Flags", 0);
 
+	SOCKET_BOOLEAN(adaptive_sampling_pass, "Generate Adaptive Sampling Pass", false);
+
 	return type;
 }
 
@@ -457,6 +459,14 @@ void Film::device_update(Device *device, DeviceScene *dscene, Scene *scene)
 		}
 	}
 
+	/* Must come after all other passes, which are scaled when pixels stop
+	 * early with adaptive sampling. */
+	kfilm->pass_adaptive_sampling = 0;
+	if(adaptive_sampling_pass) {
+		kfilm->pass_adaptive_sampling = kfilm->pass_stride;
+		kfilm->pass_stride += ADAPTIVE_PASS_SIZE;
+	}
+
 	kfilm->pass_stride = align_up(kfilm->pass_stride, 4);
 	kfilm->pass_alpha_threshold = pass_alpha_threshold;
 
@@ -23,6 +23,7 @@
 #include "util/util_path.h"
 #include "util/util_progress.h"
 #include "util/util_texture.h"
+#include "util/util_texture_cache.h"
 
 #ifdef WITH_OSL
 #include <OSL/oslexec.h>
@@ -712,6 +713,26 @@ void ImageManager::device_load_image(Device *device,
 		img->mem = NULL;
 	}
 
+	/* Read image on demand in tiles instead, when supported by the device. */
+	TextureCache *texture_cache = device->get_texture_cache();
+	if(texture_cache) {
+		texture_cache->remove_image(flat_slot);
+
+		if(scene->params.texture_cache_size > 0 &&
+		   texture_limit == 0 &&
+		   !img->builtin_data &&
+		   texture_cache->add_image(flat_slot,
+		                            img->filename,
+		                            img->use_alpha,
+		                            img->interpolation,
+		                            img->extension))
+		{
+			VLOG(1) << "Using texture cache for image " << img->filename << ".";
+			img->need_load = false;
+			return;
+		}
+	}
+
 	/* Create new texture. */
 	if(type == IMAGE_DATA_TYPE_FLOAT4) {
 		device_vector<float4> *tex_img
@@ -861,11 +882,16 @@ void ImageManager::device_load_image(Device *device,
 	img->need_load = false;
 }
 
-void ImageManager::device_free_image(Device *, ImageDataType type, int slot)
+void ImageManager::device_free_image(Device *device, ImageDataType type, int slot)
 {
 	Image *img = images[type][slot];
 
 	if(img) {
+		TextureCache *texture_cache = device->get_texture_cache();
+		if(texture_cache) {
+			texture_cache->remove_image(type_index_to_flattened_slot(slot, type));
+		}
+
 		if(osl_texture_system && !img->builtin_data) {
 #ifdef WITH_OSL
 			ustring filename(images[type][slot]->filename);
@@ -892,6 +918,12 @@ void ImageManager::device_update(Device *device,
 		return;
 	}
 
+	TextureCache *texture_cache = device->get_texture_cache();
+	if(texture_cache && scene->params.texture_cache_size > 0) {
+		texture_cache->set_options(scene->params.texture_cache_size,
+		                           scene->params.texture_auto_convert);
+	}
+
 	TaskPool pool;
 	for(int type = 0; type < IMAGE_DATA_NUM_TYPES; type++) {
 		for(size_t slot = 0; slot < images[type].size(); slot++) {
@@ -955,6 +987,14 @@ void ImageManager::device_free_builtin(Device *device)
 
 void ImageManager::device_free(Device *device)
 {
+	TextureCache *texture_cache = device->get_texture_cache();
+	if(texture_cache) {
+		const string stats = texture_cache->stats();
+		if(!stats.empty()) {
+			VLOG(1) << "Texture cache statistics:\n" << stats;
+		}
+	}
+
 	for(int type = 0; type < IMAGE_DATA_NUM_TYPES; type++) {
 		for(size_t slot = 0; slot < images[type].size(); slot++) {
 			device_free_image(device, (ImageDataType)type, slot);
@@ -68,6 +68,13 @@ public:
 	bool sample_all_lights_direct;
 	bool sample_all_lights_indirect;
 	float light_sampling_threshold;
+	bool use_light_tree;
+
+	/* With adaptive sampling pixels stop once their error estimate is below
+	 * the threshold, after at least the minimum number of samples, zero
+	 * meaning automatic. */
+	float adaptive_threshold;
+	int adaptive_min_samples;
 
 	enum Method {
 		BRANCHED_PATH = 0,
@@ -90,6 +97,8 @@ public:
 
 	bool modified(const Integrator& integrator);
 	void tag_update(Scene *scene);
+
+	int get_adaptive_min_samples() const;
 };
 
 CCL_NAMESPACE_END
@@ -19,6 +19,7 @@
 #include "render/integrator.h"
 #include "render/film.h"
 #include "render/light.h"
+#include "render/light_tree.h"
 #include "render/mesh.h"
 #include "render/object.h"
 #include "render/scene.h"
@@ -242,6 +243,61 @@ bool LightManager::object_usable_as_light(Object *object) {
 	return false;
 }
 
+/* Energy of the enabled lamps in the light tree. Lamp emission is normalized
+ * by the lamp area in the kernel, so the power is estimated from the shader
+ * strength alone. Local and distant lamps are scaled to the same total weight
+ * they have in the flat distribution, lamps of which the strength is unknown
+ * get the average strength of their group. */
+static void light_tree_lamp_energy(Scene *scene, float lightarea, vector<float>& energy)
+{
+	float known_strength[2] = {0.0f, 0.0f};
+	int num_known[2] = {0, 0};
+	int num_lamps[2] = {0, 0};
+	vector<int> groups;
+
+	foreach(Light *light, scene->lights) {
+		if(!light->is_enabled)
+			continue;
+
+		const int group = (light->type == LIGHT_DISTANT || light->type == LIGHT_BACKGROUND);
+		Shader *shader = (light->shader) ? light->shader : scene->default_light;
+		float3 emission;
+		float strength = -1.0f;
+
+		if(shader->is_constant_emission(&emission)) {
+			strength = max(average(emission), 0.0f);
+			known_strength[group] += strength;
+			num_known[group]++;
+		}
+
+		energy.push_back(strength);
+		groups.push_back(group);
+		num_lamps[group]++;
+	}
+
+	float total_strength[2];
+	for(int group = 0; group < 2; group++) {
+		const float unknown_strength = (num_known[group] > 0 && known_strength[group] > 0.0f)
+		                               ? known_strength[group] / num_known[group]
+		                               : 1.0f;
+		total_strength[group] = known_strength[group] +
+		                        unknown_strength * (num_lamps[group] - num_known[group]);
+
+		for(size_t i = 0; i < energy.size(); i++) {
+			if(groups[i] == group && energy[i] < 0.0f) {
+				energy[i] = unknown_strength;
+			}
+		}
+	}
+
+	for(size_t i = 0; i < energy.size(); i++) {
+		const int group = groups[i];
+		energy[i] = (total_strength[group] > 0.0f)
+		            ? lightarea * num_lamps[group] * energy[i] / total_strength[group]
+		            : lightarea;
+	}
+}
+
 void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Scene *scene, Progress& progress)
 {
 	progress.set_status("Updating Lights", "Computing distribution");
@@ -291,6 +347,20 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 	float4 *distribution = dscene->light_distribution.alloc(num_distribution + 1);
 	float totarea = 0.0f;
 
+	/* light tree */
+	const bool use_light_tree = scene->integrator->use_light_tree;
+	LightTree light_tree;
+
+	/* Distribution index of every triangle of light objects, to find the
+	 * emitter in the light tree when it is hit by a ray. Per object there is
+	 * the start of its triangles and the triangle offset of its mesh. */
+	vector<uint> object_emitters;
+	vector<uint> triangle_emitters;
+
+	if(use_light_tree) {
+		object_emitters.resize(scene->objects.size()*2, ~0u);
+	}
+
 	/* triangles */
 	size_t offset = 0;
 	int j = 0;
@@ -327,6 +397,14 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 		}
 
 		size_t mesh_num_triangles = mesh->num_triangles();
+		size_t triangle_emitters_start = triangle_emitters.size();
+
+		if(use_light_tree) {
+			object_emitters[j*2 + 0] = triangle_emitters_start;
+			object_emitters[j*2 + 1] = mesh->tri_offset;
+			triangle_emitters.resize(triangle_emitters_start + mesh_num_triangles, ~0u);
+		}
+
 		for(size_t i = 0; i < mesh_num_triangles; i++) {
 			int shader_index = mesh->shader[i];
 			Shader *shader = (shader_index < mesh->used_shaders.size())
@@ -334,6 +412,12 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 			                         : scene->default_surface;
 
 			if(shader->use_mis && shader->has_surface_emission) {
+				int distribution_index = offset;
+
+				if(use_light_tree) {
+					triangle_emitters[triangle_emitters_start + i] = distribution_index;
+				}
+
 				distribution[offset].x = totarea;
 				distribution[offset].y = __int_as_float(i + mesh->tri_offset);
 				distribution[offset].z = __int_as_float(shader_flag);
@@ -354,7 +438,13 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 					p3 = transform_point(&tfm, p3);
 				}
 
-				totarea += triangle_area(p1, p2, p3);
+				float area = triangle_area(p1, p2, p3);
+				totarea += area;
+
+				if(use_light_tree && area > 0.0f) {
+					float3 V[3] = {p1, p2, p3};
+					light_tree.add_triangle(distribution_index, V, area);
+				}
 			}
 		}
 
@@ -367,6 +457,11 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 	float lightarea = (totarea > 0.0f) ? totarea / num_lights : 1.0f;
 	bool use_lamp_mis = false;
 
+	vector<float> lamp_energy;
+	if(use_light_tree) {
+		light_tree_lamp_energy(scene, lightarea, lamp_energy);
+	}
+
 	int light_index = 0;
 	foreach(Light *light, scene->lights) {
 		if(!light->is_enabled)
@@ -378,6 +473,10 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 		distribution[offset].w = light->size;
 		totarea += lightarea;
 
+		if(use_light_tree) {
+			light_tree.add_lamp(offset, light, lamp_energy[light_index]);
+		}
+
 		if(light->size > 0.0f && light->use_mis)
 			use_lamp_mis = true;
 		if(light->type == LIGHT_BACKGROUND) {
@@ -446,6 +545,46 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 		/* CDF */
 		dscene->light_distribution.copy_to_device();
 
+		/* Light tree */
+		if(use_light_tree) {
+			array<float4> tree_nodes;
+			array<uint> leaf_nodes;
+			light_tree.build(num_distribution, tree_nodes, leaf_nodes);
+
+			VLOG(1) << "Light tree with " << light_tree.num_nodes() << " nodes for "
+			        << light_tree.num_emitters() << " emitters.";
+
+			/* Leaf node of every distribution index, followed by the object and
+			 * triangle tables with offsets relative to the start of the array. */
+			size_t triangles_start = num_distribution + object_emitters.size();
+			uint *emitters = dscene->light_tree_emitters.alloc(triangles_start + triangle_emitters.size());
+
+			memcpy(emitters, leaf_nodes.data(), num_distribution*sizeof(uint));
+			for(size_t i = 0; i < object_emitters.size(); i += 2) {
+				emitters[num_distribution + i + 0] = (object_emitters[i] != ~0u)
+				                                     ? object_emitters[i] + triangles_start
+				                                     : ~0u;
+				emitters[num_distribution + i + 1] = object_emitters[i + 1];
+			}
+			if(triangle_emitters.size()) {
+				memcpy(emitters + triangles_start,
+				       &triangle_emitters[0],
+				       triangle_emitters.size()*sizeof(uint));
+			}
+
+			dscene->light_tree_nodes.steal_data(tree_nodes);
+			dscene->light_tree_nodes.copy_to_device();
+			dscene->light_tree_emitters.copy_to_device();
+
+			kintegrator->use_light_tree = true;
+		}
+		else {
+			dscene->light_tree_nodes.free();
+			dscene->light_tree_emitters.free();
+
+			kintegrator->use_light_tree = false;
+		}
+
 		/* Portals */
 		if(num_portals > 0) {
 			kintegrator->portal_offset = light_index;
@@ -460,6 +599,8 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 	}
 	else {
 		dscene->light_distribution.free();
+		dscene->light_tree_nodes.free();
+		dscene->light_tree_emitters.free();
 
 		kintegrator->num_distribution = 0;
 		kintegrator->num_all_lights = 0;
@@ -469,6 +610,7 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 		kintegrator->num_portals = 0;
 		kintegrator->portal_offset = 0;
 		kintegrator->portal_pdf = 0.0f;
+		kintegrator->use_light_tree = false;
 
 		kfilm->pass_shadow_scale = 1.0f;
 	}
@@ -842,6 +984,8 @@ void LightManager::device_update(Device *device, DeviceScene *dscene, Scene *sce
 void LightManager::device_free(Device *, DeviceScene *dscene)
 {
 	dscene->light_distribution.free();
+	dscene->light_tree_nodes.free();
+	dscene->light_tree_emitters.free();
 	dscene->light_data.free();
 	dscene->light_background_marginal_cdf.free();
 	dscene->light_background_conditional_cdf.free();
@@ -0,0 +1,453 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/light_tree.h"
+#include "render/light.h"
+
+#include "kernel/kernel_types.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Number of bins along every axis to evaluate splits. */
+#define LIGHT_TREE_NUM_BINS 12
+
+LightTree::LightTree()
+{
+}
+
+void LightTree::add_triangle(int distribution_index, const float3 V[3], float energy)
+{
+	Emitter emitter;
+	emitter.bbox = BoundBox(BoundBox::empty);
+	emitter.bbox.grow(V[0]);
+	emitter.bbox.grow(V[1]);
+	emitter.bbox.grow(V[2]);
+	emitter.orientation = Orientation(safe_normalize(cross(V[1] - V[0], V[2] - V[0])),
+	                                  0.0f,
+	                                  M_PI_2_F);
+	emitter.energy = energy;
+	emitter.distribution_index = distribution_index;
+	emitter.group = GROUP_TRIANGLE;
+	emitters.push_back(emitter);
+}
+
+void LightTree::add_lamp(int distribution_index, const Light *light, float energy)
+{
+	Emitter emitter;
+	emitter.bbox = BoundBox(BoundBox::empty);
+	emitter.energy = energy;
+	emitter.distribution_index = distribution_index;
+	emitter.group = GROUP_LOCAL;
+
+	switch(light->type) {
+		case LIGHT_DISTANT:
+		case LIGHT_BACKGROUND:
+			emitter.orientation = Orientation(make_float3(0.0f, 0.0f, 1.0f), M_PI_F, M_PI_2_F);
+			emitter.group = GROUP_INFINITE;
+			break;
+		case LIGHT_AREA: {
+			float3 axisu = light->axisu*(light->sizeu*light->size);
+			float3 axisv = light->axisv*(light->sizev*light->size);
+			emitter.bbox.grow(light->co + 0.5f*(axisu + axisv));
+			emitter.bbox.grow(light->co + 0.5f*(axisu - axisv));
+			emitter.bbox.grow(light->co - 0.5f*(axisu + axisv));
+			emitter.bbox.grow(light->co - 0.5f*(axisu - axisv));
+			/* Emits on the front side only. */
+			emitter.orientation = Orientation(safe_normalize(light->dir), 0.0f, M_PI_2_F);
+			break;
+		}
+		case LIGHT_SPOT:
+			emitter.bbox.grow(light->co, light->size);
+			emitter.orientation = Orientation(safe_normalize(light->dir),
+			                                  0.0f,
+			                                  min(light->spot_angle*0.5f, M_PI_F));
+			break;
+		default:
+			emitter.bbox.grow(light->co, light->size);
+			emitter.orientation = Orientation(make_float3(0.0f, 0.0f, 1.0f), M_PI_F, M_PI_2_F);
+			break;
+	}
+
+	emitters.push_back(emitter);
+}
+
+/* Smallest cone containing both cones, for two sided cones the axis of b
+ * may be flipped. */
+LightTree::Orientation LightTree::merge(const Orientation& a_, const Orientation& b_, bool two_sided)
+{
+	Orientation a = a_, b = b_;
+	if(two_sided && dot(a.axis, b.axis) < 0.0f) {
+		b.axis = -b.axis;
+	}
+	if(a.theta_o < b.theta_o) {
+		swap(a, b);
+	}
+
+	const float theta_e = max(a.theta_e, b.theta_e);
+	const float theta_d = safe_acosf(dot(a.axis, b.axis));
+
+	if(min(theta_d + b.theta_o, M_PI_F) <= a.theta_o) {
+		return Orientation(a.axis, a.theta_o, theta_e);
+	}
+
+	const float theta_o = 0.5f*(a.theta_o + theta_d + b.theta_o);
+	if(theta_o >= M_PI_F) {
+		return Orientation(a.axis, M_PI_F, theta_e);
+	}
+
+	/* Rotate axis of a towards b. */
+	const float theta_r = theta_o - a.theta_o;
+	const float3 ortho = b.axis - a.axis*dot(a.axis, b.axis);
+	const float ortho_len = len(ortho);
+	if(ortho_len < 1e-6f) {
+		/* Opposite axes, there is no unique rotation. */
+		return Orientation(a.axis, M_PI_F, theta_e);
+	}
+
+	const float3 axis = a.axis*cosf(theta_r) + ortho*(sinf(theta_r)/ortho_len);
+	return Orientation(safe_normalize(axis), theta_o, theta_e);
+}
+
+/* Solid angle measure of the directions bounded by the orientation. */
+float LightTree::orientation_measure(const Orientation& o)
+{
+	const float theta_w = min(o.theta_o + o.theta_e, M_PI_F);
+	const float sin_theta_o = sinf(o.theta_o);
+	const float cos_theta_o = cosf(o.theta_o);
+
+	return M_2PI_F*(1.0f - cos_theta_o) +
+	       M_PI_2_F*(2.0f*theta_w*sin_theta_o -
+	                 cosf(o.theta_o - 2.0f*theta_w) -
+	                 2.0f*o.theta_o*sin_theta_o +
+	                 cos_theta_o);
+}
+
+int LightTree::add_node(int parent)
+{
+	nodes.push_back(Node());
+	nodes.back().parent = parent;
+	return nodes.size() - 1;
+}
+
+void LightTree::build_join(int node_index, int child0, int child1)
+{
+	const Node& a = nodes[child0];
+	const Node& b = nodes[child1];
+	Node& node = nodes[node_index];
+
+	node.bbox = BoundBox(BoundBox::empty);
+	if(a.bbox.valid()) {
+		node.bbox.grow(a.bbox);
+	}
+	if(b.bbox.valid()) {
+		node.bbox.grow(b.bbox);
+	}
+	node.orientation = merge(a.orientation, b.orientation, false);
+	node.energy = a.energy + b.energy;
+	node.children[0] = child0;
+	node.children[1] = child1;
+	node.flags = LIGHT_TREE_NODE_ENERGY_SPLIT;
+}
+
+/* Pick split of the references by the surface area orientation heuristic,
+ * returns the index of the first reference of the second child. */
+int LightTree::split(int start, int end, const BoundBox& centroid_bounds, int flags)
+{
+	const int mid = (start + end)/2;
+
+	/* Children of infinite lamps are picked by energy, bounds do not matter. */
+	if(flags & LIGHT_TREE_NODE_ENERGY_SPLIT) {
+		return mid;
+	}
+
+	struct Bin {
+		Bin() : bbox(BoundBox::empty), energy(0.0f), count(0) {}
+
+		BoundBox bbox;
+		Orientation orientation;
+		float energy;
+		int count;
+	};
+
+	const bool two_sided = (flags & LIGHT_TREE_NODE_TWO_SIDED) != 0;
+	const float3 centroid_extent = centroid_bounds.size();
+	const float max_extent = max3(centroid_extent);
+
+	float best_cost = FLT_MAX;
+	int best_axis = -1, best_bin = 0;
+
+	for(int axis = 0; axis < 3; axis++) {
+		if(centroid_extent[axis] <= 0.0f) {
+			continue;
+		}
+
+		const float bin_scale = LIGHT_TREE_NUM_BINS/centroid_extent[axis];
+		Bin bins[LIGHT_TREE_NUM_BINS];
+
+		for(int i = start; i < end; i++) {
+			const Emitter& emitter = emitters[references[i]];
+			const float centroid = emitter.bbox.center()[axis];
+			const int b = clamp((int)((centroid - centroid_bounds.min[axis])*bin_scale),
+			                    0,
+			                    LIGHT_TREE_NUM_BINS - 1);
+
+			Bin& bin = bins[b];
+			bin.orientation = (bin.count == 0)? emitter.orientation:
+			                  merge(bin.orientation, emitter.orientation, two_sided);
+			bin.bbox.grow(emitter.bbox);
+			bin.energy += emitter.energy;
+			bin.count++;
+		}
+
+		/* Sweep from the right to get the cost of all right sides. */
+		float right_cost[LIGHT_TREE_NUM_BINS];
+		int right_count[LIGHT_TREE_NUM_BINS];
+		Bin right;
+		for(int b = LIGHT_TREE_NUM_BINS - 1; b > 0; b--) {
+			const Bin& bin = bins[b];
+			if(bin.count > 0) {
+				right.orientation = (right.count == 0)? bin.orientation:
+				                    merge(right.orientation, bin.orientation, two_sided);
+				right.bbox.grow(bin.bbox);
+				right.energy += bin.energy;
+				right.count += bin.count;
+			}
+			right_cost[b] = (right.count > 0)?
+			        right.energy*orientation_measure(right.orientation)*right.bbox.area(): 0.0f;
+			right_count[b] = right.count;
+		}
+
+		/* Elongated boxes are better split along their longest axis. */
+		const float regularization = max_extent/centroid_extent[axis];
+
+		Bin left;
+		for(int b = 0; b < LIGHT_TREE_NUM_BINS - 1; b++) {
+			const Bin& bin = bins[b];
+			if(bin.count > 0) {
+				left.orientation = (left.count == 0)? bin.orientation:
+				                   merge(left.orientation, bin.orientation, two_sided);
+				left.bbox.grow(bin.bbox);
+				left.energy += bin.energy;
+				left.count += bin.count;
+			}
+
+			if(left.count == 0 || right_count[b + 1] == 0) {
+				continue;
+			}
+
+			const float left_cost =
+			        left.energy*orientation_measure(left.orientation)*left.bbox.area();
+			const float cost = regularization*(left_cost + right_cost[b + 1]);
+
+			if(cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = b + 1;
+			}
+		}
+	}
+
+	/* All centroids at the same location. */
+	if(best_axis == -1) {
+		return mid;
+	}
+
+	const float bin_scale = LIGHT_TREE_NUM_BINS/centroid_extent[best_axis];
+	int left = start, right = end - 1;
+
+	while(left <= right) {
+		const float centroid = emitters[references[left]].bbox.center()[best_axis];
+		const int b = clamp((int)((centroid - centroid_bounds.min[best_axis])*bin_scale),
+		                    0,
+		                    LIGHT_TREE_NUM_BINS - 1);
+		if(b < best_bin) {
+			left++;
+		}
+		else {
+			swap(references[left], references[right]);
+			right--;
+		}
+	}
+
+	return left;
+}
+
+void LightTree::build_group(int node_index, int start, int end, int flags)
+{
+	struct BuildTask {
+		int node_index;
+		int start, end;
+	};
+
+	/* Iterative, unbalanced splits could otherwise overflow the stack. */
+	vector<BuildTask> stack;
+	BuildTask root_task = {node_index, start, end};
+	stack.push_back(root_task);
+
+	const bool two_sided = (flags & LIGHT_TREE_NODE_TWO_SIDED) != 0;
+
+	while(!stack.empty()) {
+		const BuildTask task = stack.back();
+		stack.pop_back();
+
+		BoundBox bbox = BoundBox::empty;
+		BoundBox centroid_bounds = BoundBox::empty;
+		Orientation orientation;
+		float energy = 0.0f;
+
+		for(int i = task.start; i < task.end; i++) {
+			const Emitter& emitter = emitters[references[i]];
+			bbox.grow(emitter.bbox);
+			centroid_bounds.grow(emitter.bbox.center());
+			orientation = (i == task.start)? emitter.orientation:
+			              merge(orientation, emitter.orientation, two_sided);
+			energy += emitter.energy;
+		}
+
+		Node& node = nodes[task.node_index];
+		node.bbox = bbox;
+		node.orientation = orientation;
+		node.energy = energy;
+		node.flags = flags;
+
+		if(task.end - task.start == 1) {
+			node.distribution_index = emitters[references[task.start]].distribution_index;
+			continue;
+		}
+
+		const int mid = split(task.start, task.end, centroid_bounds, flags);
+
+		/* Adding nodes may reallocate, no references to nodes after this. */
+		const int child0 = add_node(task.node_index);
+		const int child1 = add_node(task.node_index);
+		nodes[task.node_index].children[0] = child0;
+		nodes[task.node_index].children[1] = child1;
+
+		BuildTask task0 = {child0, task.start, mid};
+		BuildTask task1 = {child1, mid, task.end};
+		stack.push_back(task1);
+		stack.push_back(task0);
+	}
+}
+
+void LightTree::build(size_t num_distribution,
+                      array<float4>& packed_nodes,
+                      array<uint>& leaf_nodes)
+{
+	nodes.clear();
+
+	/* Sort references by group. */
+	int group_start[NUM_GROUPS + 1] = {0};
+	for(size_t i = 0; i < emitters.size(); i++) {
+		group_start[emitters[i].group + 1]++;
+	}
+	for(int group = 0; group < NUM_GROUPS; group++) {
+		group_start[group + 1] += group_start[group];
+	}
+
+	references.resize(emitters.size());
+	int group_offset[NUM_GROUPS];
+	for(int group = 0; group < NUM_GROUPS; group++) {
+		group_offset[group] = group_start[group];
+	}
+	for(size_t i = 0; i < emitters.size(); i++) {
+		references[group_offset[emitters[i].group]++] = i;
+	}
+
+	const bool has_triangles = group_start[GROUP_TRIANGLE + 1] > group_start[GROUP_TRIANGLE];
+	const bool has_local = group_start[GROUP_LOCAL + 1] > group_start[GROUP_LOCAL];
+	const bool has_infinite = group_start[GROUP_INFINITE + 1] > group_start[GROUP_INFINITE];
+	const bool has_lamps = has_local || has_infinite;
+
+	/* Root is always the first node. */
+	const int root = add_node(-1);
+	int triangles_node = root, lamps_node = root;
+
+	if(has_triangles && has_lamps) {
+		triangles_node = add_node(root);
+		lamps_node = add_node(root);
+	}
+
+	if(has_triangles) {
+		build_group(triangles_node,
+		            group_start[GROUP_TRIANGLE],
+		            group_start[GROUP_TRIANGLE + 1],
+		            LIGHT_TREE_NODE_TWO_SIDED);
+	}
+
+	if(has_local && has_infinite) {
+		const int local_node = add_node(lamps_node);
+		const int infinite_node = add_node(lamps_node);
+		build_group(local_node,
+		            group_start[GROUP_LOCAL],
+		            group_start[GROUP_LOCAL + 1],
+		            0);
+		build_group(infinite_node,
+		            group_start[GROUP_INFINITE],
+		            group_start[GROUP_INFINITE + 1],
+		            LIGHT_TREE_NODE_ENERGY_SPLIT);
+		build_join(lamps_node, local_node, infinite_node);
+	}
+	else if(has_local) {
+		build_group(lamps_node,
+		            group_start[GROUP_LOCAL],
+		            group_start[GROUP_LOCAL + 1],
+		            0);
+	}
+	else if(has_infinite) {
+		build_group(lamps_node,
+		            group_start[GROUP_INFINITE],
+		            group_start[GROUP_INFINITE + 1],
+		            LIGHT_TREE_NODE_ENERGY_SPLIT);
+	}
+
+	if(has_triangles && has_lamps) {
+		build_join(root, triangles_node, lamps_node);
+	}
+
+	/* Pack nodes. */
+	packed_nodes.resize(nodes.size()*LIGHT_TREE_NODE_SIZE);
+	leaf_nodes.resize(num_distribution);
+	for(size_t i = 0; i < num_distribution; i++) {
+		leaf_nodes[i] = ~0u;
+	}
+
+	for(size_t i = 0; i < nodes.size(); i++) {
+		const Node& node = nodes[i];
+		const BoundBox bbox = node.bbox.valid()? node.bbox:
+		                      BoundBox(make_float3(0.0f, 0.0f, 0.0f));
+		const float3 axis = node.orientation.axis;
+		const bool is_leaf = (node.children[0] == -1);
+
+		float4 *packed = &packed_nodes[i*LIGHT_TREE_NODE_SIZE];
+		packed[0] = make_float4(bbox.min.x, bbox.min.y, bbox.min.z, node.energy);
+		packed[1] = make_float4(bbox.max.x, bbox.max.y, bbox.max.z, node.orientation.theta_o);
+		packed[2] = make_float4(axis.x, axis.y, axis.z, node.orientation.theta_e);
+		packed[3] = make_float4(__int_as_float(is_leaf? -1: node.children[0]),
+		                        __int_as_float(is_leaf? node.distribution_index: node.children[1]),
+		                        __int_as_float(node.parent),
+		                        __int_as_float(node.flags));
+
+		if(is_leaf && node.distribution_index >= 0) {
+			leaf_nodes[node.distribution_index] = i;
+		}
+	}
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LIGHT_TREE_H__
+#define __LIGHT_TREE_H__
+
+#include "util/util_boundbox.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class Light;
+
+/* Light Tree
+ *
+ * Bounding volume hierarchy over the emitters of the light distribution,
+ * storing the spatial bounds, the bounds of the emission directions and the
+ * energy of every subtree. The kernel descends it picking children by their
+ * estimated contribution to the shading point, as described in "Importance
+ * Sampling of Many Lights with Adaptive Tree Splitting" by Conty Estevez and
+ * Kulla, 2018.
+ *
+ * Triangles, local lamps and distant/background lamps are kept in separate
+ * subtrees which are joined by energy only, so the probability of picking
+ * each group stays the same as with the flat distribution. Triangles emit
+ * from both sides, their direction bounds are cones around the axis and its
+ * opposite. */
+
+class LightTree {
+public:
+	LightTree();
+
+	/* Emitters are identified by their index in the light distribution,
+	 * energy is the estimated power of the emitter. The kernel computes pdfs
+	 * from the tree, so it does not have to match the distribution weight. */
+	void add_triangle(int distribution_index, const float3 V[3], float energy);
+	void add_lamp(int distribution_index, const Light *light, float energy);
+
+	/* Build and pack the tree, leaf_nodes has the leaf node of every
+	 * distribution index, or ~0 for emitters which were never added. */
+	void build(size_t num_distribution,
+	           array<float4>& packed_nodes,
+	           array<uint>& leaf_nodes);
+
+	size_t num_emitters() const { return emitters.size(); }
+	size_t num_nodes() const { return nodes.size(); }
+
+protected:
+	/* Bounds of emission directions: cone around the axis with spread
+	 * theta_o of normals, and theta_e of emission around those normals. */
+	struct Orientation {
+		Orientation() : axis(make_float3(0.0f, 0.0f, 1.0f)), theta_o(0.0f), theta_e(0.0f) {}
+		Orientation(const float3& axis, float theta_o, float theta_e)
+		: axis(axis), theta_o(theta_o), theta_e(theta_e) {}
+
+		float3 axis;
+		float theta_o;
+		float theta_e;
+	};
+
+	enum Group {
+		GROUP_TRIANGLE = 0,
+		GROUP_LOCAL,
+		GROUP_INFINITE,
+
+		NUM_GROUPS
+	};
+
+	struct Emitter {
+		BoundBox bbox;
+		Orientation orientation;
+		float energy;
+		int distribution_index;
+		int group;
+	};
+
+	struct Node {
+		Node() : bbox(BoundBox::empty), energy(0.0f), parent(-1), distribution_index(-1), flags(0)
+		{
+			children[0] = children[1] = -1;
+		}
+
+		BoundBox bbox;
+		Orientation orientation;
+		float energy;
+		int children[2];
+		int parent;
+		int distribution_index;
+		int flags;
+	};
+
+	static Orientation merge(const Orientation& a, const Orientation& b, bool two_sided);
+	static float orientation_measure(const Orientation& o);
+
+	int add_node(int parent);
+	void build_join(int node_index, int child0, int child1);
+	void build_group(int node_index, int start, int end, int flags);
+	int split(int start, int end, const BoundBox& centroid_bounds, int flags);
+
+	vector<Emitter> emitters;
+	vector<int> references;
+	vector<Node> nodes;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __LIGHT_TREE_H__ */
@@ -16,6 +16,7 @@
 
 #include "bvh/bvh.h"
 #include "bvh/bvh_build.h"
+#include "bvh/bvh_cache.h"
 
 #include "render/camera.h"
 #include "render/curves.h"
@@ -35,6 +36,8 @@
 
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
+#include "util/util_map.h"
+#include "util/util_md5.h"
 #include "util/util_progress.h"
 #include "util/util_set.h"
 
@@ -1048,17 +1051,33 @@ void Mesh::compute_bvh(Device *device,
 		vector<Object*> objects;
 		objects.push_back(&object);
 
-		if(bvh && !need_update_rebuild) {
+		bool need_build = true;
+
+		/* Build nodes are only kept for meshes which deformed before, static
+		 * meshes don't pay their memory cost. On the first deformation the
+		 * BVH is built again, keeping them for the following refits.
+		 */
+		const bool is_deforming = (bvh && !need_update_rebuild);
+		const bool keep_build_nodes = params->use_bvh_refit && is_deforming;
+
+		if(is_deforming && (!keep_build_nodes || bvh->has_build_nodes())) {
 			progress->set_status(msg, "Refitting BVH");
 			bvh->objects = objects;
-			bvh->refit(*progress);
+			need_build = !bvh->refit(*progress);
 		}
-		else {
+
+		if(need_build) {
 			progress->set_status(msg, "Building BVH");
 
 			BVHParams bparams;
 			bparams.use_spatial_split = params->use_bvh_spatial_split;
+			bparams.use_parallel_build = params->use_bvh_parallel_build;
+			bparams.keep_build_nodes = keep_build_nodes;
+			/* Cached BVH has no build nodes, and deforming meshes get a new
+			 * cache key on every update anyway. */
+			bparams.use_cache = params->use_bvh_cache && !keep_build_nodes;
 			bparams.use_qbvh = params->use_qbvh && device->info.has_qbvh;
+			bparams.use_obvh = bparams.use_qbvh && device->info.has_obvh;
 			bparams.use_unaligned_nodes = dscene->data.bvh.have_curves &&
 			                              params->use_bvh_unaligned_nodes;
 			bparams.num_motion_triangle_steps = params->num_bvh_time_steps;
@@ -1131,10 +1150,12 @@ MeshManager::MeshManager()
 {
 	need_update = true;
 	need_flags_update = true;
+	bvh = NULL;
 }
 
 MeshManager::~MeshManager()
 {
+	delete bvh;
 }
 
 void MeshManager::update_osl_attributes(Device *device, Scene *scene, vector<AttributeRequestSet>& mesh_attributes)
@@ -1810,28 +1831,91 @@ void MeshManager::device_update_mesh(Device *,
 	}
 }
 
-void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
+/* Hash of everything primitive references of the top level BVH depend on,
+ * the BVH can only be refitted when it did not change since the build.
+ *
+ * References store object and primitive indices, so objects are identified
+ * by their index and meshes by their index and primitive ranges. Pointers are
+ * not stable: sync may re-create identical objects, and addresses of deleted
+ * ones may be reused. Transforms only affect bounds, which are refitted.
+ */
+static string bvh_topology_hash(Scene *scene)
 {
-	/* bvh build */
-	progress.set_status("Updating Scene BVH", "Building");
+	map<const Mesh*, int> mesh_index;
+	for(size_t i = 0; i < scene->meshes.size(); i++) {
+		mesh_index[scene->meshes[i]] = (int)i;
+	}
 
-	BVHParams bparams;
-	bparams.top_level = true;
-	bparams.use_qbvh = scene->params.use_qbvh && device->info.has_qbvh;
-	bparams.use_spatial_split = scene->params.use_bvh_spatial_split;
-	bparams.use_unaligned_nodes = dscene->data.bvh.have_curves &&
-	                              scene->params.use_bvh_unaligned_nodes;
-	bparams.num_motion_triangle_steps = scene->params.num_bvh_time_steps;
-	bparams.num_motion_curve_steps = scene->params.num_bvh_time_steps;
+	MD5Hash md5;
+	const int num_objects = (int)scene->objects.size();
+	md5.append((const uint8_t*)&num_objects, sizeof(num_objects));
+	foreach(Object *object, scene->objects) {
+		const Mesh *mesh = object->mesh;
+		const int data[] = {mesh_index[mesh],
+		                    object->is_traceable(),
+		                    mesh->is_instanced(),
+		                    mesh->has_motion_blur(),
+		                    (int)mesh->num_triangles(),
+		                    (int)mesh->num_curves(),
+		                    (int)mesh->curve_keys.size(),
+		                    (int)mesh->tri_offset,
+		                    (int)mesh->curve_offset};
+		md5.append((const uint8_t*)data, sizeof(data));
+	}
+	return md5.get_hex();
+}
 
-	VLOG(1) << (bparams.use_qbvh ? "Using QBVH optimization structure"
-	                             : "Using regular BVH optimization structure");
+void MeshManager::device_update_bvh(Device *device,
+                                    DeviceScene *dscene,
+                                    Scene *scene,
+                                    bool topology_changed,
+                                    Progress& progress)
+{
+	const string topology_hash = bvh_topology_hash(scene);
+	bool need_build = true;
 
-	BVH *bvh = BVH::create(bparams, scene->objects);
-	bvh->build(progress);
+	/* bvh refit */
+	if(bvh != NULL &&
+	   scene->params.use_bvh_refit &&
+	   !topology_changed &&
+	   topology_hash == bvh_topology)
+	{
+		progress.set_status("Updating Scene BVH", "Refitting");
+
+		bvh->objects = scene->objects;
+		need_build = !bvh->refit(progress);
+	}
+
+	/* bvh build */
+	if(need_build) {
+		progress.set_status("Updating Scene BVH", "Building");
+
+		BVHParams bparams;
+		bparams.top_level = true;
+		bparams.use_qbvh = scene->params.use_qbvh && device->info.has_qbvh;
+		bparams.use_obvh = bparams.use_qbvh && device->info.has_obvh;
+		bparams.use_spatial_split = scene->params.use_bvh_spatial_split;
+		bparams.use_parallel_build = scene->params.use_bvh_parallel_build;
+		bparams.use_unaligned_nodes = dscene->data.bvh.have_curves &&
+		                              scene->params.use_bvh_unaligned_nodes;
+		bparams.num_motion_triangle_steps = scene->params.num_bvh_time_steps;
+		bparams.num_motion_curve_steps = scene->params.num_bvh_time_steps;
+		bparams.keep_build_nodes = scene->params.use_bvh_refit;
+		bparams.use_cache = scene->params.use_bvh_cache;
+
+		VLOG(1) << (bparams.use_obvh ? "Using OBVH optimization structure"
+		            : bparams.use_qbvh ? "Using QBVH optimization structure"
+		                               : "Using regular BVH optimization structure");
+
+		delete bvh;
+		bvh = BVH::create(bparams, scene->objects);
+		bvh->build(progress);
+		bvh_topology = topology_hash;
+	}
 
 	if(progress.get_cancel()) {
 		delete bvh;
+		bvh = NULL;
 		return;
 	}
 
@@ -1882,10 +1966,17 @@ void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *
 	}
 
 	dscene->data.bvh.root = pack.root_index;
-	dscene->data.bvh.use_qbvh = bparams.use_qbvh;
+	dscene->data.bvh.use_qbvh = bvh->params.use_qbvh;
+	dscene->data.bvh.use_obvh = bvh->params.use_obvh;
 	dscene->data.bvh.use_bvh_steps = (scene->params.num_bvh_time_steps != 0);
 
-	delete bvh;
+	/* Packed data is now owned by the device, the BVH is only kept when it
+	 * can be refitted from its build nodes on the next update.
+	 */
+	if(!scene->params.use_bvh_refit) {
+		delete bvh;
+		bvh = NULL;
+	}
 }
 
 void MeshManager::device_update_flags(Device * /*device*/,
@@ -2067,6 +2158,23 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 		if(progress.get_cancel()) return;
 	}
 
+	/* Top level BVH can only be refitted when only positions of primitives
+	 * changed, check this before mesh BVH updates reset the flags.
+	 */
+	bool bvh_topology_changed = false;
+	foreach(Mesh *mesh, scene->meshes) {
+		if(mesh->need_update && mesh->need_update_rebuild) {
+			bvh_topology_changed = true;
+			break;
+		}
+	}
+
+	/* Cache misses are written to the BVH cache, which is trimmed once all
+	 * of them are written.
+	 */
+	int bvh_cache_hits, bvh_cache_misses, prev_bvh_cache_misses;
+	progress.get_bvh_cache_stats(bvh_cache_hits, prev_bvh_cache_misses);
+
 	/* Update bvh. */
 	size_t num_bvh = 0;
 	foreach(Mesh *mesh, scene->meshes) {
@@ -2118,7 +2226,13 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 
 	if(progress.get_cancel()) return;
 
-	device_update_bvh(device, dscene, scene, progress);
+	device_update_bvh(device, dscene, scene, bvh_topology_changed, progress);
+
+	progress.get_bvh_cache_stats(bvh_cache_hits, bvh_cache_misses);
+	if(bvh_cache_misses != prev_bvh_cache_misses) {
+		BVHCache::trim();
+	}
+
 	if(progress.get_cancel()) return;
 
 	device_update_mesh(device, dscene, scene, false, progress);
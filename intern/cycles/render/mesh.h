@@ -365,11 +365,18 @@ protected:
 	void device_update_bvh(Device *device,
 	                       DeviceScene *dscene,
 	                       Scene *scene,
+	                       bool topology_changed,
 	                       Progress& progress);
 
 	void device_update_displacement_images(Device *device,
 	                                       Scene *scene,
 	                                       Progress& progress);
+
+	/* Top level BVH, kept between updates when it can be refitted, and hash
+	 * of the objects topology it was built for.
+	 */
+	BVH *bvh;
+	string bvh_topology;
 };
 
 CCL_NAMESPACE_END
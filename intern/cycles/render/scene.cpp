@@ -66,6 +66,8 @@ DeviceScene::DeviceScene(Device *device)
   attributes_float3(device, "__attributes_float3", MEM_TEXTURE),
   attributes_uchar4(device, "__attributes_uchar4", MEM_TEXTURE),
   light_distribution(device, "__light_distribution", MEM_TEXTURE),
+  light_tree_nodes(device, "__light_tree_nodes", MEM_TEXTURE),
+  light_tree_emitters(device, "__light_tree_emitters", MEM_TEXTURE),
   light_data(device, "__light_data", MEM_TEXTURE),
   light_background_marginal_cdf(device, "__light_background_marginal_cdf", MEM_TEXTURE),
   light_background_conditional_cdf(device, "__light_background_conditional_cdf", MEM_TEXTURE),
@@ -286,6 +288,14 @@ void Scene::device_update(Device *device_, Progress& progress)
 		        << " (" << string_human_readable_size(mem_used) << ")\n"
 		        << "  Peak: " << string_human_readable_number(mem_peak)
 		        << " (" << string_human_readable_size(mem_peak) << ")";
+
+		if(params.use_bvh_cache) {
+			int bvh_cache_hits, bvh_cache_misses;
+			progress.get_bvh_cache_stats(bvh_cache_hits, bvh_cache_misses);
+			VLOG(1) << "BVH cache statistics:\n"
+			        << "  Hits: " << bvh_cache_hits << "\n"
+			        << "  Misses: " << bvh_cache_misses;
+		}
 	}
 }
 
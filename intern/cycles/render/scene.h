@@ -95,6 +95,8 @@ public:
 
 	/* lights */
 	device_vector<float4> light_distribution;
+	device_vector<float4> light_tree_nodes;
+	device_vector<uint> light_tree_emitters;
 	device_vector<float4> light_data;
 	device_vector<float2> light_background_marginal_cdf;
 	device_vector<float2> light_background_conditional_cdf;
@@ -131,10 +133,15 @@ public:
 	} bvh_type;
 	bool use_bvh_spatial_split;
 	bool use_bvh_unaligned_nodes;
+	bool use_bvh_parallel_build;
+	bool use_bvh_refit;
+	bool use_bvh_cache;
 	int num_bvh_time_steps;
 	bool use_qbvh;
 	bool persistent_data;
 	int texture_limit;
+	int texture_cache_size;
+	bool texture_auto_convert;
 
 	SceneParams()
 	{
@@ -142,10 +149,15 @@ public:
 		bvh_type = BVH_DYNAMIC;
 		use_bvh_spatial_split = false;
 		use_bvh_unaligned_nodes = true;
+		use_bvh_parallel_build = false;
+		use_bvh_refit = false;
+		use_bvh_cache = false;
 		num_bvh_time_steps = 0;
 		use_qbvh = true;
 		persistent_data = false;
 		texture_limit = 0;
+		texture_cache_size = 0;
+		texture_auto_convert = false;
 	}
 
 	bool modified(const SceneParams& params)
@@ -153,10 +165,15 @@ public:
 		&& bvh_type == params.bvh_type
 		&& use_bvh_spatial_split == params.use_bvh_spatial_split
 		&& use_bvh_unaligned_nodes == params.use_bvh_unaligned_nodes
+		&& use_bvh_parallel_build == params.use_bvh_parallel_build
+		&& use_bvh_refit == params.use_bvh_refit
+		&& use_bvh_cache == params.use_bvh_cache
 		&& num_bvh_time_steps == params.num_bvh_time_steps
 		&& use_qbvh == params.use_qbvh
 		&& persistent_data == params.persistent_data
-		&& texture_limit == params.texture_limit); }
+		&& texture_limit == params.texture_limit
+		&& texture_cache_size == params.texture_cache_size
+		&& texture_auto_convert == params.texture_auto_convert); }
 };
 
 /* Scene */
@@ -28,6 +28,7 @@
 #include "render/session.h"
 #include "render/bake.h"
 
+#include "util/util_debug.h"
 #include "util/util_foreach.h"
 #include "util/util_function.h"
 #include "util/util_logging.h"
@@ -51,7 +52,7 @@ Session::Session(const SessionParams& params_)
 {
 	device_use_gl = ((params.device.type != DEVICE_CPU) && !params.background);
 
-	TaskScheduler::init(params.threads);
+	TaskScheduler::init(params.threads, DebugFlags().cpu.numa);
 
 	device = Device::create(params.device, stats, params.background);
 
@@ -360,7 +361,15 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 	Tile *tile;
 	int device_num = device->device_number(tile_device);
 
-	if(!tile_manager.next_tile(tile, device_num))
+	bool have_tile = tile_manager.next_tile(tile, device_num);
+
+	/* Converged tiles skipped with adaptive sampling count as rendered. */
+	if(tile_manager.state.skipped_pixel_samples) {
+		progress.add_samples(tile_manager.state.skipped_pixel_samples, tile_manager.state.sample);
+		tile_manager.state.skipped_pixel_samples = 0;
+	}
+
+	if(!have_tile)
 		return false;
 	
 	/* fill render tile */
@@ -373,6 +382,7 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 	rtile.resolution = tile_manager.state.resolution_divider;
 	rtile.tile_index = tile->index;
 	rtile.task = (tile->state == Tile::DENOISE)? RenderTile::DENOISE: RenderTile::PATH_TRACE;
+	rtile.converged = false;
 
 	tile_lock.unlock();
 
@@ -438,6 +448,12 @@ void Session::release_tile(RenderTile& rtile)
 
 	progress.add_finished_tile(rtile.task == RenderTile::DENOISE);
 
+	if(rtile.converged) {
+		Tile& tile = tile_manager.state.tiles[rtile.tile_index];
+		tile.converged = true;
+		tile.converged_sample = rtile.sample;
+	}
+
 	bool delete_tile;
 
 	if(tile_manager.finish_tile(rtile.tile_index, delete_tile)) {
@@ -949,6 +965,11 @@ void Session::render()
 	task.requested_tile_size = params.tile_size;
 	task.passes_size = tile_manager.params.get_passes_size();
 
+	if(tile_manager.params.adaptive_sampling) {
+		task.adaptive_sampling.use = true;
+		task.adaptive_sampling.min_samples = scene->integrator->get_adaptive_min_samples();
+	}
+
 	if(params.use_denoising) {
 		task.denoising_radius = params.denoising_radius;
 		task.denoising_strength = params.denoising_strength;
@@ -1014,7 +1035,7 @@ bool Session::update_progressive_refine(bool cancel)
 			rtile.y = tile_manager.state.buffer.full_y + tile.y;
 			rtile.w = tile.w;
 			rtile.h = tile.h;
-			rtile.sample = sample;
+			rtile.sample = (tile.converged)? tile.converged_sample: sample;
 			rtile.buffers = tile.buffers;
 
 			if(write) {
@@ -166,6 +166,7 @@ SVMCompiler::SVMCompiler(ShaderManager *shader_manager_, ImageManager *image_man
 	background = false;
 	mix_weight_offset = SVM_STACK_INVALID;
 	compile_failed = false;
+	num_fused_values = 0;
 }
 
 int SVMCompiler::stack_size(SocketType::Type type)
@@ -246,23 +247,27 @@ int SVMCompiler::stack_assign(ShaderInput *input)
 		else {
 			Node *node = input->parent;
 
-			/* not linked to output -> add nodes to load default value */
+			/* not linked to output -> load default value before the next node */
 			input->stack_offset = stack_find_offset(input->type());
 
 			if(input->type() == SocketType::FLOAT) {
-				add_node(NODE_VALUE_F, __float_as_int(node->get_float(input->socket_type)), input->stack_offset);
+				pending_float_values.push_back(make_int2(__float_as_int(node->get_float(input->socket_type)),
+				                                         input->stack_offset));
 			}
 			else if(input->type() == SocketType::INT) {
-				add_node(NODE_VALUE_F, node->get_int(input->socket_type), input->stack_offset);
+				pending_float_values.push_back(make_int2(node->get_int(input->socket_type),
+				                                         input->stack_offset));
 			}
 			else if(input->type() == SocketType::VECTOR ||
 			        input->type() == SocketType::NORMAL ||
 			        input->type() == SocketType::POINT ||
 			        input->type() == SocketType::COLOR)
 			{
-
-				add_node(NODE_VALUE_V, input->stack_offset);
-				add_node(NODE_VALUE_V, node->get_float3(input->socket_type));
+				float3 f = node->get_float3(input->socket_type);
+				pending_vector_values.push_back(make_int4(__float_as_int(f.x),
+				                                          __float_as_int(f.y),
+				                                          __float_as_int(f.z),
+				                                          input->stack_offset));
 			}
 			else /* should not get called for closure */
 				assert(0);
@@ -363,18 +368,57 @@ uint SVMCompiler::encode_uchar4(uint x, uint y, uint z, uint w)
 	return (x) | (y << 8) | (z << 16) | (w << 24);
 }
 
+void SVMCompiler::add_pending_values()
+{
+	const int num_floats = pending_float_values.size();
+	const int num_vectors = pending_vector_values.size();
+
+	if(num_floats + num_vectors == 1) {
+		/* Single value, no need for the extra node. */
+		if(num_floats == 1) {
+			const int2 v = pending_float_values[0];
+			current_svm_nodes.push_back_slow(make_int4(NODE_VALUE_F, v.x, v.y, 0));
+		}
+		else {
+			const int4 v = pending_vector_values[0];
+			current_svm_nodes.push_back_slow(make_int4(NODE_VALUE_V, v.w, 0, 0));
+			current_svm_nodes.push_back_slow(make_int4(NODE_VALUE_V, v.x, v.y, v.z));
+		}
+	}
+	else if(num_floats + num_vectors > 1) {
+		current_svm_nodes.push_back_slow(make_int4(NODE_VALUES, num_floats, num_vectors, 0));
+
+		for(int i = 0; i < num_floats; i += 2) {
+			const int2 a = pending_float_values[i];
+			const int2 b = (i + 1 < num_floats)? pending_float_values[i + 1]: make_int2(0, 0);
+			current_svm_nodes.push_back_slow(make_int4(a.x, a.y, b.x, b.y));
+		}
+		for(int i = 0; i < num_vectors; i++) {
+			current_svm_nodes.push_back_slow(pending_vector_values[i]);
+		}
+
+		num_fused_values += num_floats + num_vectors;
+	}
+
+	pending_float_values.clear();
+	pending_vector_values.clear();
+}
+
 void SVMCompiler::add_node(int a, int b, int c, int d)
 {
+	add_pending_values();
 	current_svm_nodes.push_back_slow(make_int4(a, b, c, d));
 }
 
 void SVMCompiler::add_node(ShaderNodeType type, int a, int b, int c)
 {
+	add_pending_values();
 	current_svm_nodes.push_back_slow(make_int4(type, a, b, c));
 }
 
 void SVMCompiler::add_node(ShaderNodeType type, const float3& f)
 {
+	add_pending_values();
 	current_svm_nodes.push_back_slow(make_int4(type,
 		__float_as_int(f.x),
 		__float_as_int(f.y),
@@ -383,6 +427,7 @@ void SVMCompiler::add_node(ShaderNodeType type, const float3& f)
 
 void SVMCompiler::add_node(const float4& f)
 {
+	add_pending_values();
 	current_svm_nodes.push_back_slow(make_int4(
 		__float_as_int(f.x),
 		__float_as_int(f.y),
@@ -432,6 +477,8 @@ void SVMCompiler::find_dependencies(ShaderNodeSet& dependencies,
 void SVMCompiler::generate_node(ShaderNode *node, ShaderNodeSet& done)
 {
 	node->compile(*this);
+	/* Values must be written before their stack space is reused. */
+	add_pending_values();
 	stack_clear_users(node, done);
 	stack_clear_temporary(node);
 
@@ -626,10 +673,7 @@ void SVMCompiler::generate_multi_closure(ShaderNode *root_node,
 				/* Add instruction to skip closure and its dependencies if mix
 				 * weight is zero.
 				 */
-				current_svm_nodes.push_back_slow(make_int4(NODE_JUMP_IF_ONE,
-				                                      0,
-				                                      stack_assign(facin),
-				                                      0));
+				add_node(NODE_JUMP_IF_ONE, 0, stack_assign(facin), 0);
 				int node_jump_skip_index = current_svm_nodes.size() - 1;
 
 				generate_multi_closure(root_node, cl1in->link->parent, state);
@@ -644,10 +688,7 @@ void SVMCompiler::generate_multi_closure(ShaderNode *root_node,
 				/* Add instruction to skip closure and its dependencies if mix
 				 * weight is zero.
 				 */
-				current_svm_nodes.push_back_slow(make_int4(NODE_JUMP_IF_ZERO,
-				                                      0,
-				                                      stack_assign(facin),
-				                                      0));
+				add_node(NODE_JUMP_IF_ZERO, 0, stack_assign(facin), 0);
 				int node_jump_skip_index = current_svm_nodes.size() - 1;
 
 				generate_multi_closure(root_node, cl2in->link->parent, state);
@@ -725,6 +766,8 @@ void SVMCompiler::compile_type(Shader *shader, ShaderGraph *graph, ShaderType ty
 	/* clear all compiler state */
 	memset(&active_stack, 0, sizeof(active_stack));
 	current_svm_nodes.clear();
+	pending_float_values.clear();
+	pending_vector_values.clear();
 
 	foreach(ShaderNode *node_iter, graph->nodes) {
 		foreach(ShaderInput *input, node_iter->inputs)
@@ -775,6 +818,7 @@ void SVMCompiler::compile_type(Shader *shader, ShaderGraph *graph, ShaderType ty
 
 		/* compile output node */
 		node->compile(*this);
+		add_pending_values();
 	}
 
 	/* add node to restore state after bump shader has finished */
@@ -872,6 +916,7 @@ void SVMCompiler::compile(Scene *scene,
 	if(summary != NULL) {
 		summary->time_total = time_dt() - time_start;
 		summary->peak_stack_usage = max_stack_use;
+		summary->num_fused_values = num_fused_values;
 		summary->num_svm_nodes = svm_nodes.size() - start_num_svm_nodes;
 	}
 }
@@ -881,6 +926,7 @@ void SVMCompiler::compile(Scene *scene,
 SVMCompiler::Summary::Summary()
 	: num_svm_nodes(0),
 	  peak_stack_usage(0),
+	  num_fused_values(0),
 	  time_finalize(0.0),
 	  time_generate_surface(0.0),
 	  time_generate_bump(0.0),
@@ -895,6 +941,7 @@ string SVMCompiler::Summary::full_report() const
 	string report = "";
 	report += string_printf("Number of SVM nodes: %d\n", num_svm_nodes);
 	report += string_printf("Peak stack usage:    %d\n", peak_stack_usage);
+	report += string_printf("Fused values:        %d\n", num_fused_values);
 
 	report += string_printf("Time (in seconds):\n");
 	report += string_printf("Finalize:            %f\n", time_finalize);
@@ -71,6 +71,9 @@ public:
 		/* Peak stack usage during shader evaluation. */
 		int peak_stack_usage;
 
+		/* Number of constant inputs loaded together with others. */
+		int num_fused_values;
+
 		/* Time spent on surface graph finalization. */
 		double time_finalize;
 
@@ -181,6 +184,7 @@ protected:
 
 	void stack_clear_temporary(ShaderNode *node);
 	int stack_size(SocketType::Type type);
+	void add_pending_values();
 	void stack_clear_users(ShaderNode *node, ShaderNodeSet& done);
 
 	bool node_skip_input(ShaderNode *node, ShaderInput *input);
@@ -208,6 +212,14 @@ protected:
 	void compile_type(Shader *shader, ShaderGraph *graph, ShaderType type);
 
 	array<int4> current_svm_nodes;
+
+	/* Constant input values which are not loaded onto the stack yet, emitted
+	 * together before the next node. Floats store value and offset, vectors
+	 * the value and offset in the last component. */
+	vector<int2> pending_float_values;
+	vector<int4> pending_vector_values;
+	int num_fused_values;
+
 	ShaderType current_type;
 	Shader *current_shader;
 	ShaderGraph *current_graph;
@@ -150,6 +150,7 @@ void TileManager::reset(BufferParams& params_, int num_samples_)
 	state.sample = range_start_sample - 1;
 	state.num_tiles = 0;
 	state.num_samples = 0;
+	state.skipped_pixel_samples = 0;
 	state.resolution_divider = get_divider(params.width, params.height, start_resolution);
 	state.render_tiles.clear();
 	state.denoising_tiles.clear();
@@ -476,13 +477,22 @@ bool TileManager::next_tile(Tile* &tile, int device)
 		return true;
 	}
 
-	if(state.render_tiles[logical_device].empty())
-		return false;
+	while(!state.render_tiles[logical_device].empty()) {
+		int idx = state.render_tiles[logical_device].front();
+		state.render_tiles[logical_device].pop_front();
 
-	int idx = state.render_tiles[logical_device].front();
-	state.render_tiles[logical_device].pop_front();
-	tile = &state.tiles[idx];
-	return true;
+		/* With adaptive sampling, tiles which converged in an earlier sample
+		 * don't need to be rendered again. */
+		if(state.tiles[idx].converged) {
+			state.skipped_pixel_samples += (uint64_t)state.tiles[idx].w*state.tiles[idx].h*state.num_samples;
+			continue;
+		}
+
+		tile = &state.tiles[idx];
+		return true;
+	}
+
+	return false;
 }
 
 bool TileManager::done()
@@ -40,11 +40,17 @@ public:
 	State state;
 	RenderBuffers *buffers;
 
+	/* Adaptive sampling: all pixels converged, and the buffers were scaled to
+	 * the given sample, so the tile is skipped for the remaining samples. */
+	bool converged;
+	int converged_sample;
+
 	Tile()
 	{}
 
 	Tile(int index_, int x_, int y_, int w_, int h_, int device_, State state_ = RENDER)
-	: index(index_), x(x_), y(y_), w(w_), h(h_), device(device_), state(state_), buffers(NULL) {}
+	: index(index_), x(x_), y(y_), w(w_), h(h_), device(device_), state(state_), buffers(NULL),
+	  converged(false), converged_sample(0) {}
 };
 
 /* Tile order */
@@ -78,6 +84,10 @@ public:
 		 * but can be higher due to the initial resolution division for previews. */
 		uint64_t total_pixel_samples;
 
+		/* Pixel samples of converged tiles skipped by next_tile(), which are
+		 * to be counted as rendered. */
+		uint64_t skipped_pixel_samples;
+
 		/* These lists contain the indices of the tiles to be rendered/denoised and are used
 		 * when acquiring a new tile for the device.
 		 * Each list in each vector is for one logical device. */
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "bvh/bvh_build.h"
+#include "bvh/bvh_node.h"
+#include "bvh/bvh_params.h"
+
+#include "render/mesh.h"
+#include "render/object.h"
+
+#include "util/util_foreach.h"
+#include "util/util_progress.h"
+#include "util/util_system.h"
+#include "util/util_task.h"
+#include "util/util_time.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Number of objects in the scene, and number of grid cells of every object
+ * along each of the axis.
+ */
+#define NUM_OBJECTS 8192
+#define GRID_SIZE 16
+
+void create_objects(vector<Object*> *objects)
+{
+	for(int i = 0; i < NUM_OBJECTS; ++i) {
+		Mesh *mesh = new Mesh();
+		mesh->reserve_mesh((GRID_SIZE + 1) * (GRID_SIZE + 1),
+		                   GRID_SIZE * GRID_SIZE * 2);
+		const float3 offset = make_float3((float)(i % 32),
+		                                  (float)((i / 32) % 32),
+		                                  (float)(i / 1024));
+		for(int y = 0; y <= GRID_SIZE; ++y) {
+			for(int x = 0; x <= GRID_SIZE; ++x) {
+				const float u = (float)x / GRID_SIZE;
+				const float v = (float)y / GRID_SIZE;
+				mesh->add_vertex(offset + make_float3(u, v, 0.1f * sinf(10.0f * (u + v) + i)));
+			}
+		}
+		for(int y = 0; y < GRID_SIZE; ++y) {
+			for(int x = 0; x < GRID_SIZE; ++x) {
+				const int v0 = y * (GRID_SIZE + 1) + x;
+				const int v1 = v0 + 1;
+				const int v2 = v0 + GRID_SIZE + 1;
+				const int v3 = v2 + 1;
+				mesh->add_triangle(v0, v1, v3, 0, false);
+				mesh->add_triangle(v0, v3, v2, 0, false);
+			}
+		}
+		Object *object = new Object();
+		object->mesh = mesh;
+		object->tfm = transform_identity();
+		objects->push_back(object);
+	}
+}
+
+void free_objects(vector<Object*> *objects)
+{
+	foreach(Object *object, *objects) {
+		delete object->mesh;
+		delete object;
+	}
+	objects->clear();
+}
+
+double build_bvh(const vector<Object*>& objects,
+                 bool use_parallel_build,
+                 int *num_nodes)
+{
+	BVHParams params;
+	params.use_spatial_split = false;
+	params.use_parallel_build = use_parallel_build;
+
+	array<int> prim_type, prim_index, prim_object;
+	array<float2> prim_time;
+	Progress progress;
+
+	const double start_time = time_dt();
+	BVHBuild bvh_build(objects,
+	                   prim_type,
+	                   prim_index,
+	                   prim_object,
+	                   prim_time,
+	                   params,
+	                   progress);
+	BVHNode *root = bvh_build.run();
+	const double build_time = time_dt() - start_time;
+
+	*num_nodes = root->getSubtreeSize(BVH_STAT_NODE_COUNT);
+	root->deleteSubtree();
+
+	return build_time;
+}
+
+}  /* namespace */
+
+TEST(bvh_build, parallel_build_threads)
+{
+	vector<Object*> objects;
+	create_objects(&objects);
+
+	printf("\n========== BVH build of %d objects, %d triangles ==========\n",
+	       NUM_OBJECTS, NUM_OBJECTS * GRID_SIZE * GRID_SIZE * 2);
+	printf("%8s %14s %14s %8s\n", "Threads", "Regular (s)", "Parallel (s)", "Speedup");
+
+	const int max_threads = system_cpu_thread_count();
+	for(int num_threads = 1; ; num_threads = min(num_threads * 2, max_threads)) {
+		TaskScheduler::init(num_threads);
+
+		int num_regular_nodes, num_parallel_nodes;
+		const double regular_time = build_bvh(objects, false, &num_regular_nodes);
+		const double parallel_time = build_bvh(objects, true, &num_parallel_nodes);
+
+		TaskScheduler::exit();
+
+		printf("%8d %14.4f %14.4f %7.2fx\n",
+		       num_threads, regular_time, parallel_time, regular_time / parallel_time);
+
+		/* Parallel build is expected to give exactly the same tree. */
+		EXPECT_EQ(num_regular_nodes, num_parallel_nodes);
+
+		if(num_threads == max_threads) {
+			break;
+		}
+	}
+
+	free_objects(&objects);
+}
+
+CCL_NAMESPACE_END
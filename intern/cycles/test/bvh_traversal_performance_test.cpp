@@ -0,0 +1,400 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* This file is compiled with AVX2 kernel flags, same as the AVX2 CPU kernel,
+ * so both QBVH and OBVH traversal are using the same instruction set.
+ */
+
+#include "testing/testing.h"
+
+#include "util/util_optimization.h"
+
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+#  define __KERNEL_SSE__
+#  define __KERNEL_SSE2__
+#  define __KERNEL_SSE3__
+#  define __KERNEL_SSSE3__
+#  define __KERNEL_SSE41__
+#  define __KERNEL_AVX__
+#  define __KERNEL_AVX2__
+
+#  include "bvh/bvh.h"
+#  include "bvh/bvh_params.h"
+
+#  include "render/mesh.h"
+#  include "render/object.h"
+
+#  include "util/util_foreach.h"
+#  include "util/util_progress.h"
+#  include "util/util_system.h"
+#  include "util/util_time.h"
+
+#  include "kernel/kernel_compat_cpu.h"
+#  include "kernel/kernel_math.h"
+#  include "kernel/kernel_types.h"
+#  include "kernel/split/kernel_split_data.h"
+#  include "kernel/kernel_globals.h"
+#  include "kernel/kernels/cpu/kernel_cpu_image.h"
+#  include "kernel/kernel_random.h"
+#  include "kernel/kernel_projection.h"
+#  include "kernel/geom/geom.h"
+#  include "kernel/bvh/bvh.h"
+#endif
+
+CCL_NAMESPACE_BEGIN
+
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+
+namespace {
+
+/* Scene is a single mesh made of grid cells randomly placed in a cube, every
+ * cell is a small wavy surface of GRID_SIZE x GRID_SIZE quads.
+ */
+#define NUM_CELLS 4096
+#define GRID_SIZE 8
+#define NUM_RAYS (1 << 20)
+#define SCENE_SIZE 32.0f
+#define CAMERA_RESOLUTION 1024
+#define AO_DISTANCE 1.0f
+
+Object *create_object()
+{
+	Mesh *mesh = new Mesh();
+	mesh->reserve_mesh(NUM_CELLS * (GRID_SIZE + 1) * (GRID_SIZE + 1),
+	                   NUM_CELLS * GRID_SIZE * GRID_SIZE * 2);
+	uint rng = 0;
+	for(int i = 0; i < NUM_CELLS; ++i) {
+		const float3 offset = make_float3(lcg_step_float(&rng),
+		                                  lcg_step_float(&rng),
+		                                  lcg_step_float(&rng)) * SCENE_SIZE;
+		const float3 axis_u = normalize(make_float3(lcg_step_float(&rng) - 0.5f,
+		                                            lcg_step_float(&rng) - 0.5f,
+		                                            lcg_step_float(&rng) - 0.5f));
+		const float3 axis_v = normalize(cross(axis_u,
+		                                      make_float3(lcg_step_float(&rng),
+		                                                  lcg_step_float(&rng),
+		                                                  1.0f)));
+		const float3 axis_n = cross(axis_u, axis_v);
+		const int first_vertex = mesh->verts.size();
+		for(int y = 0; y <= GRID_SIZE; ++y) {
+			for(int x = 0; x <= GRID_SIZE; ++x) {
+				const float u = (float)x / GRID_SIZE;
+				const float v = (float)y / GRID_SIZE;
+				mesh->add_vertex(offset +
+				                 axis_u * u +
+				                 axis_v * v +
+				                 axis_n * (0.1f * sinf(10.0f * (u + v) + i)));
+			}
+		}
+		for(int y = 0; y < GRID_SIZE; ++y) {
+			for(int x = 0; x < GRID_SIZE; ++x) {
+				const int v0 = first_vertex + y * (GRID_SIZE + 1) + x;
+				const int v1 = v0 + 1;
+				const int v2 = v0 + GRID_SIZE + 1;
+				const int v3 = v2 + 1;
+				mesh->add_triangle(v0, v1, v3, 0, false);
+				mesh->add_triangle(v0, v3, v2, 0, false);
+			}
+		}
+	}
+	Object *object = new Object();
+	object->mesh = mesh;
+	object->tfm = transform_identity();
+	return object;
+}
+
+void create_rays(vector<Ray> *rays)
+{
+	uint rng = 1;
+	rays->resize(NUM_RAYS);
+	foreach(Ray& ray, *rays) {
+		memset(&ray, 0, sizeof(ray));
+		ray.P = make_float3(lcg_step_float(&rng),
+		                    lcg_step_float(&rng),
+		                    lcg_step_float(&rng)) * SCENE_SIZE;
+		ray.D = normalize(make_float3(lcg_step_float(&rng) - 0.5f,
+		                              lcg_step_float(&rng) - 0.5f,
+		                              lcg_step_float(&rng) - 0.5f));
+		ray.t = FLT_MAX;
+	}
+}
+
+BVH *build_bvh(const vector<Object*>& objects, bool use_obvh)
+{
+	BVHParams params;
+	params.use_qbvh = true;
+	params.use_obvh = use_obvh;
+	BVH *bvh = BVH::create(params, objects);
+	Progress progress;
+	bvh->build(progress);
+	return bvh;
+}
+
+/* Packed BVH arrays are used by the kernel directly, same as CPU device does
+ * when copying them to the device memory.
+ */
+template<typename T, typename U>
+void set_texture(texture<T> *tex, array<U>& data)
+{
+	static_assert(sizeof(T) == sizeof(U), "Texture and array type mismatch");
+	tex->data = reinterpret_cast<T*>(data.data());
+	tex->width = data.size();
+}
+
+void setup_kernel_globals(KernelGlobals *kg, BVH *bvh)
+{
+	memset(kg, 0, sizeof(*kg));
+	PackedBVH& pack = bvh->pack;
+	set_texture(&kg->__bvh_nodes, pack.nodes);
+	set_texture(&kg->__bvh_leaf_nodes, pack.leaf_nodes);
+	set_texture(&kg->__object_node, pack.object_node);
+	set_texture(&kg->__prim_tri_index, pack.prim_tri_index);
+	set_texture(&kg->__prim_tri_verts, pack.prim_tri_verts);
+	set_texture(&kg->__prim_type, pack.prim_type);
+	set_texture(&kg->__prim_visibility, pack.prim_visibility);
+	set_texture(&kg->__prim_index, pack.prim_index);
+	set_texture(&kg->__prim_object, pack.prim_object);
+	set_texture(&kg->__prim_time, pack.prim_time);
+	kg->__data.bvh.root = pack.root_index;
+	kg->__data.bvh.use_qbvh = bvh->params.use_qbvh;
+	kg->__data.bvh.use_obvh = bvh->params.use_obvh;
+}
+
+double trace_rays(KernelGlobals *kg,
+                  const vector<Ray>& rays,
+                  vector<Intersection> *isects)
+{
+	isects->resize(rays.size());
+	const double start_time = time_dt();
+	for(size_t i = 0; i < rays.size(); ++i) {
+		scene_intersect(kg, rays[i], PATH_RAY_ALL_VISIBILITY,
+		                &(*isects)[i], NULL, 0.0f, 0.0f);
+	}
+	return time_dt() - start_time;
+}
+
+/* Camera rays of a pinhole camera looking into the scene, stored in
+ * scanline order so neighbour rays form coherent packets.
+ */
+void create_camera_rays(vector<Ray> *rays)
+{
+	const int width = CAMERA_RESOLUTION, height = CAMERA_RESOLUTION;
+	const float3 P = make_float3(0.5f, 0.5f, -0.5f) * SCENE_SIZE;
+	rays->resize(width * height);
+	for(int y = 0; y < height; ++y) {
+		for(int x = 0; x < width; ++x) {
+			Ray& ray = (*rays)[y * width + x];
+			memset(&ray, 0, sizeof(ray));
+			ray.P = P;
+			ray.D = normalize(make_float3((x + 0.5f) / width - 0.5f,
+			                              (y + 0.5f) / height - 0.5f,
+			                              1.0f));
+			ray.t = FLT_MAX;
+		}
+	}
+}
+
+/* Ambient occlusion rays leaving closest hits of the camera rays, rays of
+ * pixels which missed the scene get zero length.
+ */
+void create_ao_rays(const vector<Ray>& camera_rays,
+                    const vector<Intersection>& isects,
+                    vector<Ray> *rays)
+{
+	uint rng = 2;
+	rays->resize(camera_rays.size());
+	for(size_t i = 0; i < camera_rays.size(); ++i) {
+		Ray& ray = (*rays)[i];
+		memset(&ray, 0, sizeof(ray));
+		ray.P = camera_rays[i].P;
+		ray.D = camera_rays[i].D;
+		if(isects[i].prim == PRIM_NONE) {
+			continue;
+		}
+		const float3 N = -camera_rays[i].D;
+		float3 D = normalize(make_float3(lcg_step_float(&rng) - 0.5f,
+		                                 lcg_step_float(&rng) - 0.5f,
+		                                 lcg_step_float(&rng) - 0.5f));
+		if(dot(D, N) < 0.0f) {
+			D = -D;
+		}
+		ray.P = camera_rays[i].P + camera_rays[i].D * isects[i].t + N * 1e-4f;
+		ray.D = D;
+		ray.t = AO_DISTANCE;
+	}
+}
+
+double trace_rays_packet(KernelGlobals *kg,
+                         const vector<Ray>& rays,
+                         const uint visibility,
+                         vector<Intersection> *isects)
+{
+	isects->resize(rays.size());
+	const double start_time = time_dt();
+	for(size_t i = 0; i < rays.size(); i += BVH_PACKET_SIZE) {
+		const int num_rays = min((int)(rays.size() - i), BVH_PACKET_SIZE);
+		scene_intersect_packet(kg, &rays[i], visibility, &(*isects)[i], num_rays);
+	}
+	return time_dt() - start_time;
+}
+
+double trace_rays_single(KernelGlobals *kg,
+                         const vector<Ray>& rays,
+                         const uint visibility,
+                         vector<Intersection> *isects)
+{
+	isects->resize(rays.size());
+	const double start_time = time_dt();
+	for(size_t i = 0; i < rays.size(); ++i) {
+		scene_intersect(kg, rays[i], visibility, &(*isects)[i], NULL, 0.0f, 0.0f);
+	}
+	return time_dt() - start_time;
+}
+
+void print_packet_timing(const char *name,
+                         size_t num_rays,
+                         double single_time,
+                         double packet_time)
+{
+	printf("%8s %14s %14.4f %14.4f\n", name, "Single",
+	       single_time, num_rays * 1e-6 / single_time);
+	printf("%8s %14s %14.4f %14.4f\n", name, "Packet",
+	       packet_time, num_rays * 1e-6 / packet_time);
+}
+
+}  /* namespace */
+
+TEST(bvh_traversal, obvh_vs_qbvh)
+{
+	if(!system_cpu_support_avx2()) {
+		printf("CPU does not support AVX2, skipping OBVH traversal test.\n");
+		return;
+	}
+
+	vector<Object*> objects;
+	objects.push_back(create_object());
+	vector<Ray> rays;
+	create_rays(&rays);
+
+	BVH *qbvh = build_bvh(objects, false);
+	BVH *obvh = build_bvh(objects, true);
+
+	KernelGlobals kg;
+	vector<Intersection> qbvh_isects, obvh_isects;
+
+	setup_kernel_globals(&kg, qbvh);
+	const double qbvh_time = trace_rays(&kg, rays, &qbvh_isects);
+	setup_kernel_globals(&kg, obvh);
+	const double obvh_time = trace_rays(&kg, rays, &obvh_isects);
+
+	printf("\n========== Traversal of %d rays, %d triangles ==========\n",
+	       NUM_RAYS, NUM_CELLS * GRID_SIZE * GRID_SIZE * 2);
+	printf("%8s %14s %14s\n", "BVH", "Time (s)", "Mrays/s");
+	printf("%8s %14.4f %14.4f\n", "QBVH", qbvh_time, NUM_RAYS * 1e-6 / qbvh_time);
+	printf("%8s %14.4f %14.4f\n", "OBVH", obvh_time, NUM_RAYS * 1e-6 / obvh_time);
+
+	/* Both layouts are expected to find the same closest hits. */
+	int num_hits = 0, num_mismatches = 0;
+	for(size_t i = 0; i < rays.size(); ++i) {
+		const Intersection& a = qbvh_isects[i];
+		const Intersection& b = obvh_isects[i];
+		num_hits += (a.prim != PRIM_NONE);
+		if(a.prim != b.prim || a.t != b.t) {
+			num_mismatches++;
+		}
+	}
+	printf("%d rays hit the scene\n", num_hits);
+	EXPECT_GT(num_hits, 0);
+	EXPECT_EQ(num_mismatches, 0);
+
+	delete qbvh;
+	delete obvh;
+	foreach(Object *object, objects) {
+		delete object->mesh;
+		delete object;
+	}
+}
+
+TEST(bvh_traversal, packet_vs_single)
+{
+	if(!system_cpu_support_avx2()) {
+		printf("CPU does not support AVX2, skipping packet traversal test.\n");
+		return;
+	}
+
+	vector<Object*> objects;
+	objects.push_back(create_object());
+
+	/* Packet traversal is only implemented for QBVH. */
+	BVH *qbvh = build_bvh(objects, false);
+	KernelGlobals kg;
+	setup_kernel_globals(&kg, qbvh);
+
+	vector<Ray> camera_rays, ao_rays;
+	vector<Intersection> single_isects, packet_isects;
+	create_camera_rays(&camera_rays);
+
+	const double camera_single_time = trace_rays_single(
+	        &kg, camera_rays, PATH_RAY_CAMERA, &single_isects);
+	const double camera_packet_time = trace_rays_packet(
+	        &kg, camera_rays, PATH_RAY_CAMERA, &packet_isects);
+
+	/* Closest hits are expected to be exactly the same. */
+	int num_mismatches = 0;
+	for(size_t i = 0; i < camera_rays.size(); ++i) {
+		if(single_isects[i].prim != packet_isects[i].prim ||
+		   single_isects[i].t != packet_isects[i].t)
+		{
+			num_mismatches++;
+		}
+	}
+	EXPECT_EQ(num_mismatches, 0);
+
+	create_ao_rays(camera_rays, single_isects, &ao_rays);
+	const double ao_single_time = trace_rays_single(
+	        &kg, ao_rays, PATH_RAY_SHADOW_OPAQUE, &single_isects);
+	const double ao_packet_time = trace_rays_packet(
+	        &kg, ao_rays, PATH_RAY_SHADOW_OPAQUE, &packet_isects);
+
+	/* Any hit terminates shadow rays, so only occlusion is compared. */
+	num_mismatches = 0;
+	for(size_t i = 0; i < ao_rays.size(); ++i) {
+		if((single_isects[i].prim == PRIM_NONE) !=
+		   (packet_isects[i].prim == PRIM_NONE))
+		{
+			num_mismatches++;
+		}
+	}
+	EXPECT_EQ(num_mismatches, 0);
+
+	printf("\n========== Packet traversal of %d x %d camera and AO rays ==========\n",
+	       CAMERA_RESOLUTION, CAMERA_RESOLUTION);
+	printf("%8s %14s %14s %14s\n", "Rays", "Traversal", "Time (s)", "Mrays/s");
+	print_packet_timing("Camera", camera_rays.size(),
+	                    camera_single_time, camera_packet_time);
+	print_packet_timing("AO", ao_rays.size(),
+	                    ao_single_time, ao_packet_time);
+
+	delete qbvh;
+	foreach(Object *object, objects) {
+		delete object->mesh;
+		delete object;
+	}
+}
+
+#endif  /* WITH_CYCLES_OPTIMIZED_KERNEL_AVX2 */
+
+CCL_NAMESPACE_END
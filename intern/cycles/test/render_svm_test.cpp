@@ -0,0 +1,199 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "render/graph.h"
+#include "render/nodes.h"
+#include "render/svm.h"
+#include "util/util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Compiles single nodes, without a shader or scene. */
+class SVMNodeCompiler : public SVMCompiler {
+public:
+	SVMNodeCompiler()
+	  : SVMCompiler(NULL, NULL)
+	{
+	}
+
+	const array<int4>& compile(ShaderNode *node)
+	{
+		current_svm_nodes.clear();
+		node->compile(*this);
+		add_pending_values();
+		return current_svm_nodes;
+	}
+};
+
+/* Loads constant values onto the stack the same way as the kernel, returns
+ * the index of the first node which is not a value node. */
+int eval_values(const array<int4>& nodes, int offset, float *stack)
+{
+	while(offset < nodes.size()) {
+		const int4 node = nodes[offset++];
+
+		if(node.x == NODE_VALUE_F) {
+			stack[node.z] = __int_as_float(node.y);
+		}
+		else if(node.x == NODE_VALUE_V) {
+			const int4 value = nodes[offset++];
+			stack[node.y + 0] = __int_as_float(value.y);
+			stack[node.y + 1] = __int_as_float(value.z);
+			stack[node.y + 2] = __int_as_float(value.w);
+		}
+		else if(node.x == NODE_VALUES) {
+			for(int i = 0; i < node.y; i += 2) {
+				const int4 value = nodes[offset++];
+				stack[value.y] = __int_as_float(value.x);
+				if(i + 1 < node.y) {
+					stack[value.w] = __int_as_float(value.z);
+				}
+			}
+			for(int i = 0; i < node.z; i++) {
+				const int4 value = nodes[offset++];
+				stack[value.w + 0] = __int_as_float(value.x);
+				stack[value.w + 1] = __int_as_float(value.y);
+				stack[value.w + 2] = __int_as_float(value.z);
+			}
+		}
+		else {
+			return offset - 1;
+		}
+	}
+
+	return offset;
+}
+
+float3 stack_float3(const float *stack, int offset)
+{
+	return make_float3(stack[offset], stack[offset + 1], stack[offset + 2]);
+}
+
+}  // namespace
+
+/*
+ * A lone constant keeps the single value encoding.
+ */
+TEST(render_svm, values_single)
+{
+	RGBToBWNode node;
+	node.color = make_float3(0.1f, 0.2f, 0.3f);
+
+	SVMNodeCompiler compiler;
+	const array<int4>& nodes = compiler.compile(&node);
+
+	ASSERT_EQ(nodes.size(), 3);
+	EXPECT_EQ(nodes[0].x, NODE_VALUE_V);
+
+	float stack[SVM_STACK_SIZE] = {0.0f};
+	const int index = eval_values(nodes, 0, stack);
+	ASSERT_EQ(index, 2);
+	EXPECT_EQ(nodes[index].x, NODE_CONVERT);
+	EXPECT_EQ(stack_float3(stack, nodes[index].z), make_float3(0.1f, 0.2f, 0.3f));
+}
+
+/*
+ * Odd number of floats, the last data word is half empty.
+ */
+TEST(render_svm, values_mix)
+{
+	MixNode node;
+	node.fac = 0.25f;
+	node.color1 = make_float3(0.1f, 0.2f, 0.3f);
+	node.color2 = make_float3(0.4f, 0.5f, 0.6f);
+
+	SVMNodeCompiler compiler;
+	const array<int4>& nodes = compiler.compile(&node);
+
+	ASSERT_GT(nodes.size(), 0);
+	EXPECT_EQ(nodes[0].x, NODE_VALUES);
+	EXPECT_EQ(nodes[0].y, 1);
+	EXPECT_EQ(nodes[0].z, 2);
+
+	float stack[SVM_STACK_SIZE] = {0.0f};
+	const int index = eval_values(nodes, 0, stack);
+	ASSERT_EQ(index, 4);
+	EXPECT_EQ(nodes[index].x, NODE_MIX);
+	EXPECT_EQ(stack[nodes[index].y], 0.25f);
+	EXPECT_EQ(stack_float3(stack, nodes[index].z), make_float3(0.1f, 0.2f, 0.3f));
+	EXPECT_EQ(stack_float3(stack, nodes[index].w), make_float3(0.4f, 0.5f, 0.6f));
+}
+
+/*
+ * Even number of floats, offsets packed into the node by encode_uchar4().
+ */
+TEST(render_svm, values_hsv)
+{
+	HSVNode node;
+	node.hue = 0.1f;
+	node.saturation = 0.2f;
+	node.value = 0.3f;
+	node.fac = 0.4f;
+	node.color = make_float3(0.5f, 0.6f, 0.7f);
+
+	SVMNodeCompiler compiler;
+	const array<int4>& nodes = compiler.compile(&node);
+
+	ASSERT_GT(nodes.size(), 0);
+	EXPECT_EQ(nodes[0].x, NODE_VALUES);
+	EXPECT_EQ(nodes[0].y, 4);
+	EXPECT_EQ(nodes[0].z, 1);
+
+	float stack[SVM_STACK_SIZE] = {0.0f};
+	const int index = eval_values(nodes, 0, stack);
+	ASSERT_EQ(index, 4);
+	EXPECT_EQ(nodes[index].x, NODE_HSV);
+
+	const uint in = nodes[index].y, params = nodes[index].z;
+	EXPECT_EQ(stack_float3(stack, in & 0xFF), make_float3(0.5f, 0.6f, 0.7f));
+	EXPECT_EQ(stack[(in >> 8) & 0xFF], 0.4f);
+	EXPECT_EQ(stack[params & 0xFF], 0.1f);
+	EXPECT_EQ(stack[(params >> 8) & 0xFF], 0.2f);
+	EXPECT_EQ(stack[(params >> 16) & 0xFF], 0.3f);
+}
+
+/*
+ * Values are written before the node which reads them, also when a node
+ * compiles into several nodes.
+ */
+TEST(render_svm, values_combine)
+{
+	CombineRGBNode node;
+	node.r = 0.1f;
+	node.g = 0.2f;
+	node.b = 0.3f;
+	const float expected[3] = {0.1f, 0.2f, 0.3f};
+
+	SVMNodeCompiler compiler;
+	const array<int4>& nodes = compiler.compile(&node);
+
+	float stack[SVM_STACK_SIZE] = {0.0f};
+	int index = 0;
+	for(int i = 0; i < 3; i++) {
+		index = eval_values(nodes, index, stack);
+		ASSERT_LT(index, nodes.size());
+		EXPECT_EQ(nodes[index].x, NODE_COMBINE_VECTOR);
+		EXPECT_EQ(stack[nodes[index].y], expected[nodes[index].z]);
+		index++;
+	}
+	EXPECT_EQ(index, nodes.size());
+}
+
+CCL_NAMESPACE_END
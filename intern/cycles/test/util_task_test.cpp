@@ -25,6 +25,45 @@ namespace {
 void task_run() {
 }
 
+void task_push(TaskPool *pool) {
+	for(int i = 0; i < 10; ++i) {
+		pool->push(function_bind(task_run));
+	}
+}
+
+struct FrontPushState {
+	FrontPushState() : num_blocked(0), front_done(false), num_back_before_front(0) {}
+
+	thread_mutex mutex;
+	thread_condition_variable cond;
+	int num_blocked;
+	bool front_done;
+	int num_back_before_front;
+};
+
+/* Keeps a worker thread busy until the front task ran. */
+void task_block(FrontPushState *state) {
+	thread_scoped_lock lock(state->mutex);
+	state->num_blocked++;
+	state->cond.notify_all();
+	while(!state->front_done) {
+		state->cond.wait(lock);
+	}
+}
+
+void task_back(FrontPushState *state) {
+	thread_scoped_lock lock(state->mutex);
+	if(!state->front_done) {
+		state->num_back_before_front++;
+	}
+}
+
+void task_front(FrontPushState *state) {
+	thread_scoped_lock lock(state->mutex);
+	state->front_done = true;
+	state->cond.notify_all();
+}
+
 }  // namespace
 
 TEST(util_task, basic) {
@@ -53,4 +92,76 @@ TEST(util_task, multiple_times) {
 	}
 }
 
+TEST(util_task, nested_push) {
+	TaskScheduler::init(0);
+	TaskPool pool;
+	for(int i = 0; i < 100; ++i) {
+		pool.push(function_bind(task_push, &pool));
+	}
+	TaskPool::Summary summary;
+	pool.wait_work(&summary);
+	TaskScheduler::exit();
+	EXPECT_EQ(summary.num_tasks_handled, 1100);
+	EXPECT_LE(summary.num_tasks_stolen, summary.num_tasks_handled);
+}
+
+TEST(util_task, numa) {
+	TaskScheduler::init(0, true);
+	TaskPool pool;
+	for(int i = 0; i < 100; ++i) {
+		pool.push(function_bind(task_run));
+	}
+	TaskPool::Summary summary;
+	pool.wait_work(&summary);
+	TaskScheduler::exit();
+	EXPECT_EQ(summary.num_tasks_handled, 100);
+}
+
+TEST(util_task, numa_mode_change) {
+	TaskScheduler::init(0, false);
+	/* threads are re-created, tasks of both modes are all done */
+	TaskScheduler::init(0, true);
+	TaskPool pool;
+	for(int i = 0; i < 100; ++i) {
+		pool.push(function_bind(task_push, &pool));
+	}
+	TaskPool::Summary summary;
+	pool.wait_work(&summary);
+	TaskScheduler::exit();
+	TaskScheduler::exit();
+	EXPECT_EQ(summary.num_tasks_handled, 1100);
+}
+
+TEST(util_task, front_push) {
+	/* Front task is pushed last to the shared queue, and must be taken
+	 * before all others, whichever queues they were distributed to. */
+	TaskScheduler::init(4, true);
+	FrontPushState state;
+	TaskPool pool;
+
+	/* occupy all worker threads, so the front task is taken by wait_work */
+	const int num_threads = TaskScheduler::num_threads();
+	for(int i = 0; i < num_threads; ++i) {
+		pool.push(function_bind(task_block, &state));
+	}
+	{
+		thread_scoped_lock lock(state.mutex);
+		while(state.num_blocked != num_threads) {
+			state.cond.wait(lock);
+		}
+	}
+
+	for(int i = 0; i < 101; ++i) {
+		pool.push(function_bind(task_back, &state));
+	}
+	pool.push(function_bind(task_front, &state), true);
+
+	TaskPool::Summary summary;
+	pool.wait_work(&summary);
+	TaskScheduler::exit();
+	EXPECT_EQ(summary.num_tasks_handled, num_threads + 102);
+	EXPECT_TRUE(state.front_done);
+	EXPECT_EQ(state.num_back_before_front, 0);
+}
+
 CCL_NAMESPACE_END
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imageio.h>
+
+#include "util/util_math.h"
+#include "util/util_path.h"
+#include "util/util_texture_cache.h"
+
+OIIO_NAMESPACE_USING
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+const int width = 96;
+const int height = 80;
+const int channels = 3;
+
+/* Image file of which all pixels differ, written to a temporary file. */
+class TextureCacheTest : public ::testing::Test {
+protected:
+	virtual void SetUp()
+	{
+		filename = path_join(Filesystem::temp_directory_path(),
+		                     Filesystem::unique_path("cycles_texture_cache_%%%%%%%%.tif"));
+
+		pixels.resize(width * height * channels);
+		for(int i = 0; i < pixels.size(); i++) {
+			pixels[i] = (float)i / pixels.size();
+		}
+
+		/* Scanlines, so the texture system tiles the image on the fly. */
+		ImageOutput *out = ImageOutput::create(filename);
+		ASSERT_TRUE(out != NULL);
+		ImageSpec spec(width, height, channels, TypeDesc::FLOAT);
+		ASSERT_TRUE(out->open(filename, spec));
+		ASSERT_TRUE(out->write_image(TypeDesc::FLOAT, &pixels[0]));
+		out->close();
+		delete out;
+
+		cache.set_options(16, false);
+	}
+
+	virtual void TearDown()
+	{
+		path_remove(filename);
+	}
+
+	/* Pixel as loaded into a regular image texture, which stores scanlines
+	 * bottom to top. */
+	float3 loaded_pixel(int x, int y) const
+	{
+		const float *p = &pixels[((height - 1 - y) * width + x) * channels];
+		return make_float3(p[0], p[1], p[2]);
+	}
+
+	/* Center of the pixel, so closest lookup of the cache has to return
+	 * exactly that pixel. */
+	float4 cached_pixel(int flat_slot, int x, int y, void *thread_info = NULL) const
+	{
+		return cache.lookup(thread_info,
+		                    flat_slot,
+		                    (x + 0.5f) / width,
+		                    (y + 0.5f) / height);
+	}
+
+	string filename;
+	vector<float> pixels;
+	TextureCache cache;
+};
+
+}  // namespace
+
+TEST_F(TextureCacheTest, same_as_loaded)
+{
+	ASSERT_TRUE(cache.add_image(0, filename, true, INTERPOLATION_CLOSEST, EXTENSION_REPEAT));
+	ASSERT_TRUE(cache.is_cached(0));
+
+	void *thread_info = cache.thread_info();
+	EXPECT_TRUE(thread_info != NULL);
+
+	for(int y = 0; y < height; y++) {
+		for(int x = 0; x < width; x++) {
+			const float4 r = cached_pixel(0, x, y, thread_info);
+			EXPECT_EQ(make_float3(r.x, r.y, r.z), loaded_pixel(x, y));
+			EXPECT_EQ(r.w, 1.0f);
+		}
+	}
+}
+
+TEST_F(TextureCacheTest, thread_info)
+{
+	ASSERT_TRUE(cache.add_image(0, filename, true, INTERPOLATION_LINEAR, EXTENSION_EXTEND));
+
+	/* Per-thread data only avoids finding it on every lookup. */
+	void *thread_info = cache.thread_info();
+	EXPECT_EQ(cache.thread_info(), thread_info);
+	for(int i = 0; i < 64; i++) {
+		const float x = (float)(i * 7 % 64) / 63.0f;
+		const float y = (float)(i * 13 % 64) / 63.0f;
+		const float4 a = cache.lookup(NULL, 0, x, y);
+		const float4 b = cache.lookup(thread_info, 0, x, y);
+		EXPECT_EQ(a.x, b.x);
+		EXPECT_EQ(a.y, b.y);
+		EXPECT_EQ(a.z, b.z);
+		EXPECT_EQ(a.w, b.w);
+	}
+}
+
+TEST_F(TextureCacheTest, remove_shared_file)
+{
+	/* Same file in two slots, removing one must not affect the other. */
+	ASSERT_TRUE(cache.add_image(0, filename, true, INTERPOLATION_CLOSEST, EXTENSION_REPEAT));
+	ASSERT_TRUE(cache.add_image(1, filename, true, INTERPOLATION_CLOSEST, EXTENSION_CLIP));
+
+	cache.remove_image(0);
+	EXPECT_FALSE(cache.is_cached(0));
+	ASSERT_TRUE(cache.is_cached(1));
+
+	for(int y = 0; y < height; y += 7) {
+		for(int x = 0; x < width; x += 5) {
+			const float4 r = cached_pixel(1, x, y);
+			EXPECT_EQ(make_float3(r.x, r.y, r.z), loaded_pixel(x, y));
+		}
+	}
+
+	cache.remove_image(1);
+	EXPECT_FALSE(cache.is_cached(1));
+}
+
+TEST_F(TextureCacheTest, missing_file)
+{
+	EXPECT_FALSE(cache.add_image(0, filename + ".missing", true, INTERPOLATION_LINEAR, EXTENSION_REPEAT));
+	EXPECT_FALSE(cache.is_cached(0));
+}
+
+CCL_NAMESPACE_END
@@ -30,7 +30,11 @@ DebugFlags::CPU::CPU()
     sse3(true),
     sse2(true),
     qbvh(true),
-    split_kernel(false)
+    split_kernel(false),
+    ray_packets(false),
+    shader_sort(false),
+    timing(false),
+    numa(false)
 {
 	reset();
 }
@@ -57,6 +61,10 @@ void DebugFlags::CPU::reset()
 
 	qbvh = true;
 	split_kernel = false;
+	ray_packets = false;
+	shader_sort = false;
+	timing = false;
+	numa = false;
 }
 
 DebugFlags::CUDA::CUDA()
@@ -145,7 +153,11 @@ std::ostream& operator <<(std::ostream &os,
 	   << "  SSE3   : " << string_from_bool(debug_flags.cpu.sse3)  << "\n"
 	   << "  SSE2   : " << string_from_bool(debug_flags.cpu.sse2)  << "\n"
 	   << "  QBVH   : " << string_from_bool(debug_flags.cpu.qbvh)  << "\n"
-	   << "  Split  : " << string_from_bool(debug_flags.cpu.split_kernel) << "\n";
+	   << "  Split  : " << string_from_bool(debug_flags.cpu.split_kernel) << "\n"
+	   << "  Packets: " << string_from_bool(debug_flags.cpu.ray_packets) << "\n"
+	   << "  Sort   : " << string_from_bool(debug_flags.cpu.shader_sort) << "\n"
+	   << "  Timing : " << string_from_bool(debug_flags.cpu.timing) << "\n"
+	   << "  NUMA   : " << string_from_bool(debug_flags.cpu.numa) << "\n";
 
 	os << "CUDA flags:\n"
 	   << " Adaptive Compile: " << string_from_bool(debug_flags.cuda.adaptive_compile) << "\n";
@@ -52,6 +52,20 @@ public:
 
 		/* Whether split kernel is used */
 		bool split_kernel;
+
+		/* Whether camera rays are traced in packets of neighbour pixels. */
+		bool ray_packets;
+
+		/* Whether paths of a tile are integrated in order of the shader hit by
+		 * their camera ray. */
+		bool shader_sort;
+
+		/* Whether time spent in ray traversal and shader evaluation is
+		 * measured and logged. */
+		bool timing;
+
+		/* Whether scheduler threads are bound to NUMA nodes. */
+		bool numa;
 	};
 
 	/* Descriptor of CUDA feature-set to be used. */
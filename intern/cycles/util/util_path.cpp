@@ -33,14 +33,18 @@ OIIO_NAMESPACE_USING
 #  define DIR_SEP '\\'
 #  define DIR_SEP_ALT '/'
 #  include <direct.h>
+#  include <sys/utime.h>
 #else
 #  define DIR_SEP '/'
 #  include <dirent.h>
 #  include <pwd.h>
 #  include <unistd.h>
+#  include <utime.h>
 #  include <sys/types.h>
 #endif
 
+#include <algorithm>
+
 #ifdef HAVE_SHLWAPI_H
 #  include <shlwapi.h>
 #endif
@@ -769,6 +773,16 @@ bool path_remove(const string& path)
 	return remove(path.c_str()) == 0;
 }
 
+bool path_touch(const string& path)
+{
+#ifdef _WIN32
+	wstring path_wc = string_to_wstring(path);
+	return _wutime(path_wc.c_str(), NULL) == 0;
+#else
+	return utime(path.c_str(), NULL) == 0;
+#endif
+}
+
 struct SourceReplaceState {
 	typedef map<string, string> ProcessedMapping;
 	/* Base director for all relative include headers. */
@@ -987,5 +1001,56 @@ void path_cache_clear_except(const string& name, const set<string>& except)
 
 }
 
+void path_cache_trim(const string& dir, size_t max_size)
+{
+	if(!path_exists(dir)) {
+		return;
+	}
+
+	struct CacheFile {
+		uint64_t modified_time;
+		size_t size;
+		string path;
+
+		bool operator<(const CacheFile& other) const
+		{
+			return modified_time < other.modified_time;
+		}
+	};
+
+	vector<CacheFile> files;
+	size_t total_size = 0;
+
+	directory_iterator it(dir), it_end;
+	for(; it != it_end; ++it) {
+		path_stat_t st;
+		const string filepath = it->path();
+		if(path_stat(filepath, &st) != 0 || !(st.st_mode & S_IFREG)) {
+			continue;
+		}
+
+		CacheFile file;
+		file.modified_time = st.st_mtime;
+		file.size = st.st_size;
+		file.path = filepath;
+		files.push_back(file);
+		total_size += file.size;
+	}
+
+	if(total_size <= max_size) {
+		return;
+	}
+
+	std::sort(files.begin(), files.end());
+
+	for(size_t i = 0; i < files.size() && total_size > max_size; i++) {
+		/* Files which are still open in another process may fail to be
+		 * removed on some platforms, they are removed next time. */
+		if(path_remove(files[i].path)) {
+			total_size -= files[i].size;
+		}
+	}
+}
+
 CCL_NAMESPACE_END
 
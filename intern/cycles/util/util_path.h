@@ -64,6 +64,7 @@ bool path_read_text(const string& path, string& text);
 
 /* File manipulation. */
 bool path_remove(const string& path);
+bool path_touch(const string& path);
 
 /* source code utility */
 string path_source_replace_includes(const string& source,
@@ -73,6 +74,10 @@ string path_source_replace_includes(const string& source,
 /* cache utility */
 void path_cache_clear_except(const string& name, const set<string>& except);
 
+/* Remove least recently modified files of the directory, until the size of
+ * the remaining files is below max_size. */
+void path_cache_trim(const string& dir, size_t max_size);
+
 CCL_NAMESPACE_END
 
 #endif
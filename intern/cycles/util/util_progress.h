@@ -39,6 +39,8 @@ public:
 		current_tile_sample = 0;
 		rendered_tiles = 0;
 		denoised_tiles = 0;
+		bvh_cache_hits = 0;
+		bvh_cache_misses = 0;
 		start_time = time_dt();
 		render_start_time = time_dt();
 		end_time = 0.0;
@@ -79,6 +81,8 @@ public:
 		current_tile_sample = 0;
 		rendered_tiles = 0;
 		denoised_tiles = 0;
+		bvh_cache_hits = 0;
+		bvh_cache_misses = 0;
 		start_time = time_dt();
 		render_start_time = time_dt();
 		end_time = 0.0;
@@ -254,6 +258,27 @@ public:
 		return denoised_tiles;
 	}
 
+	/* BVH cache statistics */
+
+	void add_bvh_cache_hit()
+	{
+		thread_scoped_lock lock(progress_mutex);
+		bvh_cache_hits++;
+	}
+
+	void add_bvh_cache_miss()
+	{
+		thread_scoped_lock lock(progress_mutex);
+		bvh_cache_misses++;
+	}
+
+	void get_bvh_cache_stats(int& hits, int& misses)
+	{
+		thread_scoped_lock lock(progress_mutex);
+		hits = bvh_cache_hits;
+		misses = bvh_cache_misses;
+	}
+
 	/* status messages */
 
 	void set_status(const string& status_, const string& substatus_ = "")
@@ -345,6 +370,9 @@ protected:
 	/* Stores the number of tiles that's already finished.
 	 * Used to determine whether all but the last tile are finished rendering, in which case the current_tile_sample is displayed. */
 	int rendered_tiles, denoised_tiles;
+	/* Number of BVHs loaded from the on-disk cache and number of BVHs which
+	 * were not found there and had to be built. */
+	int bvh_cache_hits, bvh_cache_misses;
 
 	double start_time, render_start_time;
 	/* End time written when render is done, so it doesn't keep increasing on redraws. */
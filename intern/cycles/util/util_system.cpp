@@ -17,6 +17,7 @@
 #include "util/util_system.h"
 
 #include "util/util_debug.h"
+#include "util/util_foreach.h"
 #include "util/util_logging.h"
 #include "util/util_types.h"
 #include "util/util_string.h"
@@ -33,6 +34,12 @@
 #  include <unistd.h>
 #endif
 
+#if !defined(_WIN32) && !defined(__APPLE__)
+#  include <pthread.h>
+#  include <sched.h>
+#  include <stdio.h>
+#endif
+
 CCL_NAMESPACE_BEGIN
 
 int system_cpu_group_count()
@@ -105,6 +112,94 @@ unsigned short system_cpu_process_groups(unsigned short max_groups,
 #endif
 }
 
+#if !defined(_WIN32) && !defined(__APPLE__)
+/* Read list of processors in the format used by sysfs, like "0-7,16-23". */
+static bool system_cpu_read_list(const string& filename, vector<int> *cpus)
+{
+	FILE *f = fopen(filename.c_str(), "r");
+	if(f == NULL) {
+		return false;
+	}
+	int first, last;
+	while(fscanf(f, "%d", &first) == 1) {
+		last = first;
+		int c = fgetc(f);
+		if(c == '-') {
+			if(fscanf(f, "%d", &last) != 1) {
+				break;
+			}
+			c = fgetc(f);
+		}
+		for(int cpu = first; cpu <= last; ++cpu) {
+			cpus->push_back(cpu);
+		}
+		if(c != ',') {
+			break;
+		}
+	}
+	fclose(f);
+	return !cpus->empty();
+}
+#endif
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+static const vector<int>& system_cpu_numa_nodes()
+{
+	/* Online node numbers, these are not necessarily contiguous. */
+	static vector<int> nodes;
+	static bool nodes_initialized = false;
+	if(!nodes_initialized) {
+		if(!system_cpu_read_list("/sys/devices/system/node/online", &nodes)) {
+			nodes.clear();
+		}
+		nodes_initialized = true;
+		VLOG(1) << "Detected " << nodes.size() << " NUMA nodes.";
+	}
+	return nodes;
+}
+#endif
+
+int system_cpu_numa_node_count()
+{
+#if !defined(_WIN32) && !defined(__APPLE__)
+	const int count = (int)system_cpu_numa_nodes().size();
+	return (count > 0)? count: 1;
+#else
+	/* NOTE: On Windows threads are placed using CPU groups instead. */
+	return 1;
+#endif
+}
+
+bool system_cpu_numa_node_bind_thread(int node)
+{
+#if !defined(_WIN32) && !defined(__APPLE__)
+	const vector<int>& nodes = system_cpu_numa_nodes();
+	if(node < 0 || node >= (int)nodes.size()) {
+		return false;
+	}
+	node = nodes[node];
+
+	vector<int> cpus;
+	if(!system_cpu_read_list(string_printf("/sys/devices/system/node/node%d/cpulist",
+	                                       node),
+	                         &cpus))
+	{
+		return false;
+	}
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	foreach(int cpu, cpus) {
+		if(cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &cpu_set);
+		}
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+	(void) node;
+	return false;
+#endif
+}
+
 #if !defined(_WIN32) || defined(FREE_WINDOWS)
 static void __cpuid(int data[4], int selector)
 {
@@ -34,6 +34,15 @@ int system_cpu_thread_count();
 unsigned short system_cpu_process_groups(unsigned short max_groups,
                                          unsigned short *grpups);
 
+/* Get number of NUMA nodes, 1 when NUMA topology is not known. */
+int system_cpu_numa_node_count();
+
+/* Restrict current thread to the processors of the given NUMA node, where
+ * node is an index from 0 to system_cpu_numa_node_count() - 1.
+ * Returns false if affinity could not be changed.
+ */
+bool system_cpu_numa_node_bind_thread(int node);
+
 string system_cpu_brand_string();
 int system_cpu_bits();
 bool system_cpu_support_sse2();
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "util/util_atomic.h"
 #include "util/util_debug.h"
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
@@ -37,6 +38,8 @@ CCL_NAMESPACE_BEGIN
 TaskPool::TaskPool()
 {
 	num_tasks_handled = 0;
+	num_tasks_stolen = 0;
+	num_lock_contentions = 0;
 	num = 0;
 	do_cancel = false;
 }
@@ -68,26 +71,10 @@ void TaskPool::wait_work(Summary *stats)
 	while(num != 0) {
 		num_lock.unlock();
 
-		thread_scoped_lock queue_lock(TaskScheduler::queue_mutex);
-
 		/* find task from this pool. if we get a task from another pool,
 		 * we can get into deadlock */
 		TaskScheduler::Entry work_entry;
-		bool found_entry = false;
-		list<TaskScheduler::Entry>::iterator it;
-
-		for(it = TaskScheduler::queue.begin(); it != TaskScheduler::queue.end(); it++) {
-			TaskScheduler::Entry& entry = *it;
-
-			if(entry.pool == this) {
-				work_entry = entry;
-				found_entry = true;
-				TaskScheduler::queue.erase(it);
-				break;
-			}
-		}
-
-		queue_lock.unlock();
+		bool found_entry = TaskScheduler::pool_pop(this, work_entry);
 
 		/* if found task, do it, otherwise wait until other tasks are done */
 		if(found_entry) {
@@ -115,6 +102,8 @@ void TaskPool::wait_work(Summary *stats)
 	if(stats != NULL) {
 		stats->time_total = time_dt() - start_time;
 		stats->num_tasks_handled = num_tasks_handled;
+		stats->num_tasks_stolen = num_tasks_stolen;
+		stats->num_lock_contentions = num_lock_contentions;
 	}
 }
 
@@ -182,11 +171,19 @@ int TaskScheduler::users = 0;
 vector<thread*> TaskScheduler::threads;
 bool TaskScheduler::do_exit = false;
 
-list<TaskScheduler::Entry> TaskScheduler::queue;
+vector<TaskScheduler::ThreadQueue*> TaskScheduler::queues;
+TaskScheduler::ThreadQueue TaskScheduler::front_queue;
+int TaskScheduler::num_queued = 0;
+int TaskScheduler::next_queue = 0;
+
+bool TaskScheduler::use_auto_threads = false;
+bool TaskScheduler::use_numa = false;
+
 thread_mutex TaskScheduler::queue_mutex;
 thread_condition_variable TaskScheduler::queue_cond;
+int TaskScheduler::num_waiting = 0;
 
-void TaskScheduler::init(int num_threads)
+void TaskScheduler::init(int num_threads, bool use_numa)
 {
 	thread_scoped_lock lock(mutex);
 
@@ -195,64 +192,38 @@ void TaskScheduler::init(int num_threads)
 	if(users == 0) {
 		do_exit = false;
 
-		const bool use_auto_threads = (num_threads == 0);
+		use_auto_threads = (num_threads == 0);
 		if(use_auto_threads) {
 			/* automatic number of threads */
 			num_threads = system_cpu_thread_count();
 		}
 		VLOG(1) << "Creating pool of " << num_threads << " threads.";
 
-		/* launch threads that will be waiting for work */
-		threads.resize(num_threads);
-
-		const int num_groups = system_cpu_group_count();
-		unsigned short num_process_groups = 0;
-		vector<unsigned short> process_groups;
-		int current_group_threads = 0;
-		if(num_groups > 1) {
-			process_groups.resize(num_groups);
-			num_process_groups = system_cpu_process_groups(num_groups, 
-			                                               &process_groups[0]);
-			if(num_process_groups == 1) {
-				current_group_threads = system_cpu_group_thread_count(process_groups[0]);
-			}
-		}
-		int thread_index = 0;
-		for(int group = 0; group < num_groups; ++group) {
-			/* NOTE: That's not really efficient from threading point of view,
-			 * but it is simple to read and it doesn't make sense to use more
-			 * user-specified threads than logical threads anyway.
-			 */
-			int num_group_threads = (group == num_groups - 1)
-			        ? (threads.size() - thread_index)
-			        : system_cpu_group_thread_count(group);
-			for(int group_thread = 0;
-				group_thread < num_group_threads && thread_index < threads.size();
-				++group_thread, ++thread_index)
-			{
-				/* NOTE: Thread group of -1 means we would not force thread affinity. */
-				int thread_group;
-				if(num_groups == 1) {
-					/* Use default affinity if there's only one CPU group in the system. */
-					thread_group = -1;
-				}
-				else if(use_auto_threads &&
-				        num_process_groups == 1 &&
-						num_threads <= current_group_threads)
-				{
-					/* If we fit into curent CPU group we also don't force any affinity. */
-					thread_group = -1;
-				}
-				else {
-					thread_group = group;
-				}
-				threads[thread_index] = new thread(function_bind(&TaskScheduler::thread_run,
-				                                                 thread_index + 1),
-				                                   thread_group);
-			}
+		/* every thread gets its own queue */
+		queues.resize(num_threads);
+		for(int i = 0; i < num_threads; ++i) {
+			queues[i] = new ThreadQueue();
 		}
+		num_queued = 0;
+		next_queue = 0;
+
+		TaskScheduler::use_numa = use_numa;
+		threads_create(num_threads);
 	}
-	
+	else if(use_numa != TaskScheduler::use_numa) {
+		/* Threads bind themselves to their NUMA node when they start, so they
+		 * are re-created for the new mode. Queues are kept, the old threads
+		 * finish all queued tasks before they exit. */
+		VLOG(1) << "Re-creating pool of " << threads.size() << " threads "
+		        << (use_numa ? "with" : "without") << " NUMA placement.";
+
+		threads_join();
+		do_exit = false;
+
+		TaskScheduler::use_numa = use_numa;
+		threads_create(queues.size());
+	}
+
 	users++;
 }
 
@@ -263,19 +234,15 @@ void TaskScheduler::exit()
 	users--;
 
 	if(users == 0) {
-		/* stop all waiting threads */
-		TaskScheduler::queue_mutex.lock();
-		do_exit = true;
-		TaskScheduler::queue_cond.notify_all();
-		TaskScheduler::queue_mutex.unlock();
+		threads_join();
 
-		/* delete threads */
-		foreach(thread *t, threads) {
-			t->join();
-			delete t;
+		foreach(ThreadQueue *queue, queues) {
+			assert(queue->entries.empty());
+			delete queue;
 		}
 
-		threads.clear();
+		queues.clear();
+		assert(front_queue.entries.empty());
 	}
 }
 
@@ -283,34 +250,241 @@ void TaskScheduler::free_memory()
 {
 	assert(users == 0);
 	threads.free_memory();
+	queues.free_memory();
 }
 
-bool TaskScheduler::thread_wait_pop(Entry& entry)
+void TaskScheduler::threads_create(int num_threads)
 {
-	thread_scoped_lock queue_lock(queue_mutex);
+	/* threads are bound to NUMA nodes in contiguous blocks, so queues
+	 * of neighbour threads are on the same node. */
+	const int num_numa_nodes = use_numa ? system_cpu_numa_node_count() : 1;
+	if(num_numa_nodes > 1) {
+		VLOG(1) << "Distributing threads over " << num_numa_nodes << " NUMA nodes.";
+	}
 
-	while(queue.empty() && !do_exit)
-		queue_cond.wait(queue_lock);
+	/* launch threads that will be waiting for work */
+	threads.resize(num_threads);
+
+	const int num_groups = system_cpu_group_count();
+	unsigned short num_process_groups = 0;
+	vector<unsigned short> process_groups;
+	int current_group_threads = 0;
+	if(num_groups > 1) {
+		process_groups.resize(num_groups);
+		num_process_groups = system_cpu_process_groups(num_groups,
+		                                               &process_groups[0]);
+		if(num_process_groups == 1) {
+			current_group_threads = system_cpu_group_thread_count(process_groups[0]);
+		}
+	}
+	int thread_index = 0;
+	for(int group = 0; group < num_groups; ++group) {
+		/* NOTE: That's not really efficient from threading point of view,
+		 * but it is simple to read and it doesn't make sense to use more
+		 * user-specified threads than logical threads anyway.
+		 */
+		int num_group_threads = (group == num_groups - 1)
+		        ? (threads.size() - thread_index)
+		        : system_cpu_group_thread_count(group);
+		for(int group_thread = 0;
+			group_thread < num_group_threads && thread_index < threads.size();
+			++group_thread, ++thread_index)
+		{
+			/* NOTE: Thread group of -1 means we would not force thread affinity. */
+			int thread_group;
+			if(num_groups == 1) {
+				/* Use default affinity if there's only one CPU group in the system. */
+				thread_group = -1;
+			}
+			else if(use_auto_threads &&
+			        num_process_groups == 1 &&
+					num_threads <= current_group_threads)
+			{
+				/* If we fit into curent CPU group we also don't force any affinity. */
+				thread_group = -1;
+			}
+			else {
+				thread_group = group;
+			}
+			/* NOTE: NUMA node of -1 means we would not force thread affinity. */
+			const int numa_node = (num_numa_nodes > 1)
+			        ? thread_index * num_numa_nodes / num_threads
+			        : -1;
+			threads[thread_index] = new thread(function_bind(&TaskScheduler::thread_run,
+			                                                 thread_index + 1,
+			                                                 numa_node),
+			                                   thread_group);
+		}
+	}
+}
 
-	if(queue.empty()) {
-		assert(do_exit);
+void TaskScheduler::threads_join()
+{
+	/* stop all waiting threads, they only exit once all queues are empty */
+	TaskScheduler::queue_mutex.lock();
+	do_exit = true;
+	TaskScheduler::queue_cond.notify_all();
+	TaskScheduler::queue_mutex.unlock();
+
+	/* delete threads */
+	foreach(thread *t, threads) {
+		t->join();
+		delete t;
+	}
+
+	threads.clear();
+}
+
+bool TaskScheduler::queue_lock(ThreadQueue *queue)
+{
+	/* returns true if the lock was taken by another thread */
+	if(queue->mutex.try_lock()) {
 		return false;
 	}
-	
-	entry = queue.front();
-	queue.pop_front();
+
+	queue->mutex.lock();
+	return true;
+}
+
+bool TaskScheduler::queue_pop(ThreadQueue *queue, bool front, Entry& entry)
+{
+	if(queue->num_entries == 0) {
+		return false;
+	}
+
+	const bool contended = queue_lock(queue);
+
+	if(queue->entries.empty()) {
+		queue->mutex.unlock();
+		return false;
+	}
+
+	if(front) {
+		entry = queue->entries.front();
+		queue->entries.pop_front();
+	}
+	else {
+		entry = queue->entries.back();
+		queue->entries.pop_back();
+	}
+
+	atomic_sub_and_fetch_int32(&queue->num_entries, 1);
+	atomic_sub_and_fetch_int32(&num_queued, 1);
+
+	queue->mutex.unlock();
+
+	if(UNLIKELY(contended)) {
+		atomic_add_and_fetch_int32(&entry.pool->num_lock_contentions, 1);
+	}
+
+	return true;
+}
+
+bool TaskScheduler::queue_pop_pool(ThreadQueue *queue, TaskPool *pool, Entry& entry)
+{
+	if(queue->num_entries == 0) {
+		return false;
+	}
+
+	if(UNLIKELY(queue_lock(queue))) {
+		atomic_add_and_fetch_int32(&pool->num_lock_contentions, 1);
+	}
+
+	bool found_entry = false;
+
+	list<Entry>::iterator it;
+	for(it = queue->entries.begin(); it != queue->entries.end(); it++) {
+		if(it->pool == pool) {
+			entry = *it;
+			found_entry = true;
+			queue->entries.erase(it);
+			atomic_sub_and_fetch_int32(&queue->num_entries, 1);
+			atomic_sub_and_fetch_int32(&num_queued, 1);
+			break;
+		}
+	}
+
+	queue->mutex.unlock();
+
+	return found_entry;
+}
+
+bool TaskScheduler::thread_pop(int thread_id, Entry& entry)
+{
+	const int num_queues = queues.size();
+	const int own_queue = thread_id - 1;
+
+	/* tasks pushed to the front are taken first by any thread */
+	if(queue_pop(&front_queue, true, entry)) {
+		return true;
+	}
+
+	/* pop from own queue first, then steal from the other queues, starting
+	 * with the neighbours which are likely on the same NUMA node. owner takes
+	 * tasks from the front, thieves take tasks from the back of the queue */
+	for(int i = 0; i < num_queues; ++i) {
+		if(queue_pop(queues[(own_queue + i) % num_queues], i == 0, entry)) {
+			if(i != 0) {
+				atomic_add_and_fetch_int32(&entry.pool->num_tasks_stolen, 1);
+			}
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool TaskScheduler::pool_pop(TaskPool *pool, Entry& entry)
+{
+	if(queue_pop_pool(&front_queue, pool, entry)) {
+		return true;
+	}
+
+	foreach(ThreadQueue *queue, queues) {
+		if(queue_pop_pool(queue, pool, entry)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool TaskScheduler::thread_wait_pop(int thread_id, Entry& entry)
+{
+	while(!thread_pop(thread_id, entry)) {
+		thread_scoped_lock lock(queue_mutex);
+
+		/* pushing threads only notify when someone is waiting, so the waiting
+		 * counter must be increased before checking for queued tasks */
+		atomic_add_and_fetch_int32(&num_waiting, 1);
+		while(num_queued == 0 && !do_exit)
+			queue_cond.wait(lock);
+		atomic_sub_and_fetch_int32(&num_waiting, 1);
+
+		if(num_queued == 0) {
+			assert(do_exit);
+			return false;
+		}
+	}
 
 	return true;
 }
 
-void TaskScheduler::thread_run(int thread_id)
+void TaskScheduler::thread_run(int thread_id, int numa_node)
 {
 	Entry entry;
 
+	if(numa_node != -1) {
+		if(!system_cpu_numa_node_bind_thread(numa_node)) {
+			VLOG(1) << "Failed to bind thread " << thread_id
+			        << " to NUMA node " << numa_node << ".";
+		}
+	}
+
 	/* todo: test affinity/denormal mask */
 
 	/* keep popping off tasks */
-	while(thread_wait_pop(entry)) {
+	while(thread_wait_pop(thread_id, entry)) {
 		/* run task */
 		entry.task->run(thread_id);
 
@@ -326,39 +500,66 @@ void TaskScheduler::push(Entry& entry, bool front)
 {
 	entry.pool->num_increase();
 
+	/* tasks pushed to the front go to the shared queue, the others are
+	 * distributed over the thread queues */
+	ThreadQueue *queue;
+	if(front) {
+		queue = &front_queue;
+	}
+	else {
+		const uint queue_index = (uint)atomic_fetch_and_add_int32(&next_queue, 1);
+		queue = queues[queue_index % queues.size()];
+	}
+
 	/* add entry to queue */
-	TaskScheduler::queue_mutex.lock();
+	if(UNLIKELY(queue_lock(queue))) {
+		atomic_add_and_fetch_int32(&entry.pool->num_lock_contentions, 1);
+	}
 	if(front)
-		TaskScheduler::queue.push_front(entry);
+		queue->entries.push_front(entry);
 	else
-		TaskScheduler::queue.push_back(entry);
+		queue->entries.push_back(entry);
+	atomic_add_and_fetch_int32(&queue->num_entries, 1);
+	atomic_add_and_fetch_int32(&num_queued, 1);
+	queue->mutex.unlock();
 
-	TaskScheduler::queue_cond.notify_one();
-	TaskScheduler::queue_mutex.unlock();
+	/* wake up a sleeping thread */
+	if(num_waiting > 0) {
+		TaskScheduler::queue_mutex.lock();
+		TaskScheduler::queue_cond.notify_one();
+		TaskScheduler::queue_mutex.unlock();
+	}
 }
 
 void TaskScheduler::clear(TaskPool *pool)
 {
-	thread_scoped_lock queue_lock(TaskScheduler::queue_mutex);
-
-	/* erase all tasks from this pool from the queue */
-	list<Entry>::iterator it = queue.begin();
 	int done = 0;
 
-	while(it != queue.end()) {
-		Entry& entry = *it;
+	/* erase all tasks from this pool from the queues */
+	for(int i = -1; i < (int)queues.size(); i++) {
+		ThreadQueue *queue = (i == -1) ? &front_queue : queues[i];
+		thread_scoped_lock lock(queue->mutex);
+
+		list<Entry>::iterator it = queue->entries.begin();
+		int queue_done = 0;
 
-		if(entry.pool == pool) {
-			done++;
-			delete entry.task;
+		while(it != queue->entries.end()) {
+			Entry& entry = *it;
 
-			it = queue.erase(it);
+			if(entry.pool == pool) {
+				queue_done++;
+				delete entry.task;
+
+				it = queue->entries.erase(it);
+			}
+			else
+				it++;
 		}
-		else
-			it++;
-	}
 
-	queue_lock.unlock();
+		atomic_sub_and_fetch_int32(&queue->num_entries, queue_done);
+		atomic_sub_and_fetch_int32(&num_queued, queue_done);
+		done += queue_done;
+	}
 
 	/* notify done */
 	pool->num_decrease(done);
@@ -515,6 +716,8 @@ string TaskPool::Summary::full_report() const
 	string report = "";
 	report += string_printf("Total time:    %f\n", time_total);
 	report += string_printf("Tasks handled: %d\n", num_tasks_handled);
+	report += string_printf("Tasks stolen:  %d\n", num_tasks_stolen);
+	report += string_printf("Contentions:   %d\n", num_lock_contentions);
 	return report;
 }
 
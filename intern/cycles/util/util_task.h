@@ -78,6 +78,16 @@ public:
 		/* Number of all tasks handled by this pool. */
 		int num_tasks_handled;
 
+		/* Number of tasks which were stolen from the queue of another
+		 * thread.
+		 */
+		int num_tasks_stolen;
+
+		/* Number of times a queue lock was already taken by another thread
+		 * when pushing or popping tasks of this pool.
+		 */
+		int num_lock_contentions;
+
 		/* A full multiline description of the state of the pool after
 		 * all work is done.
 		 */
@@ -115,17 +125,28 @@ protected:
 
 	/* Number of all tasks handled by this pool. */
 	int num_tasks_handled;
+
+	/* Number of stolen tasks and lock contentions, updated atomically. */
+	int num_tasks_stolen;
+	int num_lock_contentions;
 };
 
 /* Task Scheduler
- * 
- * Central scheduler that holds running threads ready to execute tasks. A singe
- * queue holds the task from all pools. */
+ *
+ * Central scheduler that holds running threads ready to execute tasks. Every
+ * thread has its own queue holding tasks from all pools, pushed tasks are
+ * distributed over the queues and threads which ran out of work steal tasks
+ * from queues of other threads. Tasks pushed to the front go to a single
+ * shared queue, which all threads check before their own. */
 
 class TaskScheduler
 {
 public:
-	static void init(int num_threads = 0);
+	/* When use_numa is true, worker threads are bound to NUMA nodes in
+	 * contiguous blocks, so neighbour threads steal from each other first.
+	 * If the scheduler is already in use with another NUMA mode, its threads
+	 * are re-created once they finished all queued tasks. */
+	static void init(int num_threads = 0, bool use_numa = false);
 	static void exit();
 	static void free_memory();
 
@@ -143,18 +164,49 @@ protected:
 		TaskPool *pool;
 	};
 
+	/* Queue owned by a worker thread. The owner pops tasks from the front,
+	 * other threads steal from the back. */
+	struct ThreadQueue {
+		ThreadQueue() : num_entries(0) {}
+
+		list<Entry> entries;
+		thread_mutex mutex;
+		/* Size of the list, to skip empty queues without locking. */
+		int num_entries;
+	};
+
 	static thread_mutex mutex;
 	static int users;
 	static vector<thread*> threads;
 	static bool do_exit;
 
-	static list<Entry> queue;
+	static vector<ThreadQueue*> queues;
+	static ThreadQueue front_queue;
+	/* Total number of entries in all queues and round-robin counter used
+	 * to pick queue for pushed tasks. */
+	static int num_queued;
+	static int next_queue;
+
+	/* Settings the threads were created with. */
+	static bool use_auto_threads;
+	static bool use_numa;
+
+	/* Only used to put threads with no work to sleep and wake them up. */
 	static thread_mutex queue_mutex;
 	static thread_condition_variable queue_cond;
+	static int num_waiting;
+
+	static void threads_create(int num_threads);
+	static void threads_join();
 
-	static void thread_run(int thread_id);
-	static bool thread_wait_pop(Entry& entry);
+	static void thread_run(int thread_id, int numa_node);
+	static bool thread_wait_pop(int thread_id, Entry& entry);
+	static bool thread_pop(int thread_id, Entry& entry);
+	static bool pool_pop(TaskPool *pool, Entry& entry);
 
+	static bool queue_lock(ThreadQueue *queue);
+	static bool queue_pop(ThreadQueue *queue, bool front, Entry& entry);
+	static bool queue_pop_pool(ThreadQueue *queue, TaskPool *pool, Entry& entry);
 	static void push(Entry& entry, bool front);
 	static void clear(TaskPool *pool);
 };
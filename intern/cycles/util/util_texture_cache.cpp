@@ -0,0 +1,344 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/util_texture_cache.h"
+
+#include <stdio.h>
+
+#include <OpenImageIO/imagebufalgo.h>
+#include <OpenImageIO/imageio.h>
+#include <OpenImageIO/texture.h>
+
+#include "util/util_foreach.h"
+#include "util/util_logging.h"
+#include "util/util_math.h"
+#include "util/util_md5.h"
+#include "util/util_path.h"
+#include "util/util_time.h"
+
+OIIO_NAMESPACE_USING
+
+CCL_NAMESPACE_BEGIN
+
+/* Tile size used for files which are tiled on the fly or converted. */
+#define TEXTURE_CACHE_TILE_SIZE 64
+
+TextureCache::TextureCache()
+: texture_system(NULL),
+  auto_convert(false),
+  num_images(0)
+{
+}
+
+TextureCache::~TextureCache()
+{
+	if(texture_system) {
+		TextureSystem *ts = (TextureSystem*)texture_system;
+		ts->invalidate_all(true);
+		TextureSystem::destroy(ts);
+	}
+}
+
+void TextureCache::set_options(int max_memory_mb, bool auto_convert_)
+{
+	thread_scoped_lock lock(mutex);
+
+	if(!texture_system) {
+		/* Not shared with OSL, so each has its own memory budget. */
+		TextureSystem *ts = TextureSystem::create(false);
+		ts->attribute("automip", 1);
+		ts->attribute("autotile", TEXTURE_CACHE_TILE_SIZE);
+		texture_system = ts;
+	}
+
+	TextureSystem *ts = (TextureSystem*)texture_system;
+	ts->attribute("max_memory_MB", (float)max_memory_mb);
+	auto_convert = auto_convert_;
+}
+
+string TextureCache::convert_texture(const string& filename)
+{
+	string filepath;
+
+	{
+		/* Images are loaded from multiple threads, while cache directory is
+		 * lazily initialized on first access.
+		 */
+		thread_scoped_lock lock(mutex);
+		MD5Hash md5;
+		md5.append((const uint8_t*)filename.c_str(), filename.size());
+		filepath = path_cache_get(path_join("textures", md5.get_hex() + ".tx"));
+	}
+
+	if(path_exists(filepath) &&
+	   path_modified_time(filepath) >= path_modified_time(filename))
+	{
+		return filepath;
+	}
+
+	/* Write to a temporary file first, so other processes sharing the cache
+	 * never read partially written file.
+	 */
+	const string tmp_filepath = string_printf("%s.%p.%.0f.tmp",
+	                                          filepath.c_str(),
+	                                          (const void*)&filename,
+	                                          time_dt() * 1e6);
+	path_create_directories(tmp_filepath);
+
+	ImageSpec config;
+	config.tile_width = TEXTURE_CACHE_TILE_SIZE;
+	config.tile_height = TEXTURE_CACHE_TILE_SIZE;
+	config.tile_depth = 1;
+	/* Temporary file has no .tx extension, so format has to be explicit. */
+	config.attribute("maketx:fileformatname", "tiff");
+
+	double start_time = time_dt();
+	bool success = ImageBufAlgo::make_texture(ImageBufAlgo::MakeTxTexture,
+	                                          filename,
+	                                          tmp_filepath,
+	                                          config);
+	if(success) {
+		/* Renaming fails when another process already wrote the same file,
+		 * which is fine since its content is identical.
+		 */
+		path_remove(filepath);
+		success = (rename(tmp_filepath.c_str(), filepath.c_str()) == 0);
+	}
+
+	if(!success) {
+		VLOG(1) << "Failed to convert " << filename << " to tiled texture.";
+		path_remove(tmp_filepath);
+		return filename;
+	}
+
+	VLOG(1) << "Converted " << filename << " to tiled texture " << filepath
+	        << " in " << time_dt() - start_time << " seconds.";
+
+	return filepath;
+}
+
+bool TextureCache::add_image(int flat_slot,
+                             const string& filename,
+                             bool use_alpha,
+                             InterpolationType interpolation,
+                             ExtensionType extension)
+{
+	if(!texture_system) {
+		return false;
+	}
+
+	ImageInput *in = ImageInput::create(filename);
+	if(!in) {
+		return false;
+	}
+
+	ImageSpec spec;
+	if(!in->open(filename, spec)) {
+		delete in;
+		return false;
+	}
+
+	const bool is_cmyk = strcmp(in->format_name(), "jpeg") == 0 && spec.nchannels == 4;
+	ImageSpec mip_spec;
+	const bool is_tiled_mipmap = spec.tile_width > 0 && in->seek_subimage(0, 1, mip_spec);
+	in->close();
+	delete in;
+
+	/* Cases which need conversion of the pixels as done when loading the
+	 * image as a whole, the texture system can't do it on the fly.
+	 * Unassociated alpha of the file is only kept when loading the image. */
+	if(spec.depth > 1 || is_cmyk || spec.nchannels < 1) {
+		return false;
+	}
+	const int channels = min(spec.nchannels, 4);
+	if(!use_alpha && (channels == 2 || channels == 4)) {
+		return false;
+	}
+
+	string texture_filename = filename;
+	if(auto_convert && !is_tiled_mipmap) {
+		texture_filename = convert_texture(filename);
+	}
+
+	TextureSystem *ts = (TextureSystem*)texture_system;
+	TextureSystem::TextureHandle *handle = ts->get_texture_handle(ustring(texture_filename));
+	if(!handle) {
+		return false;
+	}
+
+	thread_scoped_lock lock(mutex);
+
+	if((size_t)flat_slot >= slots.size()) {
+		slots.resize(flat_slot + 128);
+	}
+
+	Slot& slot = slots[flat_slot];
+	slot.filename = texture_filename;
+	slot.handle = handle;
+	slot.channels = channels;
+	slot.interpolation = interpolation;
+	slot.extension = extension;
+	num_images++;
+
+	return true;
+}
+
+void TextureCache::remove_image(int flat_slot)
+{
+	thread_scoped_lock lock(mutex);
+
+	if(!is_cached(flat_slot)) {
+		return;
+	}
+
+	const string filename = slots[flat_slot].filename;
+	slots[flat_slot] = Slot();
+	num_images--;
+
+	/* Tiles belong to the file, which may be used by other slots with
+	 * different settings. Only drop them once the last slot is removed,
+	 * so the file is read again if it was modified. */
+	foreach(const Slot& slot, slots) {
+		if(slot.handle != NULL && slot.filename == filename) {
+			return;
+		}
+	}
+
+	TextureSystem *ts = (TextureSystem*)texture_system;
+	ts->invalidate(ustring(filename));
+}
+
+void *TextureCache::thread_info() const
+{
+	if(!texture_system) {
+		return NULL;
+	}
+
+	TextureSystem *ts = (TextureSystem*)texture_system;
+	return ts->get_perthread_info();
+}
+
+float4 TextureCache::lookup(void *thread_info, int flat_slot, float x, float y) const
+{
+	const Slot& slot = slots[flat_slot];
+	TextureSystem *ts = (TextureSystem*)texture_system;
+
+	TextureOpt opt;
+	switch(slot.interpolation) {
+		case INTERPOLATION_CLOSEST:
+			opt.interpmode = TextureOpt::InterpClosest;
+			break;
+		case INTERPOLATION_CUBIC:
+			opt.interpmode = TextureOpt::InterpBicubic;
+			break;
+		case INTERPOLATION_SMART:
+			opt.interpmode = TextureOpt::InterpSmartBicubic;
+			break;
+		default:
+			opt.interpmode = TextureOpt::InterpBilinear;
+			break;
+	}
+	switch(slot.extension) {
+		case EXTENSION_EXTEND:
+			opt.swrap = opt.twrap = TextureOpt::WrapClamp;
+			break;
+		case EXTENSION_CLIP:
+			opt.swrap = opt.twrap = TextureOpt::WrapBlack;
+			break;
+		default:
+			opt.swrap = opt.twrap = TextureOpt::WrapPeriodic;
+			break;
+	}
+
+	/* Without texture coordinate differentials the finest level is used,
+	 * only tiles covering the looked up area are read. Images are stored
+	 * bottom to top, while texture system has the first scanline at t = 0.
+	 */
+	float result[4];
+	if(!ts->texture((TextureSystem::TextureHandle*)slot.handle,
+	                (TextureSystem::Perthread*)thread_info,
+	                opt,
+	                x, 1.0f - y, 0.0f, 0.0f, 0.0f, 0.0f,
+	                slot.channels, result))
+	{
+		return make_float4(TEX_IMAGE_MISSING_R,
+		                   TEX_IMAGE_MISSING_G,
+		                   TEX_IMAGE_MISSING_B,
+		                   TEX_IMAGE_MISSING_A);
+	}
+
+	float4 r;
+	switch(slot.channels) {
+		case 1:
+			r = make_float4(result[0], result[0], result[0], 1.0f);
+			break;
+		case 2:
+			r = make_float4(result[0], result[0], result[0], result[1]);
+			break;
+		case 3:
+			r = make_float4(result[0], result[1], result[2], 1.0f);
+			break;
+		default:
+			r = make_float4(result[0], result[1], result[2], result[3]);
+			break;
+	}
+
+	/* Same as for loaded images, avoid artifacts from non-finite pixels. */
+	if(!isfinite_safe(r.x) || !isfinite_safe(r.y) || !isfinite_safe(r.z) || !isfinite_safe(r.w)) {
+		return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+	}
+
+	return r;
+}
+
+string TextureCache::stats() const
+{
+	if(!texture_system || num_images == 0) {
+		return "";
+	}
+
+	TextureSystem *ts = (TextureSystem*)texture_system;
+	long long find_tile_calls = 0, bytes_read = 0, memory_used = 0;
+	int tiles_created = 0, tiles_peak = 0;
+	float max_memory_mb = 0.0f;
+
+	ts->getattribute("stat:find_tile_calls", TypeDesc::INT64, &find_tile_calls);
+	ts->getattribute("stat:bytes_read", TypeDesc::INT64, &bytes_read);
+	ts->getattribute("stat:cache_memory_used", TypeDesc::INT64, &memory_used);
+	ts->getattribute("stat:tiles_created", TypeDesc::INT, &tiles_created);
+	ts->getattribute("stat:tiles_peak", TypeDesc::INT, &tiles_peak);
+	ts->getattribute("max_memory_MB", TypeDesc::FLOAT, &max_memory_mb);
+
+	/* Every tile which had to be read from file is a miss. */
+	const long long misses = tiles_created;
+	const long long hits = (find_tile_calls > misses)? find_tile_calls - misses: 0;
+
+	return string_printf("  Images: %d\n"
+	                     "  Hits: %lld\n"
+	                     "  Misses: %lld\n"
+	                     "  Bytes read: %s\n"
+	                     "  Tiles peak: %d\n"
+	                     "  Memory: %s (budget %s)",
+	                     num_images,
+	                     hits,
+	                     misses,
+	                     string_human_readable_size(bytes_read).c_str(),
+	                     tiles_peak,
+	                     string_human_readable_size(memory_used).c_str(),
+	                     string_human_readable_size((size_t)max_memory_mb * 1024 * 1024).c_str());
+}
+
+CCL_NAMESPACE_END
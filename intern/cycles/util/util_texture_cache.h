@@ -0,0 +1,98 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UTIL_TEXTURE_CACHE_H__
+#define __UTIL_TEXTURE_CACHE_H__
+
+#include "util/util_string.h"
+#include "util/util_texture.h"
+#include "util/util_thread.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Texture Cache
+ *
+ * Image textures which are not loaded into memory as a whole, but read on
+ * demand in tiles through the OpenImageIO texture system. Tiles are kept in
+ * memory up to the configured budget, least recently used tiles are evicted
+ * first. Files which are not tiled and mipmapped already are tiled on the fly,
+ * or optionally converted to tiled mipmapped .tx files in the cache directory.
+ *
+ * Only used by the CPU device, images are registered by their flattened slot
+ * and looked up from the kernel instead of the regular image textures. */
+
+class TextureCache {
+public:
+	TextureCache();
+	~TextureCache();
+
+	/* Memory budget for tiles in megabytes, and whether to convert files
+	 * to tiled mipmapped textures before rendering. */
+	void set_options(int max_memory_mb, bool auto_convert);
+
+	/* Register image file for the given flattened slot, returns false if
+	 * the file can not be read from the cache, in which case the image
+	 * must be loaded as regular texture. */
+	bool add_image(int flat_slot,
+	               const string& filename,
+	               bool use_alpha,
+	               InterpolationType interpolation,
+	               ExtensionType extension);
+	void remove_image(int flat_slot);
+
+	bool is_cached(int flat_slot) const
+	{
+		return (size_t)flat_slot < slots.size() && slots[flat_slot].handle != NULL;
+	}
+
+	/* Texture system data of the calling thread, to be passed to lookup()
+	 * from that thread. Owned by the texture system, NULL if no image can be
+	 * cached. */
+	void *thread_info() const;
+
+	/* Filtered lookup at the given texture coordinate, same conventions as
+	 * for the regular image textures. */
+	float4 lookup(void *thread_info, int flat_slot, float x, float y) const;
+
+	/* Human readable statistics: hits, misses, bytes read and memory usage. */
+	string stats() const;
+
+protected:
+	struct Slot {
+		Slot() : handle(NULL), channels(0), interpolation(0), extension(0) {}
+
+		string filename;
+		void *handle;
+		int channels;
+		int interpolation;
+		int extension;
+	};
+
+	string convert_texture(const string& filename);
+
+	/* OIIO::TextureSystem, created on first use. */
+	void *texture_system;
+	vector<Slot> slots;
+	thread_mutex mutex;
+	bool auto_convert;
+	int num_images;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __UTIL_TEXTURE_CACHE_H__ */
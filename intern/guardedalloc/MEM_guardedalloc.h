@@ -206,6 +206,14 @@ extern const char *(*MEM_name_ptr)(void *vmemh);
 /* Switch allocator to slower but fully guarded mode. */
 void MEM_use_guarded_allocator(void);
 
+/* Cache small blocks per thread (lock-free allocator only), and gather statistics by size,
+ * printed by #MEM_printmemlist_stats. Can be used at any time. */
+void MEM_use_thread_cache(void);
+
+/* Give the blocks cached by the calling thread back, for threads which are about to end.
+ * Only needed where thread exit can't do it automatically (no pthread TLS destructors). */
+void MEM_thread_cache_release(void);
+
 #ifdef __cplusplus
 /* alloc funcs for C++ only */
 #define MEM_CXX_CLASS_ALLOC_FUNCS(_id)                                        \
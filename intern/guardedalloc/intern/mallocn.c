@@ -128,3 +128,18 @@ void MEM_use_guarded_allocator(void)
 	MEM_name_ptr = MEM_guarded_name_ptr;
 #endif
 }
+
+void MEM_use_thread_cache(void)
+{
+	/* The guarded allocator keeps track of all blocks, nothing to gain there. */
+	if (MEM_mallocN == MEM_lockfree_mallocN) {
+		MEM_lockfree_use_thread_cache();
+	}
+}
+
+void MEM_thread_cache_release(void)
+{
+	if (MEM_mallocN == MEM_lockfree_mallocN) {
+		MEM_lockfree_thread_cache_release();
+	}
+}
@@ -54,6 +54,7 @@ typedef struct MemHeadAligned {
 static unsigned int totblock = 0;
 static size_t mem_in_use = 0, mmap_in_use = 0, peak_mem = 0;
 static bool malloc_debug_memset = false;
+static bool use_thread_cache = false;
 
 static void (*error_callback)(const char *) = NULL;
 static void (*thread_lock_callback)(void) = NULL;
@@ -63,12 +64,16 @@ enum {
 	MEMHEAD_MMAP_FLAG = 1,
 	MEMHEAD_ALIGN_FLAG = 2,
 };
+/* Block of a size class, see #MEM_lockfree_use_thread_cache (lengths never get that big). */
+#define MEMHEAD_CACHE_FLAG ((size_t)1 << (sizeof(size_t) * 8 - 1))
+#define MEMHEAD_FLAGS ((size_t)(MEMHEAD_MMAP_FLAG | MEMHEAD_ALIGN_FLAG) | MEMHEAD_CACHE_FLAG)
 
 #define MEMHEAD_FROM_PTR(ptr) (((MemHead*) ptr) - 1)
 #define PTR_FROM_MEMHEAD(memhead) (memhead + 1)
 #define MEMHEAD_ALIGNED_FROM_PTR(ptr) (((MemHeadAligned*) ptr) - 1)
 #define MEMHEAD_IS_MMAP(memhead) ((memhead)->len & (size_t) MEMHEAD_MMAP_FLAG)
 #define MEMHEAD_IS_ALIGNED(memhead) ((memhead)->len & (size_t) MEMHEAD_ALIGN_FLAG)
+#define MEMHEAD_IS_CACHED(memhead) ((memhead)->len & MEMHEAD_CACHE_FLAG)
 
 /* Uncomment this to have proper peak counter. */
 #define USE_ATOMIC_MAX
@@ -114,10 +119,295 @@ static void mem_unlock_thread(void)
 }
 #endif
 
+/* -------------------------------------------------------------------- */
+/* Thread Cache
+ *
+ * Optional cache of small blocks, to avoid contention on the system allocator
+ * from highly threaded code allocating and freeing many small blocks.
+ *
+ * Blocks are rounded up to size classes, freed blocks go to a free list of the
+ * thread freeing them, which the next allocations of that thread reuse.
+ * Threads with too many free blocks move a batch to a shared list of the size class,
+ * which threads refill from, and which returns blocks to the system past a limit.
+ *
+ * Cached blocks are regular system allocations of the size class,
+ * so they can always be freed to the system directly.
+ */
+
+#define MEM_CACHE_CLASS_STEP 16
+#define MEM_CACHE_CLASSES 32
+/* Largest block (including #MemHead) served by the cache. */
+#define MEM_CACHE_BLOCK_MAX (MEM_CACHE_CLASS_STEP * MEM_CACHE_CLASSES)
+/* Number of blocks moved at once between thread and shared lists. */
+#define MEM_CACHE_BATCH 32
+/* Free blocks kept in the shared list of a size class, above that they return to the system. */
+#define MEM_CACHE_SHARED_MAX 4096
+
+/* Power of two buckets of larger allocations, for statistics. */
+#define MEM_STATS_LARGE_BUCKETS 32
+
+#if defined(_MSC_VER)
+#  define MEM_THREAD_LOCAL __declspec(thread)
+#else
+#  define MEM_THREAD_LOCAL __thread
+#  define USE_THREAD_CACHE_DESTRUCTOR
+#  include <pthread.h>
+#endif
+
+typedef struct MemCacheBlock {
+	struct MemCacheBlock *next;
+} MemCacheBlock;
+
+typedef struct MemCacheStats {
+	/* Allocations of the size class. */
+	size_t num_alloc;
+	/* Allocations served from a free list. */
+	size_t num_reuse;
+} MemCacheStats;
+
+typedef struct MemCacheShared {
+	uint32_t lock;
+	unsigned int count;
+	MemCacheBlock *first;
+	MemCacheStats stats;
+	/* Avoid false sharing between size classes. */
+	char _pad[64 - sizeof(uint32_t) - sizeof(unsigned int) - sizeof(MemCacheBlock *) - sizeof(MemCacheStats)];
+} MemCacheShared;
+
+typedef struct MemThreadCache {
+	MemCacheBlock *first[MEM_CACHE_CLASSES];
+	unsigned int count[MEM_CACHE_CLASSES];
+	/* Flushed into the shared statistics when blocks move to the shared list. */
+	MemCacheStats stats[MEM_CACHE_CLASSES];
+	bool is_registered;
+} MemThreadCache;
+
+static MemCacheShared cache_shared[MEM_CACHE_CLASSES];
+static size_t stats_large_num_alloc[MEM_STATS_LARGE_BUCKETS];
+static MEM_THREAD_LOCAL MemThreadCache thread_cache;
+
+#ifdef USE_THREAD_CACHE_DESTRUCTOR
+static pthread_key_t thread_cache_key;
+#endif
+
+MEM_INLINE unsigned int mem_cache_class(size_t len)
+{
+	return (unsigned int)((len + sizeof(MemHead) - 1) / MEM_CACHE_CLASS_STEP);
+}
+
+MEM_INLINE size_t mem_cache_class_block_size(unsigned int c)
+{
+	return (size_t)(c + 1) * MEM_CACHE_CLASS_STEP;
+}
+
+static void mem_cache_shared_lock(MemCacheShared *shared)
+{
+	while (atomic_cas_uint32(&shared->lock, 0, 1) != 0) {
+		/* spin */
+	}
+}
+
+static void mem_cache_shared_unlock(MemCacheShared *shared)
+{
+	atomic_cas_uint32(&shared->lock, 1, 0);
+}
+
+static void mem_cache_stats_flush(MemThreadCache *cache, unsigned int c)
+{
+	atomic_add_and_fetch_z(&cache_shared[c].stats.num_alloc, cache->stats[c].num_alloc);
+	atomic_add_and_fetch_z(&cache_shared[c].stats.num_reuse, cache->stats[c].num_reuse);
+	cache->stats[c].num_alloc = 0;
+	cache->stats[c].num_reuse = 0;
+}
+
+/* Move up to \a num blocks of the thread list to the shared list, or back to the system. */
+static void mem_cache_release(MemThreadCache *cache, unsigned int c, unsigned int num)
+{
+	MemCacheShared *shared = &cache_shared[c];
+	MemCacheBlock *first = cache->first[c], *last = NULL, *block;
+	unsigned int i;
+
+	if (first == NULL) {
+		return;
+	}
+
+	for (block = first, i = 0; block && i < num; block = block->next, i++) {
+		last = block;
+	}
+	cache->first[c] = last->next;
+	cache->count[c] -= i;
+
+	mem_cache_shared_lock(shared);
+	if (shared->count + i <= MEM_CACHE_SHARED_MAX) {
+		last->next = shared->first;
+		shared->first = first;
+		shared->count += i;
+		first = NULL;
+	}
+	mem_cache_shared_unlock(shared);
+
+	/* Shared list is full. */
+	while (first) {
+		block = first;
+		first = first->next;
+		free(block);
+	}
+
+	mem_cache_stats_flush(cache, c);
+}
+
+static void mem_cache_release_all(MemThreadCache *cache)
+{
+	unsigned int c;
+
+	for (c = 0; c < MEM_CACHE_CLASSES; c++) {
+		if (cache->first[c]) {
+			mem_cache_release(cache, c, cache->count[c]);
+		}
+		else {
+			mem_cache_stats_flush(cache, c);
+		}
+	}
+}
+
+#ifdef USE_THREAD_CACHE_DESTRUCTOR
+static void mem_cache_thread_exit(void *data)
+{
+	mem_cache_release_all(data);
+}
+#endif
+
+MEM_INLINE MemThreadCache *mem_cache_thread_get(void)
+{
+	MemThreadCache *cache = &thread_cache;
+
+#ifdef USE_THREAD_CACHE_DESTRUCTOR
+	if (UNLIKELY(!cache->is_registered)) {
+		/* Give the blocks back when the thread ends. Without pthread TLS destructors (MSVC)
+		 * threads have to call #MEM_thread_cache_release themselves. */
+		pthread_setspecific(thread_cache_key, cache);
+		cache->is_registered = true;
+	}
+#endif
+
+	return cache;
+}
+
+static MemHead *mem_cache_alloc(size_t len)
+{
+	MemThreadCache *cache = mem_cache_thread_get();
+	const unsigned int c = mem_cache_class(len);
+	MemCacheBlock *block;
+
+	cache->stats[c].num_alloc++;
+
+	if (cache->first[c] == NULL) {
+		MemCacheShared *shared = &cache_shared[c];
+
+		/* Refill a batch from the shared list, avoid locking when it's empty. */
+		if (shared->count != 0) {
+			MemCacheBlock *last = NULL;
+			unsigned int i = 0;
+
+			mem_cache_shared_lock(shared);
+			for (block = shared->first; block && i < MEM_CACHE_BATCH; block = block->next, i++) {
+				last = block;
+			}
+			if (last) {
+				cache->first[c] = shared->first;
+				shared->first = last->next;
+				shared->count -= i;
+				last->next = NULL;
+				cache->count[c] = i;
+			}
+			mem_cache_shared_unlock(shared);
+		}
+
+		if (cache->first[c] == NULL) {
+			return malloc(mem_cache_class_block_size(c));
+		}
+	}
+
+	block = cache->first[c];
+	cache->first[c] = block->next;
+	cache->count[c]--;
+	cache->stats[c].num_reuse++;
+
+	return (MemHead *)block;
+}
+
+static void mem_cache_free(MemHead *memh, size_t len)
+{
+	MemThreadCache *cache = mem_cache_thread_get();
+	const unsigned int c = mem_cache_class(len);
+	MemCacheBlock *block = (MemCacheBlock *)memh;
+
+	block->next = cache->first[c];
+	cache->first[c] = block;
+	cache->count[c]++;
+
+	if (UNLIKELY(cache->count[c] > MEM_CACHE_BATCH * 2)) {
+		mem_cache_release(cache, c, MEM_CACHE_BATCH);
+	}
+}
+
+MEM_INLINE void mem_stats_large_alloc(size_t len)
+{
+	unsigned int bucket = 0;
+
+	if (!use_thread_cache) {
+		return;
+	}
+	while ((len >>= 1) != 0 && bucket < MEM_STATS_LARGE_BUCKETS - 1) {
+		bucket++;
+	}
+	atomic_add_and_fetch_z(&stats_large_num_alloc[bucket], 1);
+}
+
+static void mem_cache_print_stats(void)
+{
+	MemThreadCache *cache = &thread_cache;
+	size_t shared_mem = 0;
+	unsigned int c, bucket;
+	char num_str[32], size_str[32];
+
+	printf("\nallocations by size class (thread cache):\n");
+	printf("%10s %14s %14s %10s\n", "block", "allocations", "reused", "shared");
+	for (c = 0; c < MEM_CACHE_CLASSES; c++) {
+		/* Statistics of other threads are only up to date since their last release. */
+		const size_t num_alloc = cache_shared[c].stats.num_alloc + cache->stats[c].num_alloc;
+		const size_t num_reuse = cache_shared[c].stats.num_reuse + cache->stats[c].num_reuse;
+
+		shared_mem += cache_shared[c].count * mem_cache_class_block_size(c);
+		if (num_alloc == 0) {
+			continue;
+		}
+		snprintf(num_str, sizeof(num_str), SIZET_FORMAT, SIZET_ARG(num_alloc));
+		printf("%10u %14s %13.1f%% %10u\n",
+		       (unsigned int)mem_cache_class_block_size(c), num_str,
+		       100.0 * (double)num_reuse / (double)num_alloc, cache_shared[c].count);
+	}
+
+	printf("\nlarger allocations:\n");
+	printf("%10s %14s\n", "size", "allocations");
+	for (bucket = 0; bucket < MEM_STATS_LARGE_BUCKETS; bucket++) {
+		if (stats_large_num_alloc[bucket] == 0) {
+			continue;
+		}
+		snprintf(size_str, sizeof(size_str), SIZET_FORMAT "K", SIZET_ARG(((size_t)1 << bucket) >> 10));
+		snprintf(num_str, sizeof(num_str), SIZET_FORMAT, SIZET_ARG(stats_large_num_alloc[bucket]));
+		printf("%10s %14s\n", size_str, num_str);
+	}
+
+	printf("\nfree blocks in shared lists: %.3f MB\n", (double)shared_mem / (double)(1024 * 1024));
+}
+
+/* -------------------------------------------------------------------- */
+
 size_t MEM_lockfree_allocN_len(const void *vmemh)
 {
 	if (vmemh) {
-		return MEMHEAD_FROM_PTR(vmemh)->len & ~((size_t) (MEMHEAD_MMAP_FLAG | MEMHEAD_ALIGN_FLAG));
+		return MEMHEAD_FROM_PTR(vmemh)->len & ~MEMHEAD_FLAGS;
 	}
 	else {
 		return 0;
@@ -160,6 +450,9 @@ void MEM_lockfree_freeN(void *vmemh)
 			MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
 			aligned_free(MEMHEAD_REAL_PTR(memh_aligned));
 		}
+		else if (MEMHEAD_IS_CACHED(memh)) {
+			mem_cache_free(memh, len);
+		}
 		else {
 			free(memh);
 		}
@@ -276,12 +569,24 @@ void *MEM_lockfree_callocN(size_t len, const char *str)
 {
 	MemHead *memh;
 
+	size_t cache_flag = 0;
+
 	len = SIZET_ALIGN_4(len);
 
-	memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+	if (use_thread_cache && (len + sizeof(MemHead) <= MEM_CACHE_BLOCK_MAX)) {
+		memh = mem_cache_alloc(len);
+		if (LIKELY(memh)) {
+			memset(memh + 1, 0, len);
+		}
+		cache_flag = MEMHEAD_CACHE_FLAG;
+	}
+	else {
+		mem_stats_large_alloc(len);
+		memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+	}
 
 	if (LIKELY(memh)) {
-		memh->len = len;
+		memh->len = len | cache_flag;
 		atomic_add_and_fetch_u(&totblock, 1);
 		atomic_add_and_fetch_z(&mem_in_use, len);
 		update_maximum(&peak_mem, mem_in_use);
@@ -297,16 +602,25 @@ void *MEM_lockfree_mallocN(size_t len, const char *str)
 {
 	MemHead *memh;
 
+	size_t cache_flag = 0;
+
 	len = SIZET_ALIGN_4(len);
 
-	memh = (MemHead *)malloc(len + sizeof(MemHead));
+	if (use_thread_cache && (len + sizeof(MemHead) <= MEM_CACHE_BLOCK_MAX)) {
+		memh = mem_cache_alloc(len);
+		cache_flag = MEMHEAD_CACHE_FLAG;
+	}
+	else {
+		mem_stats_large_alloc(len);
+		memh = (MemHead *)malloc(len + sizeof(MemHead));
+	}
 
 	if (LIKELY(memh)) {
 		if (UNLIKELY(malloc_debug_memset && len)) {
 			memset(memh + 1, 255, len);
 		}
 
-		memh->len = len;
+		memh->len = len | cache_flag;
 		atomic_add_and_fetch_u(&totblock, 1);
 		atomic_add_and_fetch_z(&mem_in_use, len);
 		update_maximum(&peak_mem, mem_in_use);
@@ -426,6 +740,9 @@ void MEM_lockfree_printmemlist_stats(void)
 	       (double)mem_in_use / (double)(1024 * 1024));
 	printf("peak memory len: %.3f MB\n",
 	       (double)peak_mem / (double)(1024 * 1024));
+	if (use_thread_cache) {
+		mem_cache_print_stats();
+	}
 	printf("\nFor more detailed per-block statistics run Blender with memory debugging command line argument.\n");
 
 #ifdef HAVE_MALLOC_STATS
@@ -455,6 +772,24 @@ void MEM_lockfree_set_memory_debug(void)
 	malloc_debug_memset = true;
 }
 
+void MEM_lockfree_use_thread_cache(void)
+{
+	if (use_thread_cache) {
+		return;
+	}
+#ifdef USE_THREAD_CACHE_DESTRUCTOR
+	pthread_key_create(&thread_cache_key, mem_cache_thread_exit);
+#endif
+	use_thread_cache = true;
+}
+
+void MEM_lockfree_thread_cache_release(void)
+{
+	if (use_thread_cache) {
+		mem_cache_release_all(&thread_cache);
+	}
+}
+
 size_t MEM_lockfree_get_memory_in_use(void)
 {
 	return mem_in_use;
@@ -101,6 +101,7 @@ void *mmap(void *UNUSED(start), size_t len, int prot, int flags, int fd, off_t o
 	int access_flags = mmap_get_access_flags(prot);
 	MemMap *mm = NULL;
 	void *ptr = NULL;
+	unsigned __int64 map_size;
 
 	if (flags & MAP_FIXED) {
 		return MAP_FAILED;
@@ -129,14 +130,29 @@ void *mmap(void *UNUSED(start), size_t len, int prot, int flags, int fd, off_t o
 		}
 	}
 
-	/* note len is passed to a 32 bit DWORD, so can't be > 4 GB */
-	maphandle = CreateFileMapping(fhandle, NULL, prot_flags, 0, len, NULL);
+	/* Private writable mappings of a file are copy-on-write, writes must not
+	 * reach the file, which may also be opened read-only. */
+	if ((flags & MAP_PRIVATE) && (prot & PROT_WRITE) && fhandle != INVALID_HANDLE_VALUE) {
+		prot_flags = (prot & PROT_EXEC) ? PAGE_EXECUTE_WRITECOPY : PAGE_WRITECOPY;
+		access_flags = FILE_MAP_COPY | ((prot & PROT_EXEC) ? FILE_MAP_EXECUTE : 0);
+	}
+
+	/* sizes and offset are passed as pairs of 32 bit DWORD, the mapping has to
+	 * include the range before the offset */
+	map_size = (unsigned __int64)offset + (unsigned __int64)len;
+	maphandle = CreateFileMapping(fhandle, NULL, prot_flags,
+	                              (DWORD)(map_size >> 32),
+	                              (DWORD)(map_size & 0xFFFFFFFF),
+	                              NULL);
 	if (maphandle == 0) {
 		errno = EBADF;
 		return MAP_FAILED;
 	}
 
-	ptr = MapViewOfFile(maphandle, access_flags, 0, offset, 0);
+	ptr = MapViewOfFile(maphandle, access_flags,
+	                    (DWORD)((unsigned __int64)offset >> 32),
+	                    (DWORD)((unsigned __int64)offset & 0xFFFFFFFF),
+	                    len);
 	if (ptr == NULL) {
 		DWORD dwLastErr = GetLastError();
 		if (dwLastErr == ERROR_MAPPED_ALIGNMENT)
@@ -45,6 +45,7 @@ extern const char   *BKE_undo_get_name(int nr, bool *r_active);
 extern const char   *BKE_undo_get_name_last(void);
 extern bool          BKE_undo_save_file(const char *filename);
 extern struct Main  *BKE_undo_get_main(struct Scene **r_scene);
+extern void          BKE_undo_memory_stats(int *r_steps, size_t *r_mem_used, size_t *r_mem_shared);
 
 extern void          BKE_undo_callback_wm_kill_jobs_set(void (*callback)(struct bContext *C));
 
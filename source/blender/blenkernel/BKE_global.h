@@ -129,10 +129,12 @@ enum {
 	G_DEBUG_GPU =        (1 << 12), /* gpu debug */
 	G_DEBUG_IO = (1 << 13),   /* IO Debugging (for Collada, ...)*/
 	G_DEBUG_GPU_SHADERS = (1 << 14),   /* GLSL shaders */
+	G_DEBUG_FILELOAD = (1 << 15),   /* .blend file loading time profiling */
 };
 
 #define G_DEBUG_ALL  (G_DEBUG | G_DEBUG_FFMPEG | G_DEBUG_PYTHON | G_DEBUG_EVENTS | G_DEBUG_WM | G_DEBUG_JOBS | \
-                      G_DEBUG_FREESTYLE | G_DEBUG_DEPSGRAPH | G_DEBUG_GPU_MEM | G_DEBUG_IO | G_DEBUG_GPU_SHADERS)
+                      G_DEBUG_FREESTYLE | G_DEBUG_DEPSGRAPH | G_DEBUG_GPU_MEM | G_DEBUG_IO | G_DEBUG_GPU_SHADERS | \
+                      G_DEBUG_FILELOAD)
 
 
 /* G.fileflags */
@@ -179,6 +181,8 @@ enum {
 /* On write, restore paths after editing them (G_FILE_RELATIVE_REMAP) */
 #define G_FILE_SAVE_COPY         (1 << 27)
 #define G_FILE_GLSL_NO_ENV_LIGHTING (1 << 28)
+/* On write, with G_FILE_COMPRESS, use fast LZO compression instead of gzip */
+#define G_FILE_COMPRESS_FAST     (1 << 29)
 
 #define G_FILE_FLAGS_RUNTIME (G_FILE_NO_UI | G_FILE_RELATIVE_REMAP | G_FILE_MESH_COMPAT | G_FILE_SAVE_COPY)
 
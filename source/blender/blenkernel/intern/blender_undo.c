@@ -386,6 +386,24 @@ bool BKE_undo_save_file(const char *filename)
 	return true;
 }
 
+/**
+ * Memory statistics of the undo steps.
+ *
+ * \param r_mem_used: Memory used by the steps, chunks shared between steps are counted once.
+ * \param r_mem_shared: Memory saved by sharing identical chunks.
+ */
+void BKE_undo_memory_stats(int *r_steps, size_t *r_mem_used, size_t *r_mem_shared)
+{
+	MemFileStats stats;
+
+	/* includes the snapshot of a save in progress, which is short lived */
+	BLO_memfile_stats(&stats);
+
+	*r_steps = BLI_listbase_count(&undobase);
+	*r_mem_used = stats.size_stored;
+	*r_mem_shared = stats.size_logical - stats.size_stored;
+}
+
 /* sets curscene */
 Main *BKE_undo_get_main(Scene **r_scene)
 {
@@ -38,9 +38,12 @@
 #include "BLI_sys_types.h"
 
 #include "BLI_utildefines.h"
+#include "BLI_concurrent_ghash.h"
 #include "BLI_edgehash.h"
 #include "BLI_math_base.h"
 #include "BLI_math_vector.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "BKE_deform.h"
 #include "BKE_DerivedMesh.h"
@@ -1364,101 +1367,257 @@ void BKE_mesh_calc_edges_legacy(Mesh *me, const bool use_old)
 }
 
 
-/**
- * Calculate edges from polygons
- *
- * \param mesh  The mesh to add edges into
- * \param update  When true create new edges co-exist
- */
-void BKE_mesh_calc_edges(Mesh *mesh, bool update, const bool select)
+/* Edge of a loop (or of an existing edge), vertices are sorted so both directions match. */
+typedef struct MeshCalcEdgeKey {
+	unsigned int v1, v2;
+	/* Index in the final edges array, only set on the keys stored in the hash. */
+	int edge_index;
+	/* Key stored in the hash for this edge (may be this key), NULL for degenerate loops. */
+	struct MeshCalcEdgeKey *key_stored;
+} MeshCalcEdgeKey;
+
+static unsigned int mesh_calc_edges_key_hash(const void *key)
+{
+	const MeshCalcEdgeKey *ek = key;
+	return BLI_ghashutil_uinthash((ek->v1 * 65) ^ (ek->v2 * 31));
+}
+
+static bool mesh_calc_edges_key_cmp(const void *a, const void *b)
+{
+	const MeshCalcEdgeKey *ek_a = a, *ek_b = b;
+	return (ek_a->v1 != ek_b->v1) || (ek_a->v2 != ek_b->v2);
+}
+
+BLI_INLINE void mesh_calc_edges_key_init(MeshCalcEdgeKey *ek, const unsigned int v1, const unsigned int v2)
+{
+	if (v1 < v2) {
+		ek->v1 = v1;
+		ek->v2 = v2;
+	}
+	else {
+		ek->v1 = v2;
+		ek->v2 = v1;
+	}
+	ek->edge_index = -1;
+	ek->key_stored = NULL;
+}
+
+typedef struct MeshCalcEdgesData {
+	const MPoly *mpoly;
+	const MLoop *mloop;
+	MeshCalcEdgeKey *loop_keys;
+	ConcurrentGHash *cgh;
+} MeshCalcEdgesData;
+
+static void mesh_calc_edges_insert_task_cb(void *userdata, const int index)
+{
+	MeshCalcEdgesData *data = userdata;
+	const MPoly *mp = &data->mpoly[index];
+	const MLoop *ml = &data->mloop[mp->loopstart];
+	MeshCalcEdgeKey *ek = &data->loop_keys[mp->loopstart];
+
+	/* The edge from a loop to the next one is the edge of that loop. */
+	for (int j = 0; j < mp->totloop; j++, ek++) {
+		const unsigned int v_next = ml[(j + 1 == mp->totloop) ? 0 : j + 1].v;
+
+		mesh_calc_edges_key_init(ek, ml[j].v, v_next);
+		if (ml[j].v != v_next) {
+			void *val;
+			BLI_concurrent_ghash_insert_or_lookup(data->cgh, ek, ek, &val);
+			ek->key_stored = val;
+		}
+	}
+}
+
+/* Serial version, using an EdgeHash. Gives the same edges in the same order as the concurrent
+ * version: existing edges keep their index, new edges follow in order of their first loop. */
+static int mesh_calc_edges_edgehash(Mesh *mesh, const bool update, const short ed_flag, CustomData *edata)
 {
-	CustomData edata;
 	EdgeHashIterator *ehi;
 	MPoly *mp;
-	MEdge *med, *med_orig;
+	MEdge *med;
 	EdgeHash *eh;
 	unsigned int eh_reserve;
-	int i, totedge, totpoly = mesh->totpoly;
-	int med_index;
-	/* select for newly created meshes which are selected [#25595] */
-	const short ed_flag = (ME_EDGEDRAW | ME_EDGERENDER) | (select ? SELECT : 0);
-
-	if (mesh->totedge == 0)
-		update = false;
+	int i, totedge, totedge_orig = 0, totpoly = mesh->totpoly;
 
 	eh_reserve = max_ii(update ? mesh->totedge : 0, BLI_EDGEHASH_SIZE_GUESS_FROM_POLYS(totpoly));
 	eh = BLI_edgehash_new_ex(__func__, eh_reserve);
 
 	if (update) {
 		/* assume existing edges are valid
-		 * useful when adding more faces and generating edges from them */
+		 * useful when adding more faces and generating edges from them,
+		 * existing edges keep their index. */
+		totedge_orig = mesh->totedge;
 		med = mesh->medge;
-		for (i = 0; i < mesh->totedge; i++, med++)
-			BLI_edgehash_insert(eh, med->v1, med->v2, med);
+		for (i = 0; i < totedge_orig; i++, med++) {
+			void **val_p;
+			/* loops use the first of duplicate edges */
+			if (!BLI_edgehash_ensure_p(eh, med->v1, med->v2, &val_p)) {
+				*val_p = SET_INT_IN_POINTER(i);
+			}
+		}
 	}
 
-	/* mesh loops (bmesh only) */
+	/* mesh loops (bmesh only), the edge from a loop to the next one is the edge of that loop */
+	totedge = totedge_orig;
 	for (mp = mesh->mpoly, i = 0; i < totpoly; mp++, i++) {
-		MLoop *l = &mesh->mloop[mp->loopstart];
-		int j, v_prev = (l + (mp->totloop - 1))->v;
-		for (j = 0; j < mp->totloop; j++, l++) {
-			if (v_prev != l->v) {
+		MLoop *ml = &mesh->mloop[mp->loopstart];
+		int j;
+		for (j = 0; j < mp->totloop; j++) {
+			const unsigned int v_next = ml[(j + 1 == mp->totloop) ? 0 : j + 1].v;
+			if (ml[j].v != v_next) {
 				void **val_p;
-				if (!BLI_edgehash_ensure_p(eh, v_prev, l->v, &val_p)) {
-					*val_p = NULL;
+				if (!BLI_edgehash_ensure_p(eh, ml[j].v, v_next, &val_p)) {
+					*val_p = SET_INT_IN_POINTER(totedge++);
 				}
+				ml[j].e = (unsigned int)GET_INT_FROM_POINTER(*val_p);
+			}
+			else {
+				ml[j].e = 0;
 			}
-			v_prev = l->v;
 		}
 	}
 
-	totedge = BLI_edgehash_size(eh);
-
 	/* write new edges into a temporary CustomData */
-	CustomData_reset(&edata);
-	CustomData_add_layer(&edata, CD_MEDGE, CD_CALLOC, NULL, totedge);
+	med = CustomData_add_layer(edata, CD_MEDGE, CD_CALLOC, NULL, totedge);
+
+	if (totedge_orig) {
+		memcpy(med, mesh->medge, sizeof(*med) * (size_t)totedge_orig);
+	}
 
-	med = CustomData_get_layer(&edata, CD_MEDGE);
-	for (ehi = BLI_edgehashIterator_new(eh), i = 0;
+	for (ehi = BLI_edgehashIterator_new(eh);
 	     BLI_edgehashIterator_isDone(ehi) == false;
-	     BLI_edgehashIterator_step(ehi), ++i, ++med)
+	     BLI_edgehashIterator_step(ehi))
 	{
-		if (update && (med_orig = BLI_edgehashIterator_getValue(ehi))) {
-			*med = *med_orig; /* copy from the original */
+		const int med_index = GET_INT_FROM_POINTER(BLI_edgehashIterator_getValue(ehi));
+		if (med_index >= totedge_orig) {
+			MEdge *med_new = &med[med_index];
+			BLI_edgehashIterator_getKey(ehi, &med_new->v1, &med_new->v2);
+			med_new->flag = ed_flag;
 		}
-		else {
-			BLI_edgehashIterator_getKey(ehi, &med->v1, &med->v2);
-			med->flag = ed_flag;
+	}
+	BLI_edgehashIterator_free(ehi);
+
+	BLI_edgehash_free(eh, NULL);
+
+	return totedge;
+}
+
+/* Parallel version, edges are deduplicated from all polygons using a ConcurrentGHash, new edges
+ * are then numbered in order of their first loop so the result does not depend on threads
+ * scheduling. Existing edges keep their index, the same order as the serial version. */
+static int mesh_calc_edges_concurrent(Mesh *mesh, const bool update, const short ed_flag, CustomData *edata)
+{
+	MEdge *med;
+	ConcurrentGHash *cgh;
+	MeshCalcEdgeKey *loop_keys, *edge_keys = NULL;
+	int i, totedge, totedge_orig = 0, totpoly = mesh->totpoly, totloop = mesh->totloop;
+
+	cgh = BLI_concurrent_ghash_new_ex(
+	        mesh_calc_edges_key_hash, mesh_calc_edges_key_cmp, __func__,
+	        max_ii(update ? mesh->totedge : 0, BLI_EDGEHASH_SIZE_GUESS_FROM_POLYS(totpoly)));
+
+	if (update) {
+		/* assume existing edges are valid
+		 * useful when adding more faces and generating edges from them,
+		 * existing edges keep their index. */
+		totedge_orig = mesh->totedge;
+		edge_keys = MEM_mallocN(sizeof(*edge_keys) * (size_t)totedge_orig, __func__);
+		for (i = 0, med = mesh->medge; i < totedge_orig; i++, med++) {
+			void *val;
+			mesh_calc_edges_key_init(&edge_keys[i], med->v1, med->v2);
+			edge_keys[i].edge_index = i;
+			BLI_concurrent_ghash_insert_or_lookup(cgh, &edge_keys[i], &edge_keys[i], &val);
 		}
+	}
 
-		/* store the new edge index in the hash value */
-		BLI_edgehashIterator_setValue(ehi, SET_INT_IN_POINTER(i));
+	/* mesh loops (bmesh only) */
+	/* cleared, loops outside of polygons get no edge */
+	loop_keys = MEM_callocN(sizeof(*loop_keys) * (size_t)totloop, __func__);
+	{
+		MeshCalcEdgesData data = {
+		    .mpoly = mesh->mpoly, .mloop = mesh->mloop, .loop_keys = loop_keys, .cgh = cgh,
+		};
+		BLI_task_parallel_range(0, totpoly, &data, mesh_calc_edges_insert_task_cb, true);
 	}
-	BLI_edgehashIterator_free(ehi);
 
-	if (mesh->totpoly) {
-		/* second pass, iterate through all loops again and assign
-		 * the newly created edges to them. */
-		for (mp = mesh->mpoly, i = 0; i < mesh->totpoly; mp++, i++) {
-			MLoop *l = &mesh->mloop[mp->loopstart];
-			MLoop *l_prev = (l + (mp->totloop - 1));
-			int j;
-			for (j = 0; j < mp->totloop; j++, l++) {
-				/* lookup hashed edge index */
-				med_index = GET_INT_FROM_POINTER(BLI_edgehash_lookup(eh, l_prev->v, l->v));
-				l_prev->e = med_index;
-				l_prev = l;
+	/* Number new edges in order of their first loop, polygon by polygon like the serial version.
+	 * Loops of degenerate edges use the first edge as before. */
+	totedge = totedge_orig;
+	for (i = 0; i < totpoly; i++) {
+		const MPoly *mp = &mesh->mpoly[i];
+		for (int j = 0; j < mp->totloop; j++) {
+			MeshCalcEdgeKey *ek_stored = loop_keys[mp->loopstart + j].key_stored;
+			if (ek_stored && ek_stored->edge_index == -1) {
+				ek_stored->edge_index = totedge++;
 			}
 		}
 	}
 
+	/* write new edges into a temporary CustomData */
+	med = CustomData_add_layer(edata, CD_MEDGE, CD_CALLOC, NULL, totedge);
+
+	if (totedge_orig) {
+		memcpy(med, mesh->medge, sizeof(*med) * (size_t)totedge_orig);
+	}
+
+	for (i = 0; i < totloop; i++) {
+		MeshCalcEdgeKey *ek_stored = loop_keys[i].key_stored;
+		if (ek_stored) {
+			if (ek_stored->edge_index >= totedge_orig) {
+				MEdge *med_new = &med[ek_stored->edge_index];
+				med_new->v1 = ek_stored->v1;
+				med_new->v2 = ek_stored->v2;
+				med_new->flag = ed_flag;
+			}
+			mesh->mloop[i].e = (unsigned int)ek_stored->edge_index;
+		}
+		else {
+			mesh->mloop[i].e = 0;
+		}
+	}
+
+	BLI_concurrent_ghash_free(cgh, NULL, NULL);
+	MEM_freeN(loop_keys);
+	if (edge_keys) {
+		MEM_freeN(edge_keys);
+	}
+
+	return totedge;
+}
+
+/**
+ * Calculate edges from polygons
+ *
+ * Large meshes are handled in parallel when multiple threads are available, the serial
+ * version avoids the locking and per-loop keys overhead otherwise.
+ *
+ * \param mesh  The mesh to add edges into
+ * \param update  When true create new edges co-exist
+ */
+void BKE_mesh_calc_edges(Mesh *mesh, bool update, const bool select)
+{
+	CustomData edata;
+	int totedge;
+	/* select for newly created meshes which are selected [#25595] */
+	const short ed_flag = (ME_EDGEDRAW | ME_EDGERENDER) | (select ? SELECT : 0);
+
+	if (mesh->totedge == 0)
+		update = false;
+
+	CustomData_reset(&edata);
+	if ((mesh->totpoly > BKE_MESH_OMP_LIMIT) && (BLI_system_thread_count() > 1)) {
+		totedge = mesh_calc_edges_concurrent(mesh, update, ed_flag, &edata);
+	}
+	else {
+		totedge = mesh_calc_edges_edgehash(mesh, update, ed_flag, &edata);
+	}
+
 	/* free old CustomData and assign new one */
 	CustomData_free(&mesh->edata, mesh->totedge);
 	mesh->edata = edata;
 	mesh->totedge = totedge;
 
 	mesh->medge = CustomData_get_layer(&mesh->edata, CD_MEDGE);
-
-	BLI_edgehash_free(eh, NULL);
 }
 /** \} */
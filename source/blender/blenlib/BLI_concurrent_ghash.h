@@ -0,0 +1,87 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_CONCURRENT_GHASH_H__
+#define __BLI_CONCURRENT_GHASH_H__
+
+/** \file BLI_concurrent_ghash.h
+ *  \ingroup bli
+ *
+ * ConcurrentGHash is a hash-map which can be filled from multiple threads at once,
+ * for builders running in #BLI_task_parallel_range and such.
+ *
+ * Keys are spread over a number of stripes, each one being a regular #GHash protected
+ * by its own spin-lock, so threads only contend when they access the same stripe.
+ *
+ * Insertion and lookup are thread-safe, removing keys is not supported.
+ * Iteration and freeing must only happen once all threads are done.
+ */
+
+#include "BLI_sys_types.h" /* for bool */
+#include "BLI_compiler_attrs.h"
+#include "BLI_ghash.h"  /* for callback types */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ConcurrentGHash ConcurrentGHash;
+
+typedef struct ConcurrentGHashIterator {
+	ConcurrentGHash *cgh;
+	unsigned int curr_stripe;
+	GHashIterator ghi;
+} ConcurrentGHashIterator;
+
+ConcurrentGHash *BLI_concurrent_ghash_new_ex(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+        const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+ConcurrentGHash *BLI_concurrent_ghash_new(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+void   BLI_concurrent_ghash_free(ConcurrentGHash *cgh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp);
+bool   BLI_concurrent_ghash_insert_or_lookup(
+        ConcurrentGHash *cgh, void *key, void *val, void **r_val) ATTR_NONNULL(1, 4);
+void  *BLI_concurrent_ghash_lookup(ConcurrentGHash *cgh, const void *key) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_concurrent_ghash_haskey(ConcurrentGHash *cgh, const void *key) ATTR_WARN_UNUSED_RESULT;
+unsigned int BLI_concurrent_ghash_size(ConcurrentGHash *cgh) ATTR_WARN_UNUSED_RESULT;
+
+/* Not thread-safe, only use once all insertions are done. */
+void   BLI_concurrent_ghashIterator_init(ConcurrentGHashIterator *cghi, ConcurrentGHash *cgh);
+void   BLI_concurrent_ghashIterator_step(ConcurrentGHashIterator *cghi);
+
+BLI_INLINE void *BLI_concurrent_ghashIterator_getKey(ConcurrentGHashIterator *cghi)
+{ return BLI_ghashIterator_getKey(&cghi->ghi); }
+BLI_INLINE void *BLI_concurrent_ghashIterator_getValue(ConcurrentGHashIterator *cghi)
+{ return BLI_ghashIterator_getValue(&cghi->ghi); }
+BLI_INLINE void **BLI_concurrent_ghashIterator_getValue_p(ConcurrentGHashIterator *cghi)
+{ return BLI_ghashIterator_getValue_p(&cghi->ghi); }
+BLI_INLINE bool BLI_concurrent_ghashIterator_done(ConcurrentGHashIterator *cghi)
+{ return BLI_ghashIterator_done(&cghi->ghi); }
+
+#define CONCURRENT_GHASH_ITER(cgh_iter_, cghash_) \
+	for (BLI_concurrent_ghashIterator_init(&cgh_iter_, cghash_); \
+	     BLI_concurrent_ghashIterator_done(&cgh_iter_) == false; \
+	     BLI_concurrent_ghashIterator_step(&cgh_iter_))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BLI_CONCURRENT_GHASH_H__ */
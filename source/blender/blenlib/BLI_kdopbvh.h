@@ -89,6 +89,21 @@ enum {
 #define BVH_RAYCAST_DEFAULT (BVH_RAYCAST_WATERTIGHT)
 #define BVH_RAYCAST_DIST_MAX (FLT_MAX / 2.0f)
 
+/* flags for BLI_bvhtree_new_ex */
+enum {
+	/* split branches using the surface area heuristic instead of the median of the largest axis,
+	 * slower to build but gives faster queries (only used for trees including the xyz axes) */
+	BVH_BUILD_SAH               = (1 << 0),
+};
+
+/* BLI_bvhtree_calc_stats */
+typedef struct BVHTreeStats {
+	int totleaf, totbranch;
+	int depth_max;
+	float depth_avg;    /* average depth of the leafs */
+	float sah_cost;     /* sum of the nodes surface area, relative to the root */
+} BVHTreeStats;
+
 /* callback must update nearest in case it finds a nearest result */
 typedef void (*BVHTree_NearestPointCallback)(void *userdata, int index, const float co[3], BVHTreeNearest *nearest);
 
@@ -111,6 +126,7 @@ typedef bool (*BVHTree_WalkLeafCallback)(const BVHTreeAxisRange *bounds, int ind
 typedef bool (*BVHTree_WalkOrderCallback)(const BVHTreeAxisRange *bounds, char axis, void *userdata);
 
 
+BVHTree *BLI_bvhtree_new_ex(int maxsize, float epsilon, char tree_type, char axis, int flag);
 BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis);
 void BLI_bvhtree_free(BVHTree *tree);
 
@@ -130,6 +146,7 @@ BVHTreeOverlap *BLI_bvhtree_overlap(
         BVHTree_OverlapCallback callback, void *userdata);
 
 int   BLI_bvhtree_get_size(const BVHTree *tree);
+void  BLI_bvhtree_calc_stats(const BVHTree *tree, BVHTreeStats *r_stats);
 
 float BLI_bvhtree_get_epsilon(const BVHTree *tree);
 
@@ -155,6 +172,15 @@ void BLI_bvhtree_ray_cast_all(
         BVHTree *tree, const float co[3], const float dir[3], float radius, float hit_dist,
         BVHTree_RayCastCallback callback, void *userdata);
 
+/* batched queries, threaded for big batches, results must be initialized by the caller */
+void BLI_bvhtree_ray_cast_batch(
+        BVHTree *tree, const float (*co)[3], const float (*dir)[3], int rays_len, float radius,
+        BVHTreeRayHit *r_hit, BVHTree_RayCastCallback callback, void *userdata,
+        int flag);
+void BLI_bvhtree_find_nearest_batch(
+        BVHTree *tree, const float (*co)[3], int co_len, BVHTreeNearest *r_nearest,
+        BVHTree_NearestPointCallback callback, void *userdata);
+
 float BLI_bvhtree_bb_raycast(const float bv[6], const float light_start[3], const float light_end[3], float pos[3]);
 
 /* range query */
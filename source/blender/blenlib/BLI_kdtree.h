@@ -66,6 +66,14 @@ void BLI_kdtree_range_search_cb(
         const KDTree *tree, const float co[3], float range,
         bool (*search_cb)(void *user_data, int index, const float co[3], float dist_sq), void *user_data);
 
+/* Batched queries, threaded for big batches */
+void BLI_kdtree_find_nearest_batch(
+        const KDTree *tree, const float (*co)[3], unsigned int co_len,
+        KDTreeNearest *r_nearest) ATTR_NONNULL(1, 2, 4);
+void BLI_kdtree_find_nearest_n_batch(
+        const KDTree *tree, const float (*co)[3], unsigned int co_len, unsigned int n,
+        KDTreeNearest *r_nearest, int *r_found) ATTR_NONNULL(1, 2, 5);
+
 int BLI_kdtree_calc_duplicates_fast(
         const KDTree *tree, const float range, bool use_index_order,
         int *doubles);
@@ -56,6 +56,12 @@ void         BLI_mempool_destroy(BLI_mempool *pool) ATTR_NONNULL(1);
 int          BLI_mempool_count(BLI_mempool *pool) ATTR_NONNULL(1);
 void        *BLI_mempool_findelem(BLI_mempool *pool, unsigned int index) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL(1);
 
+void         BLI_mempool_threads_begin(BLI_mempool *pool, const unsigned int num_threads) ATTR_NONNULL(1);
+void         BLI_mempool_threads_end(BLI_mempool *pool) ATTR_NONNULL(1);
+void        *BLI_mempool_alloc_thread(BLI_mempool *pool, const int thread_id) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_NONNULL(1);
+void        *BLI_mempool_calloc_thread(BLI_mempool *pool, const int thread_id) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_NONNULL(1);
+void         BLI_mempool_free_thread(BLI_mempool *pool, void *addr, const int thread_id) ATTR_NONNULL(1, 2);
+
 void        BLI_mempool_as_table(BLI_mempool *pool, void **data) ATTR_NONNULL(1, 2);
 void      **BLI_mempool_as_tableN(BLI_mempool *pool, const char *allocstr) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_NONNULL(1, 2);
 void        BLI_mempool_as_array(BLI_mempool *pool, void *data) ATTR_NONNULL(1, 2);
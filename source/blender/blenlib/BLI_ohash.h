@@ -0,0 +1,219 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_OHASH_H__
+#define __BLI_OHASH_H__
+
+/** \file BLI_ohash.h
+ *  \ingroup bli
+ *
+ * OHash is an open addressing hash-map, an alternative to #GHash
+ * for hot code paths where the chained buckets of GHash cause too many cache misses.
+ *
+ * Keys and values are stored inline in flat arrays, next to an array of one byte
+ * control codes holding 7 bits of the hash of every slot. Lookups compare 16 control
+ * bytes at once (SSE2 when available), so the key compare callback is only called
+ * for slots which very likely match.
+ *
+ * The API mirrors the one of #GHash and uses the same callbacks (see BLI_ghash.h),
+ * #OSet is the 'set' variant. See BLI_ohash_compat.h to switch existing GHash code.
+ *
+ * \note Unlike GHash, pointers returned by the '_p' functions are invalidated
+ * by any following insertion, as slots move when the table grows.
+ */
+
+#include "BLI_sys_types.h" /* for bool */
+#include "BLI_compiler_attrs.h"
+#include "BLI_ghash.h"  /* for callback types */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct OHash OHash;
+
+typedef struct OHashIterator {
+	OHash *oh;
+	void **curr_key;
+	void **curr_val;
+	unsigned int curr_slot;
+} OHashIterator;
+
+typedef struct OHashIterState {
+	unsigned int curr_slot;
+} OHashIterState;
+
+/* Same flags as GHash, GHASH_FLAG_ALLOW_DUPES and GHASH_FLAG_ALLOW_SHRINK are supported. */
+
+/* *** */
+
+OHash *BLI_ohash_new_ex(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+        const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OHash *BLI_ohash_new(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OHash *BLI_ohash_copy(
+        OHash *oh, GHashKeyCopyFP keycopyfp,
+        GHashValCopyFP valcopyfp) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+void   BLI_ohash_free(OHash *oh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp);
+void   BLI_ohash_reserve(OHash *oh, const unsigned int nentries_reserve);
+void   BLI_ohash_insert(OHash *oh, void *key, void *val);
+bool   BLI_ohash_reinsert(OHash *oh, void *key, void *val, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp);
+void  *BLI_ohash_replace_key(OHash *oh, void *key);
+void  *BLI_ohash_lookup(OHash *oh, const void *key) ATTR_WARN_UNUSED_RESULT;
+void  *BLI_ohash_lookup_default(OHash *oh, const void *key, void *val_default) ATTR_WARN_UNUSED_RESULT;
+void **BLI_ohash_lookup_p(OHash *oh, const void *key) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_ohash_ensure_p(OHash *oh, void *key, void ***r_val) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_ohash_ensure_p_ex(OHash *oh, const void *key, void ***r_key, void ***r_val) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_ohash_remove(OHash *oh, const void *key, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp);
+void   BLI_ohash_clear(
+        OHash *oh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp);
+void   BLI_ohash_clear_ex(
+        OHash *oh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp,
+        const unsigned int nentries_reserve);
+void  *BLI_ohash_popkey(OHash *oh, const void *key, GHashKeyFreeFP keyfreefp) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_ohash_haskey(OHash *oh, const void *key) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_ohash_pop(OHash *oh, OHashIterState *state, void **r_key, void **r_val) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+unsigned int BLI_ohash_size(OHash *oh) ATTR_WARN_UNUSED_RESULT;
+void   BLI_ohash_flag_set(OHash *oh, unsigned int flag);
+void   BLI_ohash_flag_clear(OHash *oh, unsigned int flag);
+
+/* *** */
+
+OHashIterator *BLI_ohashIterator_new(OHash *oh) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+
+void           BLI_ohashIterator_init(OHashIterator *ohi, OHash *oh);
+void           BLI_ohashIterator_free(OHashIterator *ohi);
+void           BLI_ohashIterator_step(OHashIterator *ohi);
+
+BLI_INLINE void  *BLI_ohashIterator_getKey(OHashIterator *ohi)     { return *ohi->curr_key; }
+BLI_INLINE void  *BLI_ohashIterator_getValue(OHashIterator *ohi)   { return *ohi->curr_val; }
+BLI_INLINE void **BLI_ohashIterator_getValue_p(OHashIterator *ohi) { return ohi->curr_val; }
+BLI_INLINE bool   BLI_ohashIterator_done(OHashIterator *ohi)       { return !ohi->curr_key; }
+
+#define OHASH_ITER(oh_iter_, ohash_) \
+	for (BLI_ohashIterator_init(&oh_iter_, ohash_); \
+	     BLI_ohashIterator_done(&oh_iter_) == false; \
+	     BLI_ohashIterator_step(&oh_iter_))
+
+#define OHASH_ITER_INDEX(oh_iter_, ohash_, i_) \
+	for (BLI_ohashIterator_init(&oh_iter_, ohash_), i_ = 0; \
+	     BLI_ohashIterator_done(&oh_iter_) == false; \
+	     BLI_ohashIterator_step(&oh_iter_), i_++)
+
+OHash *BLI_ohash_ptr_new_ex(
+        const char *info,
+        const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OHash *BLI_ohash_ptr_new(
+        const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OHash *BLI_ohash_str_new_ex(
+        const char *info,
+        const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OHash *BLI_ohash_str_new(
+        const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OHash *BLI_ohash_int_new_ex(
+        const char *info,
+        const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OHash *BLI_ohash_int_new(
+        const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OHash *BLI_ohash_pair_new_ex(
+        const char *info,
+        const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OHash *BLI_ohash_pair_new(
+        const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+
+/**
+ * OSet is the 'set' variant of OHash (no value storage),
+ * it has the same API as #GSet.
+ */
+
+typedef struct OSet OSet;
+
+typedef OHashIterState OSetIterState;
+
+/* so we can cast but compiler sees as different */
+typedef struct OSetIterator {
+	OHashIterator _ohi;
+} OSetIterator;
+
+OSet  *BLI_oset_new_ex(
+        GSetHashFP hashfp, GSetCmpFP cmpfp, const char *info,
+        const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OSet  *BLI_oset_new(GSetHashFP hashfp, GSetCmpFP cmpfp, const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OSet  *BLI_oset_copy(OSet *os, GSetKeyCopyFP keycopyfp) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+unsigned int BLI_oset_size(OSet *os) ATTR_WARN_UNUSED_RESULT;
+void   BLI_oset_flag_set(OSet *os, unsigned int flag);
+void   BLI_oset_flag_clear(OSet *os, unsigned int flag);
+void   BLI_oset_free(OSet *os, GSetKeyFreeFP keyfreefp);
+void   BLI_oset_reserve(OSet *os, const unsigned int nentries_reserve);
+void   BLI_oset_insert(OSet *os, void *key);
+bool   BLI_oset_add(OSet *os, void *key);
+bool   BLI_oset_ensure_p_ex(OSet *os, const void *key, void ***r_key);
+bool   BLI_oset_reinsert(OSet *os, void *key, GSetKeyFreeFP keyfreefp);
+void  *BLI_oset_replace_key(OSet *os, void *key);
+bool   BLI_oset_haskey(OSet *os, const void *key) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_oset_pop(OSet *os, OSetIterState *state, void **r_key) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+bool   BLI_oset_remove(OSet *os, const void *key, GSetKeyFreeFP keyfreefp);
+void   BLI_oset_clear_ex(OSet *os, GSetKeyFreeFP keyfreefp,
+                         const unsigned int nentries_reserve);
+void   BLI_oset_clear(OSet *os, GSetKeyFreeFP keyfreefp);
+
+/* When set's are used for key & value. */
+void  *BLI_oset_lookup(OSet *os, const void *key) ATTR_WARN_UNUSED_RESULT;
+void  *BLI_oset_pop_key(OSet *os, const void *key) ATTR_WARN_UNUSED_RESULT;
+
+OSet *BLI_oset_ptr_new_ex(const char *info, const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OSet *BLI_oset_ptr_new(const char *info);
+OSet *BLI_oset_str_new_ex(const char *info, const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OSet *BLI_oset_str_new(const char *info);
+OSet *BLI_oset_pair_new_ex(const char *info, const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+OSet *BLI_oset_pair_new(const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+
+/* rely on inline api for now */
+BLI_INLINE OSetIterator *BLI_osetIterator_new(OSet *os) { return (OSetIterator *)BLI_ohashIterator_new((OHash *)os); }
+BLI_INLINE void BLI_osetIterator_init(OSetIterator *osi, OSet *os) { BLI_ohashIterator_init((OHashIterator *)osi, (OHash *)os); }
+BLI_INLINE void BLI_osetIterator_free(OSetIterator *osi) { BLI_ohashIterator_free((OHashIterator *)osi); }
+BLI_INLINE void *BLI_osetIterator_getKey(OSetIterator *osi) { return BLI_ohashIterator_getKey((OHashIterator *)osi); }
+BLI_INLINE void BLI_osetIterator_step(OSetIterator *osi) { BLI_ohashIterator_step((OHashIterator *)osi); }
+BLI_INLINE bool BLI_osetIterator_done(OSetIterator *osi) { return BLI_ohashIterator_done((OHashIterator *)osi); }
+
+#define OSET_ITER(os_iter_, oset_) \
+	for (BLI_osetIterator_init(&os_iter_, oset_); \
+	     BLI_osetIterator_done(&os_iter_) == false; \
+	     BLI_osetIterator_step(&os_iter_))
+
+#define OSET_ITER_INDEX(os_iter_, oset_, i_) \
+	for (BLI_osetIterator_init(&os_iter_, oset_), i_ = 0; \
+	     BLI_osetIterator_done(&os_iter_) == false; \
+	     BLI_osetIterator_step(&os_iter_), i_++)
+
+/* For testing, debugging only */
+#ifdef GHASH_INTERNAL_API
+int BLI_ohash_capacity(OHash *oh);
+int BLI_oset_capacity(OSet *os);
+/** Average number of probed groups for a successful lookup of every key. */
+double BLI_ohash_calc_probe_length(OHash *oh);
+#endif  /* GHASH_INTERNAL_API */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BLI_OHASH_H__ */
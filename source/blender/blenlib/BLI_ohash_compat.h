@@ -0,0 +1,120 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_OHASH_COMPAT_H__
+#define __BLI_OHASH_COMPAT_H__
+
+/** \file BLI_ohash_compat.h
+ *  \ingroup bli
+ *
+ * Drop-in replacement of GHash/GSet by OHash/OSet for a single source file.
+ *
+ * Include this after all other headers, all GHash and GSet types, functions and iterator
+ * macros used by the rest of the file then map to their open addressing versions.
+ * Only use it for tables which don't leave the file, as other modules still expect a GHash.
+ *
+ * \note Pointers to keys and values (#BLI_ghash_lookup_p, #BLI_ghash_ensure_p...)
+ * are invalidated by insertions, check the file doesn't keep them around.
+ */
+
+#include "BLI_ghash.h"
+#include "BLI_ohash.h"
+
+#define GHash                           OHash
+#define GHashIterator                   OHashIterator
+#define GHashIterState                  OHashIterState
+#define GSet                            OSet
+#define GSetIterator                    OSetIterator
+#define GSetIterState                   OSetIterState
+
+#define BLI_ghash_new_ex                BLI_ohash_new_ex
+#define BLI_ghash_new                   BLI_ohash_new
+#define BLI_ghash_copy                  BLI_ohash_copy
+#define BLI_ghash_free                  BLI_ohash_free
+#define BLI_ghash_reserve               BLI_ohash_reserve
+#define BLI_ghash_insert                BLI_ohash_insert
+#define BLI_ghash_reinsert              BLI_ohash_reinsert
+#define BLI_ghash_replace_key           BLI_ohash_replace_key
+#define BLI_ghash_lookup                BLI_ohash_lookup
+#define BLI_ghash_lookup_default        BLI_ohash_lookup_default
+#define BLI_ghash_lookup_p              BLI_ohash_lookup_p
+#define BLI_ghash_ensure_p              BLI_ohash_ensure_p
+#define BLI_ghash_ensure_p_ex           BLI_ohash_ensure_p_ex
+#define BLI_ghash_remove                BLI_ohash_remove
+#define BLI_ghash_clear                 BLI_ohash_clear
+#define BLI_ghash_clear_ex              BLI_ohash_clear_ex
+#define BLI_ghash_popkey                BLI_ohash_popkey
+#define BLI_ghash_haskey                BLI_ohash_haskey
+#define BLI_ghash_pop                   BLI_ohash_pop
+#define BLI_ghash_size                  BLI_ohash_size
+#define BLI_ghash_flag_set              BLI_ohash_flag_set
+#define BLI_ghash_flag_clear            BLI_ohash_flag_clear
+#define BLI_ghash_ptr_new_ex            BLI_ohash_ptr_new_ex
+#define BLI_ghash_ptr_new               BLI_ohash_ptr_new
+#define BLI_ghash_str_new_ex            BLI_ohash_str_new_ex
+#define BLI_ghash_str_new               BLI_ohash_str_new
+#define BLI_ghash_int_new_ex            BLI_ohash_int_new_ex
+#define BLI_ghash_int_new               BLI_ohash_int_new
+#define BLI_ghash_pair_new_ex           BLI_ohash_pair_new_ex
+#define BLI_ghash_pair_new              BLI_ohash_pair_new
+
+#define BLI_ghashIterator_new           BLI_ohashIterator_new
+#define BLI_ghashIterator_init          BLI_ohashIterator_init
+#define BLI_ghashIterator_free          BLI_ohashIterator_free
+#define BLI_ghashIterator_step          BLI_ohashIterator_step
+#define BLI_ghashIterator_getKey        BLI_ohashIterator_getKey
+#define BLI_ghashIterator_getValue      BLI_ohashIterator_getValue
+#define BLI_ghashIterator_getValue_p    BLI_ohashIterator_getValue_p
+#define BLI_ghashIterator_done          BLI_ohashIterator_done
+
+#define BLI_gset_new_ex                 BLI_oset_new_ex
+#define BLI_gset_new                    BLI_oset_new
+#define BLI_gset_copy                   BLI_oset_copy
+#define BLI_gset_size                   BLI_oset_size
+#define BLI_gset_flag_set               BLI_oset_flag_set
+#define BLI_gset_flag_clear             BLI_oset_flag_clear
+#define BLI_gset_free                   BLI_oset_free
+#define BLI_gset_insert                 BLI_oset_insert
+#define BLI_gset_add                    BLI_oset_add
+#define BLI_gset_ensure_p_ex            BLI_oset_ensure_p_ex
+#define BLI_gset_reinsert               BLI_oset_reinsert
+#define BLI_gset_replace_key            BLI_oset_replace_key
+#define BLI_gset_haskey                 BLI_oset_haskey
+#define BLI_gset_pop                    BLI_oset_pop
+#define BLI_gset_remove                 BLI_oset_remove
+#define BLI_gset_clear_ex               BLI_oset_clear_ex
+#define BLI_gset_clear                  BLI_oset_clear
+#define BLI_gset_lookup                 BLI_oset_lookup
+#define BLI_gset_pop_key                BLI_oset_pop_key
+#define BLI_gset_ptr_new_ex             BLI_oset_ptr_new_ex
+#define BLI_gset_ptr_new                BLI_oset_ptr_new
+#define BLI_gset_str_new_ex             BLI_oset_str_new_ex
+#define BLI_gset_str_new                BLI_oset_str_new
+#define BLI_gset_pair_new_ex            BLI_oset_pair_new_ex
+#define BLI_gset_pair_new               BLI_oset_pair_new
+
+#define BLI_gsetIterator_new            BLI_osetIterator_new
+#define BLI_gsetIterator_init           BLI_osetIterator_init
+#define BLI_gsetIterator_free           BLI_osetIterator_free
+#define BLI_gsetIterator_getKey         BLI_osetIterator_getKey
+#define BLI_gsetIterator_step           BLI_osetIterator_step
+#define BLI_gsetIterator_done           BLI_osetIterator_done
+
+#endif /* __BLI_OHASH_COMPAT_H__ */
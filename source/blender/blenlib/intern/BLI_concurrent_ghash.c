@@ -0,0 +1,252 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/BLI_concurrent_ghash.c
+ *  \ingroup bli
+ *
+ * A hash table which can be filled from multiple threads, using striped locks over regular GHash.
+ *
+ * The higher bits of the scrambled key hash select the stripe, while the GHash of the stripe
+ * uses the key hash itself, so keys of a stripe are still spread over all of its buckets.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+#include "BLI_concurrent_ghash.h"
+#include "BLI_threads.h"
+
+#include "BLI_strict_flags.h"
+
+/* Stripes per thread, more stripes make contention less likely. */
+#define CGHASH_STRIPES_PER_THREAD 4
+#define CGHASH_STRIPES_MIN 16
+#define CGHASH_STRIPES_MAX 1024
+
+#define CGHASH_CACHELINE_SIZE 64
+
+/* Same members as ConcurrentGHashStripe, to size its padding including the alignment of members. */
+typedef struct ConcurrentGHashStripeUnpadded {
+	SpinLock lock;
+	GHash *gh;
+} ConcurrentGHashStripeUnpadded;
+
+typedef struct ConcurrentGHashStripe {
+	SpinLock lock;
+	GHash *gh;
+	/* Avoid false sharing of locks between threads working on neighbour stripes. */
+	char _pad[CGHASH_CACHELINE_SIZE - sizeof(ConcurrentGHashStripeUnpadded) % CGHASH_CACHELINE_SIZE];
+} ConcurrentGHashStripe;
+
+BLI_STATIC_ASSERT_ALIGN(ConcurrentGHashStripe, CGHASH_CACHELINE_SIZE)
+
+struct ConcurrentGHash {
+	GHashHashFP hashfp;
+	ConcurrentGHashStripe *stripes;
+	uint nstripes;
+	/* 32 - log2(nstripes). */
+	uint stripe_shift;
+};
+
+/* -------------------------------------------------------------------- */
+/** \name Internal Utility API
+ * \{ */
+
+BLI_INLINE ConcurrentGHashStripe *cghash_stripe(ConcurrentGHash *cgh, const void *key)
+{
+	const uint hash = cgh->hashfp(key) * 0x9E3779B1u;
+	return &cgh->stripes[hash >> cgh->stripe_shift];
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Public API
+ * \{ */
+
+/**
+ * Creates a new, empty ConcurrentGHash.
+ *
+ * \param nentries_reserve  Optionally reserve the number of members that the hash will hold,
+ * spread over all the stripes.
+ */
+ConcurrentGHash *BLI_concurrent_ghash_new_ex(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+        const uint nentries_reserve)
+{
+	ConcurrentGHash *cgh = MEM_mallocN(sizeof(*cgh), info);
+	const uint nstripes_min = (uint)(BLI_system_thread_count() * CGHASH_STRIPES_PER_THREAD);
+	uint nstripes = CGHASH_STRIPES_MIN, stripe_bits = 4;
+
+	while (nstripes < nstripes_min && nstripes < CGHASH_STRIPES_MAX) {
+		nstripes <<= 1;
+		stripe_bits++;
+	}
+
+	cgh->hashfp = hashfp;
+	cgh->nstripes = nstripes;
+	cgh->stripe_shift = 32 - stripe_bits;
+	cgh->stripes = MEM_mallocN_aligned(sizeof(*cgh->stripes) * nstripes, CGHASH_CACHELINE_SIZE, info);
+
+	for (uint i = 0; i < nstripes; i++) {
+		BLI_spin_init(&cgh->stripes[i].lock);
+		/* Slightly over-reserve since keys are never perfectly spread between stripes. */
+		cgh->stripes[i].gh = BLI_ghash_new_ex(hashfp, cmpfp, info, (nentries_reserve + nentries_reserve / 8) / nstripes);
+	}
+
+	return cgh;
+}
+
+/**
+ * Wraps #BLI_concurrent_ghash_new_ex with zero entries reserved.
+ */
+ConcurrentGHash *BLI_concurrent_ghash_new(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info)
+{
+	return BLI_concurrent_ghash_new_ex(hashfp, cmpfp, info, 0);
+}
+
+/**
+ * Frees the ConcurrentGHash and its members, must not be called while other threads use it.
+ */
+void BLI_concurrent_ghash_free(ConcurrentGHash *cgh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	for (uint i = 0; i < cgh->nstripes; i++) {
+		BLI_ghash_free(cgh->stripes[i].gh, keyfreefp, valfreefp);
+		BLI_spin_end(&cgh->stripes[i].lock);
+	}
+	MEM_freeN(cgh->stripes);
+	MEM_freeN(cgh);
+}
+
+/**
+ * Insert \a key with \a val, unless \a key is already in \a cgh.
+ * This is atomic, when multiple threads insert the same key only one of them succeeds.
+ *
+ * \param r_val  The value stored for \a key, \a val when it was inserted.
+ * \return true if \a key was inserted.
+ */
+bool BLI_concurrent_ghash_insert_or_lookup(ConcurrentGHash *cgh, void *key, void *val, void **r_val)
+{
+	ConcurrentGHashStripe *stripe = cghash_stripe(cgh, key);
+	void **val_p;
+	bool haskey;
+
+	BLI_spin_lock(&stripe->lock);
+	haskey = BLI_ghash_ensure_p(stripe->gh, key, &val_p);
+	if (!haskey) {
+		*val_p = val;
+	}
+	*r_val = *val_p;
+	BLI_spin_unlock(&stripe->lock);
+
+	return !haskey;
+}
+
+/**
+ * Lookup the value of \a key in \a cgh.
+ *
+ * \returns the value for \a key or NULL.
+ */
+void *BLI_concurrent_ghash_lookup(ConcurrentGHash *cgh, const void *key)
+{
+	ConcurrentGHashStripe *stripe = cghash_stripe(cgh, key);
+	void *val;
+
+	BLI_spin_lock(&stripe->lock);
+	val = BLI_ghash_lookup(stripe->gh, key);
+	BLI_spin_unlock(&stripe->lock);
+
+	return val;
+}
+
+/**
+ * \return true if the \a key is in \a cgh.
+ */
+bool BLI_concurrent_ghash_haskey(ConcurrentGHash *cgh, const void *key)
+{
+	ConcurrentGHashStripe *stripe = cghash_stripe(cgh, key);
+	bool haskey;
+
+	BLI_spin_lock(&stripe->lock);
+	haskey = BLI_ghash_haskey(stripe->gh, key);
+	BLI_spin_unlock(&stripe->lock);
+
+	return haskey;
+}
+
+/**
+ * \return size of the ConcurrentGHash, only exact when no other thread is inserting.
+ */
+uint BLI_concurrent_ghash_size(ConcurrentGHash *cgh)
+{
+	uint size = 0;
+	for (uint i = 0; i < cgh->nstripes; i++) {
+		size += BLI_ghash_size(cgh->stripes[i].gh);
+	}
+	return size;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Iterator API
+ * \{ */
+
+/**
+ * Skip empty stripes, until a valid entry or the end of the last stripe.
+ */
+static void cghash_iterator_skip_empty(ConcurrentGHashIterator *cghi)
+{
+	ConcurrentGHash *cgh = cghi->cgh;
+
+	while (BLI_ghashIterator_done(&cghi->ghi) && (cghi->curr_stripe + 1 < cgh->nstripes)) {
+		cghi->curr_stripe++;
+		BLI_ghashIterator_init(&cghi->ghi, cgh->stripes[cghi->curr_stripe].gh);
+	}
+}
+
+/**
+ * Init an already allocated ConcurrentGHashIterator.
+ * No thread may insert in \a cgh while the iterator is in use.
+ */
+void BLI_concurrent_ghashIterator_init(ConcurrentGHashIterator *cghi, ConcurrentGHash *cgh)
+{
+	cghi->cgh = cgh;
+	cghi->curr_stripe = 0;
+	BLI_ghashIterator_init(&cghi->ghi, cgh->stripes[0].gh);
+	cghash_iterator_skip_empty(cghi);
+}
+
+/**
+ * Steps the iterator to the next entry.
+ */
+void BLI_concurrent_ghashIterator_step(ConcurrentGHashIterator *cghi)
+{
+	BLI_ghashIterator_step(&cghi->ghi);
+	cghash_iterator_skip_empty(cghi);
+}
+
+/** \} */
@@ -44,12 +44,21 @@
  *   #BLI_bvhtree_overlap, #BVHOverlapData_Shared, #BVHOverlapData_Thread
  * - Range Query:
  *   #BLI_bvhtree_range_query
+ * - Batched ray-cast and nearest point, over a tree of 4-wide nodes:
+ *   #BLI_bvhtree_ray_cast_batch, #BLI_bvhtree_find_nearest_batch, #BVHTreeWide
  */
 
 #include <assert.h>
+#include <limits.h>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
 
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_utildefines.h"
 #include "BLI_alloca.h"
 #include "BLI_stack.h"
@@ -80,6 +89,13 @@
 #  define KDOPBVH_THREAD_LEAF_THRESHOLD 1024
 #endif
 
+/* Same as KDOPBVH_THREAD_LEAF_THRESHOLD, for the number of queries of batches. */
+#ifdef DEBUG
+#  define KDOPBVH_THREAD_QUERY_THRESHOLD 0
+#else
+#  define KDOPBVH_THREAD_QUERY_THRESHOLD 1024
+#endif
+
 
 /* -------------------------------------------------------------------- */
 
@@ -112,11 +128,12 @@ struct BVHTree {
 	axis_t start_axis, stop_axis;  /* bvhtree_kdop_axes array indices according to axis */
 	axis_t axis;                   /* kdop type (6 => OBB, 7 => AABB, ...) */
 	char tree_type;                /* type of tree (4 => quadtree) */
+	char flag;                     /* BVH_BUILD_* flags */
 };
 
 /* optimization, ensure we stay small */
-BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 48) ||
-                  (sizeof(void *) == 4 && sizeof(BVHTree) <= 32),
+BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 56) ||
+                  (sizeof(void *) == 4 && sizeof(BVHTree) <= 36),
                   "over sized")
 
 /* avoid duplicating vars in BVHOverlapData_Thread */
@@ -527,6 +544,63 @@ static void refit_kdop_hull(const BVHTree *tree, BVHNode *node, int start, int e
 
 }
 
+/* Ranges of leafs bigger than this get their bounds computed by multiple threads,
+ * for the first levels of big trees, which have too few branches to build them in parallel.
+ * Note that BLI_task_parallel_range can only be used from the main thread. */
+#define KDOPBVH_REFIT_THREAD_LEAF_THRESHOLD 65536
+
+typedef struct RefitKdopHullData {
+	const BVHTree *tree;
+	float *bv;
+} RefitKdopHullData;
+
+static void refit_kdop_hull_task_cb(void *userdata, void *userdata_chunk, const int j, const int UNUSED(thread_id))
+{
+	const RefitKdopHullData *data = userdata;
+	const BVHTree *tree = data->tree;
+	float *bv = userdata_chunk;
+	axis_t axis_iter;
+
+	for (axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
+		bv[(2 * axis_iter)] = min_ff(bv[(2 * axis_iter)], tree->nodes[j]->bv[(2 * axis_iter)]);
+		bv[(2 * axis_iter) + 1] = max_ff(bv[(2 * axis_iter) + 1], tree->nodes[j]->bv[(2 * axis_iter) + 1]);
+	}
+}
+
+static void refit_kdop_hull_finalize(void *userdata, void *userdata_chunk)
+{
+	const RefitKdopHullData *data = userdata;
+	const BVHTree *tree = data->tree;
+	const float *bv = userdata_chunk;
+	axis_t axis_iter;
+
+	for (axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
+		data->bv[(2 * axis_iter)] = min_ff(data->bv[(2 * axis_iter)], bv[(2 * axis_iter)]);
+		data->bv[(2 * axis_iter) + 1] = max_ff(data->bv[(2 * axis_iter) + 1], bv[(2 * axis_iter) + 1]);
+	}
+}
+
+/**
+ * Same as #refit_kdop_hull, using multiple threads for big ranges.
+ */
+static void refit_kdop_hull_threaded(const BVHTree *tree, BVHNode *node, int start, int end)
+{
+	if (end - start > KDOPBVH_REFIT_THREAD_LEAF_THRESHOLD) {
+		RefitKdopHullData data = {.tree = tree, .bv = node->bv};
+		float bv_chunk[26];
+
+		node_minmax_init(tree, node);
+		memcpy(bv_chunk, node->bv, sizeof(float) * tree->axis);
+
+		BLI_task_parallel_range_finalize(
+		        start, end, &data, bv_chunk, sizeof(float) * tree->axis,
+		        refit_kdop_hull_task_cb, refit_kdop_hull_finalize, true, false);
+	}
+	else {
+		refit_kdop_hull(tree, node, start, end);
+	}
+}
+
 /**
  * only supports x,y,z axis in the moment
  * but we should use a plain and simple function here for speed sake */
@@ -796,6 +870,9 @@ typedef struct BVHDivNodesData {
 	int depth;
 	int i;
 	int first_of_next_level;
+
+	/* Compute bounds of each branch with multiple threads, only when branches are built from the main thread. */
+	bool use_threaded_refit;
 } BVHDivNodesData;
 
 static void non_recursive_bvh_div_nodes_task_cb(void *userdata, const int j)
@@ -813,7 +890,12 @@ static void non_recursive_bvh_div_nodes_task_cb(void *userdata, const int j)
 
 	/* This calculates the bounding box of this branch
 	 * and chooses the largest axis as the axis to divide leafs */
-	refit_kdop_hull(data->tree, parent, parent_leafs_begin, parent_leafs_end);
+	if (data->use_threaded_refit) {
+		refit_kdop_hull_threaded(data->tree, parent, parent_leafs_begin, parent_leafs_end);
+	}
+	else {
+		refit_kdop_hull(data->tree, parent, parent_leafs_begin, parent_leafs_end);
+	}
 	split_axis = get_largest_axis(parent->bv);
 
 	/* Save split axis (this can be used on raytracing to speedup the query time) */
@@ -885,6 +967,7 @@ static void non_recursive_bvh_div_nodes(
 
 	BVHBuildHelper data;
 	int depth;
+	const int num_threads = BLI_task_scheduler_num_threads(BLI_task_scheduler_get());
 	
 	/* set parent from root node to NULL */
 	BVHNode *tmp = &branches_array[0];
@@ -910,6 +993,7 @@ static void non_recursive_bvh_div_nodes(
 		.tree = tree, .branches_array = branches_array, .leafs_array = leafs_array,
 		.tree_type = tree_type, .tree_offset = tree_offset, .data = &data,
 		.first_of_next_level = 0, .depth = 0, .i = 0,
+		.use_threaded_refit = false,
 	};
 
 	/* Loop tree levels (log N) loops */
@@ -922,7 +1006,16 @@ static void non_recursive_bvh_div_nodes(
 		cb_data.i = i;
 		cb_data.depth = depth;
 
-		if (true) {
+		if ((i_stop - i < num_threads) && (num_leafs > KDOPBVH_REFIT_THREAD_LEAF_THRESHOLD)) {
+			/* First levels of big trees: too few branches to keep all threads busy,
+			 * build them from the main thread and compute their bounds in parallel instead. */
+			cb_data.use_threaded_refit = true;
+			for (int i_task = i; i_task < i_stop; i_task++) {
+				non_recursive_bvh_div_nodes_task_cb(&cb_data, i_task);
+			}
+			cb_data.use_threaded_refit = false;
+		}
+		else if (true) {
 			BLI_task_parallel_range(
 			        i, i_stop, &cb_data, non_recursive_bvh_div_nodes_task_cb,
 			        num_leafs > KDOPBVH_THREAD_LEAF_THRESHOLD);
@@ -939,15 +1032,378 @@ static void non_recursive_bvh_div_nodes(
 /** \} */
 
 
+/* -------------------------------------------------------------------- */
+
+/** \name SAH Build
+ *
+ * Top-down build splitting leafs with the surface area heuristic, used with #BVH_BUILD_SAH.
+ *
+ * Leafs are binned along the largest axis of their centroids bounds, each branch is split
+ * in (up to) tree_type parts by splitting its biggest part until there are enough of them.
+ * Unlike the implicit tree, branches can have any number of leafs, their indices are
+ * taken from a counter as they are created so children always come after their parent.
+ *
+ * Subtrees are built in parallel by a task pool, the bounds and bins of the first
+ * (biggest) branch are computed by multiple threads.
+ * \{ */
+
+#define BVH_SAH_BINS 16
+
+typedef struct BVHSahBin {
+	float bv[6];
+	int totleaf;
+} BVHSahBin;
+
+typedef struct BVHSahBuildData {
+	const BVHTree *tree;
+	BVHNode *branches_array;
+	BVHNode **leafs_array;
+	int totbranch;
+	TaskPool *pool;
+} BVHSahBuildData;
+
+typedef struct BVHSahBuildTask {
+	BVHNode *node;
+	int begin, end;
+} BVHSahBuildTask;
+
+/* Data of the leafs passes which are done with BLI_task_parallel_range. */
+typedef struct BVHSahRangeData {
+	BVHNode **leafs_array;
+	/* bins mapping, only for the bins pass */
+	int axis;
+	float cent_min, bin_scale;
+	/* output */
+	float *cent_bv;
+	BVHSahBin *bins;
+} BVHSahRangeData;
+
+BLI_INLINE float bvh_sah_leaf_centroid(const BVHNode *leaf, const int axis)
+{
+	return (leaf->bv[2 * axis] + leaf->bv[2 * axis + 1]) * 0.5f;
+}
+
+BLI_INLINE int bvh_sah_leaf_bin(const BVHNode *leaf, const int axis, const float cent_min, const float bin_scale)
+{
+	const int bin = (int)((bvh_sah_leaf_centroid(leaf, axis) - cent_min) * bin_scale);
+	return CLAMPIS(bin, 0, BVH_SAH_BINS - 1);
+}
+
+static float bvh_sah_half_area(const float bv[6])
+{
+	const float d[3] = {bv[1] - bv[0], bv[3] - bv[2], bv[5] - bv[4]};
+	if (d[0] < 0.0f || d[1] < 0.0f || d[2] < 0.0f) {
+		return 0.0f;
+	}
+	return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+static void bvh_sah_bv_init(float bv[6])
+{
+	for (int axis = 0; axis < 3; axis++) {
+		bv[2 * axis] = FLT_MAX;
+		bv[2 * axis + 1] = -FLT_MAX;
+	}
+}
+
+static void bvh_sah_bv_join(float bv[6], const float bv_other[6])
+{
+	for (int axis = 0; axis < 3; axis++) {
+		bv[2 * axis] = min_ff(bv[2 * axis], bv_other[2 * axis]);
+		bv[2 * axis + 1] = max_ff(bv[2 * axis + 1], bv_other[2 * axis + 1]);
+	}
+}
+
+static void bvh_sah_centroid_bv_cb(void *userdata, void *userdata_chunk, const int j, const int UNUSED(thread_id))
+{
+	const BVHSahRangeData *data = userdata;
+	float *cent_bv = userdata_chunk;
+
+	for (int axis = 0; axis < 3; axis++) {
+		const float cent = bvh_sah_leaf_centroid(data->leafs_array[j], axis);
+		cent_bv[2 * axis] = min_ff(cent_bv[2 * axis], cent);
+		cent_bv[2 * axis + 1] = max_ff(cent_bv[2 * axis + 1], cent);
+	}
+}
+
+static void bvh_sah_centroid_bv_finalize(void *userdata, void *userdata_chunk)
+{
+	const BVHSahRangeData *data = userdata;
+	bvh_sah_bv_join(data->cent_bv, userdata_chunk);
+}
+
+static void bvh_sah_bins_cb(void *userdata, void *userdata_chunk, const int j, const int UNUSED(thread_id))
+{
+	const BVHSahRangeData *data = userdata;
+	BVHSahBin *bins = userdata_chunk;
+	const BVHNode *leaf = data->leafs_array[j];
+	BVHSahBin *bin = &bins[bvh_sah_leaf_bin(leaf, data->axis, data->cent_min, data->bin_scale)];
+
+	bvh_sah_bv_join(bin->bv, leaf->bv);
+	bin->totleaf++;
+}
+
+static void bvh_sah_bins_finalize(void *userdata, void *userdata_chunk)
+{
+	const BVHSahRangeData *data = userdata;
+	const BVHSahBin *bins = userdata_chunk;
+
+	for (int i = 0; i < BVH_SAH_BINS; i++) {
+		bvh_sah_bv_join(data->bins[i].bv, bins[i].bv);
+		data->bins[i].totleaf += bins[i].totleaf;
+	}
+}
+
+/**
+ * Split leafs in [begin, end) in two parts, using the surface area heuristic.
+ *
+ * \param use_threading: Compute the centroid bounds and bins with multiple threads,
+ * only allowed from the main thread.
+ * \return the first leaf of the second part, always between \a begin and \a end (exclusive).
+ */
+static int bvh_sah_split(BVHNode **leafs_array, int begin, int end, int *r_axis, const bool use_threading)
+{
+	BVHSahRangeData data = {.leafs_array = leafs_array};
+	BVHSahBin bins[BVH_SAH_BINS];
+	float cent_bv[6], bv_right[6];
+	float cost_right[BVH_SAH_BINS];
+	int totleaf_right[BVH_SAH_BINS];
+	float cost_best = FLT_MAX;
+	int split_best = -1;
+	int axis = 0, i, j;
+
+	BLI_assert(end - begin > 1);
+
+	bvh_sah_bv_init(cent_bv);
+	data.cent_bv = cent_bv;
+	{
+		float cent_bv_chunk[6];
+		bvh_sah_bv_init(cent_bv_chunk);
+		BLI_task_parallel_range_finalize(
+		        begin, end, &data, cent_bv_chunk, sizeof(cent_bv_chunk),
+		        bvh_sah_centroid_bv_cb, bvh_sah_centroid_bv_finalize, use_threading, false);
+	}
+
+	for (i = 1; i < 3; i++) {
+		if (cent_bv[2 * i + 1] - cent_bv[2 * i] > cent_bv[2 * axis + 1] - cent_bv[2 * axis]) {
+			axis = i;
+		}
+	}
+	*r_axis = axis;
+
+	/* All centroids at the same place, any split is as good as the others. */
+	if (!(cent_bv[2 * axis + 1] - cent_bv[2 * axis] > 0.0f)) {
+		return begin + (end - begin) / 2;
+	}
+
+	data.axis = axis;
+	data.cent_min = cent_bv[2 * axis];
+	data.bin_scale = (float)BVH_SAH_BINS / (cent_bv[2 * axis + 1] - cent_bv[2 * axis]);
+	data.bins = bins;
+	for (i = 0; i < BVH_SAH_BINS; i++) {
+		bvh_sah_bv_init(bins[i].bv);
+		bins[i].totleaf = 0;
+	}
+	{
+		BVHSahBin bins_chunk[BVH_SAH_BINS];
+		memcpy(bins_chunk, bins, sizeof(bins));
+		BLI_task_parallel_range_finalize(
+		        begin, end, &data, bins_chunk, sizeof(bins_chunk),
+		        bvh_sah_bins_cb, bvh_sah_bins_finalize, use_threading, false);
+	}
+
+	/* Sweep from the right, then from the left to find the cheapest split plane,
+	 * split i puts bins [0, i] on the left. */
+	bvh_sah_bv_init(bv_right);
+	for (i = BVH_SAH_BINS - 1, j = 0; i > 0; i--) {
+		bvh_sah_bv_join(bv_right, bins[i].bv);
+		j += bins[i].totleaf;
+		cost_right[i - 1] = bvh_sah_half_area(bv_right) * (float)j;
+		totleaf_right[i - 1] = j;
+	}
+	{
+		float bv_left[6];
+		bvh_sah_bv_init(bv_left);
+		for (i = 0, j = 0; i < BVH_SAH_BINS - 1; i++) {
+			bvh_sah_bv_join(bv_left, bins[i].bv);
+			j += bins[i].totleaf;
+			if (j != 0 && totleaf_right[i] != 0) {
+				const float cost = bvh_sah_half_area(bv_left) * (float)j + cost_right[i];
+				if (cost < cost_best) {
+					cost_best = cost;
+					split_best = i;
+				}
+			}
+		}
+	}
+
+	/* Centroids spread over a single bin (can only happen with float precision issues). */
+	if (split_best == -1) {
+		return begin + (end - begin) / 2;
+	}
+
+	/* Partition the leafs, on both sides of the split plane. */
+	i = begin;
+	j = end - 1;
+	while (true) {
+		while (i <= j && bvh_sah_leaf_bin(leafs_array[i], axis, data.cent_min, data.bin_scale) <= split_best) {
+			i++;
+		}
+		while (i <= j && bvh_sah_leaf_bin(leafs_array[j], axis, data.cent_min, data.bin_scale) > split_best) {
+			j--;
+		}
+		if (i >= j) {
+			break;
+		}
+		SWAP(BVHNode *, leafs_array[i], leafs_array[j]);
+	}
+
+	BLI_assert(i > begin && i < end);
+	return i;
+}
+
+static void bvh_sah_build_branch(
+        BVHSahBuildData *data, BVHNode *node, const int begin, const int end,
+        const int thread_id, const bool use_threading);
+
+static void bvh_sah_build_task_cb(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+	BVHSahBuildData *data = BLI_task_pool_userdata(pool);
+	BVHSahBuildTask *task = taskdata;
+
+	bvh_sah_build_branch(data, task->node, task->begin, task->end, threadid, false);
+}
+
+/**
+ * Build the branch \a node, from leafs in [begin, end).
+ */
+static void bvh_sah_build_branch(
+        BVHSahBuildData *data, BVHNode *node, const int begin, const int end,
+        const int thread_id, const bool use_threading)
+{
+	const BVHTree *tree = data->tree;
+	int nth[MAX_TREETYPE + 1];
+	int totpart = 1;
+	int k;
+
+	BLI_assert(end - begin > 1);
+
+	if (use_threading) {
+		refit_kdop_hull_threaded(tree, node, begin, end);
+	}
+	else {
+		refit_kdop_hull(tree, node, begin, end);
+	}
+	node->main_axis = (char)(get_largest_axis(node->bv) / 2);
+
+	/* Split the biggest part until there are tree_type of them. */
+	nth[0] = begin;
+	nth[1] = end;
+	while (totpart < tree->tree_type) {
+		int part = 0, split, axis;
+
+		for (k = 1; k < totpart; k++) {
+			if (nth[k + 1] - nth[k] > nth[part + 1] - nth[part]) {
+				part = k;
+			}
+		}
+		if (nth[part + 1] - nth[part] < 2) {
+			break;
+		}
+
+		split = bvh_sah_split(
+		        data->leafs_array, nth[part], nth[part + 1], &axis,
+		        use_threading && (nth[part + 1] - nth[part] > KDOPBVH_REFIT_THREAD_LEAF_THRESHOLD));
+
+		/* The first split separates all the children, use it to order the traversal. */
+		if (totpart == 1) {
+			node->main_axis = (char)axis;
+		}
+
+		memmove(&nth[part + 2], &nth[part + 1], sizeof(*nth) * (size_t)(totpart - part));
+		nth[part + 1] = split;
+		totpart++;
+	}
+
+	/* Setup children, new branches take the next free indices. */
+	for (k = 0; k < totpart; k++) {
+		BVHNode *child;
+
+		if (nth[k + 1] - nth[k] == 1) {
+			child = data->leafs_array[nth[k]];
+		}
+		else {
+			child = &data->branches_array[atomic_fetch_and_add_int32(&data->totbranch, 1)];
+		}
+		child->parent = node;
+		node->children[k] = child;
+	}
+	node->totnode = (char)totpart;
+
+	for (k = 0; k < totpart; k++) {
+		const int child_totleaf = nth[k + 1] - nth[k];
+
+		if (child_totleaf == 1) {
+			continue;
+		}
+		if (child_totleaf > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+			BVHSahBuildTask *task = MEM_mallocN(sizeof(*task), __func__);
+			task->node = node->children[k];
+			task->begin = nth[k];
+			task->end = nth[k + 1];
+			BLI_task_pool_push_from_thread(
+			        data->pool, bvh_sah_build_task_cb, task, true, TASK_PRIORITY_HIGH, thread_id);
+		}
+		else {
+			bvh_sah_build_branch(data, node->children[k], nth[k], nth[k + 1], thread_id, false);
+		}
+	}
+}
+
+/**
+ * Build the tree with #BVH_BUILD_SAH, the root is the first branch.
+ *
+ * \return the number of branches.
+ */
+static int bvh_sah_build(const BVHTree *tree, BVHNode *branches_array, BVHNode **leafs_array, int num_leafs)
+{
+	BVHSahBuildData data = {
+		.tree = tree, .branches_array = branches_array, .leafs_array = leafs_array,
+		.totbranch = 1,
+	};
+	BVHNode *root = &branches_array[0];
+
+	BLI_assert(num_leafs > 1);
+	BLI_assert(tree->start_axis == 0);
+
+	root->parent = NULL;
+
+	if (num_leafs > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+		data.pool = BLI_task_pool_create(BLI_task_scheduler_get(), &data);
+		bvh_sah_build_branch(&data, root, 0, num_leafs, 0, true);
+		BLI_task_pool_work_and_wait(data.pool);
+		BLI_task_pool_free(data.pool);
+	}
+	else {
+		bvh_sah_build_branch(&data, root, 0, num_leafs, 0, false);
+	}
+
+	return data.totbranch;
+}
+
+/** \} */
+
+
 /* -------------------------------------------------------------------- */
 
 /** \name BLI_bvhtree API
  * \{ */
 
 /**
+ * \param flag: #BVH_BUILD_SAH and such.
  * \note many callers don't check for ``NULL`` return.
  */
-BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
+BVHTree *BLI_bvhtree_new_ex(int maxsize, float epsilon, char tree_type, char axis, int flag)
 {
 	BVHTree *tree;
 	int numnodes, i;
@@ -965,6 +1421,7 @@ BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
 		tree->epsilon = epsilon;
 		tree->tree_type = tree_type;
 		tree->axis = axis;
+		tree->flag = (char)flag;
 
 		if (axis == 26) {
 			tree->start_axis = 0;
@@ -995,7 +1452,13 @@ BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
 
 
 		/* Allocate arrays */
-		numnodes = maxsize + implicit_needed_branches(tree_type, maxsize) + tree_type;
+		if (flag & BVH_BUILD_SAH) {
+			/* Branches may have only two children. */
+			numnodes = maxsize + max_ii(implicit_needed_branches(tree_type, maxsize), maxsize - 1) + tree_type;
+		}
+		else {
+			numnodes = maxsize + implicit_needed_branches(tree_type, maxsize) + tree_type;
+		}
 
 		tree->nodes = MEM_callocN(sizeof(BVHNode *) * (size_t)numnodes, "BVHNodes");
 		tree->nodebv = MEM_callocN(sizeof(float) * (size_t)(axis * numnodes), "BVHNodeBV");
@@ -1031,6 +1494,11 @@ fail:
 	return NULL;
 }
 
+BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
+{
+	return BLI_bvhtree_new_ex(maxsize, epsilon, tree_type, axis, 0);
+}
+
 void BLI_bvhtree_free(BVHTree *tree)
 {
 	if (tree) {
@@ -1053,12 +1521,17 @@ void BLI_bvhtree_balance(BVHTree *tree)
 	 * (some big bug goes here if its being called more than once per tree) */
 	BLI_assert(tree->totbranch == 0);
 
-	/* Build the implicit tree */
-	non_recursive_bvh_div_nodes(tree, branches_array, leafs_array, tree->totleaf);
+	if ((tree->flag & BVH_BUILD_SAH) && (tree->totleaf > 1) && (tree->start_axis == 0)) {
+		tree->totbranch = bvh_sah_build(tree, branches_array, leafs_array, tree->totleaf);
+	}
+	else {
+		/* Build the implicit tree */
+		non_recursive_bvh_div_nodes(tree, branches_array, leafs_array, tree->totleaf);
+		tree->totbranch = implicit_needed_branches(tree->tree_type, tree->totleaf);
+	}
 
 	/* current code expects the branches to be linked to the nodes array
 	 * we perform that linkage here */
-	tree->totbranch = implicit_needed_branches(tree->tree_type, tree->totleaf);
 	for (i = 0; i < tree->totbranch; i++)
 		tree->nodes[tree->totleaf + i] = branches_array + i;
 
@@ -1151,6 +1624,54 @@ float BLI_bvhtree_get_epsilon(const BVHTree *tree)
 	return tree->epsilon;
 }
 
+static void bvhtree_calc_stats_recursive(
+        const BVHTree *tree, const BVHNode *node, const int depth, const float area_root_inv,
+        BVHTreeStats *r_stats, float *r_depth_sum)
+{
+	if (area_root_inv != 0.0f) {
+		r_stats->sah_cost += bvh_sah_half_area(node->bv) * area_root_inv;
+	}
+
+	if (node->totnode == 0) {
+		r_stats->totleaf++;
+		r_stats->depth_max = max_ii(r_stats->depth_max, depth);
+		*r_depth_sum += (float)depth;
+	}
+	else {
+		r_stats->totbranch++;
+		for (int i = 0; i < node->totnode; i++) {
+			bvhtree_calc_stats_recursive(tree, node->children[i], depth + 1, area_root_inv, r_stats, r_depth_sum);
+		}
+	}
+}
+
+/**
+ * Calculate statistics on the tree quality, to compare build methods.
+ * The depth of leafs directly under the root is one.
+ *
+ * \note The surface area cost is only calculated for trees including the xyz axes.
+ */
+void BLI_bvhtree_calc_stats(const BVHTree *tree, BVHTreeStats *r_stats)
+{
+	memset(r_stats, 0, sizeof(*r_stats));
+
+	if (tree->totleaf != 0) {
+		const BVHNode *root = tree->nodes[tree->totleaf];
+		float area_root_inv = 0.0f;
+		float depth_sum = 0.0f;
+
+		if (tree->start_axis == 0) {
+			const float area_root = bvh_sah_half_area(root->bv);
+			if (area_root > 0.0f) {
+				area_root_inv = 1.0f / area_root;
+			}
+		}
+
+		bvhtree_calc_stats_recursive(tree, root, 0, area_root_inv, r_stats, &depth_sum);
+		r_stats->depth_avg = depth_sum / (float)r_stats->totleaf;
+	}
+}
+
 /** \} */
 
 
@@ -1544,33 +2065,41 @@ static void bfs_find_nearest(BVHNearestData *data, BVHNode *node)
 #endif
 
 
-int BLI_bvhtree_find_nearest(
-        BVHTree *tree, const float co[3], BVHTreeNearest *nearest,
+static void bvhtree_find_nearest_data_init(
+        BVHNearestData *data,
+        const BVHTree *tree, const float co[3], const BVHTreeNearest *nearest,
         BVHTree_NearestPointCallback callback, void *userdata)
 {
 	axis_t axis_iter;
 
-	BVHNearestData data;
-	BVHNode *root = tree->nodes[tree->totleaf];
-
 	/* init data to search */
-	data.tree = tree;
-	data.co = co;
+	data->tree = tree;
+	data->co = co;
 
-	data.callback = callback;
-	data.userdata = userdata;
+	data->callback = callback;
+	data->userdata = userdata;
 
-	for (axis_iter = data.tree->start_axis; axis_iter != data.tree->stop_axis; axis_iter++) {
-		data.proj[axis_iter] = dot_v3v3(data.co, bvhtree_kdop_axes[axis_iter]);
+	for (axis_iter = data->tree->start_axis; axis_iter != data->tree->stop_axis; axis_iter++) {
+		data->proj[axis_iter] = dot_v3v3(data->co, bvhtree_kdop_axes[axis_iter]);
 	}
 
 	if (nearest) {
-		memcpy(&data.nearest, nearest, sizeof(*nearest));
+		memcpy(&data->nearest, nearest, sizeof(*nearest));
 	}
 	else {
-		data.nearest.index = -1;
-		data.nearest.dist_sq = FLT_MAX;
+		data->nearest.index = -1;
+		data->nearest.dist_sq = FLT_MAX;
 	}
+}
+
+int BLI_bvhtree_find_nearest(
+        BVHTree *tree, const float co[3], BVHTreeNearest *nearest,
+        BVHTree_NearestPointCallback callback, void *userdata)
+{
+	BVHNearestData data;
+	BVHNode *root = tree->nodes[tree->totleaf];
+
+	bvhtree_find_nearest_data_init(&data, tree, co, nearest, callback, userdata);
 
 	/* dfs search */
 	if (root)
@@ -1792,34 +2321,43 @@ static void bvhtree_ray_cast_data_precalc(BVHRayCastData *data, int flag)
 #endif
 }
 
-int BLI_bvhtree_ray_cast_ex(
-        BVHTree *tree, const float co[3], const float dir[3], float radius, BVHTreeRayHit *hit,
+static void bvhtree_ray_cast_data_init(
+        BVHRayCastData *data,
+        const BVHTree *tree, const float co[3], const float dir[3], float radius, const BVHTreeRayHit *hit,
         BVHTree_RayCastCallback callback, void *userdata,
         int flag)
 {
-	BVHRayCastData data;
-	BVHNode *root = tree->nodes[tree->totleaf];
-
 	BLI_ASSERT_UNIT_V3(dir);
 
-	data.tree = tree;
+	data->tree = tree;
 
-	data.callback = callback;
-	data.userdata = userdata;
+	data->callback = callback;
+	data->userdata = userdata;
 
-	copy_v3_v3(data.ray.origin,    co);
-	copy_v3_v3(data.ray.direction, dir);
-	data.ray.radius = radius;
+	copy_v3_v3(data->ray.origin,    co);
+	copy_v3_v3(data->ray.direction, dir);
+	data->ray.radius = radius;
 
-	bvhtree_ray_cast_data_precalc(&data, flag);
+	bvhtree_ray_cast_data_precalc(data, flag);
 
 	if (hit) {
-		memcpy(&data.hit, hit, sizeof(*hit));
+		memcpy(&data->hit, hit, sizeof(*hit));
 	}
 	else {
-		data.hit.index = -1;
-		data.hit.dist = BVH_RAYCAST_DIST_MAX;
+		data->hit.index = -1;
+		data->hit.dist = BVH_RAYCAST_DIST_MAX;
 	}
+}
+
+int BLI_bvhtree_ray_cast_ex(
+        BVHTree *tree, const float co[3], const float dir[3], float radius, BVHTreeRayHit *hit,
+        BVHTree_RayCastCallback callback, void *userdata,
+        int flag)
+{
+	BVHRayCastData data;
+	BVHNode *root = tree->nodes[tree->totleaf];
+
+	bvhtree_ray_cast_data_init(&data, tree, co, dir, radius, hit, callback, userdata, flag);
 
 	if (root) {
 		dfs_raycast(&data, root);
@@ -1911,6 +2449,534 @@ void BLI_bvhtree_ray_cast_all(
 }
 
 
+/* -------------------------------------------------------------------- */
+
+/** \name BLI_bvhtree_ray_cast_batch / BLI_bvhtree_find_nearest_batch
+ *
+ * Batched queries, run in parallel over a temporary "wide" copy of the tree,
+ * where each node stores the axis aligned bounds of its (up to 4) children in SoA form,
+ * so all children of a node are tested at once using SIMD.
+ *
+ * Ray-cast and find-nearest only use the x, y & z slabs of the k-DOP's,
+ * so the wide tree gives the same results as the regular queries.
+ * It can only be built when the tree has those axes (all kinds but 18-DOP's).
+ *
+ * \{ */
+
+#define BVH_WIDE_LANES 4
+
+/* Value of BVHNodeWide.children for unused lanes. */
+#define BVH_WIDE_EMPTY INT_MIN
+/* Leafs are stored as negative values, their index in BVHTree.nodearray. */
+#define BVH_WIDE_LEAF_ENCODE(i) (-(i) - 1)
+#define BVH_WIDE_LEAF_DECODE(c) (-(c) - 1)
+
+/* Below that number of queries the wide tree isn't worth building. */
+#define BVH_WIDE_QUERIES_MIN 64
+
+typedef struct BVHNodeWide {
+	/* Bounds (min x, max x, min y, max y, min z, max z) of the children. */
+	float bv[6][BVH_WIDE_LANES];
+	/* Index of a wide node, or a leaf (see BVH_WIDE_LEAF_ENCODE). */
+	int children[BVH_WIDE_LANES];
+} BVHNodeWide;
+
+typedef struct BVHTreeWide {
+	const BVHTree *tree;
+	BVHNodeWide *nodes;
+	int totnode, nodes_alloc;
+	/* Number of levels, to size the traversal stacks. */
+	int depth;
+} BVHTreeWide;
+
+typedef struct BVHStackWide {
+	int child;
+	float dist;
+} BVHStackWide;
+
+static bool bvhtree_wide_supported(const BVHTree *tree)
+{
+	return (tree->start_axis == 0) && (tree->totleaf != 0);
+}
+
+static float bvhtree_node_area(const BVHNode *node)
+{
+	const float *bv = node->bv;
+	const float dims[3] = {bv[1] - bv[0], bv[3] - bv[2], bv[5] - bv[4]};
+	return dims[0] * dims[1] + dims[1] * dims[2] + dims[2] * dims[0];
+}
+
+static int bvhtree_wide_node_add(BVHTreeWide *wide)
+{
+	if (wide->totnode == wide->nodes_alloc) {
+		BVHNodeWide *nodes_prev = wide->nodes;
+		wide->nodes_alloc *= 2;
+		wide->nodes = MEM_mallocN_aligned(sizeof(*wide->nodes) * (size_t)wide->nodes_alloc, 16, __func__);
+		memcpy(wide->nodes, nodes_prev, sizeof(*wide->nodes) * (size_t)wide->totnode);
+		MEM_freeN(nodes_prev);
+	}
+	return wide->totnode++;
+}
+
+/**
+ * Create a wide node with \a items as children.
+ *
+ * Small nodes (binary trees) are filled by pulling grand-children up,
+ * big ones (8-ary trees and more) get their children spread over intermediate wide nodes.
+ */
+static int bvhtree_wide_build_node(BVHTreeWide *wide, const BVHNode **items_src, int items_len, int depth)
+{
+	const BVHTree *tree = wide->tree;
+	const BVHNode *items[MAX_TREETYPE];
+	float bv[6][BVH_WIDE_LANES];
+	int children[BVH_WIDE_LANES];
+	const int node_index = bvhtree_wide_node_add(wide);
+	int lane, i;
+
+	wide->depth = max_ii(wide->depth, depth);
+
+	memcpy(items, items_src, sizeof(*items) * (size_t)items_len);
+
+	/* Open the biggest branches while their children fit. */
+	while (items_len < BVH_WIDE_LANES) {
+		float area_best = -1.0f;
+		int i_best = -1;
+
+		for (i = 0; i < items_len; i++) {
+			if (items[i]->totnode != 0 && items_len - 1 + items[i]->totnode <= BVH_WIDE_LANES) {
+				const float area = bvhtree_node_area(items[i]);
+				if (area > area_best) {
+					area_best = area;
+					i_best = i;
+				}
+			}
+		}
+		if (i_best == -1) {
+			break;
+		}
+
+		{
+			const BVHNode *branch = items[i_best];
+			memmove(&items[i_best + branch->totnode], &items[i_best + 1], sizeof(*items) * (size_t)(items_len - (i_best + 1)));
+			memcpy(&items[i_best], branch->children, sizeof(*items) * (size_t)branch->totnode);
+			items_len += branch->totnode - 1;
+		}
+	}
+
+	for (lane = 0; lane < BVH_WIDE_LANES; lane++) {
+		/* Split the items evenly between lanes, lanes without items stay empty. */
+		const int begin = (items_len <= BVH_WIDE_LANES) ? lane : (items_len * lane) / BVH_WIDE_LANES;
+		const int end = (items_len <= BVH_WIDE_LANES) ? min_ii(lane + 1, items_len) : (items_len * (lane + 1)) / BVH_WIDE_LANES;
+		axis_t axis_iter;
+
+		for (axis_iter = 0; axis_iter < 3; axis_iter++) {
+			bv[2 * axis_iter][lane] = FLT_MAX;
+			bv[2 * axis_iter + 1][lane] = -FLT_MAX;
+		}
+
+		for (i = begin; i < end; i++) {
+			for (axis_iter = 0; axis_iter < 3; axis_iter++) {
+				bv[2 * axis_iter][lane] = min_ff(bv[2 * axis_iter][lane], items[i]->bv[2 * axis_iter]);
+				bv[2 * axis_iter + 1][lane] = max_ff(bv[2 * axis_iter + 1][lane], items[i]->bv[2 * axis_iter + 1]);
+			}
+		}
+
+		if (end <= begin) {
+			children[lane] = BVH_WIDE_EMPTY;
+		}
+		else if (end - begin > 1) {
+			children[lane] = bvhtree_wide_build_node(wide, &items[begin], end - begin, depth + 1);
+		}
+		else if (items[begin]->totnode == 0) {
+			children[lane] = BVH_WIDE_LEAF_ENCODE((int)(items[begin] - tree->nodearray));
+		}
+		else {
+			children[lane] = bvhtree_wide_build_node(
+			        wide, (const BVHNode **)items[begin]->children, items[begin]->totnode, depth + 1);
+		}
+	}
+
+	/* Wide nodes may have been reallocated by the recursion. */
+	memcpy(wide->nodes[node_index].bv, bv, sizeof(bv));
+	memcpy(wide->nodes[node_index].children, children, sizeof(children));
+
+	return node_index;
+}
+
+static void bvhtree_wide_build(BVHTreeWide *wide, const BVHTree *tree)
+{
+	const BVHNode *root = tree->nodes[tree->totleaf];
+
+	wide->tree = tree;
+	wide->totnode = 0;
+	wide->depth = 0;
+	/* 4-ary trees map one to one, others need some more or less nodes. */
+	wide->nodes_alloc = max_ii(1, tree->totbranch);
+	wide->nodes = MEM_mallocN_aligned(sizeof(*wide->nodes) * (size_t)wide->nodes_alloc, 16, __func__);
+
+	bvhtree_wide_build_node(wide, (const BVHNode **)root->children, root->totnode, 1);
+}
+
+static void bvhtree_wide_free(BVHTreeWide *wide)
+{
+	MEM_freeN(wide->nodes);
+}
+
+/* Enough for (BVH_WIDE_LANES - 1) siblings per level, and the children of the deepest node. */
+BLI_INLINE int bvhtree_wide_stack_size(const BVHTreeWide *wide)
+{
+	return wide->depth * BVH_WIDE_LANES + 1;
+}
+
+/**
+ * Push the children of a node which passed the test, with their distance,
+ * ordered so the closest one gets popped first.
+ */
+static int bvhtree_wide_stack_push(
+        BVHStackWide *stack, int stack_len,
+        const BVHNodeWide *node, const float dist[BVH_WIDE_LANES], int mask)
+{
+	const int stack_begin = stack_len;
+	int lane;
+
+	for (lane = 0; mask; lane++, mask >>= 1) {
+		if (mask & 1) {
+			int i = stack_len++;
+			/* Insertion sort, far to near. */
+			for (; i > stack_begin && stack[i - 1].dist < dist[lane]; i--) {
+				stack[i] = stack[i - 1];
+			}
+			stack[i].child = node->children[lane];
+			stack[i].dist = dist[lane];
+		}
+	}
+
+	return stack_len;
+}
+
+/**
+ * Like #fast_ray_nearest_hit, rays without radius give negative distances when starting inside bounds.
+ */
+BLI_INLINE float bvhtree_wide_ray_dist_min(const BVHRayCastData *data)
+{
+	return (data->ray.radius == 0.0f) ? -FLT_MAX : 0.0f;
+}
+
+/**
+ * Distance along the ray to the bounds of all children of \a node,
+ * same test as #ray_nearest_hit (or #fast_ray_nearest_hit for rays without radius).
+ *
+ * \return a bit-mask of the children which are hit closer than the current hit.
+ */
+static int wide_ray_nearest_hit(const BVHRayCastData *data, const BVHNodeWide *node, float r_dist[BVH_WIDE_LANES])
+{
+	int axis;
+
+#ifdef __SSE2__
+	const __m128 radius = _mm_set1_ps(data->ray.radius);
+	const __m128 hit_dist = _mm_set1_ps(data->hit.dist);
+	__m128 low = _mm_set1_ps(bvhtree_wide_ray_dist_min(data));
+	__m128 upper = hit_dist;
+	__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+	for (axis = 0; axis != 3; axis++) {
+		const __m128 origin = _mm_set1_ps(data->ray.origin[axis]);
+		if (data->ray_dot_axis[axis] == 0.0f) {
+			/* axis aligned ray */
+			const __m128 bv_min = _mm_sub_ps(_mm_load_ps(node->bv[2 * axis]), radius);
+			const __m128 bv_max = _mm_add_ps(_mm_load_ps(node->bv[2 * axis + 1]), radius);
+			inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(origin, bv_min), _mm_cmple_ps(origin, bv_max)));
+		}
+		else {
+			/* near and far slabs depend on the ray direction */
+			const __m128 idot_axis = _mm_set1_ps(data->idot_axis[axis]);
+			const __m128 radius_near = (data->idot_axis[axis] > 0.0f) ? _mm_sub_ps(_mm_setzero_ps(), radius) : radius;
+			const __m128 bv_near = _mm_add_ps(_mm_load_ps(node->bv[data->index[2 * axis]]), radius_near);
+			const __m128 bv_far = _mm_sub_ps(_mm_load_ps(node->bv[data->index[2 * axis + 1]]), radius_near);
+			low = _mm_max_ps(low, _mm_mul_ps(_mm_sub_ps(bv_near, origin), idot_axis));
+			upper = _mm_min_ps(upper, _mm_mul_ps(_mm_sub_ps(bv_far, origin), idot_axis));
+		}
+	}
+
+	_mm_storeu_ps(r_dist, low);
+	inside = _mm_and_ps(inside, _mm_cmpge_ps(upper, _mm_setzero_ps()));
+	return _mm_movemask_ps(_mm_and_ps(inside, _mm_and_ps(_mm_cmple_ps(low, upper), _mm_cmplt_ps(low, hit_dist))));
+#else
+	int lane, mask = 0;
+
+	for (lane = 0; lane < BVH_WIDE_LANES; lane++) {
+		float low = bvhtree_wide_ray_dist_min(data), upper = data->hit.dist;
+		bool inside = true;
+
+		for (axis = 0; axis != 3; axis++) {
+			const float *bv_min = &node->bv[2 * axis][lane], *bv_max = &node->bv[2 * axis + 1][lane];
+			if (data->ray_dot_axis[axis] == 0.0f) {
+				/* axis aligned ray */
+				if (data->ray.origin[axis] < *bv_min - data->ray.radius ||
+				    data->ray.origin[axis] > *bv_max + data->ray.radius)
+				{
+					inside = false;
+				}
+			}
+			else {
+				const float radius_near = (data->idot_axis[axis] > 0.0f) ? -data->ray.radius : data->ray.radius;
+				const float bv_near = node->bv[data->index[2 * axis]][lane] + radius_near;
+				const float bv_far = node->bv[data->index[2 * axis + 1]][lane] - radius_near;
+				low = max_ff(low, (bv_near - data->ray.origin[axis]) * data->idot_axis[axis]);
+				upper = min_ff(upper, (bv_far - data->ray.origin[axis]) * data->idot_axis[axis]);
+			}
+		}
+
+		r_dist[lane] = low;
+		if (inside && low <= upper && upper >= 0.0f && low < data->hit.dist) {
+			mask |= (1 << lane);
+		}
+	}
+	return mask;
+#endif
+}
+
+/**
+ * Squared distance from the query point to the bounds of all children of \a node,
+ * same as #calc_nearest_point_squared.
+ *
+ * \return a bit-mask of the children which are closer than the current nearest.
+ */
+static int wide_nearest_dist_squared(const BVHNearestData *data, const BVHNodeWide *node, float r_dist_sq[BVH_WIDE_LANES])
+{
+	int axis;
+
+#ifdef __SSE2__
+	__m128 dist_sq = _mm_setzero_ps();
+
+	for (axis = 0; axis != 3; axis++) {
+		const __m128 proj = _mm_set1_ps(data->proj[axis]);
+		const __m128 delta = _mm_max_ps(
+		        _mm_max_ps(_mm_sub_ps(_mm_load_ps(node->bv[2 * axis]), proj),
+		                   _mm_sub_ps(proj, _mm_load_ps(node->bv[2 * axis + 1]))),
+		        _mm_setzero_ps());
+		dist_sq = _mm_add_ps(dist_sq, _mm_mul_ps(delta, delta));
+	}
+
+	_mm_storeu_ps(r_dist_sq, dist_sq);
+	return _mm_movemask_ps(_mm_cmplt_ps(dist_sq, _mm_set1_ps(data->nearest.dist_sq)));
+#else
+	int lane, mask = 0;
+
+	for (lane = 0; lane < BVH_WIDE_LANES; lane++) {
+		float dist_sq = 0.0f;
+		for (axis = 0; axis != 3; axis++) {
+			const float delta = max_fff(node->bv[2 * axis][lane] - data->proj[axis],
+			                            data->proj[axis] - node->bv[2 * axis + 1][lane],
+			                            0.0f);
+			dist_sq += delta * delta;
+		}
+		r_dist_sq[lane] = dist_sq;
+		if (dist_sq < data->nearest.dist_sq) {
+			mask |= (1 << lane);
+		}
+	}
+	return mask;
+#endif
+}
+
+static void wide_raycast(const BVHTreeWide *wide, BVHRayCastData *data)
+{
+	BVHStackWide *stack = BLI_array_alloca(stack, (size_t)bvhtree_wide_stack_size(wide));
+	int stack_len = 1;
+
+	stack[0].child = 0;
+	stack[0].dist = 0.0f;
+
+	while (stack_len) {
+		const BVHStackWide item = stack[--stack_len];
+
+		/* the hit may have gotten closer since the item was pushed */
+		if (item.dist >= data->hit.dist) {
+			continue;
+		}
+
+		if (item.child >= 0) {
+			const BVHNodeWide *node = &wide->nodes[item.child];
+			float dist[BVH_WIDE_LANES];
+			const int mask = wide_ray_nearest_hit(data, node, dist);
+			stack_len = bvhtree_wide_stack_push(stack, stack_len, node, dist, mask);
+		}
+		else {
+			const BVHNode *leaf = &wide->tree->nodearray[BVH_WIDE_LEAF_DECODE(item.child)];
+			if (data->callback) {
+				data->callback(data->userdata, leaf->index, &data->ray, &data->hit);
+			}
+			else {
+				data->hit.index = leaf->index;
+				data->hit.dist  = item.dist;
+				madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, item.dist);
+			}
+		}
+	}
+}
+
+static void wide_find_nearest(const BVHTreeWide *wide, BVHNearestData *data)
+{
+	BVHStackWide *stack = BLI_array_alloca(stack, (size_t)bvhtree_wide_stack_size(wide));
+	int stack_len = 1;
+
+	stack[0].child = 0;
+	stack[0].dist = 0.0f;
+
+	while (stack_len) {
+		const BVHStackWide item = stack[--stack_len];
+
+		/* the nearest may have gotten closer since the item was pushed */
+		if (item.dist >= data->nearest.dist_sq) {
+			continue;
+		}
+
+		if (item.child >= 0) {
+			const BVHNodeWide *node = &wide->nodes[item.child];
+			float dist_sq[BVH_WIDE_LANES];
+			const int mask = wide_nearest_dist_squared(data, node, dist_sq);
+			stack_len = bvhtree_wide_stack_push(stack, stack_len, node, dist_sq, mask);
+		}
+		else {
+			BVHNode *leaf = &wide->tree->nodearray[BVH_WIDE_LEAF_DECODE(item.child)];
+			if (data->callback) {
+				data->callback(data->userdata, leaf->index, data->co, &data->nearest);
+			}
+			else {
+				data->nearest.index = leaf->index;
+				data->nearest.dist_sq = calc_nearest_point_squared(data->proj, leaf, data->nearest.co);
+			}
+		}
+	}
+}
+
+typedef struct BVHBatchData {
+	BVHTree *tree;
+	/* NULL when the regular queries are used. */
+	const BVHTreeWide *wide;
+
+	const float (*co)[3];
+	const float (*dir)[3];
+	float radius;
+	int flag;
+
+	BVHTreeRayHit *hit;
+	BVHTreeNearest *nearest;
+
+	BVHTree_RayCastCallback raycast_callback;
+	BVHTree_NearestPointCallback nearest_callback;
+	void *userdata;
+} BVHBatchData;
+
+static void bvhtree_ray_cast_batch_task_cb(void *userdata, const int i)
+{
+	const BVHBatchData *batch = userdata;
+
+	if (batch->wide) {
+		BVHRayCastData data;
+
+		bvhtree_ray_cast_data_init(
+		        &data, batch->tree, batch->co[i], batch->dir[i], batch->radius, &batch->hit[i],
+		        batch->raycast_callback, batch->userdata, batch->flag);
+		wide_raycast(batch->wide, &data);
+		memcpy(&batch->hit[i], &data.hit, sizeof(data.hit));
+	}
+	else {
+		BLI_bvhtree_ray_cast_ex(
+		        batch->tree, batch->co[i], batch->dir[i], batch->radius, &batch->hit[i],
+		        batch->raycast_callback, batch->userdata, batch->flag);
+	}
+}
+
+static void bvhtree_find_nearest_batch_task_cb(void *userdata, const int i)
+{
+	const BVHBatchData *batch = userdata;
+
+	if (batch->wide) {
+		BVHNearestData data;
+
+		bvhtree_find_nearest_data_init(
+		        &data, batch->tree, batch->co[i], &batch->nearest[i],
+		        batch->nearest_callback, batch->userdata);
+		wide_find_nearest(batch->wide, &data);
+		memcpy(&batch->nearest[i], &data.nearest, sizeof(data.nearest));
+	}
+	else {
+		BLI_bvhtree_find_nearest(
+		        batch->tree, batch->co[i], &batch->nearest[i],
+		        batch->nearest_callback, batch->userdata);
+	}
+}
+
+/**
+ * Cast \a rays_len rays, like calling #BLI_bvhtree_ray_cast_ex for each of them,
+ * the \a callback being called from multiple threads.
+ *
+ * \param r_hit: An array of \a rays_len hits, which must be initialized by the caller
+ * (index of -1 and the maximum distance of each ray).
+ */
+void BLI_bvhtree_ray_cast_batch(
+        BVHTree *tree, const float (*co)[3], const float (*dir)[3], int rays_len, float radius,
+        BVHTreeRayHit *r_hit, BVHTree_RayCastCallback callback, void *userdata,
+        int flag)
+{
+	BVHTreeWide wide;
+	const bool use_wide = (rays_len >= BVH_WIDE_QUERIES_MIN) && bvhtree_wide_supported(tree);
+	BVHBatchData batch = {
+		.tree = tree, .wide = use_wide ? &wide : NULL,
+		.co = co, .dir = dir, .radius = radius, .flag = flag, .hit = r_hit,
+		.raycast_callback = callback, .userdata = userdata,
+	};
+
+	if (use_wide) {
+		bvhtree_wide_build(&wide, tree);
+	}
+
+	BLI_task_parallel_range(
+	        0, rays_len, &batch, bvhtree_ray_cast_batch_task_cb,
+	        rays_len > KDOPBVH_THREAD_QUERY_THRESHOLD);
+
+	if (use_wide) {
+		bvhtree_wide_free(&wide);
+	}
+}
+
+/**
+ * Find the nearest node of \a co_len points, like calling #BLI_bvhtree_find_nearest for each of them,
+ * the \a callback being called from multiple threads.
+ *
+ * \param r_nearest: An array of \a co_len results, which must be initialized by the caller
+ * (index of -1 and the maximum squared distance to search around each point).
+ */
+void BLI_bvhtree_find_nearest_batch(
+        BVHTree *tree, const float (*co)[3], int co_len, BVHTreeNearest *r_nearest,
+        BVHTree_NearestPointCallback callback, void *userdata)
+{
+	BVHTreeWide wide;
+	const bool use_wide = (co_len >= BVH_WIDE_QUERIES_MIN) && bvhtree_wide_supported(tree);
+	BVHBatchData batch = {
+		.tree = tree, .wide = use_wide ? &wide : NULL,
+		.co = co, .nearest = r_nearest,
+		.nearest_callback = callback, .userdata = userdata,
+	};
+
+	if (use_wide) {
+		bvhtree_wide_build(&wide, tree);
+	}
+
+	BLI_task_parallel_range(
+	        0, co_len, &batch, bvhtree_find_nearest_batch_task_cb,
+	        co_len > KDOPBVH_THREAD_QUERY_THRESHOLD);
+
+	if (use_wide) {
+		bvhtree_wide_free(&wide);
+	}
+}
+
+/** \} */
+
+
 /* -------------------------------------------------------------------- */
 
 /** \name BLI_bvhtree_range_query
@@ -29,6 +29,8 @@
 
 #include "BLI_math.h"
 #include "BLI_kdtree.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 #include "BLI_strict_flags.h"
 
@@ -113,18 +115,14 @@ void BLI_kdtree_insert(KDTree *tree, int index, const float co[3])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint totnode, uint axis, const uint ofs)
+/**
+ * Partition the nodes around the median on \a axis (quicksort style), returns the median index.
+ */
+static uint kdtree_median_partition(KDTreeNode *nodes, uint totnode, uint axis)
 {
-	KDTreeNode *node;
 	float co;
 	uint left, right, median, i, j;
 
-	if (totnode <= 0)
-		return KD_NODE_UNSET;
-	else if (totnode == 1)
-		return 0 + ofs;
-	
-	/* quicksort style sorting around median */
 	left = 0;
 	right = totnode - 1;
 	median = totnode / 2;
@@ -151,6 +149,30 @@ static uint kdtree_balance(KDTreeNode *nodes, uint totnode, uint axis, const uin
 			left = i + 1;
 	}
 
+	return median;
+}
+
+/**
+ * Index of the root node of a balanced (sub)tree, known before it is balanced.
+ */
+BLI_INLINE uint kdtree_balance_root(uint totnode, const uint ofs)
+{
+	return (totnode == 0) ? KD_NODE_UNSET : (totnode / 2) + ofs;
+}
+
+static uint kdtree_balance(KDTreeNode *nodes, uint totnode, uint axis, const uint ofs)
+{
+	KDTreeNode *node;
+	uint median;
+
+	if (totnode <= 0)
+		return KD_NODE_UNSET;
+	else if (totnode == 1)
+		return 0 + ofs;
+	
+	/* quicksort style sorting around median */
+	median = kdtree_median_partition(nodes, totnode, axis);
+
 	/* set node and sort subnodes */
 	node = &nodes[median];
 	node->d = axis;
@@ -161,9 +183,76 @@ static uint kdtree_balance(KDTreeNode *nodes, uint totnode, uint axis, const uin
 	return median + ofs;
 }
 
+/* Subtrees smaller than this are balanced by a single thread. */
+#define KD_BALANCE_THREADED_MIN 8192
+
+typedef struct KDTreeBalanceTask {
+	KDTreeNode *nodes;
+	uint totnode, axis, ofs;
+} KDTreeBalanceTask;
+
+static void kdtree_balance_threaded(
+        TaskPool *__restrict pool, KDTreeNode *nodes, uint totnode, uint axis, uint ofs, int threadid);
+
+static void kdtree_balance_task(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+	KDTreeBalanceTask *task = taskdata;
+	kdtree_balance_threaded(pool, task->nodes, task->totnode, task->axis, task->ofs, threadid);
+}
+
+/**
+ * Same as #kdtree_balance, the left and right subtrees of big trees being balanced as separate tasks.
+ * Since the root index of a subtree only depends on its size, links can be set before subtrees are done.
+ */
+static void kdtree_balance_threaded(
+        TaskPool *__restrict pool, KDTreeNode *nodes, uint totnode, uint axis, uint ofs, int threadid)
+{
+	while (totnode >= KD_BALANCE_THREADED_MIN) {
+		KDTreeBalanceTask *task;
+		KDTreeNode *node;
+		const uint median = kdtree_median_partition(nodes, totnode, axis);
+
+		node = &nodes[median];
+		node->d = axis;
+		axis = (axis + 1) % 3;
+		node->left = kdtree_balance_root(median, ofs);
+		node->right = kdtree_balance_root(totnode - (median + 1), (median + 1) + ofs);
+
+		/* Left subtree in another task, continue with the right one. */
+		task = MEM_mallocN(sizeof(*task), __func__);
+		task->nodes = nodes;
+		task->totnode = median;
+		task->axis = axis;
+		task->ofs = ofs;
+		BLI_task_pool_push_from_thread(pool, kdtree_balance_task, task, true, TASK_PRIORITY_HIGH, threadid);
+
+		nodes += median + 1;
+		totnode -= median + 1;
+		ofs += median + 1;
+	}
+
+	kdtree_balance(nodes, totnode, axis, ofs);
+}
+
 void BLI_kdtree_balance(KDTree *tree)
 {
-	tree->root = kdtree_balance(tree->nodes, tree->totnode, 0, 0);
+	if (tree->totnode >= KD_BALANCE_THREADED_MIN) {
+		TaskPool *pool = BLI_task_pool_create(BLI_task_scheduler_get(), NULL);
+		KDTreeBalanceTask *task = MEM_mallocN(sizeof(*task), __func__);
+
+		task->nodes = tree->nodes;
+		task->totnode = tree->totnode;
+		task->axis = 0;
+		task->ofs = 0;
+		BLI_task_pool_push(pool, kdtree_balance_task, task, true, TASK_PRIORITY_HIGH);
+		BLI_task_pool_work_and_wait(pool);
+		BLI_task_pool_free(pool);
+
+		tree->root = kdtree_balance_root(tree->totnode, 0);
+	}
+	else {
+		tree->root = kdtree_balance(tree->nodes, tree->totnode, 0, 0);
+	}
 
 #ifdef DEBUG
 	tree->is_balanced = true;
@@ -510,6 +599,73 @@ int BLI_kdtree_find_nearest_n__normal(
 	return (int)found;
 }
 
+/* Batches smaller than this are queried by a single thread. */
+#define KD_BATCH_THREADED_MIN 1024
+
+typedef struct KDTreeBatchData {
+	const KDTree *tree;
+	const float (*co)[3];
+	uint n;
+	KDTreeNearest *r_nearest;
+	int *r_found;
+} KDTreeBatchData;
+
+static void kdtree_find_nearest_batch_cb(void *userdata, const int i)
+{
+	const KDTreeBatchData *data = userdata;
+	KDTreeNearest *nearest = &data->r_nearest[i];
+
+	if (BLI_kdtree_find_nearest(data->tree, data->co[i], nearest) == -1) {
+		nearest->index = -1;
+	}
+}
+
+static void kdtree_find_nearest_n_batch_cb(void *userdata, const int i)
+{
+	const KDTreeBatchData *data = userdata;
+	KDTreeNearest *nearest = &data->r_nearest[(size_t)i * data->n];
+	const int found = BLI_kdtree_find_nearest_n(data->tree, data->co[i], nearest, data->n);
+
+	if (data->r_found) {
+		data->r_found[i] = found;
+	}
+	for (uint j = (uint)found; j < data->n; j++) {
+		nearest[j].index = -1;
+	}
+}
+
+/**
+ * Find the nearest point of each one of \a co, running queries in parallel for big batches.
+ *
+ * \param r_nearest  An array of \a co_len results, index is -1 when no point was found.
+ */
+void BLI_kdtree_find_nearest_batch(
+        const KDTree *tree, const float (*co)[3], uint co_len,
+        KDTreeNearest *r_nearest)
+{
+	KDTreeBatchData data = {tree, co, 1, r_nearest, NULL};
+
+	BLI_task_parallel_range(0, (int)co_len, &data, kdtree_find_nearest_batch_cb,
+	                        co_len >= KD_BATCH_THREADED_MIN);
+}
+
+/**
+ * Find the \a n nearest points of each one of \a co, running queries in parallel for big batches.
+ *
+ * \param r_nearest  A flat array of \a co_len * \a n results, sorted by distance for each point,
+ * unused results have an index of -1.
+ * \param r_found  Optionally, an array of \a co_len found points numbers.
+ */
+void BLI_kdtree_find_nearest_n_batch(
+        const KDTree *tree, const float (*co)[3], uint co_len, uint n,
+        KDTreeNearest *r_nearest, int *r_found)
+{
+	KDTreeBatchData data = {tree, co, n, r_nearest, r_found};
+
+	BLI_task_parallel_range(0, (int)co_len, &data, kdtree_find_nearest_n_batch_cb,
+	                        co_len >= KD_BATCH_THREADED_MIN);
+}
+
 static int range_compare(const void *a, const void *b)
 {
 	const KDTreeNearest *kda = a;
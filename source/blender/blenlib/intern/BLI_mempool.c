@@ -36,6 +36,7 @@
  * - Freeing chunks.
  * - Iterating over allocated chunks
  *   (optionally when using the #BLI_MEMPOOL_ALLOW_ITER flag).
+ * - Allocating from multiple threads, between #BLI_mempool_threads_begin and #BLI_mempool_threads_end.
  */
 
 #include <string.h>
@@ -120,6 +121,19 @@ typedef struct BLI_mempool_chunk {
 #endif
 } BLI_mempool_chunk;
 
+/**
+ * Elements allocated and freed by one thread, see #BLI_mempool_threads_begin.
+ * The thread owns the chunks it allocates until they are merged back into the pool.
+ */
+typedef struct BLI_mempool_thread {
+	BLI_mempool_chunk *chunks, *chunk_tail;
+	BLI_freenode *free;
+	/* may be negative, when freeing elements allocated by other threads */
+	int totused;
+	/* avoid false sharing between threads */
+	char _pad[64 - (sizeof(void *) * 3 + sizeof(int)) % 64];
+} BLI_mempool_thread;
+
 /**
  * The mempool, stores and tracks memory \a chunks and elements within those chunks \a free.
  */
@@ -141,6 +155,10 @@ struct BLI_mempool {
 #ifdef USE_TOTALLOC
 	uint totalloc;          /* number of elements allocated in total */
 #endif
+
+	/* only between #BLI_mempool_threads_begin/end */
+	BLI_mempool_thread *threads;
+	uint num_threads;
 };
 
 #define MEMPOOL_ELEM_SIZE_MIN (sizeof(void *) * 2)
@@ -208,37 +226,16 @@ static BLI_mempool_chunk *mempool_chunk_alloc(BLI_mempool *pool)
 }
 
 /**
- * Initialize a chunk and add into \a pool->chunks
+ * Link the elements of \a mpchunk into a free list, starting with its first element.
  *
- * \param pool  The pool to add the chunk into.
- * \param mpchunk  The new uninitialized chunk (can be malloc'd)
- * \param lasttail  The last element of the previous chunk
- * (used when building free chunks initially)
- * \return The last chunk,
+ * \return The last element (terminating the list).
  */
-static BLI_freenode *mempool_chunk_add(BLI_mempool *pool, BLI_mempool_chunk *mpchunk,
-                                       BLI_freenode *lasttail)
+static BLI_freenode *mempool_chunk_free_init(const BLI_mempool *pool, BLI_mempool_chunk *mpchunk)
 {
 	const uint esize = pool->esize;
 	BLI_freenode *curnode = CHUNK_DATA(mpchunk);
 	uint j;
 
-	/* append */
-	if (pool->chunk_tail) {
-		pool->chunk_tail->next = mpchunk;
-	}
-	else {
-		BLI_assert(pool->chunks == NULL);
-		pool->chunks = mpchunk;
-	}
-
-	mpchunk->next = NULL;
-	pool->chunk_tail = mpchunk;
-
-	if (UNLIKELY(pool->free == NULL)) {
-		pool->free = curnode;
-	}
-
 	/* loop through the allocated data, building the pointer structures */
 	j = pool->pchunk;
 	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
@@ -260,6 +257,41 @@ static BLI_freenode *mempool_chunk_add(BLI_mempool *pool, BLI_mempool_chunk *mpc
 	curnode = NODE_STEP_PREV(curnode);
 	curnode->next = NULL;
 
+	return curnode;
+}
+
+/**
+ * Initialize a chunk and add into \a pool->chunks
+ *
+ * \param pool  The pool to add the chunk into.
+ * \param mpchunk  The new uninitialized chunk (can be malloc'd)
+ * \param lasttail  The last element of the previous chunk
+ * (used when building free chunks initially)
+ * \return The last chunk,
+ */
+static BLI_freenode *mempool_chunk_add(BLI_mempool *pool, BLI_mempool_chunk *mpchunk,
+                                       BLI_freenode *lasttail)
+{
+	BLI_freenode *curnode;
+
+	/* append */
+	if (pool->chunk_tail) {
+		pool->chunk_tail->next = mpchunk;
+	}
+	else {
+		BLI_assert(pool->chunks == NULL);
+		pool->chunks = mpchunk;
+	}
+
+	mpchunk->next = NULL;
+	pool->chunk_tail = mpchunk;
+
+	if (UNLIKELY(pool->free == NULL)) {
+		pool->free = CHUNK_DATA(mpchunk);
+	}
+
+	curnode = mempool_chunk_free_init(pool, mpchunk);
+
 #ifdef USE_TOTALLOC
 	pool->totalloc += pool->pchunk;
 #endif
@@ -336,6 +368,8 @@ BLI_mempool *BLI_mempool_create(uint esize, uint totelem,
 	pool->totalloc = 0;
 #endif
 	pool->totused = 0;
+	pool->threads = NULL;
+	pool->num_threads = 0;
 
 	if (totelem) {
 		/* allocate the actual chunks */
@@ -356,6 +390,8 @@ void *BLI_mempool_alloc(BLI_mempool *pool)
 {
 	BLI_freenode *free_pop;
 
+	BLI_assert(pool->threads == NULL);
+
 	if (UNLIKELY(pool->free == NULL)) {
 		/* need to allocate a new chunk */
 		BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
@@ -396,6 +432,8 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 {
 	BLI_freenode *newhead = addr;
 
+	BLI_assert(pool->threads == NULL);
+
 #ifndef NDEBUG
 	{
 		BLI_mempool_chunk *chunk;
@@ -474,6 +512,178 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 	}
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Threaded Allocation
+ *
+ * Each thread allocates from chunks it owns, and frees into its own free list,
+ * so no locking is needed. Chunks and free lists of all threads are merged back
+ * into the pool when done, where iteration visits the chunks of each thread in turn.
+ * \{ */
+
+/**
+ * Start allocating from multiple threads, regular allocation and iteration can't be used until
+ * #BLI_mempool_threads_end.
+ *
+ * \param num_threads: The range of thread ids passed to #BLI_mempool_alloc_thread,
+ * for tasks that's #BLI_task_scheduler_num_threads + 1.
+ */
+void BLI_mempool_threads_begin(BLI_mempool *pool, const uint num_threads)
+{
+	BLI_assert(pool->threads == NULL);
+	BLI_assert(num_threads != 0);
+
+	pool->threads = MEM_callocN(sizeof(*pool->threads) * num_threads, __func__);
+	pool->num_threads = num_threads;
+
+	/* the first thread starts with the current free elements */
+	pool->threads[0].free = pool->free;
+	pool->free = NULL;
+}
+
+/**
+ * Merge the elements of all threads back into the pool.
+ */
+void BLI_mempool_threads_end(BLI_mempool *pool)
+{
+	BLI_freenode *free_tail = NULL;
+	int totused = (int)pool->totused;
+
+	BLI_assert(pool->threads != NULL);
+	BLI_assert(pool->free == NULL);
+
+	for (uint i = 0; i < pool->num_threads; i++) {
+		BLI_mempool_thread *thread = &pool->threads[i];
+
+		if (thread->chunks) {
+			if (pool->chunk_tail) {
+				pool->chunk_tail->next = thread->chunks;
+			}
+			else {
+				pool->chunks = thread->chunks;
+			}
+			pool->chunk_tail = thread->chunk_tail;
+#ifdef USE_TOTALLOC
+			for (BLI_mempool_chunk *mpchunk = thread->chunks; mpchunk; mpchunk = mpchunk->next) {
+				pool->totalloc += pool->pchunk;
+			}
+#endif
+		}
+
+		if (thread->free) {
+			if (free_tail) {
+				free_tail->next = thread->free;
+			}
+			else {
+				pool->free = thread->free;
+			}
+			for (free_tail = thread->free; free_tail->next; free_tail = free_tail->next) {
+				/* pass */
+			}
+		}
+
+		totused += thread->totused;
+	}
+
+	BLI_assert(totused >= 0);
+	pool->totused = (uint)totused;
+
+	MEM_freeN(pool->threads);
+	pool->threads = NULL;
+	pool->num_threads = 0;
+}
+
+/**
+ * Allocate an element, can be called from multiple threads with different \a thread_id.
+ */
+void *BLI_mempool_alloc_thread(BLI_mempool *pool, const int thread_id)
+{
+	BLI_mempool_thread *thread;
+	BLI_freenode *free_pop;
+
+	BLI_assert(pool->threads != NULL);
+	BLI_assert((uint)thread_id < pool->num_threads);
+
+	thread = &pool->threads[thread_id];
+
+	if (UNLIKELY(thread->free == NULL)) {
+		/* need to allocate a new chunk, owned by this thread */
+		BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
+
+		mpchunk->next = NULL;
+		if (thread->chunk_tail) {
+			thread->chunk_tail->next = mpchunk;
+		}
+		else {
+			thread->chunks = mpchunk;
+		}
+		thread->chunk_tail = mpchunk;
+
+		thread->free = CHUNK_DATA(mpchunk);
+		mempool_chunk_free_init(pool, mpchunk);
+	}
+
+	free_pop = thread->free;
+
+	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+		free_pop->freeword = USEDWORD;
+	}
+
+	thread->free = free_pop->next;
+	thread->totused++;
+
+#ifdef WITH_MEM_VALGRIND
+	VALGRIND_MEMPOOL_ALLOC(pool, free_pop, pool->esize);
+#endif
+
+	return (void *)free_pop;
+}
+
+void *BLI_mempool_calloc_thread(BLI_mempool *pool, const int thread_id)
+{
+	void *retval = BLI_mempool_alloc_thread(pool, thread_id);
+	memset(retval, 0, (size_t)pool->esize);
+	return retval;
+}
+
+/**
+ * Free an element, which may have been allocated by another thread.
+ * Unlike #BLI_mempool_free, chunks are never freed.
+ */
+void BLI_mempool_free_thread(BLI_mempool *pool, void *addr, const int thread_id)
+{
+	BLI_mempool_thread *thread;
+	BLI_freenode *newhead = addr;
+
+	BLI_assert(pool->threads != NULL);
+	BLI_assert((uint)thread_id < pool->num_threads);
+
+	thread = &pool->threads[thread_id];
+
+#ifndef NDEBUG
+	if (UNLIKELY(mempool_debug_memset)) {
+		memset(addr, 255, pool->esize);
+	}
+#endif
+
+	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+#ifndef NDEBUG
+		/* this will detect double free's */
+		BLI_assert(newhead->freeword != FREEWORD);
+#endif
+		newhead->freeword = FREEWORD;
+	}
+
+	newhead->next = thread->free;
+	thread->free = newhead;
+	thread->totused--;
+
+#ifdef WITH_MEM_VALGRIND
+	VALGRIND_MEMPOOL_FREE(pool, addr);
+#endif
+}
+
+/** \} */
+
 int BLI_mempool_count(BLI_mempool *pool)
 {
 	return (int)pool->totused;
@@ -482,6 +692,7 @@ int BLI_mempool_count(BLI_mempool *pool)
 void *BLI_mempool_findelem(BLI_mempool *pool, uint index)
 {
 	BLI_assert(pool->flag & BLI_MEMPOOL_ALLOW_ITER);
+	BLI_assert(pool->threads == NULL);
 
 	if (index < pool->totused) {
 		/* we could have some faster mem chunk stepping code inline */
@@ -560,6 +771,7 @@ void *BLI_mempool_as_arrayN(BLI_mempool *pool, const char *allocstr)
 void BLI_mempool_iternew(BLI_mempool *pool, BLI_mempool_iter *iter)
 {
 	BLI_assert(pool->flag & BLI_MEMPOOL_ALLOW_ITER);
+	BLI_assert(pool->threads == NULL);
 
 	iter->pool = pool;
 	iter->curchunk = pool->chunks;
@@ -714,6 +926,8 @@ void BLI_mempool_clear_ex(BLI_mempool *pool, const int totelem_reserve)
 	BLI_mempool_chunk *chunks_temp;
 	BLI_freenode *lasttail = NULL;
 
+	BLI_assert(pool->threads == NULL);
+
 #ifdef WITH_MEM_VALGRIND
 	VALGRIND_DESTROY_MEMPOOL(pool);
 	VALGRIND_CREATE_MEMPOOL(pool, 0, false);
@@ -770,6 +984,8 @@ void BLI_mempool_clear(BLI_mempool *pool)
  */
 void BLI_mempool_destroy(BLI_mempool *pool)
 {
+	BLI_assert(pool->threads == NULL);
+
 	mempool_chunk_free_all(pool->chunks);
 
 #ifdef WITH_MEM_VALGRIND
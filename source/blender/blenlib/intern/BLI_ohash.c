@@ -0,0 +1,1237 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/BLI_ohash.c
+ *  \ingroup bli
+ *
+ * An open addressing (pointer -> pointer) hash table, see BLI_ohash.h.
+ *
+ * Slots are split in groups of #OHASH_GROUP_SIZE, every slot has a control byte which is either
+ * #CTRL_EMPTY, #CTRL_DELETED (a tombstone), or the lower 7 bits of the hash of its key ("h2").
+ * The higher bits of the hash select the first group to probe, following groups are probed
+ * with triangular steps, which visits every group since their number is a power of two.
+ *
+ * A lookup stops at the first group containing an empty slot, so removing a key only needs
+ * a tombstone when its group has no empty slot left (some other key may have probed past it).
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_sys_types.h"  /* for intptr_t support */
+#include "BLI_utildefines.h"
+#include "BLI_math_bits.h"
+
+#define GHASH_INTERNAL_API
+#include "BLI_ghash.h"
+#include "BLI_ohash.h"
+#include "BLI_strict_flags.h"
+
+#define OHASH_GROUP_SIZE 16u
+#define OHASH_CAPACITY_MIN 16u
+
+#define CTRL_EMPTY   ((int8_t)-128)
+#define CTRL_DELETED ((int8_t)-2)
+#define CTRL_IS_FULL(c) ((c) >= 0)
+
+#define OHASH_SLOT_NONE UINT_MAX
+
+/* Maximum load of the table is 7/8, shrinking happens below 1/8. */
+#define OHASH_LIMIT_GROW(_cap) (((_cap) / 8) * 7)
+#define OHASH_LIMIT_SHRINK(_cap) ((_cap) / 8)
+
+struct OHash {
+	GHashHashFP hashfp;
+	GHashCmpFP cmpfp;
+
+	/* Single allocation, control bytes followed by keys and values (values are NULL for OSet). */
+	int8_t *ctrl;
+	void **keys;
+	void **vals;
+
+	uint capacity;
+	uint group_mask;
+	uint nentries;
+	/* Number of empty slots which can still be used before the table has to grow. */
+	uint growth_left;
+	uint flag;
+};
+
+
+/* -------------------------------------------------------------------- */
+/* OHash API */
+
+/** \name Internal Utility API
+ * \{ */
+
+/**
+ * Get the full hash for a key, scrambled so its higher bits depend on all bits of the user hash
+ * (some of the GHash callbacks, like #BLI_ghashutil_ptrhash, have very few high bits set).
+ */
+BLI_INLINE uint ohash_keyhash(OHash *oh, const void *key)
+{
+	return oh->hashfp(key) * 0x9E3779B1u;
+}
+
+/**
+ * Get the control byte stored for an already-computed full hash.
+ */
+BLI_INLINE int8_t ohash_hash_ctrl(const uint hash)
+{
+	return (int8_t)(hash & 0x7F);
+}
+
+/**
+ * Get the index of the first group to probe for an already-computed full hash.
+ */
+BLI_INLINE uint ohash_group_index(OHash *oh, const uint hash)
+{
+	return (uint)(((uint64_t)hash * (uint64_t)(oh->group_mask + 1)) >> 32);
+}
+
+/**
+ * Bit-mask of the slots of a group which control byte is \a ctrl.
+ */
+BLI_INLINE uint ohash_group_match(const int8_t *group, const int8_t ctrl)
+{
+#ifdef __SSE2__
+	const __m128i group_ctrl = _mm_load_si128((const __m128i *)group);
+	return (uint)_mm_movemask_epi8(_mm_cmpeq_epi8(group_ctrl, _mm_set1_epi8((char)ctrl)));
+#else
+	uint mask = 0;
+	for (uint i = 0; i < OHASH_GROUP_SIZE; i++) {
+		if (group[i] == ctrl) {
+			mask |= (1u << i);
+		}
+	}
+	return mask;
+#endif
+}
+
+/**
+ * Bit-mask of the empty or deleted slots of a group.
+ */
+BLI_INLINE uint ohash_group_match_free(const int8_t *group)
+{
+#ifdef __SSE2__
+	return (uint)_mm_movemask_epi8(_mm_load_si128((const __m128i *)group));
+#else
+	uint mask = 0;
+	for (uint i = 0; i < OHASH_GROUP_SIZE; i++) {
+		if (!CTRL_IS_FULL(group[i])) {
+			mask |= (1u << i);
+		}
+	}
+	return mask;
+#endif
+}
+
+/**
+ * Smallest capacity which can hold \a nentries without growing.
+ */
+static uint ohash_capacity_for_nentries(const uint nentries)
+{
+	uint capacity = OHASH_CAPACITY_MIN;
+	while (OHASH_LIMIT_GROW(capacity) < nentries) {
+		capacity <<= 1;
+	}
+	return capacity;
+}
+
+/**
+ * Allocate empty slots for \a capacity, existing slots have to be freed by the caller.
+ */
+static void ohash_slots_alloc(OHash *oh, const uint capacity)
+{
+	const size_t keys_size = sizeof(void *) * capacity;
+	const bool is_gset = (oh->flag & GHASH_FLAG_IS_GSET) != 0;
+	char *mem;
+
+	BLI_assert(((capacity & (capacity - 1)) == 0) && capacity >= OHASH_CAPACITY_MIN);
+
+	/* Control bytes come first so groups stay aligned for SSE loads. */
+	mem = MEM_mallocN_aligned(capacity + (is_gset ? keys_size : keys_size * 2), 16, "OHash slots");
+	oh->ctrl = (int8_t *)mem;
+	oh->keys = (void **)(mem + capacity);
+	oh->vals = is_gset ? NULL : (void **)(mem + capacity + keys_size);
+	memset(oh->ctrl, CTRL_EMPTY, capacity);
+
+	oh->capacity = capacity;
+	oh->group_mask = capacity / OHASH_GROUP_SIZE - 1;
+	oh->growth_left = OHASH_LIMIT_GROW(capacity) - oh->nentries;
+}
+
+/**
+ * Find the slot holding \a key, or #OHASH_SLOT_NONE.
+ */
+BLI_INLINE uint ohash_lookup_slot(OHash *oh, const void *key, const uint hash)
+{
+	const int8_t h2 = ohash_hash_ctrl(hash);
+	uint group = ohash_group_index(oh, hash);
+
+	for (uint probe = 1; ; probe++) {
+		const int8_t *group_ctrl = &oh->ctrl[group * OHASH_GROUP_SIZE];
+		uint match = ohash_group_match(group_ctrl, h2);
+
+		while (match) {
+			const uint slot = group * OHASH_GROUP_SIZE + bitscan_forward_clear_uint(&match);
+			if (!oh->cmpfp(key, oh->keys[slot])) {
+				return slot;
+			}
+		}
+		if (ohash_group_match(group_ctrl, CTRL_EMPTY)) {
+			return OHASH_SLOT_NONE;
+		}
+
+		BLI_assert(probe <= oh->group_mask);
+		group = (group + probe) & oh->group_mask;
+	}
+}
+
+/**
+ * Find the first empty or deleted slot in the probe sequence of \a hash.
+ */
+BLI_INLINE uint ohash_find_free_slot(OHash *oh, const uint hash)
+{
+	uint group = ohash_group_index(oh, hash);
+
+	for (uint probe = 1; ; probe++) {
+		const uint mask = ohash_group_match_free(&oh->ctrl[group * OHASH_GROUP_SIZE]);
+		if (mask) {
+			return group * OHASH_GROUP_SIZE + bitscan_forward_uint(mask);
+		}
+
+		BLI_assert(probe <= oh->group_mask);
+		group = (group + probe) & oh->group_mask;
+	}
+}
+
+/**
+ * Find the index of next used slot, starting from \a slot (included).
+ */
+BLI_INLINE uint ohash_find_next_full_slot(OHash *oh, uint slot)
+{
+	while (slot < oh->capacity) {
+		const uint group = slot / OHASH_GROUP_SIZE;
+		uint mask = ~ohash_group_match_free(&oh->ctrl[group * OHASH_GROUP_SIZE]) & 0xFFFFu;
+
+		mask &= 0xFFFFu << (slot % OHASH_GROUP_SIZE);
+		if (mask) {
+			return group * OHASH_GROUP_SIZE + bitscan_forward_uint(mask);
+		}
+		slot = (group + 1) * OHASH_GROUP_SIZE;
+	}
+	return OHASH_SLOT_NONE;
+}
+
+/**
+ * Move all entries to new slots of \a capacity, this also gets rid of all tombstones.
+ */
+static void ohash_resize(OHash *oh, const uint capacity)
+{
+	int8_t *ctrl_old = oh->ctrl;
+	void **keys_old = oh->keys;
+	void **vals_old = oh->vals;
+	const uint capacity_old = oh->capacity;
+
+	BLI_assert(OHASH_LIMIT_GROW(capacity) >= oh->nentries);
+
+	ohash_slots_alloc(oh, capacity);
+
+	for (uint i = 0; i < capacity_old; i++) {
+		if (CTRL_IS_FULL(ctrl_old[i])) {
+			/* No need to call the compare callback, all keys are unique and there are no tombstones. */
+			const uint hash = ohash_keyhash(oh, keys_old[i]);
+			const uint slot = ohash_find_free_slot(oh, hash);
+
+			oh->ctrl[slot] = ctrl_old[i];
+			oh->keys[slot] = keys_old[i];
+			if (vals_old) {
+				oh->vals[slot] = vals_old[i];
+			}
+		}
+	}
+
+	MEM_freeN(ctrl_old);
+}
+
+/**
+ * Called when inserting in an empty slot while no more growth is allowed.
+ */
+static void ohash_rehash_for_insert(OHash *oh)
+{
+	if (oh->nentries <= OHASH_LIMIT_GROW(oh->capacity) / 2) {
+		/* Mostly tombstones, clean them up without growing. */
+		ohash_resize(oh, oh->capacity);
+	}
+	else {
+		ohash_resize(oh, oh->capacity * 2);
+	}
+}
+
+/**
+ * Get the slot where a new key with \a hash has to be stored, growing the table if needed.
+ */
+BLI_INLINE uint ohash_prepare_insert(OHash *oh, const uint hash)
+{
+	uint slot = ohash_find_free_slot(oh, hash);
+
+	if (UNLIKELY(oh->growth_left == 0 && oh->ctrl[slot] == CTRL_EMPTY)) {
+		ohash_rehash_for_insert(oh);
+		slot = ohash_find_free_slot(oh, hash);
+	}
+	return slot;
+}
+
+BLI_INLINE void ohash_slot_set(OHash *oh, const uint slot, const uint hash, void *key, void *val)
+{
+	if (oh->ctrl[slot] == CTRL_EMPTY) {
+		oh->growth_left--;
+	}
+	oh->ctrl[slot] = ohash_hash_ctrl(hash);
+	oh->keys[slot] = key;
+	if (oh->vals) {
+		oh->vals[slot] = val;
+	}
+	oh->nentries++;
+}
+
+/**
+ * Release a slot, its key and value have to be freed by the caller.
+ */
+static void ohash_slot_remove(OHash *oh, const uint slot)
+{
+	const int8_t *group_ctrl = &oh->ctrl[slot & ~(OHASH_GROUP_SIZE - 1)];
+
+	BLI_assert(CTRL_IS_FULL(oh->ctrl[slot]));
+
+	/* If the group still has an empty slot, no lookup can have probed past it. */
+	if (ohash_group_match(group_ctrl, CTRL_EMPTY)) {
+		oh->ctrl[slot] = CTRL_EMPTY;
+		oh->growth_left++;
+	}
+	else {
+		oh->ctrl[slot] = CTRL_DELETED;
+	}
+	oh->nentries--;
+}
+
+/**
+ * Shrink the slots after removal, when allowed.
+ */
+static void ohash_contract(OHash *oh)
+{
+	if ((oh->flag & GHASH_FLAG_ALLOW_SHRINK) &&
+	    (oh->capacity > OHASH_CAPACITY_MIN) &&
+	    (oh->nentries < OHASH_LIMIT_SHRINK(oh->capacity)))
+	{
+		/* Leave some room so inserting again does not grow immediately. */
+		ohash_resize(oh, ohash_capacity_for_nentries(oh->nentries * 2));
+	}
+}
+
+/**
+ * Reset the slots, reserving room for \a nentries_reserve.
+ */
+static void ohash_slots_reset(OHash *oh, const uint nentries_reserve)
+{
+	const uint capacity = ohash_capacity_for_nentries(nentries_reserve);
+
+	oh->nentries = 0;
+	if (oh->ctrl && oh->capacity == capacity) {
+		memset(oh->ctrl, CTRL_EMPTY, capacity);
+		oh->growth_left = OHASH_LIMIT_GROW(capacity);
+	}
+	else {
+		if (oh->ctrl) {
+			MEM_freeN(oh->ctrl);
+		}
+		ohash_slots_alloc(oh, capacity);
+	}
+}
+
+static OHash *ohash_new(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+                        const uint nentries_reserve, const uint flag)
+{
+	OHash *oh = MEM_mallocN(sizeof(*oh), info);
+
+	oh->hashfp = hashfp;
+	oh->cmpfp = cmpfp;
+
+	oh->ctrl = NULL;
+	oh->flag = flag;
+
+	ohash_slots_reset(oh, nentries_reserve);
+
+	return oh;
+}
+
+BLI_INLINE void ohash_insert(OHash *oh, void *key, void *val)
+{
+	const uint hash = ohash_keyhash(oh, key);
+
+	BLI_assert((oh->flag & GHASH_FLAG_ALLOW_DUPES) || (ohash_lookup_slot(oh, key, hash) == OHASH_SLOT_NONE));
+
+	ohash_slot_set(oh, ohash_prepare_insert(oh, hash), hash, key, val);
+}
+
+BLI_INLINE bool ohash_insert_safe(
+        OHash *oh, void *key, void *val, const bool override,
+        GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	const uint hash = ohash_keyhash(oh, key);
+	const uint slot = ohash_lookup_slot(oh, key, hash);
+
+	if (slot != OHASH_SLOT_NONE) {
+		if (override) {
+			if (keyfreefp) {
+				keyfreefp(oh->keys[slot]);
+			}
+			if (valfreefp) {
+				valfreefp(oh->vals[slot]);
+			}
+			oh->keys[slot] = key;
+			if (oh->vals) {
+				oh->vals[slot] = val;
+			}
+		}
+		return false;
+	}
+	else {
+		ohash_slot_set(oh, ohash_prepare_insert(oh, hash), hash, key, val);
+		return true;
+	}
+}
+
+/**
+ * Lookup the slot of \a key, inserting it if not found (value is set to NULL).
+ * \return true if the key was already present.
+ */
+BLI_INLINE bool ohash_ensure_slot(OHash *oh, const void *key, uint *r_slot)
+{
+	const uint hash = ohash_keyhash(oh, key);
+	uint slot = ohash_lookup_slot(oh, key, hash);
+
+	if (slot != OHASH_SLOT_NONE) {
+		*r_slot = slot;
+		return true;
+	}
+	slot = ohash_prepare_insert(oh, hash);
+	ohash_slot_set(oh, slot, hash, (void *)key, NULL);
+	*r_slot = slot;
+	return false;
+}
+
+/**
+ * Run free callbacks for freeing entries.
+ */
+static void ohash_free_cb(
+        OHash *oh,
+        GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	BLI_assert(keyfreefp  || valfreefp);
+	BLI_assert(!valfreefp || !(oh->flag & GHASH_FLAG_IS_GSET));
+
+	for (uint i = 0; i < oh->capacity; i++) {
+		if (CTRL_IS_FULL(oh->ctrl[i])) {
+			if (keyfreefp) {
+				keyfreefp(oh->keys[i]);
+			}
+			if (valfreefp) {
+				valfreefp(oh->vals[i]);
+			}
+		}
+	}
+}
+
+/**
+ * Copy the OHash, the copy has the same capacity and slots layout.
+ */
+static OHash *ohash_copy(OHash *oh, GHashKeyCopyFP keycopyfp, GHashValCopyFP valcopyfp)
+{
+	OHash *oh_new = MEM_mallocN(sizeof(*oh_new), __func__);
+	const size_t keys_size = sizeof(void *) * oh->capacity;
+
+	BLI_assert(!valcopyfp || !(oh->flag & GHASH_FLAG_IS_GSET));
+
+	*oh_new = *oh;
+	oh_new->ctrl = NULL;
+	ohash_slots_alloc(oh_new, oh->capacity);
+	oh_new->growth_left = oh->growth_left;
+
+	memcpy(oh_new->ctrl, oh->ctrl, oh->capacity);
+	memcpy(oh_new->keys, oh->keys, keys_size);
+	if (oh->vals) {
+		memcpy(oh_new->vals, oh->vals, keys_size);
+	}
+
+	if (keycopyfp || valcopyfp) {
+		for (uint i = 0; i < oh->capacity; i++) {
+			if (CTRL_IS_FULL(oh->ctrl[i])) {
+				if (keycopyfp) {
+					oh_new->keys[i] = keycopyfp(oh->keys[i]);
+				}
+				if (valcopyfp) {
+					oh_new->vals[i] = valcopyfp(oh->vals[i]);
+				}
+			}
+		}
+	}
+
+	return oh_new;
+}
+
+/** \} */
+
+
+/** \name Public API
+ * \{ */
+
+/**
+ * Creates a new, empty OHash.
+ *
+ * \param hashfp  Hash callback.
+ * \param cmpfp  Comparison callback.
+ * \param info  Identifier string for the OHash.
+ * \param nentries_reserve  Optionally reserve the number of members that the hash will hold.
+ * Use this to avoid growing the slots if the size is known or can be closely approximated.
+ * \return  An empty OHash.
+ */
+OHash *BLI_ohash_new_ex(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+                        const uint nentries_reserve)
+{
+	return ohash_new(hashfp, cmpfp, info, nentries_reserve, 0);
+}
+
+/**
+ * Wraps #BLI_ohash_new_ex with zero entries reserved.
+ */
+OHash *BLI_ohash_new(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info)
+{
+	return BLI_ohash_new_ex(hashfp, cmpfp, info, 0);
+}
+
+/**
+ * Copy given OHash. Keys and values are also copied if relevant callback is provided, else pointers remain the same.
+ */
+OHash *BLI_ohash_copy(OHash *oh, GHashKeyCopyFP keycopyfp, GHashValCopyFP valcopyfp)
+{
+	return ohash_copy(oh, keycopyfp, valcopyfp);
+}
+
+/**
+ * Reserve given amount of entries (resize \a oh accordingly if needed).
+ */
+void BLI_ohash_reserve(OHash *oh, const uint nentries_reserve)
+{
+	const uint capacity = ohash_capacity_for_nentries(nentries_reserve);
+
+	if (capacity > oh->capacity) {
+		ohash_resize(oh, capacity);
+	}
+}
+
+/**
+ * \return size of the OHash.
+ */
+uint BLI_ohash_size(OHash *oh)
+{
+	return oh->nentries;
+}
+
+/**
+ * Insert a key/value pair into the \a oh.
+ *
+ * \note Duplicates are not checked,
+ * the caller is expected to ensure elements are unique unless
+ * GHASH_FLAG_ALLOW_DUPES flag is set.
+ */
+void BLI_ohash_insert(OHash *oh, void *key, void *val)
+{
+	ohash_insert(oh, key, val);
+}
+
+/**
+ * Inserts a new value to a key that may already be in ohash.
+ *
+ * Avoids #BLI_ohash_remove, #BLI_ohash_insert calls (double lookups)
+ *
+ * \returns true if a new key has been added.
+ */
+bool BLI_ohash_reinsert(OHash *oh, void *key, void *val, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	return ohash_insert_safe(oh, key, val, true, keyfreefp, valfreefp);
+}
+
+/**
+ * Replaces the key of an item in the \a oh.
+ *
+ * Use when a key is re-allocated or it's memory location is changed.
+ *
+ * \returns The previous key or NULL if not found, the caller may free if it's needed.
+ */
+void *BLI_ohash_replace_key(OHash *oh, void *key)
+{
+	const uint hash = ohash_keyhash(oh, key);
+	const uint slot = ohash_lookup_slot(oh, key, hash);
+
+	if (slot != OHASH_SLOT_NONE) {
+		void *key_prev = oh->keys[slot];
+		oh->keys[slot] = key;
+		return key_prev;
+	}
+	return NULL;
+}
+
+/**
+ * Lookup the value of \a key in \a oh.
+ *
+ * \param key  The key to lookup.
+ * \returns the value for \a key or NULL.
+ *
+ * \note When NULL is a valid value, use #BLI_ohash_lookup_p to differentiate a missing key
+ * from a key with a NULL value. (Avoids calling #BLI_ohash_haskey before #BLI_ohash_lookup)
+ */
+void *BLI_ohash_lookup(OHash *oh, const void *key)
+{
+	const uint slot = ohash_lookup_slot(oh, key, ohash_keyhash(oh, key));
+
+	BLI_assert(!(oh->flag & GHASH_FLAG_IS_GSET));
+	return (slot != OHASH_SLOT_NONE) ? oh->vals[slot] : NULL;
+}
+
+/**
+ * A version of #BLI_ohash_lookup which accepts a fallback argument.
+ */
+void *BLI_ohash_lookup_default(OHash *oh, const void *key, void *val_default)
+{
+	const uint slot = ohash_lookup_slot(oh, key, ohash_keyhash(oh, key));
+
+	BLI_assert(!(oh->flag & GHASH_FLAG_IS_GSET));
+	return (slot != OHASH_SLOT_NONE) ? oh->vals[slot] : val_default;
+}
+
+/**
+ * Lookup a pointer to the value of \a key in \a oh.
+ *
+ * \param key  The key to lookup.
+ * \returns the pointer to value for \a key or NULL.
+ *
+ * \note This has 2 main benefits over #BLI_ohash_lookup.
+ * - A NULL return always means that \a key isn't in \a oh.
+ * - The value can be modified in-place without further function calls (faster).
+ *
+ * \warning The pointer is only valid until the next insertion.
+ */
+void **BLI_ohash_lookup_p(OHash *oh, const void *key)
+{
+	const uint slot = ohash_lookup_slot(oh, key, ohash_keyhash(oh, key));
+
+	BLI_assert(!(oh->flag & GHASH_FLAG_IS_GSET));
+	return (slot != OHASH_SLOT_NONE) ? &oh->vals[slot] : NULL;
+}
+
+/**
+ * Ensure \a key is exists in \a oh.
+ *
+ * This handles the common situation where the caller needs ensure a key is added to \a oh,
+ * constructing a new value in the case the key isn't found.
+ * Otherwise use the existing value.
+ *
+ * Such situations typically incur multiple lookups, however this function
+ * avoids them by ensuring the key is added,
+ * returning a pointer to the value so it can be used or initialized by the caller.
+ *
+ * \returns true when the value didn't need to be added.
+ * (when false, the caller _must_ initialize the value).
+ */
+bool BLI_ohash_ensure_p(OHash *oh, void *key, void ***r_val)
+{
+	uint slot;
+	const bool haskey = ohash_ensure_slot(oh, key, &slot);
+
+	BLI_assert(!(oh->flag & GHASH_FLAG_IS_GSET));
+	*r_val = &oh->vals[slot];
+	return haskey;
+}
+
+/**
+ * A version of #BLI_ohash_ensure_p copies the key on insertion.
+ *
+ * \warning Caller _must_ write to \a r_key when returning false.
+ */
+bool BLI_ohash_ensure_p_ex(
+        OHash *oh, const void *key, void ***r_key, void ***r_val)
+{
+	uint slot;
+	const bool haskey = ohash_ensure_slot(oh, key, &slot);
+
+	BLI_assert(!(oh->flag & GHASH_FLAG_IS_GSET));
+	*r_key = &oh->keys[slot];
+	*r_val = &oh->vals[slot];
+	return haskey;
+}
+
+/**
+ * Remove \a key from \a oh, or return false if the key wasn't found.
+ *
+ * \param key  The key to remove.
+ * \param keyfreefp  Optional callback to free the key.
+ * \param valfreefp  Optional callback to free the value.
+ * \return true if \a key was removed from \a oh.
+ */
+bool BLI_ohash_remove(OHash *oh, const void *key, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	const uint slot = ohash_lookup_slot(oh, key, ohash_keyhash(oh, key));
+
+	BLI_assert(!valfreefp || !(oh->flag & GHASH_FLAG_IS_GSET));
+
+	if (slot != OHASH_SLOT_NONE) {
+		if (keyfreefp) {
+			keyfreefp(oh->keys[slot]);
+		}
+		if (valfreefp) {
+			valfreefp(oh->vals[slot]);
+		}
+		ohash_slot_remove(oh, slot);
+		ohash_contract(oh);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Remove \a key from \a oh, returning the value or NULL if the key wasn't found.
+ *
+ * \param key  The key to remove.
+ * \param keyfreefp  Optional callback to free the key.
+ * \return the value of \a key int \a oh or NULL.
+ */
+void *BLI_ohash_popkey(OHash *oh, const void *key, GHashKeyFreeFP keyfreefp)
+{
+	const uint slot = ohash_lookup_slot(oh, key, ohash_keyhash(oh, key));
+
+	BLI_assert(!(oh->flag & GHASH_FLAG_IS_GSET));
+
+	if (slot != OHASH_SLOT_NONE) {
+		void *val = oh->vals[slot];
+		if (keyfreefp) {
+			keyfreefp(oh->keys[slot]);
+		}
+		ohash_slot_remove(oh, slot);
+		ohash_contract(oh);
+		return val;
+	}
+	return NULL;
+}
+
+/**
+ * \return true if the \a key is in \a oh.
+ */
+bool BLI_ohash_haskey(OHash *oh, const void *key)
+{
+	return (ohash_lookup_slot(oh, key, ohash_keyhash(oh, key)) != OHASH_SLOT_NONE);
+}
+
+/**
+ * Remove a random entry from \a oh, returning true if a key/value pair could be removed, false otherwise.
+ *
+ * \param r_key: The removed key.
+ * \param r_val: The removed value.
+ * \param state: Used for efficient removal.
+ * \return true if there was something to pop, false if ohash was already empty.
+ */
+bool BLI_ohash_pop(
+        OHash *oh, OHashIterState *state,
+        void **r_key, void **r_val)
+{
+	uint slot;
+
+	if (oh->nentries == 0) {
+		*r_key = *r_val = NULL;
+		return false;
+	}
+
+	/* Starting from the previous popped slot avoids scanning the already emptied ones again. */
+	slot = ohash_find_next_full_slot(oh, (state->curr_slot < oh->capacity) ? state->curr_slot : 0);
+	if (slot == OHASH_SLOT_NONE) {
+		slot = ohash_find_next_full_slot(oh, 0);
+	}
+	BLI_assert(slot != OHASH_SLOT_NONE);
+
+	*r_key = oh->keys[slot];
+	*r_val = oh->vals ? oh->vals[slot] : NULL;
+
+	ohash_slot_remove(oh, slot);
+	ohash_contract(oh);
+
+	state->curr_slot = slot;
+	return true;
+}
+
+/**
+ * Reset \a oh clearing all entries.
+ *
+ * \param keyfreefp  Optional callback to free the key.
+ * \param valfreefp  Optional callback to free the value.
+ * \param nentries_reserve  Optionally reserve the number of members that the hash will hold.
+ */
+void BLI_ohash_clear_ex(
+        OHash *oh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp,
+        const uint nentries_reserve)
+{
+	if (keyfreefp || valfreefp) {
+		ohash_free_cb(oh, keyfreefp, valfreefp);
+	}
+
+	ohash_slots_reset(oh, nentries_reserve);
+}
+
+/**
+ * Wraps #BLI_ohash_clear_ex with zero entries reserved.
+ */
+void BLI_ohash_clear(OHash *oh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	BLI_ohash_clear_ex(oh, keyfreefp, valfreefp, 0);
+}
+
+/**
+ * Frees the OHash and its members.
+ *
+ * \param oh  The OHash to free.
+ * \param keyfreefp  Optional callback to free the key.
+ * \param valfreefp  Optional callback to free the value.
+ */
+void BLI_ohash_free(OHash *oh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	if (keyfreefp || valfreefp) {
+		ohash_free_cb(oh, keyfreefp, valfreefp);
+	}
+
+	MEM_freeN(oh->ctrl);
+	MEM_freeN(oh);
+}
+
+/**
+ * Sets a OHash flag.
+ */
+void BLI_ohash_flag_set(OHash *oh, uint flag)
+{
+	oh->flag |= flag;
+}
+
+/**
+ * Clear a OHash flag.
+ */
+void BLI_ohash_flag_clear(OHash *oh, uint flag)
+{
+	oh->flag &= ~flag;
+}
+
+/** \} */
+
+
+/** \name OHash Iterator API
+ * \{ */
+
+BLI_INLINE void ohash_iterator_set_slot(OHashIterator *ohi, const uint slot)
+{
+	OHash *oh = ohi->oh;
+
+	ohi->curr_slot = slot;
+	if (slot != OHASH_SLOT_NONE) {
+		ohi->curr_key = &oh->keys[slot];
+		ohi->curr_val = oh->vals ? &oh->vals[slot] : NULL;
+	}
+	else {
+		ohi->curr_key = NULL;
+		ohi->curr_val = NULL;
+	}
+}
+
+/**
+ * Create a new OHashIterator. The hash table must not be mutated
+ * while the iterator is in use, and the iterator will step exactly
+ * BLI_ohash_size(oh) times before becoming done.
+ *
+ * \param oh The OHash to iterate over.
+ * \return Pointer to a new iterator.
+ */
+OHashIterator *BLI_ohashIterator_new(OHash *oh)
+{
+	OHashIterator *ohi = MEM_mallocN(sizeof(*ohi), "ohash iterator");
+	BLI_ohashIterator_init(ohi, oh);
+	return ohi;
+}
+
+/**
+ * Init an already allocated OHashIterator. The hash table must not
+ * be mutated while the iterator is in use, and the iterator will
+ * step exactly BLI_ohash_size(oh) times before becoming done.
+ *
+ * \param ohi The OHashIterator to initialize.
+ * \param oh The OHash to iterate over.
+ */
+void BLI_ohashIterator_init(OHashIterator *ohi, OHash *oh)
+{
+	ohi->oh = oh;
+	ohash_iterator_set_slot(ohi, (oh->nentries != 0) ? ohash_find_next_full_slot(oh, 0) : OHASH_SLOT_NONE);
+}
+
+/**
+ * Steps the iterator to the next index.
+ *
+ * \param ohi The iterator.
+ */
+void BLI_ohashIterator_step(OHashIterator *ohi)
+{
+	if (ohi->curr_key) {
+		ohash_iterator_set_slot(ohi, ohash_find_next_full_slot(ohi->oh, ohi->curr_slot + 1));
+	}
+}
+
+/**
+ * Free a OHashIterator.
+ *
+ * \param ohi The iterator to free.
+ */
+void BLI_ohashIterator_free(OHashIterator *ohi)
+{
+	MEM_freeN(ohi);
+}
+
+/** \} */
+
+
+/** \name Convenience OHash Creation Functions
+ * \{ */
+
+OHash *BLI_ohash_ptr_new_ex(const char *info, const uint nentries_reserve)
+{
+	return BLI_ohash_new_ex(BLI_ghashutil_ptrhash, BLI_ghashutil_ptrcmp, info, nentries_reserve);
+}
+OHash *BLI_ohash_ptr_new(const char *info)
+{
+	return BLI_ohash_ptr_new_ex(info, 0);
+}
+
+OHash *BLI_ohash_str_new_ex(const char *info, const uint nentries_reserve)
+{
+	return BLI_ohash_new_ex(BLI_ghashutil_strhash_p, BLI_ghashutil_strcmp, info, nentries_reserve);
+}
+OHash *BLI_ohash_str_new(const char *info)
+{
+	return BLI_ohash_str_new_ex(info, 0);
+}
+
+OHash *BLI_ohash_int_new_ex(const char *info, const uint nentries_reserve)
+{
+	return BLI_ohash_new_ex(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, info, nentries_reserve);
+}
+OHash *BLI_ohash_int_new(const char *info)
+{
+	return BLI_ohash_int_new_ex(info, 0);
+}
+
+OHash *BLI_ohash_pair_new_ex(const char *info, const uint nentries_reserve)
+{
+	return BLI_ohash_new_ex(BLI_ghashutil_pairhash, BLI_ghashutil_paircmp, info, nentries_reserve);
+}
+OHash *BLI_ohash_pair_new(const char *info)
+{
+	return BLI_ohash_pair_new_ex(info, 0);
+}
+
+/** \} */
+
+
+/* -------------------------------------------------------------------- */
+/* OSet API */
+
+/* Use ohash API to give 'set' functionality */
+
+/** \name OSet Functions
+ * \{ */
+OSet *BLI_oset_new_ex(GSetHashFP hashfp, GSetCmpFP cmpfp, const char *info,
+                      const uint nentries_reserve)
+{
+	return (OSet *)ohash_new(hashfp, cmpfp, info, nentries_reserve, GHASH_FLAG_IS_GSET);
+}
+
+OSet *BLI_oset_new(GSetHashFP hashfp, GSetCmpFP cmpfp, const char *info)
+{
+	return BLI_oset_new_ex(hashfp, cmpfp, info, 0);
+}
+
+/**
+ * Copy given OSet. Keys are also copied if callback is provided, else pointers remain the same.
+ */
+OSet *BLI_oset_copy(OSet *os, GHashKeyCopyFP keycopyfp)
+{
+	return (OSet *)ohash_copy((OHash *)os, keycopyfp, NULL);
+}
+
+uint BLI_oset_size(OSet *os)
+{
+	return ((OHash *)os)->nentries;
+}
+
+void BLI_oset_reserve(OSet *os, const uint nentries_reserve)
+{
+	BLI_ohash_reserve((OHash *)os, nentries_reserve);
+}
+
+/**
+ * Adds the key to the set (no checks for unique keys!).
+ * Matching #BLI_ohash_insert
+ */
+void BLI_oset_insert(OSet *os, void *key)
+{
+	ohash_insert((OHash *)os, key, NULL);
+}
+
+/**
+ * A version of BLI_oset_insert which checks first if the key is in the set.
+ * \returns true if a new key has been added.
+ *
+ * \note OHash has no equivalent to this because typically the value would be different.
+ */
+bool BLI_oset_add(OSet *os, void *key)
+{
+	return ohash_insert_safe((OHash *)os, key, NULL, false, NULL, NULL);
+}
+
+/**
+ * Set counterpart to #BLI_ohash_ensure_p_ex.
+ * similar to BLI_oset_add, except it returns the key pointer.
+ *
+ * \warning Caller _must_ write to \a r_key when returning false.
+ */
+bool BLI_oset_ensure_p_ex(OSet *os, const void *key, void ***r_key)
+{
+	OHash *oh = (OHash *)os;
+	uint slot;
+	const bool haskey = ohash_ensure_slot(oh, key, &slot);
+
+	*r_key = &oh->keys[slot];
+	return haskey;
+}
+
+/**
+ * Adds the key to the set (duplicates are managed).
+ * Matching #BLI_ohash_reinsert
+ *
+ * \returns true if a new key has been added.
+ */
+bool BLI_oset_reinsert(OSet *os, void *key, GSetKeyFreeFP keyfreefp)
+{
+	return ohash_insert_safe((OHash *)os, key, NULL, true, keyfreefp, NULL);
+}
+
+/**
+ * Replaces the key to the set if it's found.
+ * Matching #BLI_ohash_replace_key
+ *
+ * \returns The old key or NULL if not found.
+ */
+void *BLI_oset_replace_key(OSet *os, void *key)
+{
+	return BLI_ohash_replace_key((OHash *)os, key);
+}
+
+bool BLI_oset_remove(OSet *os, const void *key, GSetKeyFreeFP keyfreefp)
+{
+	return BLI_ohash_remove((OHash *)os, key, keyfreefp, NULL);
+}
+
+bool BLI_oset_haskey(OSet *os, const void *key)
+{
+	return BLI_ohash_haskey((OHash *)os, key);
+}
+
+/**
+ * Remove a random entry from \a os, returning true if a key could be removed, false otherwise.
+ *
+ * \param r_key: The removed key.
+ * \param state: Used for efficient removal.
+ * \return true if there was something to pop, false if oset was already empty.
+ */
+bool BLI_oset_pop(
+        OSet *os, OSetIterState *state,
+        void **r_key)
+{
+	void *val;
+	return BLI_ohash_pop((OHash *)os, (OHashIterState *)state, r_key, &val);
+}
+
+void BLI_oset_clear_ex(OSet *os, GSetKeyFreeFP keyfreefp,
+                       const uint nentries_reserve)
+{
+	BLI_ohash_clear_ex((OHash *)os, keyfreefp, NULL,
+	                   nentries_reserve);
+}
+
+void BLI_oset_clear(OSet *os, GSetKeyFreeFP keyfreefp)
+{
+	BLI_ohash_clear((OHash *)os, keyfreefp, NULL);
+}
+
+void BLI_oset_free(OSet *os, GSetKeyFreeFP keyfreefp)
+{
+	BLI_ohash_free((OHash *)os, keyfreefp, NULL);
+}
+
+void BLI_oset_flag_set(OSet *os, uint flag)
+{
+	((OHash *)os)->flag |= flag;
+}
+
+void BLI_oset_flag_clear(OSet *os, uint flag)
+{
+	((OHash *)os)->flag &= ~flag;
+}
+
+/** \} */
+
+
+/** \name OSet Combined Key/Value Usage
+ *
+ * \note Not typical ``set`` use, only use when the pointer identity matters.
+ * This can be useful when the key references data stored outside the OSet.
+ * \{ */
+
+/**
+ * Returns the pointer to the key if it's found.
+ */
+void *BLI_oset_lookup(OSet *os, const void *key)
+{
+	OHash *oh = (OHash *)os;
+	const uint slot = ohash_lookup_slot(oh, key, ohash_keyhash(oh, key));
+
+	return (slot != OHASH_SLOT_NONE) ? oh->keys[slot] : NULL;
+}
+
+/**
+ * Returns the pointer to the key if it's found, removing it from the OSet.
+ * \note Caller must handle freeing.
+ */
+void *BLI_oset_pop_key(OSet *os, const void *key)
+{
+	OHash *oh = (OHash *)os;
+	const uint slot = ohash_lookup_slot(oh, key, ohash_keyhash(oh, key));
+
+	if (slot != OHASH_SLOT_NONE) {
+		void *key_ret = oh->keys[slot];
+		ohash_slot_remove(oh, slot);
+		ohash_contract(oh);
+		return key_ret;
+	}
+	return NULL;
+}
+
+/** \} */
+
+
+/** \name Convenience OSet Creation Functions
+ * \{ */
+
+OSet *BLI_oset_ptr_new_ex(const char *info, const uint nentries_reserve)
+{
+	return BLI_oset_new_ex(BLI_ghashutil_ptrhash, BLI_ghashutil_ptrcmp, info, nentries_reserve);
+}
+OSet *BLI_oset_ptr_new(const char *info)
+{
+	return BLI_oset_ptr_new_ex(info, 0);
+}
+
+OSet *BLI_oset_str_new_ex(const char *info, const uint nentries_reserve)
+{
+	return BLI_oset_new_ex(BLI_ghashutil_strhash_p, BLI_ghashutil_strcmp, info, nentries_reserve);
+}
+OSet *BLI_oset_str_new(const char *info)
+{
+	return BLI_oset_str_new_ex(info, 0);
+}
+
+OSet *BLI_oset_pair_new_ex(const char *info, const uint nentries_reserve)
+{
+	return BLI_oset_new_ex(BLI_ghashutil_pairhash, BLI_ghashutil_paircmp, info, nentries_reserve);
+}
+OSet *BLI_oset_pair_new(const char *info)
+{
+	return BLI_oset_pair_new_ex(info, 0);
+}
+
+/** \} */
+
+
+/** \name Debugging & Introspection
+ * \{ */
+
+/**
+ * \return number of slots in the OHash.
+ */
+int BLI_ohash_capacity(OHash *oh)
+{
+	return (int)oh->capacity;
+}
+int BLI_oset_capacity(OSet *os)
+{
+	return BLI_ohash_capacity((OHash *)os);
+}
+
+/**
+ * Measure how well the hash function performs, as the average number of groups
+ * which have to be probed to find each key (1.0 being the best).
+ */
+double BLI_ohash_calc_probe_length(OHash *oh)
+{
+	uint64_t sum = 0;
+
+	if (oh->nentries == 0) {
+		return 0.0;
+	}
+
+	for (uint i = 0; i < oh->capacity; i++) {
+		if (CTRL_IS_FULL(oh->ctrl[i])) {
+			const uint hash = ohash_keyhash(oh, oh->keys[i]);
+			uint group = ohash_group_index(oh, hash);
+			uint probe = 1;
+
+			while (group != i / OHASH_GROUP_SIZE) {
+				group = (group + probe) & oh->group_mask;
+				probe++;
+			}
+			sum += probe;
+		}
+	}
+	return (double)sum / (double)oh->nentries;
+}
+
+/** \} */
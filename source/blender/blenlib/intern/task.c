@@ -49,11 +49,15 @@
  */
 #define MEMPOOL_SIZE 256
 
-/* Number of tasks which are pushed directly to local thread queue.
+/* Number of tasks which fit into per-thread work-stealing deque.
  *
- * This allows thread to fetch next task without locking the whole queue.
+ * Must be power of two. When deque is full tasks are pushed to the scheduler's
+ * global queue.
  */
-#define LOCAL_QUEUE_SIZE 1
+#define TASK_DEQUE_SIZE 1024
+
+/* Used to keep both ends of the deque on separate cache lines. */
+#define TASK_CACHELINE_SIZE 64
 
 /* Number of tasks which are allowed to be scheduled in a delayed manner.
  *
@@ -136,18 +140,45 @@ typedef struct TaskMemPoolStats {
 } TaskMemPoolStats;
 #endif
 
+/* Lock-free work-stealing deque (Chase-Lev).
+ *
+ * Every worker thread owns a deque. Tasks pushed from the worker thread go to
+ * the bottom of its own deque, and the owner pops tasks from the bottom, so
+ * the most recently pushed (cache-hot) task is handled first. Other threads
+ * which ran out of work steal from the top of the deque.
+ *
+ * Only the owner modifies bottom, top is advanced with atomic CAS by both
+ * thieves and the owner when they compete for the last task. Indices are only
+ * growing and wrap around, they are compared using their signed difference.
+ *
+ * Pool of the task is stored next to it, so it can be checked without touching
+ * task memory before the task is actually taken: work_and_wait() only takes
+ * tasks of the pool it is waiting for.
+ *
+ * All tasks in a deque belong to the same pool, tasks of other pools go to the
+ * global queue until the deque is empty again. Otherwise tasks of a waited pool
+ * could be buried between tasks of other pools, where neither the bottom nor
+ * the top of the deque gives access to them, and the waiting thread would stall.
+ */
+typedef struct TaskDequeItem {
+	Task *task;
+	TaskPool *pool;
+} TaskDequeItem;
+
+typedef struct TaskDeque {
+	uint32_t bottom;
+	char _pad1[TASK_CACHELINE_SIZE - sizeof(uint32_t)];
+	uint32_t top;
+	char _pad2[TASK_CACHELINE_SIZE - sizeof(uint32_t)];
+	TaskDequeItem items[TASK_DEQUE_SIZE];
+} TaskDeque;
+
 typedef struct TaskThreadLocalStorage {
 	/* Memory pool for faster task allocation.
 	 * The idea is to re-use memory of finished/discarded tasks by this thread.
 	 */
 	TaskMemPool task_mempool;
 
-	/* Local queue keeps thread alive by keeping small amount of tasks ready
-	 * to be picked up without causing global thread locks for synchronization.
-	 */
-	int num_local_queue;
-	Task *local_queue[LOCAL_QUEUE_SIZE];
-
 	/* Thread can be marked for delayed tasks push. This is helpful when it's
 	 * know that lots of subsequent task pushed will happen from the same thread
 	 * without "interrupting" for task execution.
@@ -210,10 +241,18 @@ struct TaskScheduler {
 	int num_threads;
 	bool background_thread_only;
 
+	/* Global queue, used for tasks pushed from threads which are not scheduler
+	 * workers, by suspended pools and when worker's deque is full.
+	 */
 	ListBase queue;
 	ThreadMutex queue_mutex;
 	ThreadCondition queue_cond;
 
+	/* Number of worker threads sleeping on queue_cond, tasks pushed to deques
+	 * only need to wake threads up when this is non-zero.
+	 */
+	uint32_t num_sleeping;
+
 	volatile bool do_exit;
 
 	/* NOTE: In pthread's TLS we store the whole TaskThread structure. */
@@ -224,8 +263,114 @@ typedef struct TaskThread {
 	TaskScheduler *scheduler;
 	int id;
 	TaskThreadLocalStorage tls;
+
+	/* Work-stealing deque, only used by scheduler's worker threads. Kept out
+	 * of the TLS so pools with their own local TLS don't carry it around.
+	 */
+	TaskDeque deque;
 } TaskThread;
 
+/* Work-stealing deque */
+
+BLI_INLINE uint32_t task_atomic_read_uint32(const uint32_t *p)
+{
+	return *(const volatile uint32_t *)p;
+}
+
+BLI_INLINE bool task_deque_is_empty(TaskDeque *deque)
+{
+	return (int32_t)(task_atomic_read_uint32(&deque->bottom) - task_atomic_read_uint32(&deque->top)) <= 0;
+}
+
+/* Push task to the bottom of the deque, only called by the owner thread.
+ * Returns false if the deque is full or holds tasks of another pool.
+ */
+static bool task_deque_push(TaskDeque *deque, Task *task)
+{
+	const uint32_t bottom = deque->bottom;
+	const uint32_t top = task_atomic_read_uint32(&deque->top);
+	if ((int32_t)(bottom - top) >= TASK_DEQUE_SIZE) {
+		return false;
+	}
+	/* Only the owner writes items, so the pool of the last pushed item is
+	 * stable. If it was stolen meanwhile this is only overly conservative.
+	 */
+	if ((int32_t)(bottom - top) > 0 &&
+	    deque->items[(bottom - 1) & (TASK_DEQUE_SIZE - 1)].pool != task->pool)
+	{
+		return false;
+	}
+	TaskDequeItem *item = &deque->items[bottom & (TASK_DEQUE_SIZE - 1)];
+	item->task = task;
+	item->pool = task->pool;
+	/* Full barrier, makes item visible before thieves see new bottom. */
+	atomic_add_and_fetch_uint32(&deque->bottom, 1);
+	return true;
+}
+
+/* Pop task from the bottom of the deque, only called by the owner thread.
+ * When pool is not NULL only a task of that pool is popped.
+ */
+static Task *task_deque_pop(TaskDeque *deque, TaskPool *pool)
+{
+	const uint32_t last = deque->bottom - 1;
+	if ((int32_t)(last - task_atomic_read_uint32(&deque->top)) < 0) {
+		return NULL;
+	}
+	TaskDequeItem *item = &deque->items[last & (TASK_DEQUE_SIZE - 1)];
+	if (pool != NULL && item->pool != pool) {
+		return NULL;
+	}
+	Task *task = item->task;
+	/* Reserve the item first, full barrier orders it with reading top. */
+	atomic_sub_and_fetch_uint32(&deque->bottom, 1);
+	const uint32_t top = task_atomic_read_uint32(&deque->top);
+	if ((int32_t)(last - top) > 0) {
+		/* There are more items, no thief can get to this one. */
+		return task;
+	}
+	if (last == top) {
+		/* Last item, compete with thieves for it. */
+		if (atomic_cas_uint32(&deque->top, top, top + 1) != top) {
+			task = NULL;
+		}
+	}
+	else {
+		/* Stolen in the meantime. */
+		task = NULL;
+	}
+	/* Deque is empty now, restore bottom so it matches top. */
+	atomic_add_and_fetch_uint32(&deque->bottom, 1);
+	return task;
+}
+
+/* Steal task from the top of the deque, called by any thread.
+ * When pool is not NULL only a task of that pool is stolen.
+ */
+static Task *task_deque_steal(TaskDeque *deque, TaskPool *pool)
+{
+	/* Both ends are read with full barriers: top must be read before bottom,
+	 * and item must be read after bottom to see what the owner has written.
+	 */
+	const uint32_t top = atomic_add_and_fetch_uint32(&deque->top, 0);
+	const uint32_t bottom = atomic_add_and_fetch_uint32(&deque->bottom, 0);
+	if ((int32_t)(bottom - top) <= 0) {
+		return NULL;
+	}
+	/* Item might be overwritten by the owner if it was taken already, the CAS
+	 * below fails in that case, so task is not touched before it.
+	 */
+	TaskDequeItem *item = &deque->items[top & (TASK_DEQUE_SIZE - 1)];
+	Task *task = item->task;
+	if (pool != NULL && item->pool != pool) {
+		return NULL;
+	}
+	if (atomic_cas_uint32(&deque->top, top, top + 1) != top) {
+		return NULL;
+	}
+	return task;
+}
+
 /* Helper */
 BLI_INLINE void task_data_free(Task *task, const int thread_id)
 {
@@ -334,9 +479,8 @@ static void task_pool_num_decrease(TaskPool *pool, size_t done)
 
 	BLI_assert(pool->num >= done);
 
-	pool->num -= done;
-
-	if (pool->num == 0)
+	/* Atomic since tasks pushed to deques increase it without lock. */
+	if (atomic_sub_and_fetch_z((size_t *)&pool->num, done) == 0)
 		BLI_condition_notify_all(&pool->num_cond);
 
 	BLI_mutex_unlock(&pool->num_mutex);
@@ -346,29 +490,106 @@ static void task_pool_num_increase(TaskPool *pool, size_t new)
 {
 	BLI_mutex_lock(&pool->num_mutex);
 
-	pool->num += new;
+	atomic_add_and_fetch_z((size_t *)&pool->num, new);
 	BLI_condition_notify_all(&pool->num_cond);
 
 	BLI_mutex_unlock(&pool->num_mutex);
 }
 
-static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, Task **task)
+static bool task_scheduler_deques_have_work(TaskScheduler *scheduler)
 {
-	bool found_task = false;
-	BLI_mutex_lock(&scheduler->queue_mutex);
+	if (scheduler->background_thread_only) {
+		return false;
+	}
+	for (int i = 1; i <= scheduler->num_threads; i++) {
+		if (!task_deque_is_empty(&scheduler->task_threads[i].deque)) {
+			return true;
+		}
+	}
+	return false;
+}
 
-	while (!scheduler->queue.first && !scheduler->do_exit)
-		BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+/* Steal task from deques of other worker threads, starting with the neighbour
+ * of the given thread. When pool is not NULL only its tasks are stolen.
+ */
+static Task *task_scheduler_steal(TaskScheduler *scheduler,
+                                  TaskPool *pool,
+                                  const int thread_id)
+{
+	if (scheduler->background_thread_only) {
+		return NULL;
+	}
+	const int num_threads = scheduler->num_threads;
+	for (int i = 0; i < num_threads; i++) {
+		const int victim_id = (thread_id + i) % num_threads + 1;
+		if (victim_id == thread_id && pool == NULL) {
+			continue;
+		}
+		TaskDeque *deque = &scheduler->task_threads[victim_id].deque;
+		if (task_deque_is_empty(deque)) {
+			continue;
+		}
+		Task *task = task_deque_steal(deque, pool);
+		if (task != NULL) {
+			return task;
+		}
+	}
+	return NULL;
+}
 
-	do {
-		Task *current_task;
+/* Push task to the deque of the calling worker thread, waking up sleeping
+ * threads so they can steal it.
+ */
+static bool task_scheduler_deque_push(TaskScheduler *scheduler,
+                                      Task *task,
+                                      const int thread_id)
+{
+	BLI_assert(thread_id > 0 && thread_id <= scheduler->num_threads);
+	TaskDeque *deque = &scheduler->task_threads[thread_id].deque;
+
+	/* Counted before the task becomes visible, so it's never negative. */
+	atomic_add_and_fetch_z((size_t *)&task->pool->num, 1);
+
+	if (!task_deque_push(deque, task)) {
+		atomic_sub_and_fetch_z((size_t *)&task->pool->num, 1);
+		return false;
+	}
+
+	/* Push above is a full barrier, sleeping threads increase the counter
+	 * before checking the deques, so either they see the task or we see them.
+	 */
+	if (task_atomic_read_uint32(&scheduler->num_sleeping) != 0) {
+		BLI_mutex_lock(&scheduler->queue_mutex);
+		BLI_condition_notify_one(&scheduler->queue_cond);
+		BLI_mutex_unlock(&scheduler->queue_mutex);
+	}
+	return true;
+}
 
-		/* Assuming we can only have a void queue in 'exit' case here seems logical (we should only be here after
-		 * our worker thread has been woken up from a condition_wait(), which only happens after a new task was
-		 * added to the queue), but it is wrong.
-		 * Waiting on condition may wake up the thread even if condition is not signaled (spurious wake-ups), and some
-		 * race condition may also empty the queue **after** condition has been signaled, but **before** awoken thread
-		 * reaches this point...
+static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler,
+                                           TaskThread *thread,
+                                           Task **task)
+{
+	const int thread_id = thread->id;
+
+	while (true) {
+		/* Lock-free paths first: own deque, then stealing from others. */
+		if (!scheduler->background_thread_only) {
+			*task = task_deque_pop(&thread->deque, NULL);
+			if (*task == NULL) {
+				*task = task_scheduler_steal(scheduler, NULL, thread_id);
+			}
+			if (*task != NULL) {
+				return true;
+			}
+		}
+
+		BLI_mutex_lock(&scheduler->queue_mutex);
+
+		/* Waiting on condition may wake up the thread even if condition is not
+		 * signaled (spurious wake-ups), and some race condition may also empty
+		 * the queue after condition has been signaled, but before awoken thread
+		 * reaches this point, so the queue is always checked again.
 		 * See http://stackoverflow.com/questions/8594591
 		 *
 		 * So we only abort here if do_exit is set.
@@ -378,6 +599,7 @@ static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, Task **task
 			return false;
 		}
 
+		Task *current_task;
 		for (current_task = scheduler->queue.first;
 		     current_task != NULL;
 		     current_task = current_task->next)
@@ -389,37 +611,33 @@ static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, Task **task
 			}
 
 			*task = current_task;
-			found_task = true;
 			BLI_remlink(&scheduler->queue, *task);
-			break;
+			BLI_mutex_unlock(&scheduler->queue_mutex);
+			return true;
 		}
-		if (!found_task)
-			BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
-	} while (!found_task);
 
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+		/* Nothing to do, sleep until new task is pushed. Counter is increased
+		 * before checking deques, see task_scheduler_deque_push().
+		 */
+		atomic_add_and_fetch_uint32(&scheduler->num_sleeping, 1);
+		if (!task_scheduler_deques_have_work(scheduler)) {
+			BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+		}
+		atomic_sub_and_fetch_uint32(&scheduler->num_sleeping, 1);
 
-	return true;
+		BLI_mutex_unlock(&scheduler->queue_mutex);
+	}
 }
 
-BLI_INLINE void handle_local_queue(TaskThreadLocalStorage *tls,
-                                   const int thread_id)
+BLI_INLINE void task_run(Task *task, const int thread_id)
 {
-	BLI_assert(!tls->do_delayed_push);
-	while (tls->num_local_queue > 0) {
-		/* We pop task from queue before handling it so handler of the task can
-		 * push next job to the local queue.
-		 */
-		tls->num_local_queue--;
-		Task *local_task = tls->local_queue[tls->num_local_queue];
-		/* TODO(sergey): Double-check work_and_wait() doesn't handle other's
-		 * pool tasks.
-		 */
-		TaskPool *local_pool = local_task->pool;
-		local_task->run(local_pool, local_task->taskdata, thread_id);
-		task_free(local_pool, local_task, thread_id);
+	TaskPool *pool = task->pool;
+	/* Tasks of canceled pool which are already in the deques can not be
+	 * removed from there, skip them instead.
+	 */
+	if (!pool->do_cancel) {
+		task->run(pool, task->taskdata, thread_id);
 	}
-	BLI_assert(!tls->do_delayed_push);
 }
 
 static void *task_scheduler_thread_run(void *thread_p)
@@ -433,24 +651,24 @@ static void *task_scheduler_thread_run(void *thread_p)
 	pthread_setspecific(scheduler->tls_id_key, thread);
 
 	/* keep popping off tasks */
-	while (task_scheduler_thread_wait_pop(scheduler, &task)) {
+	while (task_scheduler_thread_wait_pop(scheduler, thread, &task)) {
 		TaskPool *pool = task->pool;
 
 		/* run task */
 		BLI_assert(!tls->do_delayed_push);
-		task->run(pool, task->taskdata, thread_id);
+		task_run(task, thread_id);
 		BLI_assert(!tls->do_delayed_push);
 
 		/* delete task */
 		task_free(pool, task, thread_id);
 
-		/* Handle all tasks from local queue. */
-		handle_local_queue(tls, thread_id);
-
 		/* notify pool task was done */
 		task_pool_num_decrease(pool, 1);
 	}
 
+	/* Not done automatically on all platforms. */
+	MEM_thread_cache_release();
+
 	return NULL;
 }
 
@@ -483,8 +701,13 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 	scheduler->task_threads = MEM_mallocN(sizeof(TaskThread) * (num_threads + 1),
 	                                      "TaskScheduler task threads");
 
-	/* Initialize TLS for main thread. */
-	initialize_task_tls(&scheduler->task_threads[0].tls);
+	/* Initialize TLS for main thread and all worker threads, workers access
+	 * deques of each other, so this must happen before any thread is launched.
+	 */
+	for (int i = 0; i < num_threads + 1; i++) {
+		initialize_task_tls(&scheduler->task_threads[i].tls);
+		memset(&scheduler->task_threads[i].deque, 0, sizeof(TaskDeque));
+	}
 
 	pthread_key_create(&scheduler->tls_id_key, NULL);
 
@@ -499,7 +722,6 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 			TaskThread *thread = &scheduler->task_threads[i + 1];
 			thread->scheduler = scheduler;
 			thread->id = i + 1;
-			initialize_task_tls(&thread->tls);
 
 			if (pthread_create(&scheduler->threads[i], NULL, task_scheduler_thread_run, thread) != 0) {
 				fprintf(stderr, "TaskScheduler failed to launch thread %d/%d\n", i, num_threads);
@@ -538,6 +760,7 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 	if (scheduler->task_threads) {
 		for (int i = 0; i < scheduler->num_threads + 1; ++i) {
 			TaskThreadLocalStorage *tls = &scheduler->task_threads[i].tls;
+			BLI_assert(task_deque_is_empty(&scheduler->task_threads[i].deque));
 			free_task_tls(tls);
 		}
 
@@ -798,22 +1021,27 @@ static void task_pool_push(
 	if (task_can_use_local_queues(pool, thread_id)) {
 		ASSERT_THREAD_ID(pool->scheduler, thread_id);
 		TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
-		/* Try to push to a local execution queue.
-		 * These tasks will be picked up next.
-		 */
-		if (tls->num_local_queue < LOCAL_QUEUE_SIZE) {
-			tls->local_queue[tls->num_local_queue] = task;
-			tls->num_local_queue++;
-			return;
-		}
 		/* If we are in the delayed tasks push mode, we push tasks to a
 		 * temporary local queue first without any locks, and then move them
-		 * to global execution queue with a single lock.
+		 * to global execution queue with a single lock. Checked first, also
+		 * worker threads must not make these tasks visible before the end
+		 * of the delayed push.
 		 */
-		if (tls->do_delayed_push && tls->num_delayed_queue < DELAYED_QUEUE_SIZE) {
-			tls->delayed_queue[tls->num_delayed_queue] = task;
-			tls->num_delayed_queue++;
-			return;
+		if (tls->do_delayed_push) {
+			if (tls->num_delayed_queue < DELAYED_QUEUE_SIZE) {
+				tls->delayed_queue[tls->num_delayed_queue] = task;
+				tls->num_delayed_queue++;
+				return;
+			}
+		}
+		/* Worker threads push to their own deque without any locks.
+		 * These tasks will be picked up next by the worker, or stolen by
+		 * other threads which ran out of work.
+		 */
+		else if (thread_id != 0 && !pool->scheduler->background_thread_only) {
+			if (task_scheduler_deque_push(pool->scheduler, task, thread_id)) {
+				return;
+			}
 		}
 	}
 	/* Do push to a global execution ppol, slowest possible method,
@@ -870,34 +1098,43 @@ void BLI_task_pool_work_and_wait(TaskPool *pool)
 
 		BLI_mutex_unlock(&pool->num_mutex);
 
-		BLI_mutex_lock(&scheduler->queue_mutex);
-
 		/* find task from this pool. if we get a task from another pool,
 		 * we can get into deadlock */
 
-		for (task = scheduler->queue.first; task; task = task->next) {
-			if (task->pool == pool) {
-				work_task = task;
-				found_task = true;
-				BLI_remlink(&scheduler->queue, task);
-				break;
+		/* Own deque first when waiting from a worker thread. */
+		if (pool->thread_id != 0 && !scheduler->background_thread_only) {
+			work_task = task_deque_pop(&scheduler->task_threads[pool->thread_id].deque, pool);
+		}
+
+		if (work_task == NULL) {
+			BLI_mutex_lock(&scheduler->queue_mutex);
+
+			for (task = scheduler->queue.first; task; task = task->next) {
+				if (task->pool == pool) {
+					work_task = task;
+					BLI_remlink(&scheduler->queue, task);
+					break;
+				}
 			}
+
+			BLI_mutex_unlock(&scheduler->queue_mutex);
 		}
 
-		BLI_mutex_unlock(&scheduler->queue_mutex);
+		if (work_task == NULL) {
+			work_task = task_scheduler_steal(scheduler, pool, pool->thread_id);
+		}
+
+		found_task = (work_task != NULL);
 
 		/* if found task, do it, otherwise wait until other tasks are done */
 		if (found_task) {
 			/* run task */
 			BLI_assert(!tls->do_delayed_push);
-			work_task->run(pool, work_task->taskdata, pool->thread_id);
+			task_run(work_task, pool->thread_id);
 			BLI_assert(!tls->do_delayed_push);
 
 			/* delete task */
-			task_free(pool, task, pool->thread_id);
-
-			/* Handle all tasks from local queue. */
-			handle_local_queue(tls, pool->thread_id);
+			task_free(pool, work_task, pool->thread_id);
 
 			/* notify pool task was done */
 			task_pool_num_decrease(pool, 1);
@@ -912,8 +1149,6 @@ void BLI_task_pool_work_and_wait(TaskPool *pool)
 	}
 
 	BLI_mutex_unlock(&pool->num_mutex);
-
-	handle_local_queue(tls, pool->thread_id);
 }
 
 void BLI_task_pool_cancel(TaskPool *pool)
@@ -250,7 +250,12 @@ static void *tslot_thread_start(void *tslot_p)
 	pthread_setspecific(gomp_tls_key, thread_tls_data);
 #endif
 
-	return tslot->do_thread(tslot->callerdata);
+	void *ret = tslot->do_thread(tslot->callerdata);
+
+	/* Not done automatically on all platforms. */
+	MEM_thread_cache_release();
+
+	return ret;
 }
 
 int BLI_thread_is_main(void)
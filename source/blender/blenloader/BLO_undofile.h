@@ -36,22 +36,34 @@
 typedef struct {
 	void *next, *prev;
 	
+	/* shared between identical chunks of all memfiles, never modify */
 	char *buf;
+	/* ident: buf was already stored when the chunk was added */
 	unsigned int ident, size;
 	
 } MemFileChunk;
 
 typedef struct MemFile {
 	ListBase chunks;
+	/* size of the chunks this memfile added to the store */
 	unsigned int size;
 } MemFile;
 
+typedef struct MemFileStats {
+	/* sum of the chunks of all memfiles, as if nothing was shared */
+	size_t size_logical;
+	/* memory used by chunk buffers, identical chunks are stored once */
+	size_t size_stored;
+	unsigned int chunks_logical, chunks_stored;
+} MemFileStats;
+
 /* actually only used writefile.c */
 extern void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsigned int size);
 
 /* exports */
 extern void BLO_memfile_free(MemFile *memfile);
 extern void BLO_memfile_merge(MemFile *first, MemFile *second);
+extern void BLO_memfile_stats(MemFileStats *r_stats);
 
 #endif
 
@@ -44,5 +44,14 @@ extern bool BLO_write_file(
 extern bool BLO_write_file_mem(
         struct Main *mainvar, struct MemFile *compare, struct MemFile *current, int write_flags);
 
+/* Write in memory from the main thread, then compress and write to disk from a thread. */
+typedef struct BLOWriteAsync BLOWriteAsync;
+
+extern BLOWriteAsync *BLO_write_file_async_begin(
+        struct Main *mainvar, const char *filepath, int write_flags,
+        struct ReportList *reports, const struct BlendThumbnail *thumb);
+extern void BLO_write_file_async_run(BLOWriteAsync *wa, float *progress);
+extern bool BLO_write_file_async_end(BLOWriteAsync *wa, struct ReportList *reports);
+
 #endif
 
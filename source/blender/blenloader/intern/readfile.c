@@ -51,6 +51,20 @@
 #  include "BLI_winstuff.h"
 #endif
 
+#ifndef WIN32
+#  include <sys/mman.h> // for mmap
+#else
+#  include "mmap_win.h"
+#endif
+
+#ifdef WITH_LZO
+#  ifdef WITH_SYSTEM_LZO
+#    include <lzo/lzo1x.h>
+#  else
+#    include "minilzo.h"
+#  endif
+#endif
+
 /* allow readfile to use deprecated functionality */
 #define DNA_DEPRECATED_ALLOW
 /* Allow using DNA struct members that are marked as private for read/write.
@@ -118,6 +132,9 @@
 #include "BLI_math.h"
 #include "BLI_threads.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
+
+#include "PIL_time.h"
 
 #include "BLT_translation.h"
 
@@ -232,6 +249,14 @@
 /* Use GHash for restoring pointers by name */
 #define USE_GHASH_RESTORE_POINTER
 
+/* Read uncompressed files from a memory mapping, using the blocks in place (no copy of the whole file)
+ * when the file has the same endianness and pointer size as Blender.
+ * Blocks are only 4 bytes aligned in files, only enable on 64bit architectures supporting unaligned access
+ * (32bit ones can't map big files anyway). */
+#if defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__) || defined(_M_ARM64)
+#  define USE_BHEAD_MMAP
+#endif
+
 /***/
 
 typedef struct OldNew {
@@ -240,11 +265,29 @@ typedef struct OldNew {
 	int nr;
 } OldNew;
 
+/* Lookup statistics, printed with --debug-fileload. */
+typedef struct OldNewMapStats {
+	unsigned int lookups;
+	/* found as the entry following the previous lookup, no hashing needed */
+	unsigned int lookups_lasthit;
+	/* not found at all */
+	unsigned int lookups_miss;
+	/* hash slots visited by lookups which missed lasthit */
+	unsigned int probes;
+} OldNewMapStats;
+
 typedef struct OldNewMap {
+	/* entries in insertion order, the same order in which data is written and usually linked */
 	OldNew *entries;
 	int nentries, entriessize;
-	bool sorted;
 	int lasthit;
+
+	/* Open addressing hash of the old addresses, storing indices in entries (-1 for free slots).
+	 * Always twice the size of entries, so it's never more than half full. */
+	int *map;
+	unsigned int map_mask;
+
+	OldNewMapStats stats;
 } OldNewMap;
 
 
@@ -289,49 +332,116 @@ static const char *library_parent_filepath(Library *lib)
 	return lib->parent ? lib->parent->filepath : "<direct>";
 }
 
+#define OLDNEWMAP_SIZE_DEFAULT 1024
+
+/* Python style probing, walking over all slots while using all bits of the hash. */
+#define OLDNEWMAP_PERTURB_SHIFT 5
+
+BLI_INLINE unsigned int oldnewmap_hash(const void *addr)
+{
+	/* bottom bits are always zero for allocated memory */
+	const uint64_t y = (uint64_t)(uintptr_t)addr >> 3;
+	return (unsigned int)(y ^ (y >> 32));
+}
+
+/* Fill the hash from scratch, for entries resized to \a entriessize. */
+static void oldnewmap_map_rebuild(OldNewMap *onm)
+{
+	const unsigned int map_size = (unsigned int)onm->entriessize * 2;
+	int i;
+
+	MEM_SAFE_FREE(onm->map);
+	onm->map = MEM_mallocN(sizeof(*onm->map) * map_size, "OldNewMap.map");
+	onm->map_mask = map_size - 1;
+	memset(onm->map, 0xff, sizeof(*onm->map) * map_size);
+
+	for (i = 0; i < onm->nentries; i++) {
+		const unsigned int hash = oldnewmap_hash(onm->entries[i].old);
+		unsigned int perturb = hash;
+		unsigned int slot = hash & onm->map_mask;
+
+		/* shadowed by a later entry with the same old address */
+		if (onm->entries[i].old == NULL) {
+			continue;
+		}
+
+		while (onm->map[slot] != -1) {
+			slot = (5 * slot + 1 + perturb) & onm->map_mask;
+			perturb >>= OLDNEWMAP_PERTURB_SHIFT;
+		}
+		onm->map[slot] = i;
+	}
+}
+
 static OldNewMap *oldnewmap_new(void) 
 {
 	OldNewMap *onm= MEM_callocN(sizeof(*onm), "OldNewMap");
 	
-	onm->entriessize = 1024;
+	onm->entriessize = OLDNEWMAP_SIZE_DEFAULT;
 	onm->entries = MEM_mallocN(sizeof(*onm->entries)*onm->entriessize, "OldNewMap.entries");
+	oldnewmap_map_rebuild(onm);
 	
 	return onm;
 }
 
-static int verg_oldnewmap(const void *v1, const void *v2)
+/**
+ * \return the index in entries of \a addr, or -1.
+ */
+BLI_INLINE int oldnewmap_lookup_entry(OldNewMap *onm, const void *addr)
 {
-	const struct OldNew *x1=v1, *x2=v2;
-	
-	if (x1->old > x2->old) return 1;
-	else if (x1->old < x2->old) return -1;
-	return 0;
-}
+	const unsigned int hash = oldnewmap_hash(addr);
+	unsigned int perturb = hash;
+	unsigned int slot = hash & onm->map_mask;
+	int i;
 
+	while ((i = onm->map[slot]) != -1) {
+		onm->stats.probes++;
+		if (onm->entries[i].old == addr) {
+			return i;
+		}
+		slot = (5 * slot + 1 + perturb) & onm->map_mask;
+		perturb >>= OLDNEWMAP_PERTURB_SHIFT;
+	}
+	onm->stats.probes++;
 
-static void oldnewmap_sort(FileData *fd) 
-{
-	BLI_assert(fd->libmap->sorted == false);
-	qsort(fd->libmap->entries, fd->libmap->nentries, sizeof(OldNew), verg_oldnewmap);
-	fd->libmap->sorted = 1;
+	return -1;
 }
 
 /* nr is zero for data, and ID code for libdata */
 static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
 {
 	OldNew *entry;
+	unsigned int hash, perturb, slot;
+	int i;
 	
 	if (oldaddr==NULL || newaddr==NULL) return;
 	
 	if (UNLIKELY(onm->nentries == onm->entriessize)) {
 		onm->entriessize *= 2;
 		onm->entries = MEM_reallocN(onm->entries, sizeof(*onm->entries) * onm->entriessize);
+		oldnewmap_map_rebuild(onm);
 	}
 
-	entry = &onm->entries[onm->nentries++];
+	i = onm->nentries++;
+	entry = &onm->entries[i];
 	entry->old = oldaddr;
 	entry->newp = newaddr;
 	entry->nr = nr;
+
+	/* A duplicate old address (from relinked placeholders or corrupt files) resolves to the last
+	 * entry, as the linear search did for libdata. The previous entry loses its old address, so
+	 * the lasthit shortcut can't return it either, it's only kept for iteration and freeing. */
+	hash = oldnewmap_hash(oldaddr);
+	perturb = hash;
+	slot = hash & onm->map_mask;
+	while (onm->map[slot] != -1 && onm->entries[onm->map[slot]].old != oldaddr) {
+		slot = (5 * slot + 1 + perturb) & onm->map_mask;
+		perturb >>= OLDNEWMAP_PERTURB_SHIFT;
+	}
+	if (onm->map[slot] != -1) {
+		onm->entries[onm->map[slot]].old = NULL;
+	}
+	onm->map[slot] = i;
 }
 
 void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
@@ -339,117 +449,60 @@ void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void
 	oldnewmap_insert(onm, oldaddr, newaddr, nr);
 }
 
-/**
- * Do a full search (no state).
- *
- * \param lasthit: Use as a reference position to avoid a full search
- * from either end of the array, giving more efficient lookups.
- *
- * \note This would seem an ideal case for hash or btree lookups.
- * However the data is written in-order, using the \a lasthit will normally avoid calling this function.
- * Creating a btree/hash structure adds overhead for the common-case to optimize the corner-case
- * (since most entries will never be retrieved).
- * So just keep full lookups as a fall-back.
- */
-static int oldnewmap_lookup_entry_full(const OldNewMap *onm, const void *addr, int lasthit)
-{
-	const int nentries = onm->nentries;
-	const OldNew *entries = onm->entries;
-	int i;
-
-	/* search relative to lasthit where possible */
-	if (lasthit >= 0 && lasthit < nentries) {
-
-		/* search forwards */
-		i = lasthit;
-		while (++i != nentries) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
-
-		/* search backwards */
-		i = lasthit + 1;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
-	}
-	else {
-		/* search backwards (full) */
-		i = nentries;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
-	}
-
-	return -1;
-}
-
 static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool increase_users)
 {
 	int i;
 	
 	if (addr == NULL) return NULL;
+
+	onm->stats.lookups++;
 	
+	/* data is written in-order, so most of the time the entry after the previous one is the one */
 	if (onm->lasthit < onm->nentries-1) {
-		OldNew *entry = &onm->entries[++onm->lasthit];
+		OldNew *entry = &onm->entries[onm->lasthit + 1];
 		
 		if (entry->old == addr) {
+			onm->lasthit++;
+			onm->stats.lookups_lasthit++;
 			if (increase_users)
 				entry->nr++;
 			return entry->newp;
 		}
 	}
 	
-	i = oldnewmap_lookup_entry_full(onm, addr, onm->lasthit);
+	i = oldnewmap_lookup_entry(onm, addr);
 	if (i != -1) {
 		OldNew *entry = &onm->entries[i];
-		BLI_assert(entry->old == addr);
 		onm->lasthit = i;
 		if (increase_users)
 			entry->nr++;
 		return entry->newp;
 	}
 	
+	onm->stats.lookups_miss++;
 	return NULL;
 }
 
 /* for libdata, nr has ID code, no increment */
 static void *oldnewmap_liblookup(OldNewMap *onm, const void *addr, const void *lib)
 {
+	int i;
+
 	if (addr == NULL) {
 		return NULL;
 	}
 
-	/* lasthit works fine for non-libdata, linking there is done in same sequence as writing */
-	if (onm->sorted) {
-		const OldNew entry_s = {.old = addr};
-		OldNew *entry = bsearch(&entry_s, onm->entries, onm->nentries, sizeof(OldNew), verg_oldnewmap);
-		if (entry) {
-			ID *id = entry->newp;
+	onm->stats.lookups++;
 
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
-		}
-	}
-	else {
-		/* note, this can be a bottle neck when loading some files */
-		const int i = oldnewmap_lookup_entry_full(onm, addr, -1);
-		if (i != -1) {
-			OldNew *entry = &onm->entries[i];
-			ID *id = entry->newp;
-			BLI_assert(entry->old == addr);
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
+	i = oldnewmap_lookup_entry(onm, addr);
+	if (i != -1) {
+		ID *id = onm->entries[i].newp;
+		if (id && (!lib || id->lib)) {
+			return id;
 		}
 	}
 
+	onm->stats.lookups_miss++;
 	return NULL;
 }
 
@@ -470,14 +523,37 @@ static void oldnewmap_clear(OldNewMap *onm)
 {
 	onm->nentries = 0;
 	onm->lasthit = 0;
+
+	/* The datamap is cleared for every ID, don't keep clearing a huge hash after reading a big one. */
+	if (onm->entriessize > OLDNEWMAP_SIZE_DEFAULT) {
+		onm->entriessize = OLDNEWMAP_SIZE_DEFAULT;
+		onm->entries = MEM_reallocN(onm->entries, sizeof(*onm->entries) * onm->entriessize);
+		oldnewmap_map_rebuild(onm);
+	}
+	else {
+		memset(onm->map, 0xff, sizeof(*onm->map) * (onm->map_mask + 1));
+	}
 }
 
 static void oldnewmap_free(OldNewMap *onm) 
 {
 	MEM_freeN(onm->entries);
+	MEM_freeN(onm->map);
 	MEM_freeN(onm);
 }
 
+static void oldnewmap_print_stats(const OldNewMap *onm, const char *name)
+{
+	const OldNewMapStats *stats = &onm->stats;
+	const unsigned int lookups_hashed = stats->lookups - stats->lookups_lasthit;
+
+	printf("  %-9s %10u lookups, %5.1f%% lasthit, %5.1f%% miss, %.2f probes per hashed lookup\n",
+	       name, stats->lookups,
+	       stats->lookups ? 100.0 * stats->lookups_lasthit / stats->lookups : 0.0,
+	       stats->lookups ? 100.0 * stats->lookups_miss / stats->lookups : 0.0,
+	       lookups_hashed ? (double)stats->probes / lookups_hashed : 0.0);
+}
+
 /***/
 
 static void read_libraries(FileData *basefd, ListBase *mainlist);
@@ -833,11 +909,98 @@ static BHeadN *get_bhead(FileData *fd)
 	return(new_bhead);
 }
 
+#ifdef USE_BHEAD_MMAP
+
+/**
+ * Get the block at \a offset of the mapping, the block data directly follows it like in #BHeadN.
+ * Returns NULL past the end of the file or for truncated blocks, like #get_bhead.
+ */
+static BHead *mmap_bhead_at(FileData *fd, size_t offset)
+{
+	BHead *bhead;
+
+	if (offset + sizeof(BHead) > fd->mmap_size) {
+		return NULL;
+	}
+
+	bhead = (BHead *)(fd->mmap_data + offset);
+
+	/* make sure people are not trying to pass bad blend files */
+	if (bhead->len < 0 || (offset + sizeof(BHead) + (size_t)bhead->len > fd->mmap_size)) {
+		return NULL;
+	}
+
+	return bhead;
+}
+
+static BHead *mmap_bhead_add(FileData *fd, BHead *bhead)
+{
+	if (bhead) {
+		if (fd->mmap_bheads_len == fd->mmap_bheads_alloc) {
+			fd->mmap_bheads_alloc = max_ii(1024, fd->mmap_bheads_alloc * 2);
+			fd->mmap_bheads = MEM_reallocN(fd->mmap_bheads, sizeof(*fd->mmap_bheads) * fd->mmap_bheads_alloc);
+		}
+		fd->mmap_bheads[fd->mmap_bheads_len++] = bhead;
+	}
+	return bhead;
+}
+
+static BHead *mmap_firstbhead(FileData *fd)
+{
+	if (fd->mmap_bheads_len != 0) {
+		return fd->mmap_bheads[0];
+	}
+	return mmap_bhead_add(fd, mmap_bhead_at(fd, SIZEOFBLENDERHEADER));
+}
+
+static BHead *mmap_nextbhead(FileData *fd, BHead *thisblock)
+{
+	const size_t offset = (size_t)((char *)(thisblock + 1) - fd->mmap_data) + (size_t)thisblock->len;
+	BHead *bhead = mmap_bhead_at(fd, offset);
+
+	/* Blocks are always visited in file order the first time. */
+	if (bhead && (fd->mmap_bheads[fd->mmap_bheads_len - 1] == thisblock)) {
+		mmap_bhead_add(fd, bhead);
+	}
+
+	return bhead;
+}
+
+static BHead *mmap_prevbhead(FileData *fd, BHead *thisblock)
+{
+	/* binary search, blocks are stored in file order */
+	int lo = 0, hi = fd->mmap_bheads_len - 1;
+
+	while (lo <= hi) {
+		const int mid = (lo + hi) / 2;
+		if (fd->mmap_bheads[mid] < thisblock) {
+			lo = mid + 1;
+		}
+		else if (fd->mmap_bheads[mid] > thisblock) {
+			hi = mid - 1;
+		}
+		else {
+			return (mid > 0) ? fd->mmap_bheads[mid - 1] : NULL;
+		}
+	}
+
+	BLI_assert(!"block not found");
+	return NULL;
+}
+
+#endif  /* USE_BHEAD_MMAP */
+
 BHead *blo_firstbhead(FileData *fd)
 {
 	BHeadN *new_bhead;
 	BHead *bhead = NULL;
 	
+#ifdef USE_BHEAD_MMAP
+	if (fd->flags & FD_FLAGS_MMAP_BHEAD) {
+		return mmap_firstbhead(fd);
+	}
+#endif
+
 	/* Rewind the file
 	 * Read in a new block if necessary
 	 */
@@ -853,10 +1016,20 @@ BHead *blo_firstbhead(FileData *fd)
 	return(bhead);
 }
 
-BHead *blo_prevbhead(FileData *UNUSED(fd), BHead *thisblock)
+BHead *blo_prevbhead(FileData *fd, BHead *thisblock)
 {
-	BHeadN *bheadn = (BHeadN *)POINTER_OFFSET(thisblock, -offsetof(BHeadN, bhead));
-	BHeadN *prev = bheadn->prev;
+	BHeadN *bheadn, *prev;
+
+#ifdef USE_BHEAD_MMAP
+	if (fd->flags & FD_FLAGS_MMAP_BHEAD) {
+		return mmap_prevbhead(fd, thisblock);
+	}
+#else
+	UNUSED_VARS(fd);
+#endif
+
+	bheadn = (BHeadN *)POINTER_OFFSET(thisblock, -offsetof(BHeadN, bhead));
+	prev = bheadn->prev;
 	
 	return (prev) ? &prev->bhead : NULL;
 }
@@ -866,6 +1039,12 @@ BHead *blo_nextbhead(FileData *fd, BHead *thisblock)
 	BHeadN *new_bhead = NULL;
 	BHead *bhead = NULL;
 	
+#ifdef USE_BHEAD_MMAP
+	if (fd->flags & FD_FLAGS_MMAP_BHEAD) {
+		return (thisblock) ? mmap_nextbhead(fd, thisblock) : NULL;
+	}
+#endif
+
 	if (thisblock) {
 		/* bhead is actually a sub part of BHeadN
 		 * We calculate the BHeadN pointer from the BHead pointer below */
@@ -1014,6 +1193,19 @@ static int fd_read_from_file(FileData *filedata, void *buffer, unsigned int size
 	return readsize;
 }
 
+#ifdef USE_BHEAD_MMAP
+static int fd_read_from_mmap(FileData *filedata, void *buffer, unsigned int size)
+{
+	/* don't read more bytes then there are available in the mapping */
+	const size_t readsize = MIN2(size, filedata->mmap_size - filedata->mmap_seek);
+
+	memcpy(buffer, filedata->mmap_data + filedata->mmap_seek, readsize);
+	filedata->mmap_seek += readsize;
+
+	return (int)readsize;
+}
+#endif
+
 static int fd_read_gzip_from_file(FileData *filedata, void *buffer, unsigned int size)
 {
 	int readsize = gzread(filedata->gzfiledes, buffer, size);
@@ -1118,6 +1310,13 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
 {
 	decode_blender_header(fd);
 	
+#ifdef USE_BHEAD_MMAP
+	/* Blocks can be used in place when they don't need any conversion. */
+	if (fd->mmap_data && !(fd->flags & (FD_FLAGS_SWITCH_ENDIAN | FD_FLAGS_POINTSIZE_DIFFERS))) {
+		fd->flags |= FD_FLAGS_MMAP_BHEAD;
+	}
+#endif
+
 	if (fd->flags & FD_FLAGS_FILE_OK) {
 		const char *error_message = NULL;
 		if (read_file_dna(fd, &error_message) == false) {
@@ -1137,11 +1336,270 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
 	return fd;
 }
 
+#ifdef USE_BHEAD_MMAP
+/**
+ * Map uncompressed files in memory, blocks are then only paged in (and converted) when they are read.
+ * The mapping is private so blocks can still be patched in place.
+ *
+ * \return NULL for compressed files or when the file can't be mapped (caller falls back to reading it).
+ */
+static FileData *blo_openblenderfile_mmap(const char *filepath)
+{
+	const int file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	size_t size;
+	char *mem;
+
+	if (file == -1) {
+		return NULL;
+	}
+
+	size = BLI_file_descriptor_size(file);
+	if ((size == (size_t)-1) || (size < SIZEOFBLENDERHEADER)) {
+		close(file);
+		return NULL;
+	}
+
+	mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	if (mem == (char *)MAP_FAILED) {
+		close(file);
+		return NULL;
+	}
+
+	/* test if gzip or lzo */
+	if ((mem[0] == 0x1f && mem[1] == (char)0x8b) || STREQLEN(mem, BLEND_LZO_MAGIC, BLEND_LZO_MAGIC_LEN)) {
+		munmap(mem, size);
+		close(file);
+		return NULL;
+	}
+	else {
+		FileData *fd = filedata_new();
+		fd->filedes = file;
+		fd->mmap_data = mem;
+		fd->mmap_size = size;
+		fd->read = fd_read_from_mmap;
+		return fd;
+	}
+}
+#endif  /* USE_BHEAD_MMAP */
+
+#ifdef WITH_LZO
+typedef struct LZOReadChunk {
+	const unsigned char *in;
+	unsigned char *out;
+	unsigned int in_len, out_len;
+} LZOReadChunk;
+
+typedef struct LZOReadData {
+	LZOReadChunk *chunks;
+	bool error;
+} LZOReadData;
+
+static void blo_lzo_decompress_cb(void *userdata, const int i)
+{
+	LZOReadData *data = userdata;
+	const LZOReadChunk *chunk = &data->chunks[i];
+
+	if (chunk->in_len == chunk->out_len) {
+		/* stored as-is */
+		memcpy(chunk->out, chunk->in, chunk->in_len);
+	}
+	else {
+		lzo_uint out_len = chunk->out_len;
+		if ((lzo1x_decompress_safe(chunk->in, chunk->in_len, chunk->out, &out_len, NULL) != LZO_E_OK) ||
+		    (out_len != chunk->out_len))
+		{
+			data->error = true;
+		}
+	}
+}
+
+static bool blo_lzo_read_all(const int file, void *buffer, size_t len)
+{
+	char *p = buffer;
+	while (len) {
+		/* chunks are small, the length always fits an int */
+		const int readsize = read(file, p, (unsigned int)len);
+		if (readsize <= 0) {
+			return false;
+		}
+		p += readsize;
+		len -= (size_t)readsize;
+	}
+	return true;
+}
+
+/**
+ * Read the chunks of an LZO compressed file (see #BLEND_LZO_MAGIC), and decompress them in parallel.
+ *
+ * \param chunks_max: Stop after this many chunks (when only the start of the file is needed), -1 for all.
+ * \return the decompressed file, NULL when it's truncated or corrupt.
+ */
+static char *blo_lzo_read_file(const int file, const int chunks_max, size_t *r_size)
+{
+	const size_t file_size = BLI_file_descriptor_size(file);
+	LZOReadData data = {NULL, false};
+	unsigned char *in, *in_end, *out = NULL;
+	int chunks_len = 0, chunks_alloc = 64;
+	size_t out_size = 0;
+
+	if ((file_size == (size_t)-1) || (file_size < BLEND_LZO_MAGIC_LEN) || (lzo_init() != LZO_E_OK)) {
+		return NULL;
+	}
+
+	/* all compressed chunks, following the magic */
+	in = MEM_mallocN(file_size - BLEND_LZO_MAGIC_LEN, __func__);
+	in_end = in;
+	data.chunks = MEM_mallocN(sizeof(*data.chunks) * chunks_alloc, __func__);
+
+	while (chunks_len != chunks_max) {
+		unsigned int header[2];
+		LZOReadChunk *chunk;
+
+		if (!blo_lzo_read_all(file, header, sizeof(header))) {
+			data.error = true;
+			break;
+		}
+#ifdef __BIG_ENDIAN__
+		BLI_endian_switch_uint32_array(header, 2);
+#endif
+		if (header[0] == 0) {
+			break;
+		}
+		if ((header[1] > header[0]) || (header[0] > BLEND_LZO_CHUNK_SIZE) ||
+		    ((size_t)(in_end - in) + header[1] > file_size - BLEND_LZO_MAGIC_LEN) ||
+		    !blo_lzo_read_all(file, in_end, header[1]))
+		{
+			data.error = true;
+			break;
+		}
+
+		if (chunks_len == chunks_alloc) {
+			chunks_alloc *= 2;
+			data.chunks = MEM_reallocN(data.chunks, sizeof(*data.chunks) * chunks_alloc);
+		}
+		chunk = &data.chunks[chunks_len++];
+		chunk->in = in_end;
+		chunk->in_len = header[1];
+		chunk->out_len = header[0];
+		in_end += header[1];
+		out_size += header[0];
+	}
+
+	if (!data.error && out_size != 0) {
+		int i;
+
+		out = MEM_mallocN(out_size, __func__);
+		for (i = 0, out_size = 0; i < chunks_len; i++) {
+			data.chunks[i].out = (unsigned char *)out + out_size;
+			out_size += data.chunks[i].out_len;
+		}
+
+		BLI_task_parallel_range(0, chunks_len, &data, blo_lzo_decompress_cb, (chunks_len > 1) && BLI_thread_is_main());
+
+		if (data.error) {
+			MEM_freeN(out);
+			out = NULL;
+		}
+	}
+
+	MEM_freeN(data.chunks);
+	MEM_freeN(in);
+
+	*r_size = out_size;
+	return (char *)out;
+}
+#endif  /* WITH_LZO */
+
+/**
+ * Open files written with #G_FILE_COMPRESS_FAST, the whole file is decompressed in memory.
+ *
+ * \param r_is_lzo: Set when the file is LZO compressed, when NULL is returned it's then unreadable.
+ */
+static FileData *blo_openblenderfile_lzo(const char *filepath, const int chunks_max, bool *r_is_lzo)
+{
+	const int file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	char magic[BLEND_LZO_MAGIC_LEN];
+	FileData *fd = NULL;
+
+	*r_is_lzo = false;
+
+	if (file == -1) {
+		return NULL;
+	}
+
+	if ((read(file, magic, sizeof(magic)) == sizeof(magic)) && STREQLEN(magic, BLEND_LZO_MAGIC, sizeof(magic))) {
+		*r_is_lzo = true;
+#ifdef WITH_LZO
+		{
+			size_t size;
+			char *mem = blo_lzo_read_file(file, chunks_max, &size);
+
+			if (mem) {
+				fd = filedata_new();
+#ifdef USE_BHEAD_MMAP
+				/* blocks can be used in place, as for mapped files */
+				fd->mmap_data = mem;
+				fd->mmap_size = size;
+				fd->read = fd_read_from_mmap;
+				fd->flags |= FD_FLAGS_MMAP_IS_BUFFER;
+#else
+				if (size <= INT_MAX) {
+					fd->buffer = mem;
+					fd->buffersize = (int)size;
+					fd->read = fd_read_from_memory;
+				}
+				else {
+					MEM_freeN(mem);
+					blo_freefiledata(fd);
+					fd = NULL;
+				}
+#endif
+			}
+		}
+#else
+		UNUSED_VARS(chunks_max);
+#endif
+	}
+
+	close(file);
+
+	return fd;
+}
+
 /* cannot be called with relative paths anymore! */
 /* on each new library added, it now checks for the current FileData and expands relativeness */
 FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
 {
 	gzFile gzfile;
+
+	{
+		bool is_lzo;
+		FileData *fd = blo_openblenderfile_lzo(filepath, -1, &is_lzo);
+		if (fd) {
+			/* needed for library_append and read_libraries */
+			BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+			return blo_decode_and_check(fd, reports);
+		}
+		else if (is_lzo) {
+			BKE_reportf(reports, RPT_ERROR,
+			            "Failed to read blend file '%s', compressed data is corrupt or unsupported", filepath);
+			return NULL;
+		}
+	}
+
+#ifdef USE_BHEAD_MMAP
+	{
+		FileData *fd = blo_openblenderfile_mmap(filepath);
+		if (fd) {
+			/* needed for library_append and read_libraries */
+			BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+			return blo_decode_and_check(fd, reports);
+		}
+	}
+#endif
+
 	errno = 0;
 	gzfile = BLI_gzopen(filepath, "rb");
 	
@@ -1169,11 +1627,29 @@ FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
 static FileData *blo_openblenderfile_minimal(const char *filepath)
 {
 	gzFile gzfile;
+	bool is_lzo;
+	FileData *fd;
+
+	/* the header and thumbnail are at the start of the first chunk */
+	fd = blo_openblenderfile_lzo(filepath, 1, &is_lzo);
+	if (is_lzo) {
+		if (fd) {
+			decode_blender_header(fd);
+
+			if (fd->flags & FD_FLAGS_FILE_OK) {
+				return fd;
+			}
+
+			blo_freefiledata(fd);
+		}
+		return NULL;
+	}
+
 	errno = 0;
 	gzfile = BLI_gzopen(filepath, "rb");
 
 	if (gzfile != (gzFile)Z_NULL) {
-		FileData *fd = filedata_new();
+		fd = filedata_new();
 		fd->gzfiledes = gzfile;
 		fd->read = fd_read_gzip_from_file;
 
@@ -1301,6 +1777,21 @@ void blo_freefiledata(FileData *fd)
 		// Free all BHeadN data blocks
 		BLI_freelistN(&fd->listbase);
 
+#ifdef USE_BHEAD_MMAP
+		if (fd->mmap_data) {
+			if (fd->flags & FD_FLAGS_MMAP_IS_BUFFER) {
+				MEM_freeN(fd->mmap_data);
+			}
+			else {
+				munmap(fd->mmap_data, fd->mmap_size);
+			}
+		}
+		MEM_SAFE_FREE(fd->mmap_bheads);
+#endif
+
+		/* Freed by blo_read_file_internal once all IDs are read. */
+		BLI_assert(fd->decoded_bheads == NULL);
+
 		if (fd->filesdna)
 			DNA_sdna_free(fd->filesdna);
 		if (fd->compflags)
@@ -1556,9 +2047,7 @@ static void change_idid_adr_fd(FileData *fd, const void *old, void *new)
 {
 	int i;
 	
-	/* use a binary search if we have a sorted libmap, for now it's not needed. */
-	BLI_assert(fd->libmap->sorted == false);
-
+	/* search by new address, the hash can't be used */
 	for (i = 0; i < fd->libmap->nentries; i++) {
 		OldNew *entry = &fd->libmap->entries[i];
 		
@@ -8389,22 +8878,193 @@ static const char *dataname(short id_code)
 	
 }
 
+/* ************ PARALLEL DECODING ***************** */
+
+/* Number of DATA blocks from which decoding them in advance uses multiple threads. */
+#define READ_PREDECODE_THREADED_MIN 256
+/* Size of the DATA blocks decoded at once, bounds the memory of decoded blocks not read yet. */
+#define READ_PREDECODE_BATCH_SIZE (32 * 1024 * 1024)
+
+typedef struct BHeadDecoded {
+	BHead *bhead;
+	const char *allocname;
+	void *data;
+	bool is_decoded;
+} BHeadDecoded;
+
+static void read_data_predecode_cb(void *userdata, const int i)
+{
+	FileData *fd = userdata;
+	BHeadDecoded *decoded = &fd->decoded_bheads[i];
+
+	/* read_struct only uses the DNA of fd, and only changes the block itself (endian switch) */
+	decoded->data = read_struct(fd, decoded->bhead, decoded->allocname);
+	decoded->is_decoded = true;
+}
+
+/**
+ * Collect the DATA blocks of IDs to decode (DNA reconstruct and endian switch) in parallel,
+ * #read_data_into_oldnewmap then only has to pick the results while reading IDs in file order.
+ * Blocks are decoded in batches as reading reaches them, see #read_data_predecode_batch.
+ *
+ * Linking the data (direct_link_*) stays serial, it adds IDs to Main and uses the per ID datamap.
+ *
+ * \return the number of blocks to decode.
+ */
+static int read_data_predecode(FileData *fd)
+{
+	BHead *bhead;
+	int owner_code = 0;
+	int len = 0;
+
+	BLI_assert(fd->decoded_bheads == NULL);
+
+	for (bhead = blo_firstbhead(fd); bhead; bhead = blo_nextbhead(fd, bhead)) {
+		if (bhead->code == DATA) {
+			len++;
+		}
+		else if (bhead->code == ENDB) {
+			break;
+		}
+	}
+
+	if (len == 0) {
+		return 0;
+	}
+
+	fd->decoded_bheads = MEM_mallocN(sizeof(*fd->decoded_bheads) * len, __func__);
+	fd->decoded_bheads_len = 0;
+	fd->decoded_bheads_cursor = 0;
+	fd->decoded_bheads_end = 0;
+
+	for (bhead = blo_firstbhead(fd); bhead; bhead = blo_nextbhead(fd, bhead)) {
+		if (bhead->code == DATA) {
+			const char *allocname = NULL;
+
+			/* Only blocks which read_libblock or read_userdef will read. */
+			if (owner_code == USER) {
+				if ((fd->skip_flags & BLO_READ_SKIP_USERDEF) == 0) {
+					allocname = "user def";
+				}
+			}
+			else if (owner_code == ID_SCRN || (owner_code != ID_ID && BKE_idcode_is_valid((short)owner_code))) {
+				allocname = dataname((short)owner_code);
+			}
+
+			if (allocname) {
+				BHeadDecoded *decoded = &fd->decoded_bheads[fd->decoded_bheads_len++];
+				decoded->bhead = bhead;
+				decoded->allocname = allocname;
+				decoded->data = NULL;
+				decoded->is_decoded = false;
+			}
+		}
+		else if (bhead->code == ENDB) {
+			break;
+		}
+		else {
+			owner_code = bhead->code;
+		}
+	}
+
+	return fd->decoded_bheads_len;
+}
+
+/**
+ * Decode the blocks from \a start on, up to #READ_PREDECODE_BATCH_SIZE bytes of them.
+ */
+static void read_data_predecode_batch(FileData *fd, const int start)
+{
+	size_t size = 0;
+	int end = start;
+
+	while (end < fd->decoded_bheads_len && (end == start || size < READ_PREDECODE_BATCH_SIZE)) {
+		size += (size_t)fd->decoded_bheads[end].bhead->len;
+		end++;
+	}
+
+	BLI_task_parallel_range(
+	        start, end, fd, read_data_predecode_cb,
+	        BLI_thread_is_main() && (end - start > READ_PREDECODE_THREADED_MIN));
+
+	fd->decoded_bheads_end = end;
+}
+
+/**
+ * Get the data decoded by #read_data_predecode for \a bhead.
+ *
+ * Decodes the next batch of blocks when reading reaches a block which isn't decoded yet.
+ *
+ * \return false when the block wasn't decoded in advance.
+ */
+static bool read_data_predecoded_pop(FileData *fd, BHead *bhead, void **r_data)
+{
+	const int len = fd->decoded_bheads_len;
+
+	/* Blocks are read in file order, so this is almost always the block at the cursor. */
+	for (int n = 0; n < len; n++) {
+		const int i = (fd->decoded_bheads_cursor + n) % len;
+		BHeadDecoded *decoded = &fd->decoded_bheads[i];
+
+		if (decoded->bhead == bhead) {
+			if (i >= fd->decoded_bheads_end) {
+				read_data_predecode_batch(fd, i);
+			}
+			else if (!decoded->is_decoded) {
+				/* Skipped by a batch starting after it, read out of order. */
+				return false;
+			}
+			*r_data = decoded->data;
+			decoded->bhead = NULL;
+			decoded->data = NULL;
+			fd->decoded_bheads_cursor = (i + 1) % len;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Free the decoded blocks which were not read (e.g. data of libraries kept on undo).
+ */
+static void read_data_predecode_free(FileData *fd)
+{
+	if (fd->decoded_bheads) {
+		for (int i = 0; i < fd->decoded_bheads_len; i++) {
+			if (fd->decoded_bheads[i].data) {
+				MEM_freeN(fd->decoded_bheads[i].data);
+			}
+		}
+		MEM_freeN(fd->decoded_bheads);
+		fd->decoded_bheads = NULL;
+		fd->decoded_bheads_len = 0;
+		fd->decoded_bheads_end = 0;
+	}
+}
+
 static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *allocname)
 {
 	bhead = blo_nextbhead(fd, bhead);
 	
 	while (bhead && bhead->code==DATA) {
 		void *data;
+
+		if (fd->decoded_bheads && read_data_predecoded_pop(fd, bhead, &data)) {
+			/* already decoded by read_data_predecode */
+		}
+		else {
 #if 0
-		/* XXX DUMB DEBUGGING OPTION TO GIVE NAMES for guarded malloc errors */
-		short *sp = fd->filesdna->structs[bhead->SDNAnr];
-		char *tmp = malloc(100);
-		allocname = fd->filesdna->types[ sp[0] ];
-		strcpy(tmp, allocname);
-		data = read_struct(fd, bhead, tmp);
+			/* XXX DUMB DEBUGGING OPTION TO GIVE NAMES for guarded malloc errors */
+			short *sp = fd->filesdna->structs[bhead->SDNAnr];
+			char *tmp = malloc(100);
+			allocname = fd->filesdna->types[ sp[0] ];
+			strcpy(tmp, allocname);
+			data = read_struct(fd, bhead, tmp);
 #else
-		data = read_struct(fd, bhead, allocname);
+			data = read_struct(fd, bhead, allocname);
 #endif
+		}
 		
 		if (data) {
 			oldnewmap_insert(fd->datamap, bhead->old, data, 0);
@@ -8787,8 +9447,6 @@ static void do_versions_after_linking(Main *main)
 
 static void lib_link_all(FileData *fd, Main *main)
 {
-	oldnewmap_sort(fd);
-	
 	lib_link_id(fd, main);
 
 	/* No load UI for undo memfiles */
@@ -8914,6 +9572,13 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 	BHead *bhead = blo_firstbhead(fd);
 	BlendFileData *bfd;
 	ListBase mainlist = {NULL, NULL};
+	double time_start = 0.0, time_decode = 0.0, time_read = 0.0, time_versions = 0.0;
+	double time_libraries = 0.0, time_lib_link = 0.0;
+	int decoded_len = 0;
+
+	if (G.debug & G_DEBUG_FILELOAD) {
+		time_start = PIL_check_seconds_timer();
+	}
 	
 	bfd = MEM_callocN(sizeof(BlendFileData), "blendfiledata");
 	bfd->main = BKE_main_new();
@@ -8943,6 +9608,14 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 		}
 	}
 
+	if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
+		decoded_len = read_data_predecode(fd);
+	}
+
+	if (G.debug & G_DEBUG_FILELOAD) {
+		time_decode = PIL_check_seconds_timer();
+	}
+
 	while (bhead) {
 		switch (bhead->code) {
 		case DATA:
@@ -8990,6 +9663,12 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 			}
 		}
 	}
+
+	read_data_predecode_free(fd);
+
+	if (G.debug & G_DEBUG_FILELOAD) {
+		time_read = PIL_check_seconds_timer();
+	}
 	
 	/* do before read_libraries, but skip undo case */
 	if (fd->memfile == NULL) {
@@ -8997,12 +9676,24 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 		do_versions_userdef(fd, bfd);
 	}
 	
+	if (G.debug & G_DEBUG_FILELOAD) {
+		time_versions = PIL_check_seconds_timer();
+	}
+
 	read_libraries(fd, &mainlist);
 	
 	blo_join_main(&mainlist);
 	
+	if (G.debug & G_DEBUG_FILELOAD) {
+		time_libraries = PIL_check_seconds_timer();
+	}
+
 	lib_link_all(fd, bfd->main);
 
+	if (G.debug & G_DEBUG_FILELOAD) {
+		time_lib_link = PIL_check_seconds_timer();
+	}
+
 	/* Skip in undo case. */
 	if (fd->memfile == NULL) {
 		/* Yep, second splitting... but this is a very cheap operation, so no big deal. */
@@ -9029,6 +9720,22 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 	
 	fd->mainlist = NULL;  /* Safety, this is local variable, shall not be used afterward. */
 
+	if (G.debug & G_DEBUG_FILELOAD) {
+		const double time_end = PIL_check_seconds_timer();
+		printf("Read blend: \"%s\"%s\n", filepath, fd->memfile ? " (undo)" : "");
+		printf("  scan data:        %8.3fs (%d blocks)\n", time_decode - time_start, decoded_len);
+		printf("  read IDs:         %8.3fs (decoding data in batches)\n", time_read - time_decode);
+		printf("  versioning:       %8.3fs\n", time_versions - time_read);
+		printf("  read libraries:   %8.3fs\n", time_libraries - time_versions);
+		printf("  lib link:         %8.3fs\n", time_lib_link - time_libraries);
+		printf("  after linking:    %8.3fs\n", time_end - time_lib_link);
+		printf("  total:            %8.3fs\n", time_end - time_start);
+		printf("Pointer remapping:\n");
+		oldnewmap_print_stats(fd->datamap, "data");
+		oldnewmap_print_stats(fd->globmap, "global");
+		oldnewmap_print_stats(fd->libmap, "library");
+	}
+
 	return bfd;
 }
 
@@ -64,6 +64,18 @@ typedef struct FileData {
 	int filedes;
 	gzFile gzfiledes;
 
+	// variables needed for reading from a memory mapped file (or a decompressed one, see FD_FLAGS_MMAP_IS_BUFFER)
+	char *mmap_data;
+	size_t mmap_size, mmap_seek;
+	// blocks handed out so far in file order, to find previous blocks (only with FD_FLAGS_MMAP_BHEAD)
+	struct BHead **mmap_bheads;
+	int mmap_bheads_len, mmap_bheads_alloc;
+
+	// DATA blocks decoded in advance by multiple threads, in file order (see read_data_predecode),
+	// the ones before decoded_bheads_end were decoded already
+	struct BHeadDecoded *decoded_bheads;
+	int decoded_bheads_len, decoded_bheads_cursor, decoded_bheads_end;
+
 	// now only in use for library appending
 	char relabase[FILE_MAX];
 	
@@ -122,10 +134,20 @@ enum {
 	FD_FLAGS_FILE_OK               = 1 << 3,
 	FD_FLAGS_NOT_MY_BUFFER         = 1 << 4,
 	FD_FLAGS_NOT_MY_LIBMAP         = 1 << 5,  /* XXX Unused in practice (checked once but never set). */
+	FD_FLAGS_MMAP_BHEAD            = 1 << 6,  /* BHeads and their data are used in place from mmap_data */
+	FD_FLAGS_MMAP_IS_BUFFER        = 1 << 7,  /* mmap_data is a decompressed file in memory, not a mapping */
 };
 
 #define SIZEOFBLENDERHEADER 12
 
+/* Files written with G_FILE_COMPRESS_FAST start with this magic, followed by chunks of
+ * (uncompressed size, compressed size) as little endian uint32 and the LZO1X compressed data,
+ * stored as-is when it doesn't compress. A zero sized chunk ends the file.
+ * Chunks are compressed independently, so they can be decompressed in parallel. */
+#define BLEND_LZO_MAGIC "BLENDLZO"
+#define BLEND_LZO_MAGIC_LEN 8
+#define BLEND_LZO_CHUNK_SIZE (1 << 20)
+
 /***/
 struct Main;
 void blo_join_main(ListBase *mainlist);
@@ -40,19 +40,131 @@
 #include "DNA_listBase.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
+#include "BLI_threads.h"
 
 #include "BLO_undofile.h"
 
 /* **************** support for memory-write, for undo buffers *************** */
 
+/* -------------------------------------------------------------------- */
+/** \name Chunk Store
+ *
+ * Chunk buffers are de-duplicated by content, over all memfiles.
+ * Identical chunks share one reference counted buffer wherever they are in the file,
+ * so inserting data only costs the changed chunks instead of everything after it.
+ *
+ * Only used from the main thread (undo pushes, and the snapshot of asynchronous saves).
+ * \{ */
+
+/* Allocated together with the chunk data, which follows it. */
+typedef struct MemFileChunkBuf {
+	const char *buf;
+	unsigned int size, hash;
+	unsigned int users;
+} MemFileChunkBuf;
+
+#define CHUNK_BUF_FROM_DATA(_buf) (((MemFileChunkBuf *)(_buf)) - 1)
+
+static struct {
+	GSet *chunks;
+	MemFileStats stats;
+} memfile_store = {NULL};
+
+static unsigned int memfile_chunk_buf_hash(const void *key)
+{
+	return ((const MemFileChunkBuf *)key)->hash;
+}
+
+static bool memfile_chunk_buf_cmp(const void *a, const void *b)
+{
+	const MemFileChunkBuf *cb_a = a, *cb_b = b;
+	return ((cb_a->hash != cb_b->hash) ||
+	        (cb_a->size != cb_b->size) ||
+	        (memcmp(cb_a->buf, cb_b->buf, cb_a->size) != 0));
+}
+
+/**
+ * \return the stored buffer for \a buf, which is copied when no identical chunk was stored yet.
+ */
+static char *memfile_store_ref(const char *buf, unsigned int size, bool *r_is_new)
+{
+	MemFileChunkBuf key = {buf, size, BLI_hash_mm2((const unsigned char *)buf, size, 0), 0};
+	MemFileChunkBuf *cb;
+	void **key_p;
+
+	BLI_assert(BLI_thread_is_main());
+
+	if (memfile_store.chunks == NULL) {
+		memfile_store.chunks = BLI_gset_new(memfile_chunk_buf_hash, memfile_chunk_buf_cmp, __func__);
+	}
+
+	*r_is_new = !BLI_gset_ensure_p_ex(memfile_store.chunks, &key, &key_p);
+	if (*r_is_new) {
+		cb = MEM_mallocN(sizeof(*cb) + size, "Chunk buffer");
+		memcpy(cb + 1, buf, size);
+		cb->buf = (const char *)(cb + 1);
+		cb->size = size;
+		cb->hash = key.hash;
+		cb->users = 0;
+		*key_p = cb;
+
+		memfile_store.stats.size_stored += size;
+		memfile_store.stats.chunks_stored++;
+	}
+	else {
+		cb = *key_p;
+	}
+
+	cb->users++;
+	memfile_store.stats.size_logical += size;
+	memfile_store.stats.chunks_logical++;
+
+	return (char *)cb->buf;
+}
+
+static void memfile_store_unref(char *buf)
+{
+	MemFileChunkBuf *cb = CHUNK_BUF_FROM_DATA(buf);
+
+	BLI_assert(BLI_thread_is_main());
+
+	memfile_store.stats.size_logical -= cb->size;
+	memfile_store.stats.chunks_logical--;
+
+	if (--cb->users == 0) {
+		memfile_store.stats.size_stored -= cb->size;
+		memfile_store.stats.chunks_stored--;
+
+		BLI_gset_remove(memfile_store.chunks, cb, NULL);
+		MEM_freeN(cb);
+
+		/* Don't keep the set around (reported as leak on exit). */
+		if (BLI_gset_size(memfile_store.chunks) == 0) {
+			BLI_gset_free(memfile_store.chunks, NULL);
+			memfile_store.chunks = NULL;
+		}
+	}
+}
+
+/**
+ * Memory used by the chunks of all memfiles, see #MemFileStats.
+ */
+void BLO_memfile_stats(MemFileStats *r_stats)
+{
+	*r_stats = memfile_store.stats;
+}
+
+/** \} */
+
 /* not memfile itself */
 void BLO_memfile_free(MemFile *memfile)
 {
 	MemFileChunk *chunk;
 	
 	while ((chunk = BLI_pophead(&memfile->chunks))) {
-		if (chunk->ident == 0)
-			MEM_freeN(chunk->buf);
+		memfile_store_unref(chunk->buf);
 		MEM_freeN(chunk);
 	}
 	memfile->size = 0;
@@ -62,21 +174,9 @@ void BLO_memfile_free(MemFile *memfile)
 /* result is that 'first' is being freed */
 void BLO_memfile_merge(MemFile *first, MemFile *second)
 {
-	MemFileChunk *fc, *sc;
-	
-	fc = first->chunks.first;
-	sc = second->chunks.first;
-	while (fc || sc) {
-		if (fc && sc) {
-			if (sc->ident) {
-				sc->ident = 0;
-				fc->ident = 1;
-			}
-		}
-		if (fc) fc = fc->next;
-		if (sc) sc = sc->next;
-	}
-	
+	/* Buffers are reference counted, the ones shared with 'second' are kept. */
+	UNUSED_VARS(second);
+
 	BLO_memfile_free(first);
 }
 
@@ -84,6 +184,7 @@ void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsi
 {
 	static MemFileChunk *compchunk = NULL;
 	MemFileChunk *curchunk;
+	bool is_new;
 	
 	/* this function inits when compare != NULL or when current == NULL  */
 	if (compare) {
@@ -101,10 +202,15 @@ void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsi
 	curchunk->ident = 0;
 	BLI_addtail(&current->chunks, curchunk);
 	
-	/* we compare compchunk with buf */
+	/* we compare compchunk with buf, when nothing changed this avoids hashing */
 	if (compchunk) {
 		if (compchunk->size == curchunk->size) {
 			if (memcmp(compchunk->buf, buf, size) == 0) {
+				MemFileChunkBuf *cb = CHUNK_BUF_FROM_DATA(compchunk->buf);
+				cb->users++;
+				memfile_store.stats.size_logical += size;
+				memfile_store.stats.chunks_logical++;
+
 				curchunk->buf = compchunk->buf;
 				curchunk->ident = 1;
 			}
@@ -112,11 +218,14 @@ void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsi
 		compchunk = compchunk->next;
 	}
 	
-	/* not equal... */
+	/* not equal... look for the same data anywhere else */
 	if (curchunk->buf == NULL) {
-		curchunk->buf = MEM_mallocN(size, "Chunk buffer");
-		memcpy(curchunk->buf, buf, size);
-		current->size += size;
+		curchunk->buf = memfile_store_ref(buf, size, &is_new);
+		if (is_new) {
+			current->size += size;
+		}
+		else {
+			curchunk->ident = 1;
+		}
 	}
 }
-
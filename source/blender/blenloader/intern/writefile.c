@@ -79,6 +79,14 @@
  * - write #GLOB (#FileGlobal struct) (some global vars).
  * - write #DNA1 (#SDNA struct)
  * - write #USER (#UserDef struct) if filename is ``~/.config/blender/X.XX/config/startup.blend``.
+ *
+ *
+ * COMPRESSION
+ * ===========
+ *
+ * With #G_FILE_COMPRESS the whole file is written through gzip,
+ * or with #G_FILE_COMPRESS_FAST in independent LZO compressed chunks (see #BLEND_LZO_MAGIC),
+ * which are much faster to write and can be decompressed in parallel when reading.
  */
 
 
@@ -161,6 +169,9 @@
 #include "BLI_blenlib.h"
 #include "BLI_linklist.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_endian_switch.h"
 
 #include "BKE_action.h"
 #include "BKE_blender_version.h"
@@ -200,6 +211,14 @@
 
 #include <errno.h>
 
+#ifdef WITH_LZO
+#  ifdef WITH_SYSTEM_LZO
+#    include <lzo/lzo1x.h>
+#  else
+#    include "minilzo.h"
+#  endif
+#endif
+
 /* ********* my write, buffered writing with minimum size chunks ************ */
 
 /* Use optimal allocation since blocks of this size are kept in memory for undo. */
@@ -213,6 +232,9 @@
 typedef enum {
 	WW_WRAP_NONE = 1,
 	WW_WRAP_ZLIB,
+#ifdef WITH_LZO
+	WW_WRAP_LZO,
+#endif
 } eWriteWrapType;
 
 typedef struct WriteWrap WriteWrap;
@@ -226,6 +248,8 @@ struct WriteWrap {
 	union {
 		int file_handle;
 		gzFile gz_handle;
+		struct LZOWriteWrap *lzo_handle;
+		struct BLOWriteAsync *async_handle;
 	} _user_data;
 };
 
@@ -285,6 +309,177 @@ static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 }
 #undef FILE_HANDLE
 
+#ifdef WITH_LZO
+/* lzo, chunks are collected and compressed in parallel, then written in order */
+#define FILE_HANDLE(ww) \
+	(ww)->_user_data.lzo_handle
+
+#define LZO_OUT_LEN(size) ((size) + (size) / 16 + 64 + 3)
+#define LZO_CHUNKS_PER_THREAD 2
+
+typedef struct LZOWriteChunk {
+	unsigned char *in, *out;
+	unsigned int in_len, out_len;
+	void *wrkmem;
+} LZOWriteChunk;
+
+typedef struct LZOWriteWrap {
+	int file;
+	bool error;
+
+	LZOWriteChunk *chunks;
+	/* chunks_len full chunks, then the chunk being filled */
+	int chunks_len, chunks_num;
+} LZOWriteWrap;
+
+static void ww_lzo_compress_cb(void *userdata, const int i)
+{
+	LZOWriteWrap *lzo = userdata;
+	LZOWriteChunk *chunk = &lzo->chunks[i];
+	lzo_uint out_len = LZO_OUT_LEN(chunk->in_len);
+
+	if ((lzo1x_1_compress(chunk->in, chunk->in_len, chunk->out, &out_len, chunk->wrkmem) == LZO_E_OK) &&
+	    (out_len < chunk->in_len))
+	{
+		chunk->out_len = (unsigned int)out_len;
+	}
+	else {
+		/* store as-is */
+		chunk->out_len = chunk->in_len;
+	}
+}
+
+static bool ww_lzo_write_all(LZOWriteWrap *lzo, const void *data, size_t len)
+{
+	const char *p = data;
+	while (len) {
+		/* chunks are small, the length always fits an int */
+		const int written = write(lzo->file, p, (unsigned int)len);
+		if (written <= 0) {
+			return false;
+		}
+		p += written;
+		len -= (size_t)written;
+	}
+	return true;
+}
+
+static bool ww_lzo_write_chunk_header(LZOWriteWrap *lzo, unsigned int in_len, unsigned int out_len)
+{
+	unsigned int header[2] = {in_len, out_len};
+#ifdef __BIG_ENDIAN__
+	BLI_endian_switch_uint32_array(header, 2);
+#endif
+	return ww_lzo_write_all(lzo, header, sizeof(header));
+}
+
+static void ww_lzo_flush(LZOWriteWrap *lzo, const int chunks_len)
+{
+	int i;
+
+	/* Writing may happen from a thread (background save), don't nest threaded tasks then. */
+	BLI_task_parallel_range(0, chunks_len, lzo, ww_lzo_compress_cb, (chunks_len > 1) && BLI_thread_is_main());
+
+	for (i = 0; i < chunks_len && !lzo->error; i++) {
+		LZOWriteChunk *chunk = &lzo->chunks[i];
+		const bool is_compressed = (chunk->out_len < chunk->in_len);
+
+		if (!ww_lzo_write_chunk_header(lzo, chunk->in_len, chunk->out_len) ||
+		    !ww_lzo_write_all(lzo, is_compressed ? chunk->out : chunk->in, chunk->out_len))
+		{
+			lzo->error = true;
+		}
+		chunk->in_len = 0;
+	}
+}
+
+static bool ww_open_lzo(WriteWrap *ww, const char *filepath)
+{
+	LZOWriteWrap *lzo;
+	int file, i;
+
+	if (lzo_init() != LZO_E_OK) {
+		return false;
+	}
+
+	file = BLI_open(filepath, O_BINARY + O_WRONLY + O_CREAT + O_TRUNC, 0666);
+	if (file == -1) {
+		return false;
+	}
+
+	lzo = MEM_callocN(sizeof(*lzo), __func__);
+	lzo->file = file;
+	lzo->chunks_num = BLI_system_thread_count() * LZO_CHUNKS_PER_THREAD;
+	lzo->chunks = MEM_callocN(sizeof(*lzo->chunks) * lzo->chunks_num, __func__);
+	for (i = 0; i < lzo->chunks_num; i++) {
+		LZOWriteChunk *chunk = &lzo->chunks[i];
+		chunk->in = MEM_mallocN(BLEND_LZO_CHUNK_SIZE, __func__);
+		chunk->out = MEM_mallocN(LZO_OUT_LEN(BLEND_LZO_CHUNK_SIZE), __func__);
+		chunk->wrkmem = MEM_mallocN(LZO1X_1_MEM_COMPRESS, __func__);
+	}
+
+	if (!ww_lzo_write_all(lzo, BLEND_LZO_MAGIC, BLEND_LZO_MAGIC_LEN)) {
+		lzo->error = true;
+	}
+
+	FILE_HANDLE(ww) = lzo;
+	return true;
+}
+static bool ww_close_lzo(WriteWrap *ww)
+{
+	LZOWriteWrap *lzo = FILE_HANDLE(ww);
+	bool ok;
+	int i;
+
+	if (lzo->chunks[lzo->chunks_len].in_len) {
+		lzo->chunks_len++;
+	}
+	ww_lzo_flush(lzo, lzo->chunks_len);
+
+	/* end of file */
+	if (!lzo->error && !ww_lzo_write_chunk_header(lzo, 0, 0)) {
+		lzo->error = true;
+	}
+
+	ok = (close(lzo->file) != -1) && !lzo->error;
+
+	for (i = 0; i < lzo->chunks_num; i++) {
+		LZOWriteChunk *chunk = &lzo->chunks[i];
+		MEM_freeN(chunk->in);
+		MEM_freeN(chunk->out);
+		MEM_freeN(chunk->wrkmem);
+	}
+	MEM_freeN(lzo->chunks);
+	MEM_freeN(lzo);
+
+	return ok;
+}
+static size_t ww_write_lzo(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+	LZOWriteWrap *lzo = FILE_HANDLE(ww);
+	size_t written = 0;
+
+	while (written < buf_len) {
+		LZOWriteChunk *chunk = &lzo->chunks[lzo->chunks_len];
+		const unsigned int len = (unsigned int)MIN2(buf_len - written, BLEND_LZO_CHUNK_SIZE - chunk->in_len);
+
+		memcpy(chunk->in + chunk->in_len, buf + written, len);
+		chunk->in_len += len;
+		written += len;
+
+		if (chunk->in_len == BLEND_LZO_CHUNK_SIZE) {
+			if (++lzo->chunks_len == lzo->chunks_num) {
+				ww_lzo_flush(lzo, lzo->chunks_len);
+				lzo->chunks_len = 0;
+			}
+		}
+	}
+
+	return lzo->error ? 0 : written;
+}
+#undef FILE_HANDLE
+#endif  /* WITH_LZO */
+
 /* --- end compression types --- */
 
 static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
@@ -299,6 +494,15 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
 			r_ww->write = ww_write_zlib;
 			break;
 		}
+#ifdef WITH_LZO
+		case WW_WRAP_LZO:
+		{
+			r_ww->open  = ww_open_lzo;
+			r_ww->close = ww_close_lzo;
+			r_ww->write = ww_write_lzo;
+			break;
+		}
+#endif
 		default:
 		{
 			r_ww->open  = ww_open_none;
@@ -4190,37 +4394,17 @@ static bool do_history(const char *name, ReportList *reports)
 }
 
 /**
- * \return Success.
+ * Write the file through \a ww, with file paths remapped for \a filepath when requested.
+ *
+ * \return true on error.
  */
-bool BLO_write_file(
-        Main *mainvar, const char *filepath, int write_flags,
-        ReportList *reports, const BlendThumbnail *thumb)
+static bool write_file_remapped(
+        Main *mainvar, const char *filepath, WriteWrap *ww, int write_flags, const BlendThumbnail *thumb)
 {
-	char tempname[FILE_MAX + 1];
-	eWriteWrapType ww_type;
-	WriteWrap ww;
-
 	/* path backup/restore */
 	void     *path_list_backup = NULL;
 	const int path_list_flag = (BKE_BPATH_TRAVERSE_SKIP_LIBRARY | BKE_BPATH_TRAVERSE_SKIP_MULTIFILE);
 
-	/* open temporary file, so we preserve the original in case we crash */
-	BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
-
-	if (write_flags & G_FILE_COMPRESS) {
-		ww_type = WW_WRAP_ZLIB;
-	}
-	else {
-		ww_type = WW_WRAP_NONE;
-	}
-
-	ww_handle_init(ww_type, &ww);
-
-	if (ww.open(&ww, tempname) == false) {
-		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
-		return 0;
-	}
-
 	/* check if we need to backup and restore paths */
 	if (UNLIKELY((write_flags & G_FILE_RELATIVE_REMAP) && (G_FILE_SAVE_COPY & write_flags))) {
 		path_list_backup = BKE_bpath_list_backup(mainvar, path_list_flag);
@@ -4257,22 +4441,23 @@ bool BLO_write_file(
 	}
 
 	/* actual file writing */
-	const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, thumb);
-
-	ww.close(&ww);
+	const bool err = write_file_handle(mainvar, ww, NULL, NULL, write_flags, thumb);
 
 	if (UNLIKELY(path_list_backup)) {
 		BKE_bpath_list_restore(mainvar, path_list_flag, path_list_backup);
 		BKE_bpath_list_free(path_list_backup);
 	}
 
-	if (err) {
-		BKE_report(reports, RPT_ERROR, strerror(errno));
-		remove(tempname);
-
-		return 0;
-	}
+	return err;
+}
 
+/**
+ * Move the written temporary file to \a filepath, making version backups first.
+ *
+ * \return Success.
+ */
+static bool write_file_replace(const char *filepath, const char *tempname, int write_flags, ReportList *reports)
+{
 	/* file save to temporary file was successful */
 	/* now do reverse file history (move .blend1 -> .blend2, .blend -> .blend1) */
 	if (write_flags & G_FILE_HISTORY) {
@@ -4291,6 +4476,227 @@ bool BLO_write_file(
 	return 1;
 }
 
+static eWriteWrapType write_file_wrap_type(const int write_flags)
+{
+	if (write_flags & G_FILE_COMPRESS) {
+#ifdef WITH_LZO
+		return (write_flags & G_FILE_COMPRESS_FAST) ? WW_WRAP_LZO : WW_WRAP_ZLIB;
+#else
+		return WW_WRAP_ZLIB;
+#endif
+	}
+	else {
+		return WW_WRAP_NONE;
+	}
+}
+
+/**
+ * \return Success.
+ */
+bool BLO_write_file(
+        Main *mainvar, const char *filepath, int write_flags,
+        ReportList *reports, const BlendThumbnail *thumb)
+{
+	char tempname[FILE_MAX + 1];
+	WriteWrap ww;
+
+	/* open temporary file, so we preserve the original in case we crash */
+	BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
+
+	ww_handle_init(write_file_wrap_type(write_flags), &ww);
+
+	if (ww.open(&ww, tempname) == false) {
+		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
+		return 0;
+	}
+
+	const bool err = write_file_remapped(mainvar, filepath, &ww, write_flags, thumb);
+
+	ww.close(&ww);
+
+	if (err) {
+		BKE_report(reports, RPT_ERROR, strerror(errno));
+		remove(tempname);
+
+		return 0;
+	}
+
+	return write_file_replace(filepath, tempname, write_flags, reports);
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Asynchronous File Writing
+ *
+ * The file is first written in memory from the main thread, as a list of #MemFileChunk
+ * holding exactly what a regular save passes to the #WriteWrap.
+ * Compression and disk I/O then happen from any thread, replaying these chunks.
+ *
+ * \note The chunks are plain copies owned by the #BLOWriteAsync,
+ * unlike undo memfiles they don't go through the shared chunk store,
+ * which is only accessed from the main thread and would hash every chunk.
+ * \{ */
+
+struct BLOWriteAsync {
+	/* MemFileChunk, each allocated together with its data */
+	ListBase chunks;
+	size_t size;
+
+	char filepath[FILE_MAX];
+	char tempname[FILE_MAX + 1];
+	int write_flags;
+
+	/* set by BLO_write_file_async_run, reported by BLO_write_file_async_end */
+	bool error_open, error_write;
+	int error_errno;
+};
+
+/* memfile */
+#define FILE_HANDLE(ww) \
+	(ww)->_user_data.async_handle
+
+static bool ww_open_memfile(WriteWrap *ww, const char *UNUSED(filepath))
+{
+	UNUSED_VARS_NDEBUG(ww);
+	BLI_assert(BLI_listbase_is_empty(&FILE_HANDLE(ww)->chunks));
+	return true;
+}
+static bool ww_close_memfile(WriteWrap *UNUSED(ww))
+{
+	return true;
+}
+static size_t ww_write_memfile(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+	BLOWriteAsync *wa = FILE_HANDLE(ww);
+	MemFileChunk *chunk = MEM_mallocN(sizeof(*chunk) + buf_len, __func__);
+
+	chunk->buf = (char *)(chunk + 1);
+	chunk->size = (unsigned int)buf_len;
+	chunk->ident = 0;
+	memcpy(chunk->buf, buf, buf_len);
+
+	BLI_addtail(&wa->chunks, chunk);
+	wa->size += buf_len;
+	return buf_len;
+}
+#undef FILE_HANDLE
+
+static void write_file_async_free(BLOWriteAsync *wa)
+{
+	MemFileChunk *chunk;
+
+	while ((chunk = BLI_pophead(&wa->chunks))) {
+		MEM_freeN(chunk);
+	}
+	MEM_freeN(wa);
+}
+
+/**
+ * Write \a mainvar in memory, to be written to \a filepath by #BLO_write_file_async_run.
+ * Must be called from the main thread, \a mainvar may be modified again once this returns.
+ *
+ * \return NULL on failure.
+ */
+BLOWriteAsync *BLO_write_file_async_begin(
+        Main *mainvar, const char *filepath, int write_flags,
+        ReportList *reports, const BlendThumbnail *thumb)
+{
+	BLOWriteAsync *wa = MEM_callocN(sizeof(*wa), __func__);
+	WriteWrap ww = {NULL};
+
+	BLI_strncpy(wa->filepath, filepath, sizeof(wa->filepath));
+	BLI_snprintf(wa->tempname, sizeof(wa->tempname), "%s@", filepath);
+	wa->write_flags = write_flags;
+
+	ww.open  = ww_open_memfile;
+	ww.close = ww_close_memfile;
+	ww.write = ww_write_memfile;
+	ww._user_data.async_handle = wa;
+
+	ww.open(&ww, wa->tempname);
+	const bool err = write_file_remapped(mainvar, filepath, &ww, write_flags, thumb);
+	ww.close(&ww);
+
+	if (err) {
+		BKE_report(reports, RPT_ERROR, strerror(errno));
+		write_file_async_free(wa);
+		return NULL;
+	}
+
+	return wa;
+}
+
+/**
+ * Compress and write the file in memory to disk, can be called from any thread.
+ *
+ * \param progress: Optionally updated with the fraction of the file written so far.
+ */
+void BLO_write_file_async_run(BLOWriteAsync *wa, float *progress)
+{
+	WriteWrap ww;
+	MemFileChunk *chunk;
+	size_t written = 0;
+
+	ww_handle_init(write_file_wrap_type(wa->write_flags), &ww);
+
+	if (ww.open(&ww, wa->tempname) == false) {
+		wa->error_open = true;
+		wa->error_errno = errno;
+		return;
+	}
+
+	for (chunk = wa->chunks.first; chunk; chunk = chunk->next) {
+		if (ww.write(&ww, chunk->buf, chunk->size) != chunk->size) {
+			wa->error_write = true;
+			wa->error_errno = errno;
+			break;
+		}
+
+		written += chunk->size;
+		if (progress) {
+			*progress = (float)((double)written / (double)wa->size);
+		}
+	}
+
+	if ((ww.close(&ww) == false) && !wa->error_write) {
+		wa->error_write = true;
+		wa->error_errno = errno;
+	}
+
+	if (wa->error_write) {
+		remove(wa->tempname);
+	}
+}
+
+/**
+ * Finish writing, making version backups and moving the file in place, then free \a wa.
+ * Must be called from the main thread, after #BLO_write_file_async_run.
+ *
+ * \return Success.
+ */
+bool BLO_write_file_async_end(BLOWriteAsync *wa, ReportList *reports)
+{
+	bool ok;
+
+	if (wa->error_open) {
+		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s",
+		            wa->tempname, strerror(wa->error_errno));
+		ok = false;
+	}
+	else if (wa->error_write) {
+		BKE_report(reports, RPT_ERROR, strerror(wa->error_errno));
+		ok = false;
+	}
+	else {
+		ok = write_file_replace(wa->filepath, wa->tempname, wa->write_flags, reports);
+	}
+
+	write_file_async_free(wa);
+
+	return ok;
+}
+
+/** \} */
+
 /**
  * \return Success.
  */
@@ -44,6 +44,7 @@
 #include "BLT_translation.h"
 
 #include "BKE_anim.h"
+#include "BKE_blender_undo.h"
 #include "BKE_blender_version.h"
 #include "BKE_curve.h"
 #include "BKE_displist.h"
@@ -412,6 +413,8 @@ static void stats_string(Scene *scene, ViewLayer *view_layer)
 	SceneStatsFmt stats_fmt;
 	Object *ob = (view_layer->basact) ? view_layer->basact->object : NULL;
 	uintptr_t mem_in_use, mmap_in_use;
+	size_t undo_mem_used, undo_mem_shared;
+	int undo_steps;
 	char memstr[MAX_INFO_MEM_LEN];
 	char gpumemstr[MAX_INFO_MEM_LEN] = "";
 	char *s;
@@ -452,7 +455,12 @@ static void stats_string(Scene *scene, ViewLayer *view_layer)
 	ofs = BLI_snprintf(memstr, MAX_INFO_MEM_LEN, IFACE_(" | Mem:%.2fM"),
 	                    (double)((mem_in_use - mmap_in_use) >> 10) / 1024.0);
 	if (mmap_in_use)
-		BLI_snprintf(memstr + ofs, MAX_INFO_MEM_LEN - ofs, IFACE_(" (%.2fM)"), (double)((mmap_in_use) >> 10) / 1024.0);
+		ofs += BLI_snprintf(memstr + ofs, MAX_INFO_MEM_LEN - ofs, IFACE_(" (%.2fM)"), (double)((mmap_in_use) >> 10) / 1024.0);
+
+	BKE_undo_memory_stats(&undo_steps, &undo_mem_used, &undo_mem_shared);
+	if (undo_steps) {
+		BLI_snprintf(memstr + ofs, MAX_INFO_MEM_LEN - ofs, IFACE_(" | Undo:%.2fM"), (double)(undo_mem_used >> 10) / 1024.0);
+	}
 
 	if (GPU_mem_stats_supported()) {
 		int gpu_free_mem, gpu_tot_memory;
@@ -50,6 +50,7 @@
 #include "BLI_utildefines.h"
 
 #include "BKE_appdir.h"
+#include "BKE_blender_undo.h"
 #include "BKE_blender_version.h"
 #include "BKE_global.h"
 
@@ -342,6 +343,23 @@ static PyObject *bpy_app_preview_render_size_get(PyObject *UNUSED(self), void *c
 	return PyLong_FromLong((long)UI_preview_render_size(GET_INT_FROM_POINTER(closure)));
 }
 
+PyDoc_STRVAR(bpy_app_undo_memory_doc,
+"Memory statistics of the global undo steps, a dictionary with the number of 'steps', "
+"the memory 'used' by them in bytes and the memory saved by sharing identical data between steps (read-only)"
+);
+static PyObject *bpy_app_undo_memory_get(PyObject *UNUSED(self), void *UNUSED(closure))
+{
+	size_t mem_used, mem_shared;
+	int steps;
+
+	BKE_undo_memory_stats(&steps, &mem_used, &mem_shared);
+
+	return Py_BuildValue("{s:i,s:n,s:n}",
+	                     "steps", steps,
+	                     "used", (Py_ssize_t)mem_used,
+	                     "shared", (Py_ssize_t)mem_shared);
+}
+
 static PyObject *bpy_app_autoexec_fail_message_get(PyObject *UNUSED(self), void *UNUSED(closure))
 {
 	return PyC_UnicodeFromByte(G.autoexec_fail);
@@ -366,6 +384,8 @@ static PyGetSetDef bpy_app_getsets[] = {
 	{(char *)"tempdir", bpy_app_tempdir_get, NULL, (char *)bpy_app_tempdir_doc, NULL},
 	{(char *)"driver_namespace", bpy_app_driver_dict_get, NULL, (char *)bpy_app_driver_dict_doc, NULL},
 
+	{(char *)"undo_memory", bpy_app_undo_memory_get, NULL, (char *)bpy_app_undo_memory_doc, NULL},
+
 	{(char *)"render_icon_size", bpy_app_preview_render_size_get, NULL, (char *)bpy_app_preview_render_size_doc, (void *)ICON_SIZE_ICON},
 	{(char *)"render_preview_size", bpy_app_preview_render_size_get, NULL, (char *)bpy_app_preview_render_size_doc, (void *)ICON_SIZE_PREVIEW},
 
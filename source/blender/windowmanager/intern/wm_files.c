@@ -1095,11 +1095,109 @@ bool write_crash_blend(void)
 	}
 }
 
+/* Steps following a successful save, for the current file. */
+static void wm_file_write_post_main(const char *filepath, const int fileflags)
+{
+	if (!(fileflags & G_FILE_SAVE_COPY)) {
+		G.relbase_valid = 1;
+		BLI_strncpy(G.main->name, filepath, sizeof(G.main->name));  /* is guaranteed current file */
+
+		G.save_over = 1; /* disable untitled.blend convention */
+	}
+
+	SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_COMPRESS, G_FILE_COMPRESS);
+	SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_COMPRESS_FAST, G_FILE_COMPRESS_FAST);
+	SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_AUTOPLAY, G_FILE_AUTOPLAY);
+}
+
+/* Steps following a successful save, once the file is on disk. */
+static void wm_file_write_post_disk(const char *filepath, const bool do_history, ImBuf **ibuf_thumb_p)
+{
+	/* prevent background mode scripts from clobbering history */
+	if (do_history) {
+		wm_history_file_update();
+	}
+
+	BLI_callback_exec(G.main, NULL, BLI_CB_EVT_SAVE_POST);
+
+	/* run this function after because the file cant be written before the blend is */
+	if (*ibuf_thumb_p) {
+		IMB_thumb_delete(filepath, THB_FAIL); /* without this a failed thumb overrides */
+		*ibuf_thumb_p = IMB_thumb_create(filepath, THB_LARGE, THB_SOURCE_BLEND, *ibuf_thumb_p);
+	}
+}
+
+/* Incremented by #WM_file_tag_modified, to detect edits made while a file is saved in the background. */
+static unsigned int wm_file_modified_count = 0;
+
+/* Saving in the background, see #BLO_write_file_async_begin. */
+typedef struct FileWriteJob {
+	BLOWriteAsync *wa;
+	char filepath[FILE_MAX];
+	int fileflags;
+	bool do_history;
+	unsigned int modified_count;
+	ImBuf *ibuf_thumb;
+} FileWriteJob;
+
+static void wm_file_write_job_startjob(void *customdata, short *UNUSED(stop), short *do_update, float *progress)
+{
+	FileWriteJob *fj = customdata;
+
+	/* Not cancelable, the file must be complete once the job ends (also when quitting). */
+	BLO_write_file_async_run(fj->wa, progress);
+	*do_update = true;
+}
+
+static void wm_file_write_job_endjob(void *customdata)
+{
+	FileWriteJob *fj = customdata;
+	ReportList reports;
+	Report *report;
+
+	BKE_reports_init(&reports, RPT_STORE);
+
+	/* The file only becomes the current one once it replaced the target. */
+	if (BLO_write_file_async_end(fj->wa, &reports)) {
+		wm_file_write_post_main(fj->filepath, fj->fileflags);
+		wm_file_write_post_disk(fj->filepath, fj->do_history, &fj->ibuf_thumb);
+
+		/* Edits made while writing are not in the file, it stays modified then. */
+		if (fj->modified_count == wm_file_modified_count) {
+			WM_main_add_notifier(NC_WM | ND_FILESAVE, NULL);
+		}
+		else {
+			/* still updates the window title for the new file name */
+			WM_main_add_notifier(NC_WM | ND_DATACHANGED, NULL);
+		}
+	}
+	fj->wa = NULL;
+
+	for (report = reports.list.first; report; report = report->next) {
+		WM_report(report->type, report->message);
+	}
+	BKE_reports_clear(&reports);
+}
+
+static void wm_file_write_job_free(void *customdata)
+{
+	FileWriteJob *fj = customdata;
+
+	BLI_assert(fj->wa == NULL);
+	if (fj->ibuf_thumb) {
+		IMB_freeImBuf(fj->ibuf_thumb);
+	}
+	MEM_freeN(fj);
+}
+
 /**
+ * \param use_async: Only write the file in memory, compressing and writing it to disk is done in a job.
+ * Without a window (background mode) it's written to disk right away, so scripts can test it.
  * \see #wm_homefile_write_exec wraps #BLO_write_file in a similar way.
  */
-static int wm_file_write(bContext *C, const char *filepath, int fileflags, ReportList *reports)
+static int wm_file_write(bContext *C, const char *filepath, int fileflags, const bool use_async, ReportList *reports)
 {
+	wmWindowManager *wm = CTX_wm_manager(C);
 	Library *li;
 	int len;
 	int ret = -1;
@@ -1124,6 +1222,12 @@ static int wm_file_write(bContext *C, const char *filepath, int fileflags, Repor
 		return ret;
 	}
 
+	/* the temporary file of the previous save is still being written */
+	if (WM_jobs_test(wm, wm, WM_JOB_TYPE_FILE_WRITE)) {
+		BKE_report(reports, RPT_ERROR, "A file is being saved in the background, cannot save");
+		return ret;
+	}
+
 	/* note: used to replace the file extension (to ensure '.blend'),
 	 * no need to now because the operator ensures,
 	 * its handy for scripts to save to a predefined name without blender editing it */
@@ -1169,31 +1273,49 @@ static int wm_file_write(bContext *C, const char *filepath, int fileflags, Repor
 	/* XXX temp solution to solve bug, real fix coming (ton) */
 	G.main->recovered = 0;
 	
-	if (BLO_write_file(CTX_data_main(C), filepath, fileflags, reports, thumb)) {
-		const bool do_history = (G.background == false) && (CTX_wm_manager(C)->op_undo_depth == 0);
-
-		if (!(fileflags & G_FILE_SAVE_COPY)) {
-			G.relbase_valid = 1;
-			BLI_strncpy(G.main->name, filepath, sizeof(G.main->name));  /* is guaranteed current file */
-	
-			G.save_over = 1; /* disable untitled.blend convention */
-		}
+	const bool do_history = (G.background == false) && (wm->op_undo_depth == 0);
 
-		SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_COMPRESS, G_FILE_COMPRESS);
-		SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_AUTOPLAY, G_FILE_AUTOPLAY);
+	if (use_async) {
+		BLOWriteAsync *wa = BLO_write_file_async_begin(CTX_data_main(C), filepath, fileflags, reports, thumb);
 
-		/* prevent background mode scripts from clobbering history */
-		if (do_history) {
-			wm_history_file_update();
+		if (wa == NULL) {
+			/* pass */
 		}
-
-		BLI_callback_exec(G.main, NULL, BLI_CB_EVT_SAVE_POST);
-
-		/* run this function after because the file cant be written before the blend is */
-		if (ibuf_thumb) {
-			IMB_thumb_delete(filepath, THB_FAIL); /* without this a failed thumb overrides */
-			ibuf_thumb = IMB_thumb_create(filepath, THB_LARGE, THB_SOURCE_BLEND, ibuf_thumb);
+		else if (G.background || CTX_wm_window(C) == NULL) {
+			/* Jobs need a window, write the file in memory to disk right away. */
+			BLO_write_file_async_run(wa, NULL);
+			if (BLO_write_file_async_end(wa, reports)) {
+				wm_file_write_post_main(filepath, fileflags);
+				wm_file_write_post_disk(filepath, do_history, &ibuf_thumb);
+
+				ret = 0;  /* Success. */
+			}
 		}
+		else {
+			FileWriteJob *fj = MEM_callocN(sizeof(*fj), __func__);
+			wmJob *wm_job;
+
+			fj->wa = wa;
+			BLI_strncpy(fj->filepath, filepath, sizeof(fj->filepath));
+			fj->fileflags = fileflags;
+			fj->do_history = do_history;
+			fj->modified_count = wm_file_modified_count;
+			fj->ibuf_thumb = ibuf_thumb;
+			ibuf_thumb = NULL;
+
+			/* Post-save steps and the ND_FILESAVE notifier are done by the job's end callback. */
+			wm_job = WM_jobs_get(wm, CTX_wm_window(C), wm, "Saving", WM_JOB_PROGRESS, WM_JOB_TYPE_FILE_WRITE);
+			WM_jobs_customdata_set(wm_job, fj, wm_file_write_job_free);
+			WM_jobs_timer(wm_job, 0.1, 0, 0);
+			WM_jobs_callbacks(wm_job, wm_file_write_job_startjob, NULL, NULL, wm_file_write_job_endjob);
+			WM_jobs_start(wm, wm_job);
+
+			ret = 0;  /* Success. */
+		}
+	}
+	else if (BLO_write_file(CTX_data_main(C), filepath, fileflags, reports, thumb)) {
+		wm_file_write_post_main(filepath, fileflags);
+		wm_file_write_post_disk(filepath, do_history, &ibuf_thumb);
 
 		ret = 0;  /* Success. */
 	}
@@ -1368,6 +1490,7 @@ void wm_open_init_use_scripts(wmOperator *op, bool use_prefs)
 void WM_file_tag_modified(const bContext *C)
 {
 	wmWindowManager *wm = CTX_wm_manager(C);
+	wm_file_modified_count++;
 	if (wm->file_saved) {
 		wm->file_saved = 0;
 		/* notifier that data changed, for save-over warning or header */
@@ -2045,6 +2168,13 @@ static void save_set_compress(wmOperator *op)
 			RNA_property_boolean_set(op->ptr, prop, (U.flag & USER_FILECOMPRESS) != 0);
 		}
 	}
+
+	prop = RNA_struct_find_property(op->ptr, "compress_fast");
+	if (!RNA_property_is_set(op->ptr, prop)) {
+		if (G.save_over) {  /* keep flag for existing file */
+			RNA_property_boolean_set(op->ptr, prop, (G.fileflags & G_FILE_COMPRESS_FAST) != 0);
+		}
+	}
 }
 
 static void save_set_filepath(wmOperator *op)
@@ -2082,6 +2212,7 @@ static int wm_save_as_mainfile_invoke(bContext *C, wmOperator *op, const wmEvent
 /* function used for WM_OT_save_mainfile too */
 static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 {
+	wmWindowManager *wm = CTX_wm_manager(C);
 	char path[FILE_MAX];
 	int fileflags;
 
@@ -2101,6 +2232,9 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 	SET_FLAG_FROM_TEST(
 	        fileflags, RNA_boolean_get(op->ptr, "compress"),
 	        G_FILE_COMPRESS);
+	SET_FLAG_FROM_TEST(
+	        fileflags, RNA_boolean_get(op->ptr, "compress_fast"),
+	        G_FILE_COMPRESS_FAST);
 	SET_FLAG_FROM_TEST(
 	        fileflags, RNA_boolean_get(op->ptr, "relative_remap"),
 	        G_FILE_RELATIVE_REMAP);
@@ -2120,10 +2254,13 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 #  error "don't remove by accident"
 #endif
 
-	if (wm_file_write(C, path, fileflags, op->reports) != 0)
+	if (wm_file_write(C, path, fileflags, RNA_boolean_get(op->ptr, "async"), op->reports) != 0)
 		return OPERATOR_CANCELLED;
 
-	WM_event_add_notifier(C, NC_WM | ND_FILESAVE, NULL);
+	/* a background save notifies once the file is written */
+	if (!WM_jobs_test(wm, wm, WM_JOB_TYPE_FILE_WRITE)) {
+		WM_event_add_notifier(C, NC_WM | ND_FILESAVE, NULL);
+	}
 
 	return OPERATOR_FINISHED;
 }
@@ -2160,8 +2297,12 @@ void WM_OT_save_as_mainfile(wmOperatorType *ot)
 	        ot, FILE_TYPE_FOLDER | FILE_TYPE_BLENDER, FILE_BLENDER, FILE_SAVE,
 	        WM_FILESEL_FILEPATH, FILE_DEFAULTDISPLAY, FILE_SORT_ALPHA);
 	RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+	RNA_def_boolean(ot->srna, "compress_fast", false, "Fast Compression",
+	                "Compress faster but less (LZO instead of gzip), files can only be read by recent Blender versions");
 	RNA_def_boolean(ot->srna, "relative_remap", true, "Remap Relative",
 	                "Remap relative paths when saving in a different directory");
+	RNA_def_boolean(ot->srna, "async", false, "Save in Background",
+	                "Compress and write the file in a background job, keeping the interface responsive");
 	prop = RNA_def_boolean(ot->srna, "copy", false, "Save Copy",
 	                "Save a copy of the actual working state but does not make saved file active");
 	RNA_def_property_flag(prop, PROP_SKIP_SAVE);
@@ -2226,8 +2367,12 @@ void WM_OT_save_mainfile(wmOperatorType *ot)
 	        ot, FILE_TYPE_FOLDER | FILE_TYPE_BLENDER, FILE_BLENDER, FILE_SAVE,
 	        WM_FILESEL_FILEPATH, FILE_DEFAULTDISPLAY, FILE_SORT_ALPHA);
 	RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+	RNA_def_boolean(ot->srna, "compress_fast", false, "Fast Compression",
+	                "Compress faster but less (LZO instead of gzip), files can only be read by recent Blender versions");
 	RNA_def_boolean(ot->srna, "relative_remap", false, "Remap Relative",
 	                "Remap relative paths when saving in a different directory");
+	RNA_def_boolean(ot->srna, "async", false, "Save in Background",
+	                "Compress and write the file in a background job, keeping the interface responsive");
 }
 
 /** \} */
@@ -577,6 +577,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 	BLI_argsPrintArgDoc(ba, "--debug-wm");
 	BLI_argsPrintArgDoc(ba, "--debug-all");
 	BLI_argsPrintArgDoc(ba, "--debug-io");
+	BLI_argsPrintArgDoc(ba, "--debug-fileload");
 
 	printf("\n");
 	BLI_argsPrintArgDoc(ba, "--debug-fpe");
@@ -609,6 +610,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 	printf("\n");
 	printf("Experimental Features:\n");
 	BLI_argsPrintArgDoc(ba, "--enable-copy-on-write");
+	BLI_argsPrintArgDoc(ba, "--enable-memory-thread-cache");
 
 	/* Other options _must_ be last (anything not handled will show here) */
 	printf("\n");
@@ -770,6 +772,8 @@ static const char arg_handle_debug_mode_generic_set_doc_depsgraph_no_threads[] =
 "\n\tSwitch dependency graph to a single threaded evaluation.";
 static const char arg_handle_debug_mode_generic_set_doc_gpumem[] =
 "\n\tEnable GPU memory stats in status bar.";
+static const char arg_handle_debug_mode_generic_set_doc_fileload[] =
+"\n\tEnable time profiling for .blend file loading.";
 
 static int arg_handle_debug_mode_generic_set(int UNUSED(argc), const char **UNUSED(argv), void *data)
 {
@@ -1210,6 +1214,15 @@ static int arg_handle_use_copy_on_write(int UNUSED(argc), const char **UNUSED(ar
 	return 0;
 }
 
+static const char arg_handle_memory_thread_cache_doc[] =
+"\n\tCache small memory blocks per thread, memory statistics show allocations by size"
+;
+static int arg_handle_memory_thread_cache(int UNUSED(argc), const char **UNUSED(argv), void *UNUSED(data))
+{
+	MEM_use_thread_cache();
+	return 0;
+}
+
 static const char arg_handle_verbosity_set_doc[] =
 "<verbose>\n"
 "\tSet logging verbosity level."
@@ -1861,8 +1874,11 @@ void main_args_setup(bContext *C, bArgs *ba, SYS_SystemHandle *syshandle)
 	            CB_EX(arg_handle_debug_mode_generic_set, gpumem), (void *)G_DEBUG_GPU_MEM);
 	BLI_argsAdd(ba, 1, NULL, "--debug-gpu-shaders",
 	            CB_EX(arg_handle_debug_mode_generic_set, gpumem), (void *)G_DEBUG_GPU_SHADERS);
+	BLI_argsAdd(ba, 1, NULL, "--debug-fileload",
+	            CB_EX(arg_handle_debug_mode_generic_set, fileload), (void *)G_DEBUG_FILELOAD);
 
 	BLI_argsAdd(ba, 1, NULL, "--enable-copy-on-write", CB(arg_handle_use_copy_on_write), NULL);
+	BLI_argsAdd(ba, 1, NULL, "--enable-memory-thread-cache", CB(arg_handle_memory_thread_cache), NULL);
 
 	BLI_argsAdd(ba, 1, NULL, "--verbose", CB(arg_handle_verbosity_set), NULL);
 
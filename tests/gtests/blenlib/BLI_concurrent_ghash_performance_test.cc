@@ -0,0 +1,127 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_concurrent_ghash.h"
+#include "BLI_edgehash.h"
+#include "BLI_ghash.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Edges deduplication of a grid of quads, done as in BKE_mesh_calc_edges:
+ * serially with an EdgeHash, and in parallel with a ConcurrentGHash. */
+
+typedef struct GridEdgeKey {
+	unsigned int v1, v2;
+	struct GridEdgeKey *key_stored;
+} GridEdgeKey;
+
+typedef struct GridEdgesData {
+	unsigned int grid_size;
+	GridEdgeKey *loop_keys;
+	ConcurrentGHash *cgh;
+} GridEdgesData;
+
+/* Vertex of the i-th corner of a quad of the grid. */
+BLI_INLINE unsigned int grid_quad_vert(const unsigned int grid_size, const unsigned int quad, const int corner)
+{
+	const unsigned int x = quad % grid_size, y = quad / grid_size;
+	const unsigned int offsets[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+	return (y + offsets[corner][1]) * (grid_size + 1) + x + offsets[corner][0];
+}
+
+static unsigned int grid_edge_key_hash(const void *key)
+{
+	const GridEdgeKey *ek = (const GridEdgeKey *)key;
+	return BLI_ghashutil_uinthash((ek->v1 * 65) ^ (ek->v2 * 31));
+}
+
+static bool grid_edge_key_cmp(const void *a, const void *b)
+{
+	const GridEdgeKey *ek_a = (const GridEdgeKey *)a, *ek_b = (const GridEdgeKey *)b;
+	return (ek_a->v1 != ek_b->v1) || (ek_a->v2 != ek_b->v2);
+}
+
+static void grid_edges_insert_func(void *userdata, const int quad)
+{
+	GridEdgesData *data = (GridEdgesData *)userdata;
+
+	for (int j = 0; j < 4; j++) {
+		GridEdgeKey *ek = &data->loop_keys[quad * 4 + j];
+		const unsigned int v = grid_quad_vert(data->grid_size, (unsigned int)quad, j);
+		const unsigned int v_next = grid_quad_vert(data->grid_size, (unsigned int)quad, (j + 1) % 4);
+		void *val;
+
+		ek->v1 = MIN2(v, v_next);
+		ek->v2 = MAX2(v, v_next);
+		BLI_concurrent_ghash_insert_or_lookup(data->cgh, ek, ek, &val);
+		ek->key_stored = (GridEdgeKey *)val;
+	}
+}
+
+static void grid_edges_tests(const unsigned int grid_size, const char *id)
+{
+	const unsigned int num_quads = grid_size * grid_size;
+	const unsigned int num_edges = 2 * grid_size * (grid_size + 1);
+
+	printf("\n========== STARTING %s ==========\n", id);
+
+	BLI_threadapi_init();
+
+	{
+		TIMEIT_START(edgehash_serial);
+
+		EdgeHash *eh = BLI_edgehash_new_ex(__func__, BLI_EDGEHASH_SIZE_GUESS_FROM_POLYS(num_quads));
+		for (unsigned int quad = 0; quad < num_quads; quad++) {
+			for (int j = 0; j < 4; j++) {
+				void **val_p;
+				if (!BLI_edgehash_ensure_p(eh,
+				                           grid_quad_vert(grid_size, quad, j),
+				                           grid_quad_vert(grid_size, quad, (j + 1) % 4),
+				                           &val_p))
+				{
+					*val_p = NULL;
+				}
+			}
+		}
+		EXPECT_EQ(BLI_edgehash_size(eh), num_edges);
+		BLI_edgehash_free(eh, NULL);
+
+		TIMEIT_END(edgehash_serial);
+	}
+
+	{
+		TIMEIT_START(concurrent_ghash_parallel);
+
+		GridEdgesData data;
+		data.grid_size = grid_size;
+		data.loop_keys = (GridEdgeKey *)MEM_mallocN(sizeof(*data.loop_keys) * num_quads * 4, __func__);
+		data.cgh = BLI_concurrent_ghash_new_ex(grid_edge_key_hash, grid_edge_key_cmp, __func__,
+		                                       BLI_EDGEHASH_SIZE_GUESS_FROM_POLYS(num_quads));
+
+		BLI_task_parallel_range(0, (int)num_quads, &data, grid_edges_insert_func, true);
+
+		EXPECT_EQ(BLI_concurrent_ghash_size(data.cgh), num_edges);
+		BLI_concurrent_ghash_free(data.cgh, NULL, NULL);
+		MEM_freeN(data.loop_keys);
+
+		TIMEIT_END(concurrent_ghash_parallel);
+	}
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(concurrent_ghash, GridEdges100)
+{
+	grid_edges_tests(100, "Grid edges - 100x100 quads");
+}
+
+TEST(concurrent_ghash, GridEdges1000)
+{
+	grid_edges_tests(1000, "Grid edges - 1000x1000 quads");
+}
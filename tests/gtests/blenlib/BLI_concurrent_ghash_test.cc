@@ -0,0 +1,98 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "atomic_ops.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_concurrent_ghash.h"
+#include "BLI_ghash.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+}
+
+#define TESTCASE_SIZE 100000
+/* Every key is inserted that many times, from different iterations. */
+#define TESTCASE_DUPLICATES 4
+
+typedef struct ConcurrentInsertData {
+	ConcurrentGHash *cgh;
+	uint32_t num_inserted;
+	/* Value returned for each key, must be the same for all duplicates. */
+	void **values;
+} ConcurrentInsertData;
+
+static void concurrent_insert_func(void *userdata, const int iter)
+{
+	ConcurrentInsertData *data = (ConcurrentInsertData *)userdata;
+	const int key = iter % TESTCASE_SIZE;
+	void *val;
+
+	/* Key 0 would be NULL, offset all keys. */
+	if (BLI_concurrent_ghash_insert_or_lookup(data->cgh, SET_INT_IN_POINTER(key + 1), SET_INT_IN_POINTER(iter), &val)) {
+		atomic_add_and_fetch_uint32(&data->num_inserted, 1);
+		EXPECT_EQ(val, SET_INT_IN_POINTER(iter));
+	}
+	EXPECT_EQ(GET_INT_FROM_POINTER(val) % TESTCASE_SIZE, key);
+
+	/* All duplicates must see the value of the key which was inserted first. */
+	void *val_prev = atomic_cas_ptr(&data->values[key], NULL, val);
+	if (val_prev != NULL) {
+		EXPECT_EQ(val_prev, val);
+	}
+}
+
+/* Insert the same keys from many threads, only one insertion must succeed per key. */
+TEST(concurrent_ghash, InsertOrLookup)
+{
+	BLI_threadapi_init();
+
+	ConcurrentGHash *cgh = BLI_concurrent_ghash_new(BLI_ghashutil_ptrhash, BLI_ghashutil_ptrcmp, __func__);
+	ConcurrentInsertData data = {cgh, 0, (void **)MEM_callocN(sizeof(void *) * TESTCASE_SIZE, __func__)};
+
+	BLI_task_parallel_range(0, TESTCASE_SIZE * TESTCASE_DUPLICATES, &data, concurrent_insert_func, true);
+
+	EXPECT_EQ(data.num_inserted, (uint32_t)TESTCASE_SIZE);
+	EXPECT_EQ(BLI_concurrent_ghash_size(cgh), TESTCASE_SIZE);
+
+	for (int key = 0; key < TESTCASE_SIZE; key++) {
+		EXPECT_TRUE(BLI_concurrent_ghash_haskey(cgh, SET_INT_IN_POINTER(key + 1)));
+		EXPECT_EQ(BLI_concurrent_ghash_lookup(cgh, SET_INT_IN_POINTER(key + 1)), data.values[key]);
+	}
+	EXPECT_FALSE(BLI_concurrent_ghash_haskey(cgh, SET_INT_IN_POINTER(TESTCASE_SIZE + 1)));
+
+	MEM_freeN(data.values);
+	BLI_concurrent_ghash_free(cgh, NULL, NULL);
+}
+
+/* Iteration over all stripes visits every key once. */
+TEST(concurrent_ghash, Iterator)
+{
+	ConcurrentGHash *cgh = BLI_concurrent_ghash_new_ex(BLI_ghashutil_ptrhash, BLI_ghashutil_ptrcmp, __func__, 100);
+	ConcurrentGHashIterator cghi;
+	int num_keys = 0, sum = 0, sum_iter = 0;
+	void *val;
+
+	/* Empty. */
+	CONCURRENT_GHASH_ITER (cghi, cgh) {
+		num_keys++;
+	}
+	EXPECT_EQ(num_keys, 0);
+
+	for (int key = 1; key <= 100; key++) {
+		EXPECT_TRUE(BLI_concurrent_ghash_insert_or_lookup(cgh, SET_INT_IN_POINTER(key), SET_INT_IN_POINTER(key), &val));
+		sum += key;
+	}
+
+	CONCURRENT_GHASH_ITER (cghi, cgh) {
+		EXPECT_EQ(BLI_concurrent_ghashIterator_getKey(&cghi), BLI_concurrent_ghashIterator_getValue(&cghi));
+		sum_iter += GET_INT_FROM_POINTER(BLI_concurrent_ghashIterator_getKey(&cghi));
+		num_keys++;
+	}
+	EXPECT_EQ(num_keys, 100);
+	EXPECT_EQ(sum_iter, sum);
+
+	BLI_concurrent_ghash_free(cgh, NULL, NULL);
+}
@@ -0,0 +1,249 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_kdopbvh.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_threads.h"
+#include "PIL_time_utildefines.h"
+}
+
+#include "stubs/bf_intern_eigen_stubs.h"
+
+/* Run the longest tests! */
+//#define KDOPBVH_RUN_BIG
+
+/* Ray-casts and nearest points against the triangles of a bumpy sphere,
+ * one query at a time and batched, the way shrinkwrap, snapping or baking use BVH trees. */
+
+typedef struct SphereMesh {
+	float (*verts)[3];
+	unsigned int (*tris)[3];
+	int tris_len;
+} SphereMesh;
+
+static void sphere_mesh_create(SphereMesh *mesh, const int segments)
+{
+	const int rings = segments / 2;
+	RNG *rng = BLI_rng_new(0);
+
+	mesh->verts = (float (*)[3])MEM_mallocN(sizeof(*mesh->verts) * (rings + 1) * (segments + 1), __func__);
+	mesh->tris = (unsigned int (*)[3])MEM_mallocN(sizeof(*mesh->tris) * rings * segments * 2, __func__);
+	mesh->tris_len = 0;
+
+	for (int r = 0; r <= rings; r++) {
+		for (int s = 0; s <= segments; s++) {
+			const float phi = (float)M_PI * (float)r / (float)rings;
+			const float theta = 2.0f * (float)M_PI * (float)s / (float)segments;
+			float *co = mesh->verts[r * (segments + 1) + s];
+			co[0] = sinf(phi) * cosf(theta);
+			co[1] = sinf(phi) * sinf(theta);
+			co[2] = cosf(phi);
+			mul_v3_fl(co, 1.0f + 0.02f * BLI_rng_get_float(rng));
+		}
+	}
+
+	for (int r = 0; r < rings; r++) {
+		for (int s = 0; s < segments; s++) {
+			const unsigned int v = (unsigned int)(r * (segments + 1) + s);
+			const unsigned int v_next = v + (unsigned int)(segments + 1);
+			unsigned int *tri = mesh->tris[mesh->tris_len++];
+			tri[0] = v; tri[1] = v_next; tri[2] = v_next + 1;
+			tri = mesh->tris[mesh->tris_len++];
+			tri[0] = v; tri[1] = v_next + 1; tri[2] = v + 1;
+		}
+	}
+
+	BLI_rng_free(rng);
+}
+
+static void sphere_mesh_free(SphereMesh *mesh)
+{
+	MEM_freeN(mesh->verts);
+	MEM_freeN(mesh->tris);
+}
+
+static void sphere_mesh_raycast_cb(void *userdata, int index, const BVHTreeRay *ray, BVHTreeRayHit *hit)
+{
+	const SphereMesh *mesh = (const SphereMesh *)userdata;
+	const unsigned int *tri = mesh->tris[index];
+	float dist;
+
+	if (isect_ray_tri_watertight_v3(
+	        ray->origin, ray->isect_precalc,
+	        mesh->verts[tri[0]], mesh->verts[tri[1]], mesh->verts[tri[2]], &dist, NULL) &&
+	    dist < hit->dist)
+	{
+		hit->index = index;
+		hit->dist = dist;
+		madd_v3_v3v3fl(hit->co, ray->origin, ray->direction, dist);
+	}
+}
+
+static void sphere_mesh_nearest_cb(void *userdata, int index, const float co[3], BVHTreeNearest *nearest)
+{
+	const SphereMesh *mesh = (const SphereMesh *)userdata;
+	const unsigned int *tri = mesh->tris[index];
+	float nearest_tmp[3], dist_sq;
+
+	closest_on_tri_to_point_v3(nearest_tmp, co, mesh->verts[tri[0]], mesh->verts[tri[1]], mesh->verts[tri[2]]);
+	dist_sq = len_squared_v3v3(co, nearest_tmp);
+
+	if (dist_sq < nearest->dist_sq) {
+		nearest->index = index;
+		nearest->dist_sq = dist_sq;
+		copy_v3_v3(nearest->co, nearest_tmp);
+	}
+}
+
+static void sphere_mesh_tests(
+        const int segments, const int queries_len, const char tree_type, const int flag, const char *id)
+{
+	SphereMesh mesh;
+	BVHTree *tree;
+
+	printf("\n========== STARTING %s ==========\n", id);
+
+	BLI_threadapi_init();
+
+	sphere_mesh_create(&mesh, segments);
+
+	float (*co)[3] = (float (*)[3])MEM_mallocN(sizeof(*co) * queries_len, __func__);
+	float (*dir)[3] = (float (*)[3])MEM_mallocN(sizeof(*dir) * queries_len, __func__);
+	BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hits) * queries_len, __func__);
+	BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest) * queries_len, __func__);
+
+	{
+		RNG *rng = BLI_rng_new(1);
+		for (int i = 0; i < queries_len; i++) {
+			/* From outside the sphere, towards somewhere around its center. */
+			BLI_rng_get_float_unit_v3(rng, co[i]);
+			mul_v3_fl(co[i], 2.0f);
+			BLI_rng_get_float_unit_v3(rng, dir[i]);
+			madd_v3_v3fl(dir[i], co[i], -1.0f);
+			normalize_v3(dir[i]);
+		}
+		BLI_rng_free(rng);
+	}
+
+	{
+		TIMEIT_START(bvhtree_build);
+		tree = BLI_bvhtree_new_ex(mesh.tris_len, 0.0f, tree_type, 6, flag);
+		for (int i = 0; i < mesh.tris_len; i++) {
+			float tri_co[3][3];
+			copy_v3_v3(tri_co[0], mesh.verts[mesh.tris[i][0]]);
+			copy_v3_v3(tri_co[1], mesh.verts[mesh.tris[i][1]]);
+			copy_v3_v3(tri_co[2], mesh.verts[mesh.tris[i][2]]);
+			BLI_bvhtree_insert(tree, i, tri_co[0], 3);
+		}
+		BLI_bvhtree_balance(tree);
+		TIMEIT_END(bvhtree_build);
+	}
+
+	printf("%d triangles, %d queries, tree type %d%s\n",
+	       mesh.tris_len, queries_len, (int)tree_type, (flag & BVH_BUILD_SAH) ? ", SAH build" : "");
+
+	{
+		BVHTreeStats stats;
+		BLI_bvhtree_calc_stats(tree, &stats);
+		printf("Tree stats: %d branches, depth %d (average %f), SAH cost %f\n",
+		       stats.totbranch, stats.depth_max, stats.depth_avg, stats.sah_cost);
+	}
+
+	{
+		int hits_num = 0;
+		TIMEIT_START(ray_cast);
+		for (int i = 0; i < queries_len; i++) {
+			BVHTreeRayHit hit;
+			hit.index = -1;
+			hit.dist = BVH_RAYCAST_DIST_MAX;
+			if (BLI_bvhtree_ray_cast(tree, co[i], dir[i], 0.0f, &hit, sphere_mesh_raycast_cb, &mesh) != -1) {
+				hits_num++;
+			}
+		}
+		TIMEIT_END(ray_cast);
+		EXPECT_EQ(hits_num, queries_len);
+	}
+
+	{
+		int hits_num = 0;
+		TIMEIT_START(ray_cast_batch);
+		for (int i = 0; i < queries_len; i++) {
+			hits[i].index = -1;
+			hits[i].dist = BVH_RAYCAST_DIST_MAX;
+		}
+		BLI_bvhtree_ray_cast_batch(
+		        tree, co, dir, queries_len, 0.0f, hits, sphere_mesh_raycast_cb, &mesh, BVH_RAYCAST_DEFAULT);
+		TIMEIT_END(ray_cast_batch);
+		for (int i = 0; i < queries_len; i++) {
+			hits_num += (hits[i].index != -1);
+		}
+		EXPECT_EQ(hits_num, queries_len);
+	}
+
+	{
+		TIMEIT_START(find_nearest);
+		for (int i = 0; i < queries_len; i++) {
+			BVHTreeNearest nearest_single;
+			nearest_single.index = -1;
+			nearest_single.dist_sq = FLT_MAX;
+			BLI_bvhtree_find_nearest(tree, co[i], &nearest_single, sphere_mesh_nearest_cb, &mesh);
+		}
+		TIMEIT_END(find_nearest);
+	}
+
+	{
+		TIMEIT_START(find_nearest_batch);
+		for (int i = 0; i < queries_len; i++) {
+			nearest[i].index = -1;
+			nearest[i].dist_sq = FLT_MAX;
+		}
+		BLI_bvhtree_find_nearest_batch(tree, co, queries_len, nearest, sphere_mesh_nearest_cb, &mesh);
+		TIMEIT_END(find_nearest_batch);
+	}
+
+	BLI_bvhtree_free(tree);
+	MEM_freeN(nearest);
+	MEM_freeN(hits);
+	MEM_freeN(dir);
+	MEM_freeN(co);
+	sphere_mesh_free(&mesh);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(kdopbvh, SphereMesh100000_Tree2)
+{
+	sphere_mesh_tests(316, 100000, 2, 0, "Sphere mesh - 100000 tris - binary tree");
+}
+
+TEST(kdopbvh, SphereMesh100000_Tree4)
+{
+	sphere_mesh_tests(316, 100000, 4, 0, "Sphere mesh - 100000 tris - 4-ary tree");
+}
+
+TEST(kdopbvh, SphereMesh1000000_Tree4)
+{
+	sphere_mesh_tests(1000, 100000, 4, 0, "Sphere mesh - 1000000 tris - 4-ary tree");
+}
+
+TEST(kdopbvh, SphereMesh1000000_Tree4_SAH)
+{
+	sphere_mesh_tests(1000, 100000, 4, BVH_BUILD_SAH, "Sphere mesh - 1000000 tris - 4-ary tree - SAH build");
+}
+
+#ifdef KDOPBVH_RUN_BIG
+TEST(kdopbvh, SphereMesh10000000_Tree4)
+{
+	sphere_mesh_tests(3162, 100000, 4, 0, "Sphere mesh - 10000000 tris - 4-ary tree");
+}
+
+TEST(kdopbvh, SphereMesh10000000_Tree4_SAH)
+{
+	sphere_mesh_tests(3162, 100000, 4, BVH_BUILD_SAH, "Sphere mesh - 10000000 tris - 4-ary tree - SAH build");
+}
+#endif
@@ -95,3 +95,207 @@ static void find_nearest_points_test(int points_len, float scale, int round, int
 TEST(kdopbvh, FindNearest_1)		{ find_nearest_points_test(1, 1.0, 1000, 1234); }
 TEST(kdopbvh, FindNearest_2)		{ find_nearest_points_test(2, 1.0, 1000, 123); }
 TEST(kdopbvh, FindNearest_500)		{ find_nearest_points_test(500, 1.0, 1000, 12); }
+
+/* -------------------------------------------------------------------- */
+/* Batched Queries */
+
+#define BATCH_SPHERE_RADIUS 0.05f
+
+typedef struct BatchTestData {
+	float (*points)[3];
+} BatchTestData;
+
+/* Ray-cast against spheres around the points. */
+static void batch_raycast_cb(void *userdata, int index, const BVHTreeRay *ray, BVHTreeRayHit *hit)
+{
+	const BatchTestData *data = (const BatchTestData *)userdata;
+	float delta[3];
+
+	sub_v3_v3v3(delta, data->points[index], ray->origin);
+	const float t = dot_v3v3(delta, ray->direction);
+	const float dist_sq = len_squared_v3(delta) - t * t;
+	if (dist_sq > BATCH_SPHERE_RADIUS * BATCH_SPHERE_RADIUS) {
+		return;
+	}
+	const float dist = t - sqrtf(BATCH_SPHERE_RADIUS * BATCH_SPHERE_RADIUS - dist_sq);
+	if (dist >= 0.0f && dist < hit->dist) {
+		hit->index = index;
+		hit->dist = dist;
+		madd_v3_v3v3fl(hit->co, ray->origin, ray->direction, dist);
+	}
+}
+
+static void batch_nearest_cb(void *userdata, int index, const float co[3], BVHTreeNearest *nearest)
+{
+	const BatchTestData *data = (const BatchTestData *)userdata;
+	const float dist_sq = len_squared_v3v3(co, data->points[index]);
+
+	if (dist_sq < nearest->dist_sq) {
+		nearest->index = index;
+		nearest->dist_sq = dist_sq;
+		copy_v3_v3(nearest->co, data->points[index]);
+	}
+}
+
+/**
+ * Check batched queries give the same results as the single ones.
+ */
+static void batch_queries_test(int points_len, int queries_len, char tree_type, char axis, bool use_callback)
+{
+	struct RNG *rng = BLI_rng_new(points_len);
+	BVHTree *tree = BLI_bvhtree_new(points_len, BATCH_SPHERE_RADIUS, tree_type, axis);
+	BatchTestData data;
+
+	data.points = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	float (*co)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * queries_len, __func__);
+	float (*dir)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * queries_len, __func__);
+	BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hits) * queries_len, __func__);
+	BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest) * queries_len, __func__);
+
+	for (int i = 0; i < points_len; i++) {
+		rng_v3_round(data.points[i], 3, rng, 1000, 1.0f);
+		BLI_bvhtree_insert(tree, i, data.points[i], 1);
+	}
+	BLI_bvhtree_balance(tree);
+
+	for (int i = 0; i < queries_len; i++) {
+		rng_v3_round(co[i], 3, rng, 1000, 1.5f);
+		BLI_rng_get_float_unit_v3(rng, dir[i]);
+		/* Some axis aligned rays too. */
+		if (i % 7 == 0) {
+			dir[i][i % 3] = 0.0f;
+			normalize_v3(dir[i]);
+		}
+		hits[i].index = -1;
+		hits[i].dist = BVH_RAYCAST_DIST_MAX;
+		nearest[i].index = -1;
+		nearest[i].dist_sq = FLT_MAX;
+	}
+
+	BLI_bvhtree_ray_cast_batch(
+	        tree, co, dir, queries_len, 0.0f, hits,
+	        use_callback ? batch_raycast_cb : NULL, &data, BVH_RAYCAST_DEFAULT);
+	BLI_bvhtree_find_nearest_batch(
+	        tree, co, queries_len, nearest,
+	        use_callback ? batch_nearest_cb : NULL, &data);
+
+	for (int i = 0; i < queries_len; i++) {
+		BVHTreeRayHit hit = {-1};
+		hit.dist = BVH_RAYCAST_DIST_MAX;
+		BLI_bvhtree_ray_cast(tree, co[i], dir[i], 0.0f, &hit, use_callback ? batch_raycast_cb : NULL, &data);
+		/* Without callback the bounds are hit, single ray-casts don't handle axis aligned rays
+		 * well there (infinite inverse direction). */
+		if (use_callback || i % 7 != 0) {
+			EXPECT_EQ(hit.index, hits[i].index);
+			EXPECT_EQ(hit.dist, hits[i].dist);
+		}
+
+		BVHTreeNearest nearest_single = {-1};
+		nearest_single.dist_sq = FLT_MAX;
+		BLI_bvhtree_find_nearest(tree, co[i], &nearest_single, use_callback ? batch_nearest_cb : NULL, &data);
+		/* Points are rounded, so different points at the same distance can be found. */
+		EXPECT_EQ(nearest_single.dist_sq, nearest[i].dist_sq);
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(nearest);
+	MEM_freeN(hits);
+	MEM_freeN(dir);
+	MEM_freeN(co);
+	MEM_freeN(data.points);
+}
+
+TEST(kdopbvh, Batch_Single)			{ batch_queries_test(1, 100, 4, 6, true); }
+TEST(kdopbvh, Batch_Tree2)			{ batch_queries_test(1000, 2000, 2, 6, true); }
+TEST(kdopbvh, Batch_Tree4)			{ batch_queries_test(1000, 2000, 4, 6, true); }
+TEST(kdopbvh, Batch_Tree8)			{ batch_queries_test(1000, 2000, 8, 8, true); }
+TEST(kdopbvh, Batch_Tree4_Kdop26)	{ batch_queries_test(1000, 2000, 4, 26, true); }
+TEST(kdopbvh, Batch_Tree4_NoCallback)	{ batch_queries_test(1000, 2000, 4, 6, false); }
+TEST(kdopbvh, Batch_Few)			{ batch_queries_test(1000, 10, 4, 6, true); }
+
+/* -------------------------------------------------------------------- */
+/* SAH Build */
+
+static BVHTree *sah_test_tree_new(const float (*points)[3], int points_len, char tree_type, char axis, int flag)
+{
+	BVHTree *tree = BLI_bvhtree_new_ex(points_len, BATCH_SPHERE_RADIUS, tree_type, axis, flag);
+	for (int i = 0; i < points_len; i++) {
+		BLI_bvhtree_insert(tree, i, points[i], 1);
+	}
+	BLI_bvhtree_balance(tree);
+	return tree;
+}
+
+static void sah_compare_queries(BVHTree *tree, BVHTree *tree_sah, BatchTestData *data, struct RNG *rng, int queries_len)
+{
+	for (int i = 0; i < queries_len; i++) {
+		float co[3], dir[3];
+		rng_v3_round(co, 3, rng, 1000, 1.5f);
+		BLI_rng_get_float_unit_v3(rng, dir);
+
+		BVHTreeRayHit hit = {-1}, hit_sah = {-1};
+		hit.dist = hit_sah.dist = BVH_RAYCAST_DIST_MAX;
+		BLI_bvhtree_ray_cast(tree, co, dir, 0.0f, &hit, batch_raycast_cb, data);
+		BLI_bvhtree_ray_cast(tree_sah, co, dir, 0.0f, &hit_sah, batch_raycast_cb, data);
+		EXPECT_EQ(hit.dist, hit_sah.dist);
+
+		BVHTreeNearest nearest = {-1}, nearest_sah = {-1};
+		nearest.dist_sq = nearest_sah.dist_sq = FLT_MAX;
+		BLI_bvhtree_find_nearest(tree, co, &nearest, batch_nearest_cb, data);
+		BLI_bvhtree_find_nearest(tree_sah, co, &nearest_sah, batch_nearest_cb, data);
+		EXPECT_EQ(nearest.dist_sq, nearest_sah.dist_sq);
+	}
+}
+
+/**
+ * Check trees built with the surface area heuristic give the same results as the median build,
+ * also once their points moved.
+ */
+static void sah_build_test(int points_len, char tree_type, char axis, int round)
+{
+	struct RNG *rng = BLI_rng_new(points_len);
+	BatchTestData data;
+
+	data.points = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	for (int i = 0; i < points_len; i++) {
+		rng_v3_round(data.points[i], 3, rng, round, 1.0f);
+	}
+
+	BVHTree *tree = sah_test_tree_new(data.points, points_len, tree_type, axis, 0);
+	BVHTree *tree_sah = sah_test_tree_new(data.points, points_len, tree_type, axis, BVH_BUILD_SAH);
+
+	BVHTreeStats stats;
+	BLI_bvhtree_calc_stats(tree_sah, &stats);
+	EXPECT_EQ(stats.totleaf, points_len);
+	EXPECT_GE(stats.totbranch, 1);
+	EXPECT_LE(stats.totbranch, points_len > 1 ? points_len - 1 : 1);
+	EXPECT_LE(stats.depth_avg, (float)stats.depth_max);
+
+	sah_compare_queries(tree, tree_sah, &data, rng, 500);
+
+	/* Move the points, refit the trees. */
+	for (int i = 0; i < points_len; i++) {
+		mul_v3_fl(data.points[i], 0.5f);
+		data.points[i][0] += 0.25f;
+		BLI_bvhtree_update_node(tree, i, data.points[i], NULL, 1);
+		BLI_bvhtree_update_node(tree_sah, i, data.points[i], NULL, 1);
+	}
+	BLI_bvhtree_update_tree(tree);
+	BLI_bvhtree_update_tree(tree_sah);
+
+	sah_compare_queries(tree, tree_sah, &data, rng, 500);
+
+	BLI_bvhtree_free(tree);
+	BLI_bvhtree_free(tree_sah);
+	BLI_rng_free(rng);
+	MEM_freeN(data.points);
+}
+
+TEST(kdopbvh, SAH_Single)			{ sah_build_test(1, 4, 6, 1000); }
+TEST(kdopbvh, SAH_Tree2)			{ sah_build_test(5000, 2, 6, 1000); }
+TEST(kdopbvh, SAH_Tree4)			{ sah_build_test(5000, 4, 6, 1000); }
+TEST(kdopbvh, SAH_Tree8)			{ sah_build_test(5000, 8, 8, 1000); }
+TEST(kdopbvh, SAH_Tree4_Kdop26)		{ sah_build_test(5000, 4, 26, 1000); }
+/* Many points at the same place. */
+TEST(kdopbvh, SAH_Tree4_Duplicates)	{ sah_build_test(5000, 4, 6, 2); }
@@ -0,0 +1,88 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_kdtree.h"
+#include "BLI_rand.h"
+#include "BLI_threads.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Run the longest tests! */
+//#define KDTREE_RUN_BIG
+
+/* Number of neighbours for the k-nearest queries. */
+#define KDTREE_NEAREST_N 8
+
+static void rand_kdtree_tests(const unsigned int nbr, const unsigned int nbr_queries, const char *id)
+{
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * nbr, __func__);
+	float (*queries)[3] = (float (*)[3])MEM_mallocN(sizeof(*queries) * nbr_queries, __func__);
+	KDTreeNearest *nearest = (KDTreeNearest *)MEM_mallocN(
+	        sizeof(*nearest) * nbr_queries * KDTREE_NEAREST_N, __func__);
+	RNG *rng = BLI_rng_new(0);
+	KDTree *tree;
+
+	printf("\n========== STARTING %s ==========\n", id);
+
+	BLI_threadapi_init();
+
+	for (unsigned int i = 0; i < nbr; i++) {
+		BLI_rng_get_float_unit_v3(rng, points[i]);
+	}
+	for (unsigned int i = 0; i < nbr_queries; i++) {
+		BLI_rng_get_float_unit_v3(rng, queries[i]);
+	}
+	BLI_rng_free(rng);
+
+	{
+		TIMEIT_START(kdtree_build);
+		tree = BLI_kdtree_new(nbr);
+		for (unsigned int i = 0; i < nbr; i++) {
+			BLI_kdtree_insert(tree, (int)i, points[i]);
+		}
+		BLI_kdtree_balance(tree);
+		TIMEIT_END(kdtree_build);
+	}
+
+	{
+		TIMEIT_START(kdtree_find_nearest_n);
+		for (unsigned int i = 0; i < nbr_queries; i++) {
+			BLI_kdtree_find_nearest_n(tree, queries[i], &nearest[i * KDTREE_NEAREST_N], KDTREE_NEAREST_N);
+		}
+		TIMEIT_END(kdtree_find_nearest_n);
+	}
+
+	{
+		TIMEIT_START(kdtree_find_nearest_n_batch);
+		BLI_kdtree_find_nearest_n_batch(tree, queries, nbr_queries, KDTREE_NEAREST_N, nearest, NULL);
+		TIMEIT_END(kdtree_find_nearest_n_batch);
+	}
+
+	BLI_kdtree_free(tree);
+	MEM_freeN(nearest);
+	MEM_freeN(queries);
+	MEM_freeN(points);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(kdtree, RandPoints1000000)
+{
+	rand_kdtree_tests(1000000, 100000, "RandPoints - 1000000 points");
+}
+
+#ifdef KDTREE_RUN_BIG
+TEST(kdtree, RandPoints10000000)
+{
+	rand_kdtree_tests(10000000, 100000, "RandPoints - 10000000 points");
+}
+
+TEST(kdtree, RandPoints100000000)
+{
+	rand_kdtree_tests(100000000, 100000, "RandPoints - 100000000 points");
+}
+#endif
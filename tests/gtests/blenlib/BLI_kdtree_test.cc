@@ -0,0 +1,156 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_kdtree.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.h"
+#include "BLI_threads.h"
+}
+
+/* Big enough for the tree to be balanced and queried from several threads. */
+#define TESTCASE_SIZE 50000
+#define TESTCASE_QUERIES 2000
+
+static float (*rand_points(const unsigned int nbr, const unsigned int seed))[3]
+{
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * nbr, __func__);
+	RNG *rng = BLI_rng_new(seed);
+
+	for (unsigned int i = 0; i < nbr; i++) {
+		BLI_rng_get_float_unit_v3(rng, points[i]);
+		mul_v3_fl(points[i], BLI_rng_get_float(rng));
+	}
+	BLI_rng_free(rng);
+
+	return points;
+}
+
+static KDTree *rand_kdtree(float (*points)[3], const unsigned int nbr)
+{
+	KDTree *tree = BLI_kdtree_new(nbr);
+
+	for (unsigned int i = 0; i < nbr; i++) {
+		BLI_kdtree_insert(tree, (int)i, points[i]);
+	}
+	BLI_kdtree_balance(tree);
+
+	return tree;
+}
+
+static int find_nearest_brute_force(float (*points)[3], const unsigned int nbr, const float co[3])
+{
+	float dist_min = FLT_MAX;
+	int index = -1;
+
+	for (unsigned int i = 0; i < nbr; i++) {
+		const float dist = len_squared_v3v3(points[i], co);
+		if (dist < dist_min) {
+			dist_min = dist;
+			index = (int)i;
+		}
+	}
+	return index;
+}
+
+/* A tree balanced by several threads gives the same results as an exhaustive search. */
+TEST(kdtree, BalanceThreaded)
+{
+	BLI_threadapi_init();
+
+	float (*points)[3] = rand_points(TESTCASE_SIZE, 0);
+	float (*queries)[3] = rand_points(TESTCASE_QUERIES, 1);
+	KDTree *tree = rand_kdtree(points, TESTCASE_SIZE);
+	KDTreeNearest nearest;
+
+	for (unsigned int i = 0; i < TESTCASE_SIZE; i += 97) {
+		EXPECT_EQ(BLI_kdtree_find_nearest(tree, points[i], &nearest), (int)i);
+		EXPECT_EQ(nearest.dist, 0.0f);
+	}
+	for (unsigned int i = 0; i < TESTCASE_QUERIES; i++) {
+		EXPECT_EQ(BLI_kdtree_find_nearest(tree, queries[i], NULL),
+		          find_nearest_brute_force(points, TESTCASE_SIZE, queries[i]));
+	}
+
+	BLI_kdtree_free(tree);
+	MEM_freeN(queries);
+	MEM_freeN(points);
+}
+
+/* Batched queries give the same results as the single ones. */
+TEST(kdtree, FindNearestBatch)
+{
+	BLI_threadapi_init();
+
+	float (*points)[3] = rand_points(TESTCASE_SIZE, 0);
+	float (*queries)[3] = rand_points(TESTCASE_QUERIES, 1);
+	KDTree *tree = rand_kdtree(points, TESTCASE_SIZE);
+	KDTreeNearest *nearest_batch = (KDTreeNearest *)MEM_mallocN(sizeof(*nearest_batch) * TESTCASE_QUERIES, __func__);
+	KDTreeNearest nearest;
+
+	BLI_kdtree_find_nearest_batch(tree, queries, TESTCASE_QUERIES, nearest_batch);
+
+	for (unsigned int i = 0; i < TESTCASE_QUERIES; i++) {
+		EXPECT_EQ(BLI_kdtree_find_nearest(tree, queries[i], &nearest), nearest_batch[i].index);
+		EXPECT_EQ(nearest.dist, nearest_batch[i].dist);
+	}
+
+	MEM_freeN(nearest_batch);
+	BLI_kdtree_free(tree);
+	MEM_freeN(queries);
+	MEM_freeN(points);
+}
+
+TEST(kdtree, FindNearestNBatch)
+{
+	const unsigned int n = 8;
+
+	BLI_threadapi_init();
+
+	float (*points)[3] = rand_points(TESTCASE_SIZE, 0);
+	float (*queries)[3] = rand_points(TESTCASE_QUERIES, 1);
+	KDTree *tree = rand_kdtree(points, TESTCASE_SIZE);
+	KDTreeNearest *nearest_batch = (KDTreeNearest *)MEM_mallocN(sizeof(*nearest_batch) * TESTCASE_QUERIES * n, __func__);
+	int *found_batch = (int *)MEM_mallocN(sizeof(*found_batch) * TESTCASE_QUERIES, __func__);
+	KDTreeNearest nearest[n];
+
+	BLI_kdtree_find_nearest_n_batch(tree, queries, TESTCASE_QUERIES, n, nearest_batch, found_batch);
+
+	for (unsigned int i = 0; i < TESTCASE_QUERIES; i++) {
+		const int found = BLI_kdtree_find_nearest_n(tree, queries[i], nearest, n);
+		EXPECT_EQ(found, found_batch[i]);
+		for (int j = 0; j < found; j++) {
+			EXPECT_EQ(nearest[j].index, nearest_batch[i * n + j].index);
+			EXPECT_EQ(nearest[j].dist, nearest_batch[i * n + j].dist);
+		}
+	}
+
+	MEM_freeN(found_batch);
+	MEM_freeN(nearest_batch);
+	BLI_kdtree_free(tree);
+	MEM_freeN(queries);
+	MEM_freeN(points);
+}
+
+/* Less points in the tree than requested neighbours, unused results are tagged. */
+TEST(kdtree, FindNearestNBatchFew)
+{
+	float points[2][3] = {{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}};
+	float queries[1][3] = {{0.1f, 0.0f, 0.0f}};
+	KDTree *tree = rand_kdtree(points, 2);
+	KDTreeNearest nearest_batch[4];
+	int found;
+
+	BLI_kdtree_find_nearest_n_batch(tree, queries, 1, 4, nearest_batch, &found);
+
+	EXPECT_EQ(found, 2);
+	EXPECT_EQ(nearest_batch[0].index, 0);
+	EXPECT_EQ(nearest_batch[1].index, 1);
+	EXPECT_EQ(nearest_batch[2].index, -1);
+	EXPECT_EQ(nearest_batch[3].index, -1);
+
+	BLI_kdtree_free(tree);
+}
@@ -0,0 +1,110 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "atomic_ops.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "MEM_guardedalloc.h"
+};
+
+#define NUM_ITEMS 100000
+
+typedef struct MempoolThreadData {
+	BLI_mempool *pool;
+	int **items;
+} MempoolThreadData;
+
+static void mempool_alloc_thread_func(void *userdata, void *UNUSED(userdata_chunk), const int iter, const int thread_id)
+{
+	MempoolThreadData *data = (MempoolThreadData *)userdata;
+	int *item = (int *)BLI_mempool_alloc_thread(data->pool, thread_id);
+
+	*item = iter;
+	data->items[iter] = item;
+}
+
+static void mempool_free_thread_func(void *userdata, void *UNUSED(userdata_chunk), const int iter, const int thread_id)
+{
+	MempoolThreadData *data = (MempoolThreadData *)userdata;
+
+	/* Mostly elements allocated by other threads. */
+	if (iter % 3 == 0) {
+		BLI_mempool_free_thread(data->pool, data->items[iter], thread_id);
+		data->items[iter] = NULL;
+	}
+}
+
+static void mempool_iter_func(void *userdata, MempoolIterData *item)
+{
+	int *value = (int *)item;
+	EXPECT_NE(*value % 3, 0);
+	atomic_add_and_fetch_uint32((uint32_t *)userdata, 1);
+}
+
+/* Allocate and free from multiple threads, iterate over the result. */
+TEST(mempool, ThreadedAllocFree)
+{
+	BLI_threadapi_init();
+
+	TaskScheduler *scheduler = BLI_task_scheduler_get();
+	const unsigned int num_threads = (unsigned int)BLI_task_scheduler_num_threads(scheduler) + 1;
+	BLI_mempool *pool = BLI_mempool_create(sizeof(int), 0, 512, BLI_MEMPOOL_ALLOW_ITER);
+	MempoolThreadData data = {pool, (int **)MEM_callocN(sizeof(int *) * NUM_ITEMS, __func__)};
+
+	/* Some elements allocated before, the first thread reuses the free ones. */
+	int *item_prev = (int *)BLI_mempool_alloc(pool);
+	*item_prev = 1;
+	BLI_mempool_free(pool, BLI_mempool_alloc(pool));
+
+	BLI_mempool_threads_begin(pool, num_threads);
+	BLI_task_parallel_range_ex(0, NUM_ITEMS, &data, NULL, 0, mempool_alloc_thread_func, true, true);
+	BLI_task_parallel_range_ex(0, NUM_ITEMS, &data, NULL, 0, mempool_free_thread_func, true, true);
+	BLI_mempool_threads_end(pool);
+
+	const int num_items_expected = 1 + NUM_ITEMS - (NUM_ITEMS + 2) / 3;
+	EXPECT_EQ(BLI_mempool_count(pool), num_items_expected);
+
+	/* All elements are unique, and found by iterating. */
+	int *values_found = (int *)MEM_callocN(sizeof(int) * NUM_ITEMS, __func__);
+	int num_items = 0;
+	BLI_mempool_iter iter;
+	BLI_mempool_iternew(pool, &iter);
+	for (int *item = (int *)BLI_mempool_iterstep(&iter); item; item = (int *)BLI_mempool_iterstep(&iter)) {
+		if (item != item_prev) {
+			ASSERT_TRUE(*item >= 0 && *item < NUM_ITEMS);
+			EXPECT_EQ(data.items[*item], item);
+			values_found[*item]++;
+		}
+		num_items++;
+	}
+	EXPECT_EQ(num_items, num_items_expected);
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		EXPECT_EQ(values_found[i], (i % 3) ? 1 : 0);
+	}
+	MEM_freeN(values_found);
+
+	/* Threaded iteration. */
+	uint32_t num_items_threaded = 0;
+	*item_prev = 2;
+	BLI_task_parallel_mempool(pool, &num_items_threaded, mempool_iter_func, true);
+	EXPECT_EQ(num_items_threaded, (uint32_t)num_items_expected);
+
+	/* Regular use again, freed elements are reused. */
+	for (int i = 0; i < NUM_ITEMS; i += 3) {
+		data.items[i] = (int *)BLI_mempool_alloc(pool);
+	}
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		BLI_mempool_free(pool, data.items[i]);
+	}
+	BLI_mempool_free(pool, item_prev);
+	EXPECT_EQ(BLI_mempool_count(pool), 0);
+
+	MEM_freeN(data.items);
+	BLI_mempool_destroy(pool);
+	BLI_threadapi_exit();
+}
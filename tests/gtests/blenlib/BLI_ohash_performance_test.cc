@@ -0,0 +1,164 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#define GHASH_INTERNAL_API
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+#include "BLI_ohash.h"
+#include "BLI_rand.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Run the longest tests! */
+//#define OHASH_RUN_BIG
+
+/* Same random integers inserted, looked up and removed from both a GHash and an OHash. */
+
+static unsigned int *randint_data(const unsigned int nbr)
+{
+	unsigned int *data = (unsigned int *)MEM_mallocN(sizeof(*data) * (size_t)nbr, __func__);
+	RNG *rng = BLI_rng_new(0);
+
+	for (unsigned int i = 0; i < nbr; i++) {
+		data[i] = BLI_rng_get_uint(rng);
+	}
+	BLI_rng_free(rng);
+
+	return data;
+}
+
+static void randint_ghash_tests(const unsigned int *data, const unsigned int nbr)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	const unsigned int *dt;
+	unsigned int i;
+
+	{
+		TIMEIT_START(ghash_insert);
+		for (i = nbr, dt = data; i--; dt++) {
+			BLI_ghash_reinsert(ghash, SET_UINT_IN_POINTER(*dt), SET_UINT_IN_POINTER(*dt), NULL, NULL);
+		}
+		TIMEIT_END(ghash_insert);
+	}
+
+	{
+		TIMEIT_START(ghash_lookup);
+		for (i = nbr, dt = data; i--; dt++) {
+			void *v = BLI_ghash_lookup(ghash, SET_UINT_IN_POINTER(*dt));
+			EXPECT_EQ(GET_UINT_FROM_POINTER(v), *dt);
+		}
+		TIMEIT_END(ghash_lookup);
+	}
+
+	{
+		TIMEIT_START(ghash_lookup_miss);
+		for (i = nbr, dt = data; i--; dt++) {
+			void *v = BLI_ghash_lookup(ghash, SET_UINT_IN_POINTER(~*dt));
+			(void)v;
+		}
+		TIMEIT_END(ghash_lookup_miss);
+	}
+
+	{
+		TIMEIT_START(ghash_remove);
+		for (i = nbr, dt = data; i--; dt++) {
+			BLI_ghash_remove(ghash, SET_UINT_IN_POINTER(*dt), NULL, NULL);
+		}
+		TIMEIT_END(ghash_remove);
+	}
+
+	EXPECT_EQ(BLI_ghash_size(ghash), 0);
+	BLI_ghash_free(ghash, NULL, NULL);
+}
+
+static void randint_ohash_tests(const unsigned int *data, const unsigned int nbr)
+{
+	OHash *ohash = BLI_ohash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	const unsigned int *dt;
+	unsigned int i;
+
+	{
+		TIMEIT_START(ohash_insert);
+		for (i = nbr, dt = data; i--; dt++) {
+			BLI_ohash_reinsert(ohash, SET_UINT_IN_POINTER(*dt), SET_UINT_IN_POINTER(*dt), NULL, NULL);
+		}
+		TIMEIT_END(ohash_insert);
+	}
+
+	printf("OHash stats (%u entries, %d slots): average probed groups %f\n",
+	       BLI_ohash_size(ohash), BLI_ohash_capacity(ohash), BLI_ohash_calc_probe_length(ohash));
+
+	{
+		TIMEIT_START(ohash_lookup);
+		for (i = nbr, dt = data; i--; dt++) {
+			void *v = BLI_ohash_lookup(ohash, SET_UINT_IN_POINTER(*dt));
+			EXPECT_EQ(GET_UINT_FROM_POINTER(v), *dt);
+		}
+		TIMEIT_END(ohash_lookup);
+	}
+
+	{
+		TIMEIT_START(ohash_lookup_miss);
+		for (i = nbr, dt = data; i--; dt++) {
+			void *v = BLI_ohash_lookup(ohash, SET_UINT_IN_POINTER(~*dt));
+			(void)v;
+		}
+		TIMEIT_END(ohash_lookup_miss);
+	}
+
+	{
+		TIMEIT_START(ohash_remove);
+		for (i = nbr, dt = data; i--; dt++) {
+			BLI_ohash_remove(ohash, SET_UINT_IN_POINTER(*dt), NULL, NULL);
+		}
+		TIMEIT_END(ohash_remove);
+	}
+
+	EXPECT_EQ(BLI_ohash_size(ohash), 0);
+	BLI_ohash_free(ohash, NULL, NULL);
+}
+
+static void randint_compare_tests(const char *id, const unsigned int nbr)
+{
+	printf("\n========== STARTING %s ==========\n", id);
+
+	unsigned int *data = randint_data(nbr);
+
+	randint_ghash_tests(data, nbr);
+	randint_ohash_tests(data, nbr);
+
+	MEM_freeN(data);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(ohash, IntRandCompare1000)
+{
+	randint_compare_tests("RandInt - GHash vs OHash - 1000", 1000);
+}
+
+TEST(ohash, IntRandCompare10000)
+{
+	randint_compare_tests("RandInt - GHash vs OHash - 10000", 10000);
+}
+
+TEST(ohash, IntRandCompare100000)
+{
+	randint_compare_tests("RandInt - GHash vs OHash - 100000", 100000);
+}
+
+TEST(ohash, IntRandCompare1000000)
+{
+	randint_compare_tests("RandInt - GHash vs OHash - 1000000", 1000000);
+}
+
+#ifdef OHASH_RUN_BIG
+TEST(ohash, IntRandCompare10000000)
+{
+	randint_compare_tests("RandInt - GHash vs OHash - 10000000", 10000000);
+}
+#endif
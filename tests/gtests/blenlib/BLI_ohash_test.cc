@@ -0,0 +1,331 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#define GHASH_INTERNAL_API
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+#include "BLI_ohash.h"
+}
+
+#define TESTCASE_SIZE 10000
+
+/* Unique keys, multiplying by an odd number is a bijection on 32 bits integers. */
+static void init_keys(unsigned int keys[TESTCASE_SIZE], const int seed)
+{
+	for (unsigned int i = 0; i < TESTCASE_SIZE; i++) {
+		keys[i] = (i + (unsigned int)seed * TESTCASE_SIZE) * 2654435761u;
+	}
+}
+
+/* Worst possible hash, every key ends in the same probe sequence. */
+static unsigned int constant_hash(const void *UNUSED(key))
+{
+	return 42;
+}
+
+/* Here we simply insert and then lookup all keys, ensuring we do get back the expected stored 'data'. */
+TEST(ohash, InsertLookup)
+{
+	OHash *ohash = BLI_ohash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 0);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ohash_insert(ohash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	EXPECT_EQ(BLI_ohash_size(ohash), TESTCASE_SIZE);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ohash_lookup(ohash, SET_UINT_IN_POINTER(*k));
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+	}
+
+	EXPECT_FALSE(BLI_ohash_haskey(ohash, SET_UINT_IN_POINTER(keys[0] + 1)));
+	EXPECT_EQ(BLI_ohash_lookup_default(ohash, SET_UINT_IN_POINTER(keys[0] + 1), SET_INT_IN_POINTER(-1)),
+	          SET_INT_IN_POINTER(-1));
+	EXPECT_TRUE(BLI_ohash_calc_probe_length(ohash) < 1.5);
+
+	BLI_ohash_free(ohash, NULL, NULL);
+}
+
+/* Here we simply insert and then remove all keys, ensuring we do get an empty, unshrinked ohash. */
+TEST(ohash, InsertRemove)
+{
+	OHash *ohash = BLI_ohash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i, capacity;
+
+	init_keys(keys, 10);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ohash_insert(ohash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	EXPECT_EQ(BLI_ohash_size(ohash), TESTCASE_SIZE);
+	capacity = BLI_ohash_capacity(ohash);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ohash_popkey(ohash, SET_UINT_IN_POINTER(*k), NULL);
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+	}
+
+	EXPECT_EQ(BLI_ohash_size(ohash), 0);
+	EXPECT_EQ(BLI_ohash_capacity(ohash), capacity);
+
+	BLI_ohash_free(ohash, NULL, NULL);
+}
+
+/* Same as above, but this time we allow ohash to shrink. */
+TEST(ohash, InsertRemoveShrink)
+{
+	OHash *ohash = BLI_ohash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i, capacity;
+
+	BLI_ohash_flag_set(ohash, GHASH_FLAG_ALLOW_SHRINK);
+	init_keys(keys, 20);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ohash_insert(ohash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	EXPECT_EQ(BLI_ohash_size(ohash), TESTCASE_SIZE);
+	capacity = BLI_ohash_capacity(ohash);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ohash_popkey(ohash, SET_UINT_IN_POINTER(*k), NULL);
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+	}
+
+	EXPECT_EQ(BLI_ohash_size(ohash), 0);
+	EXPECT_LT(BLI_ohash_capacity(ohash), capacity);
+
+	BLI_ohash_free(ohash, NULL, NULL);
+}
+
+/* Keep removing and inserting different keys, tombstones must not make the table grow forever. */
+TEST(ohash, InsertRemoveChurn)
+{
+	OHash *ohash = BLI_ohash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	unsigned int keys[TESTCASE_SIZE];
+	int i, capacity;
+
+	init_keys(keys, 30);
+
+	for (i = 0; i < TESTCASE_SIZE / 2; i++) {
+		BLI_ohash_insert(ohash, SET_UINT_IN_POINTER(keys[i]), SET_UINT_IN_POINTER(keys[i]));
+	}
+	capacity = BLI_ohash_capacity(ohash);
+
+	for (int pass = 0; pass < 10; pass++) {
+		for (i = 0; i < TESTCASE_SIZE / 2; i++) {
+			const unsigned int k_old = keys[((pass % 2) ? TESTCASE_SIZE / 2 : 0) + i];
+			const unsigned int k_new = keys[((pass % 2) ? 0 : TESTCASE_SIZE / 2) + i];
+			EXPECT_TRUE(BLI_ohash_remove(ohash, SET_UINT_IN_POINTER(k_old), NULL, NULL));
+			BLI_ohash_insert(ohash, SET_UINT_IN_POINTER(k_new), SET_UINT_IN_POINTER(k_new));
+		}
+		EXPECT_EQ(BLI_ohash_size(ohash), TESTCASE_SIZE / 2);
+		EXPECT_EQ(BLI_ohash_capacity(ohash), capacity);
+	}
+
+	for (i = 0; i < TESTCASE_SIZE / 2; i++) {
+		void *v = BLI_ohash_lookup(ohash, SET_UINT_IN_POINTER(keys[i]));
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), keys[i]);
+		EXPECT_FALSE(BLI_ohash_haskey(ohash, SET_UINT_IN_POINTER(keys[TESTCASE_SIZE / 2 + i])));
+	}
+
+	BLI_ohash_free(ohash, NULL, NULL);
+}
+
+/* All keys colliding, lookups only rely on the compare callback. */
+TEST(ohash, Collisions)
+{
+	OHash *ohash = BLI_ohash_new(constant_hash, BLI_ghashutil_intcmp, __func__);
+	unsigned int keys[TESTCASE_SIZE];
+	int i;
+
+	init_keys(keys, 40);
+
+	for (i = 0; i < 1000; i++) {
+		BLI_ohash_insert(ohash, SET_UINT_IN_POINTER(keys[i]), SET_UINT_IN_POINTER(keys[i]));
+	}
+	for (i = 0; i < 1000; i += 2) {
+		EXPECT_TRUE(BLI_ohash_remove(ohash, SET_UINT_IN_POINTER(keys[i]), NULL, NULL));
+	}
+
+	EXPECT_EQ(BLI_ohash_size(ohash), 500);
+
+	for (i = 0; i < 1000; i++) {
+		void *v = BLI_ohash_lookup(ohash, SET_UINT_IN_POINTER(keys[i]));
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), (i % 2) ? keys[i] : 0);
+	}
+
+	BLI_ohash_free(ohash, NULL, NULL);
+}
+
+/* Check ensure_p and reinsert, which replace existing entries. */
+TEST(ohash, EnsureReinsert)
+{
+	OHash *ohash = BLI_ohash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	void **val_p;
+	int i;
+
+	init_keys(keys, 50);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_FALSE(BLI_ohash_ensure_p(ohash, SET_UINT_IN_POINTER(*k), &val_p));
+		*val_p = SET_UINT_IN_POINTER(*k);
+	}
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_TRUE(BLI_ohash_ensure_p(ohash, SET_UINT_IN_POINTER(*k), &val_p));
+		EXPECT_EQ(GET_UINT_FROM_POINTER(*val_p), *k);
+		EXPECT_FALSE(BLI_ohash_reinsert(ohash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k + 1), NULL, NULL));
+	}
+
+	EXPECT_EQ(BLI_ohash_size(ohash), TESTCASE_SIZE);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void **v = BLI_ohash_lookup_p(ohash, SET_UINT_IN_POINTER(*k));
+		EXPECT_EQ(GET_UINT_FROM_POINTER(*v), *k + 1);
+	}
+
+	BLI_ohash_free(ohash, NULL, NULL);
+}
+
+/* Iterate over all entries, and pop them all. */
+TEST(ohash, IterPop)
+{
+	OHash *ohash = BLI_ohash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	OHashIterator ohi;
+	OHashIterState pop_state = {0};
+	unsigned int keys[TESTCASE_SIZE], *k;
+	unsigned int sum = 0, sum_iter = 0, sum_pop = 0;
+	void *key, *val;
+	int i;
+
+	init_keys(keys, 60);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ohash_insert(ohash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+		sum += *k;
+	}
+
+	i = 0;
+	OHASH_ITER (ohi, ohash) {
+		EXPECT_EQ(BLI_ohashIterator_getKey(&ohi), BLI_ohashIterator_getValue(&ohi));
+		sum_iter += GET_UINT_FROM_POINTER(BLI_ohashIterator_getKey(&ohi));
+		i++;
+	}
+	EXPECT_EQ(i, TESTCASE_SIZE);
+	EXPECT_EQ(sum_iter, sum);
+
+	i = 0;
+	while (BLI_ohash_pop(ohash, &pop_state, &key, &val)) {
+		EXPECT_EQ(key, val);
+		sum_pop += GET_UINT_FROM_POINTER(key);
+		i++;
+	}
+	EXPECT_EQ(i, TESTCASE_SIZE);
+	EXPECT_EQ(sum_pop, sum);
+	EXPECT_EQ(BLI_ohash_size(ohash), 0);
+
+	BLI_ohash_free(ohash, NULL, NULL);
+}
+
+/* Check copy is identical. */
+TEST(ohash, Copy)
+{
+	OHash *ohash = BLI_ohash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	OHash *ohash_copy;
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 70);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ohash_insert(ohash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	ohash_copy = BLI_ohash_copy(ohash, NULL, NULL);
+
+	EXPECT_EQ(BLI_ohash_size(ohash_copy), TESTCASE_SIZE);
+	EXPECT_EQ(BLI_ohash_capacity(ohash_copy), BLI_ohash_capacity(ohash));
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ohash_lookup(ohash_copy, SET_UINT_IN_POINTER(*k));
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+	}
+
+	BLI_ohash_free(ohash, NULL, NULL);
+	BLI_ohash_free(ohash_copy, NULL, NULL);
+}
+
+/* Set API. */
+TEST(ohash, OSet)
+{
+	OSet *oset = BLI_oset_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	OSetIterator osi;
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 80);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_TRUE(BLI_oset_add(oset, SET_UINT_IN_POINTER(*k)));
+	}
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_FALSE(BLI_oset_add(oset, SET_UINT_IN_POINTER(*k)));
+		EXPECT_TRUE(BLI_oset_haskey(oset, SET_UINT_IN_POINTER(*k)));
+	}
+
+	EXPECT_EQ(BLI_oset_size(oset), TESTCASE_SIZE);
+
+	i = 0;
+	OSET_ITER (osi, oset) {
+		i++;
+	}
+	EXPECT_EQ(i, TESTCASE_SIZE);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_TRUE(BLI_oset_remove(oset, SET_UINT_IN_POINTER(*k), NULL));
+	}
+	EXPECT_EQ(BLI_oset_size(oset), 0);
+
+	BLI_oset_free(oset, NULL);
+}
+
+/* Code using the GHash API, switched to OHash by the compatibility header. */
+#include "BLI_ohash_compat.h"
+
+TEST(ohash, Compat)
+{
+	GHash *ghash = BLI_ghash_int_new(__func__);
+	GHashIterator ghi;
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 90);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	/* Would not compile if the compatibility header did not map to OHash. */
+	EXPECT_EQ(BLI_ohash_size(ghash), TESTCASE_SIZE);
+
+	i = 0;
+	GHASH_ITER (ghi, ghash) {
+		EXPECT_EQ(BLI_ghashIterator_getKey(&ghi), BLI_ghashIterator_getValue(&ghi));
+		i++;
+	}
+	EXPECT_EQ(i, TESTCASE_SIZE);
+
+	BLI_ghash_free(ghash, NULL, NULL);
+}
@@ -0,0 +1,202 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "atomic_ops.h"
+
+extern "C" {
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+
+#include "PIL_time_utildefines.h"
+}
+
+/* Number of children pushed by every task of the tree. */
+#define TREE_BRANCHING 4
+/* Depth of the task trees, every tree has (4^8 - 1) / 3 = 21845 tasks. */
+#define TREE_DEPTH 8
+/* Number of tiny tasks pushed from the main thread. */
+#define NUM_FLAT_TASKS 100000
+/* Number of nested pools created from within tasks. */
+#define NUM_NESTED_POOLS 64
+
+typedef struct TaskStressData {
+	uint32_t num_tasks_run;
+	TaskScheduler *scheduler;
+} TaskStressData;
+
+static int tree_num_tasks(int depth)
+{
+	int num_tasks = 0, num_level = 1;
+	for (int i = 0; i <= depth; i++) {
+		num_tasks += num_level;
+		num_level *= TREE_BRANCHING;
+	}
+	return num_tasks;
+}
+
+/* Similar to how depsgraph schedules children of evaluated nodes: every task
+ * pushes new tasks from its worker thread. */
+static void task_tree_func(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+	TaskStressData *data = (TaskStressData *)BLI_task_pool_userdata(pool);
+	const int depth = GET_INT_FROM_POINTER(taskdata);
+
+	atomic_add_and_fetch_uint32(&data->num_tasks_run, 1);
+
+	if (depth == 0) {
+		return;
+	}
+	for (int i = 0; i < TREE_BRANCHING; i++) {
+		BLI_task_pool_push_from_thread(pool,
+		                               task_tree_func,
+		                               SET_INT_IN_POINTER(depth - 1),
+		                               false,
+		                               TASK_PRIORITY_HIGH,
+		                               threadid);
+	}
+}
+
+static void task_flat_func(TaskPool *__restrict pool, void *UNUSED(taskdata), int UNUSED(threadid))
+{
+	TaskStressData *data = (TaskStressData *)BLI_task_pool_userdata(pool);
+	atomic_add_and_fetch_uint32(&data->num_tasks_run, 1);
+}
+
+/* Tasks which create and wait for their own pools, as done by parallel
+ * evaluation of modifiers and such. */
+static void task_nested_func(TaskPool *__restrict pool, void *UNUSED(taskdata), int threadid)
+{
+	TaskStressData *data = (TaskStressData *)BLI_task_pool_userdata(pool);
+	TaskPool *nested_pool = BLI_task_pool_create(data->scheduler, data);
+
+	for (int i = 0; i < TREE_BRANCHING; i++) {
+		BLI_task_pool_push_from_thread(nested_pool,
+		                               task_tree_func,
+		                               SET_INT_IN_POINTER(3),
+		                               false,
+		                               TASK_PRIORITY_HIGH,
+		                               threadid);
+	}
+	BLI_task_pool_work_and_wait(nested_pool);
+	BLI_task_pool_free(nested_pool);
+}
+
+static void task_stress_tree(TaskScheduler *scheduler, const char *id)
+{
+	TaskStressData data = {0, scheduler};
+	TaskPool *pool = BLI_task_pool_create(scheduler, &data);
+
+	printf("\n========== STARTING %s ==========\n", id);
+
+	TIMEIT_START(task_tree);
+	for (int i = 0; i < TREE_BRANCHING; i++) {
+		BLI_task_pool_push(pool, task_tree_func, SET_INT_IN_POINTER(TREE_DEPTH - 1), false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_work_and_wait(pool);
+	TIMEIT_END(task_tree);
+
+	EXPECT_EQ(data.num_tasks_run, (uint32_t)(TREE_BRANCHING * tree_num_tasks(TREE_DEPTH - 1)));
+
+	BLI_task_pool_free(pool);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+static void task_stress_flat(TaskScheduler *scheduler, const char *id)
+{
+	TaskStressData data = {0, scheduler};
+	TaskPool *pool = BLI_task_pool_create(scheduler, &data);
+
+	printf("\n========== STARTING %s ==========\n", id);
+
+	TIMEIT_START(task_flat);
+	for (int i = 0; i < NUM_FLAT_TASKS; i++) {
+		BLI_task_pool_push(pool, task_flat_func, NULL, false, TASK_PRIORITY_LOW);
+	}
+	BLI_task_pool_work_and_wait(pool);
+	TIMEIT_END(task_flat);
+
+	EXPECT_EQ(data.num_tasks_run, (uint32_t)(NUM_FLAT_TASKS));
+
+	BLI_task_pool_free(pool);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+static void task_stress_nested(TaskScheduler *scheduler, const char *id)
+{
+	TaskStressData data = {0, scheduler};
+	TaskPool *pool = BLI_task_pool_create(scheduler, &data);
+
+	printf("\n========== STARTING %s ==========\n", id);
+
+	TIMEIT_START(task_nested);
+	for (int i = 0; i < NUM_NESTED_POOLS; i++) {
+		BLI_task_pool_push(pool, task_nested_func, NULL, false, TASK_PRIORITY_LOW);
+	}
+	BLI_task_pool_work_and_wait(pool);
+	TIMEIT_END(task_nested);
+
+	EXPECT_EQ(data.num_tasks_run, (uint32_t)(NUM_NESTED_POOLS * TREE_BRANCHING * tree_num_tasks(3)));
+
+	BLI_task_pool_free(pool);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+static void task_stress_cancel(TaskScheduler *scheduler)
+{
+	TaskStressData data = {0, scheduler};
+	TaskPool *pool = BLI_task_pool_create(scheduler, &data);
+
+	for (int i = 0; i < TREE_BRANCHING; i++) {
+		BLI_task_pool_push(pool, task_tree_func, SET_INT_IN_POINTER(TREE_DEPTH - 1), false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_cancel(pool);
+
+	EXPECT_LE(data.num_tasks_run, (uint32_t)(TREE_BRANCHING * tree_num_tasks(TREE_DEPTH - 1)));
+
+	BLI_task_pool_free(pool);
+}
+
+TEST(task, StressTree)
+{
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(0);
+	for (int i = 0; i < 5; i++) {
+		task_stress_tree(scheduler, "Task tree pushed from worker threads");
+	}
+	BLI_task_scheduler_free(scheduler);
+}
+
+TEST(task, StressFlat)
+{
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(0);
+	for (int i = 0; i < 5; i++) {
+		task_stress_flat(scheduler, "Tiny tasks pushed from main thread");
+	}
+	BLI_task_scheduler_free(scheduler);
+}
+
+TEST(task, StressNested)
+{
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(0);
+	for (int i = 0; i < 5; i++) {
+		task_stress_nested(scheduler, "Nested pools waited from worker threads");
+	}
+	BLI_task_scheduler_free(scheduler);
+}
+
+TEST(task, StressCancel)
+{
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(0);
+	for (int i = 0; i < 100; i++) {
+		task_stress_cancel(scheduler);
+	}
+	BLI_task_scheduler_free(scheduler);
+}
@@ -9,6 +9,7 @@ extern "C" {
 #include "BLI_mempool.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
+#include "PIL_time.h"
 };
 
 #define NUM_ITEMS 10000
@@ -74,3 +75,53 @@ TEST(task, MempoolIter)
 
 	BLI_mempool_destroy(mempool);
 }
+
+#define NUM_DELAYED_PARENTS 16
+#define NUM_DELAYED_CHILDREN 64
+
+typedef struct DelayedPushData {
+	uint32_t num_children_run;
+	uint32_t num_children_run_early;
+} DelayedPushData;
+
+static void task_delayed_child_func(TaskPool *__restrict UNUSED(pool), void *taskdata, int UNUSED(threadid))
+{
+	DelayedPushData *data = (DelayedPushData *)taskdata;
+	atomic_add_and_fetch_uint32(&data->num_children_run, 1);
+}
+
+static void task_delayed_parent_func(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+	DelayedPushData *data = (DelayedPushData *)taskdata;
+
+	BLI_task_pool_delayed_push_begin(pool, threadid);
+	for (int i = 0; i < NUM_DELAYED_CHILDREN; i++) {
+		BLI_task_pool_push_from_thread(pool, task_delayed_child_func, data, false, TASK_PRIORITY_HIGH, threadid);
+	}
+	/* Give other threads time to take the tasks, if they could. */
+	PIL_sleep_ms(5);
+	atomic_add_and_fetch_uint32(&data->num_children_run_early, atomic_add_and_fetch_uint32(&data->num_children_run, 0));
+	BLI_task_pool_delayed_push_end(pool, threadid);
+}
+
+/* Tasks pushed in delayed push mode, also from worker threads, only run
+ * once the delayed push ended. */
+TEST(task, DelayedPushFromThread)
+{
+	TaskScheduler *scheduler = BLI_task_scheduler_create(4);
+	TaskPool *pool = BLI_task_pool_create(scheduler, NULL);
+	DelayedPushData data[NUM_DELAYED_PARENTS] = {{0}};
+
+	for (int i = 0; i < NUM_DELAYED_PARENTS; i++) {
+		BLI_task_pool_push(pool, task_delayed_parent_func, &data[i], false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_work_and_wait(pool);
+
+	for (int i = 0; i < NUM_DELAYED_PARENTS; i++) {
+		EXPECT_EQ(data[i].num_children_run, NUM_DELAYED_CHILDREN);
+		EXPECT_EQ(data[i].num_children_run_early, 0);
+	}
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+}
@@ -0,0 +1,124 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "BLI_utildefines.h"
+}
+
+#include "MEM_guardedalloc.h"
+
+#define NUM_THREADS 8
+#define NUM_BLOCKS 10000
+
+namespace {
+
+size_t BlockLen(const int i)
+{
+	return (i % 100 == 0) ? 4096 + (size_t)i : (size_t)(i % 600);
+}
+
+/* Allocate blocks of all small sizes and a few larger ones, filled with their index. */
+void AllocBlocks(std::vector<char *> &blocks, const int offset)
+{
+	for (int i = 0; i < NUM_BLOCKS; i++) {
+		const size_t len = BlockLen(i);
+		char *block = (char *)((i % 2) ? MEM_callocN(len, __func__) : MEM_mallocN(len, __func__));
+
+		if (i % 2) {
+			for (size_t j = 0; j < len; j++) {
+				EXPECT_EQ(block[j], 0);
+			}
+		}
+		EXPECT_GE(MEM_allocN_len(block), len);
+		EXPECT_LT(MEM_allocN_len(block), len + 4);
+		memset(block, (char)(i + offset), len);
+		blocks.push_back(block);
+	}
+}
+
+void FreeBlocks(std::vector<char *> &blocks, const int offset)
+{
+	for (int i = 0; i < (int)blocks.size(); i++) {
+		const size_t len = BlockLen(i);
+		if (len) {
+			EXPECT_EQ(blocks[i][len - 1], (char)(i + offset));
+		}
+		MEM_freeN(blocks[i]);
+	}
+	blocks.clear();
+}
+
+}  // namespace
+
+TEST(guardedalloc, ThreadCacheAllocFree)
+{
+	MEM_use_thread_cache();
+
+	const unsigned int totblock = MEM_get_memory_blocks_in_use();
+	const size_t mem_in_use = MEM_get_memory_in_use();
+	std::vector<char *> blocks;
+
+	/* Second round reuses the cached blocks. */
+	for (int round = 0; round < 2; round++) {
+		AllocBlocks(blocks, round);
+		EXPECT_EQ(MEM_get_memory_blocks_in_use(), totblock + NUM_BLOCKS);
+		FreeBlocks(blocks, round);
+		EXPECT_EQ(MEM_get_memory_blocks_in_use(), totblock);
+		EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use);
+	}
+
+	/* Reallocation keeps the content. */
+	char *block = (char *)MEM_mallocN(10, __func__);
+	memset(block, 1, 10);
+	block = (char *)MEM_reallocN(block, 300);
+	EXPECT_EQ(block[9], 1);
+	block = (char *)MEM_recallocN(block, 5000);
+	EXPECT_EQ(block[9], 1);
+	EXPECT_EQ(block[4999], 0);
+	MEM_freeN(block);
+}
+
+/* Blocks allocated by a thread are freed by another one, and threads exit with cached blocks. */
+TEST(guardedalloc, ThreadCacheThreaded)
+{
+	MEM_use_thread_cache();
+
+	const unsigned int totblock = MEM_get_memory_blocks_in_use();
+	std::vector<char *> blocks[NUM_THREADS];
+
+	for (int round = 0; round < 3; round++) {
+		std::vector<std::thread> threads;
+
+		for (int i = 0; i < NUM_THREADS; i++) {
+			threads.push_back(std::thread([&blocks, i, round]() {
+				if (round > 0) {
+					FreeBlocks(blocks[(i + 1) % NUM_THREADS], round - 1);
+				}
+			}));
+		}
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+		threads.clear();
+
+		for (int i = 0; i < NUM_THREADS; i++) {
+			threads.push_back(std::thread([&blocks, i, round]() {
+				AllocBlocks(blocks[i], round);
+			}));
+		}
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+
+		EXPECT_EQ(MEM_get_memory_blocks_in_use(), totblock + NUM_THREADS * NUM_BLOCKS);
+	}
+
+	for (int i = 0; i < NUM_THREADS; i++) {
+		FreeBlocks(blocks[i], 2);
+	}
+	EXPECT_EQ(MEM_get_memory_blocks_in_use(), totblock);
+}
@@ -0,0 +1,160 @@
+# Apache License, Version 2.0
+
+# ./blender.bin --background -noaudio --factory-startup --python tests/python/bl_blendfile_io.py -- --verbose
+import os
+import tempfile
+import unittest
+
+import bmesh
+import bpy
+
+
+COMPRESSION_MODES = (
+    ("none", dict(compress=False)),
+    ("gzip", dict(compress=True)),
+    ("lzo", dict(compress=True, compress_fast=True)),
+)
+
+
+class TestHelper:
+
+    def setUp(self):
+        self._tempdir = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        self._tempdir.cleanup()
+
+    def filepath(self, name):
+        return os.path.join(self._tempdir.name, name + ".blend")
+
+    def save(self, name, use_async, **kwargs):
+        filepath = self.filepath(name)
+        # 'async' is a keyword in newer Python versions
+        kwargs["async"] = use_async
+        self.assertEqual(bpy.ops.wm.save_as_mainfile(filepath=filepath, copy=True, **kwargs), {'FINISHED'})
+        self.assertTrue(os.path.exists(filepath))
+        # no temporary file is left behind
+        self.assertFalse(os.path.exists(filepath + "@"))
+        with open(filepath, "rb") as fh:
+            return fh.read()
+
+
+class TestBlendFileSaveAsync(TestHelper, unittest.TestCase):
+
+    def setUp(self):
+        super().setUp()
+        mesh = bpy.data.meshes.new("TestMesh")
+        mesh.from_pydata([(0, 0, 0), (1, 0, 0), (1, 1, 0), (0, 1, 0)], [], [(0, 1, 2, 3)])
+        mesh.use_fake_user = True
+
+    def tearDown(self):
+        bpy.data.meshes.remove(bpy.data.meshes["TestMesh"])
+        super().tearDown()
+
+    def test_same_bytes(self):
+        # the file written in memory holds exactly what a regular save writes
+        for mode, kwargs in COMPRESSION_MODES:
+            with self.subTest(mode=mode):
+                data_sync = self.save("sync_" + mode, use_async=False, **kwargs)
+                data_async = self.save("async_" + mode, use_async=True, **kwargs)
+                self.assertGreater(len(data_sync), 0)
+                self.assertEqual(data_sync, data_async)
+
+    def test_overwrite(self):
+        # replacing an existing file goes through the same temporary file
+        self.save("overwrite", use_async=False)
+        data = self.save("overwrite", use_async=True)
+        self.assertEqual(data, self.save("reference", use_async=False))
+
+
+class TestBlendFileCompression(TestHelper, unittest.TestCase):
+
+    def setUp(self):
+        super().setUp()
+        # several MB of mesh data, so LZO compressed files consist of multiple chunks,
+        # with random-ish coordinates that don't compress too well
+        mesh = bpy.data.meshes.new("Grid")
+        mesh.use_fake_user = True
+        bm = bmesh.new()
+        bmesh.ops.create_grid(bm, x_segments=256, y_segments=256, size=1.0)
+        for v in bm.verts:
+            v.co.z = ((v.index * 2654435761) % 1000) / 1000.0
+        bm.to_mesh(mesh)
+        bm.free()
+
+    def tearDown(self):
+        bpy.ops.wm.read_factory_settings()
+        super().tearDown()
+
+    @staticmethod
+    def mesh_data():
+        mesh = bpy.data.meshes["Grid"]
+        co = [0.0] * (len(mesh.vertices) * 3)
+        mesh.vertices.foreach_get("co", co)
+        loops = [0] * len(mesh.loops)
+        mesh.loops.foreach_get("vertex_index", loops)
+        return co, loops
+
+    def test_round_trip(self):
+        co, loops = self.mesh_data()
+        sizes = {}
+
+        for mode, kwargs in COMPRESSION_MODES:
+            with self.subTest(mode=mode):
+                sizes[mode] = len(self.save(mode, use_async=False, **kwargs))
+                self.assertEqual(bpy.ops.wm.open_mainfile(filepath=self.filepath(mode), load_ui=False),
+                                 {'FINISHED'})
+                co_loaded, loops_loaded = self.mesh_data()
+                self.assertEqual(co, co_loaded)
+                self.assertEqual(loops, loops_loaded)
+
+        self.assertLess(sizes["gzip"], sizes["none"])
+        self.assertLess(sizes["lzo"], sizes["none"])
+
+
+class TestBlendFileIDPointers(TestHelper, unittest.TestCase):
+    # more IDs than the initial size of the old to new address maps, so they grow while reading
+    NUM_OBJECTS = 3000
+
+    def setUp(self):
+        super().setUp()
+        # empties parented in a chain, and objects sharing meshes, every pointer has to be remapped
+        meshes = [bpy.data.meshes.new("Mesh%d" % i) for i in range(3)]
+        ob_parent = None
+        for i in range(self.NUM_OBJECTS):
+            ob = bpy.data.objects.new("Ob%05d" % i, meshes[i % len(meshes)] if i % 2 else None)
+            ob.use_fake_user = True
+            ob.parent = ob_parent
+            ob_parent = ob
+
+    def tearDown(self):
+        bpy.ops.wm.read_factory_settings()
+        super().tearDown()
+
+    def test_pointers(self):
+        filepath = self.filepath("pointers")
+        self.save("pointers", use_async=False)
+        self.assertEqual(bpy.ops.wm.open_mainfile(filepath=filepath, load_ui=False), {'FINISHED'})
+
+        obs = [ob for ob in bpy.data.objects if ob.name.startswith("Ob")]
+        self.assertEqual(len(obs), self.NUM_OBJECTS)
+        for ob in obs:
+            i = int(ob.name[2:])
+            if i == 0:
+                self.assertIsNone(ob.parent)
+            else:
+                self.assertEqual(ob.parent.name, "Ob%05d" % (i - 1))
+            if i % 2:
+                self.assertEqual(ob.data.name, "Mesh%d" % (i % 3))
+            else:
+                self.assertIsNone(ob.data)
+
+        # shared data is read once
+        for mesh in (bpy.data.meshes["Mesh%d" % i] for i in range(3)):
+            self.assertEqual(mesh.users, len([ob for ob in obs if ob.data == mesh]))
+
+
+if __name__ == '__main__':
+    import sys
+    sys.argv = [__file__] + (sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else [])
+    unittest.main()
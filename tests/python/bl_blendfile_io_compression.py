@@ -0,0 +1,86 @@
+# Apache License, Version 2.0
+
+# Benchmark saving and loading a .blend file without compression, with gzip and with fast (LZO) compression.
+#
+# ./blender.bin --background -noaudio --factory-startup \
+#     --python tests/python/bl_blendfile_io_compression.py -- --subdivisions=10
+
+import os
+import sys
+import tempfile
+import time
+
+import bmesh
+import bpy
+
+
+COMPRESSION_MODES = (
+    ("none", dict(compress=False)),
+    ("gzip", dict(compress=True)),
+    ("lzo", dict(compress=True, compress_fast=True)),
+)
+
+
+def create_meshes(subdivisions):
+    for i in range(4):
+        mesh = bpy.data.meshes.new("Grid%d" % i)
+        mesh.use_fake_user = True
+        # grid of (2 ^ subdivisions) ^ 2 quads, with random-ish coordinates so it doesn't compress too well
+        bm = bmesh.new()
+        bmesh.ops.create_grid(bm, x_segments=1 << subdivisions, y_segments=1 << subdivisions, size=1.0)
+        for v in bm.verts:
+            v.co.z = ((v.index * 2654435761) % 1000) / 1000.0
+        bm.to_mesh(mesh)
+        bm.free()
+
+
+def main():
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    subdivisions = 10
+    for arg in argv:
+        if arg.startswith("--subdivisions="):
+            subdivisions = int(arg[len("--subdivisions="):])
+
+    create_meshes(subdivisions)
+    num_verts = sum(len(mesh.vertices) for mesh in bpy.data.meshes if mesh.name.startswith("Grid"))
+
+    filepath_raw = None
+    size_raw = 0
+
+    for mode, kwargs in COMPRESSION_MODES:
+        filepath = os.path.join(tempfile.gettempdir(), "blendfile_io_compression_%s.blend" % mode)
+
+        t = time.time()
+        bpy.ops.wm.save_as_mainfile(filepath=filepath, copy=True, **kwargs)
+        time_save = time.time() - t
+        size = os.path.getsize(filepath)
+        if mode == "none":
+            filepath_raw = filepath
+            size_raw = size
+
+        t = time.time()
+        bpy.ops.wm.open_mainfile(filepath=filepath, load_ui=False)
+        time_load = time.time() - t
+
+        num_verts_loaded = sum(len(mesh.vertices) for mesh in bpy.data.meshes if mesh.name.startswith("Grid"))
+        assert num_verts_loaded == num_verts, "%s: expected %d vertices, found %d" % (mode, num_verts, num_verts_loaded)
+
+        # throughput of the uncompressed data
+        print("%-5s %8.1f MB (%5.1f%%), save %7.3fs (%7.1f MB/s), load %7.3fs (%7.1f MB/s)" % (
+            mode, size / 1e6, 100.0 * size / size_raw,
+            time_save, size_raw / 1e6 / time_save,
+            time_load, size_raw / 1e6 / time_load))
+
+        if filepath != filepath_raw:
+            os.remove(filepath)
+
+    os.remove(filepath_raw)
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except:
+        import traceback
+        traceback.print_exc()
+        sys.exit(1)
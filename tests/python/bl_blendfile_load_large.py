@@ -0,0 +1,73 @@
+# Apache License, Version 2.0
+
+# Benchmark loading a synthetic .blend file with many IDs pointing to each other.
+#
+# ./blender.bin --background -noaudio --factory-startup --debug-fileload \
+#     --python tests/python/bl_blendfile_load_large.py -- --ids=100000
+#
+# --debug-fileload prints the time spent in each step of reading the file,
+# and the lookup statistics of the old to new pointer maps.
+
+import os
+import sys
+import tempfile
+import time
+
+import bpy
+
+
+def create_objects(num_ids):
+    # Empties parented in a chain, every object points to another ID which has to be remapped.
+    ob_parent = None
+    for i in range(num_ids):
+        ob = bpy.data.objects.new("Ob%06d" % i, None)
+        ob.use_fake_user = True
+        ob.parent = ob_parent
+        ob_parent = ob
+
+
+def check_objects(num_ids):
+    obs = [ob for ob in bpy.data.objects if ob.name.startswith("Ob")]
+    assert len(obs) == num_ids, "expected %d objects, found %d" % (num_ids, len(obs))
+
+    for ob in obs:
+        i = int(ob.name[2:])
+        if i == 0:
+            assert ob.parent is None
+        else:
+            assert ob.parent is not None and ob.parent.name == "Ob%06d" % (i - 1), "wrong parent of " + ob.name
+
+
+def main():
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    num_ids = 100000
+    for arg in argv:
+        if arg.startswith("--ids="):
+            num_ids = int(arg[len("--ids="):])
+
+    filepath = os.path.join(tempfile.gettempdir(), "blendfile_load_large.blend")
+
+    t = time.time()
+    create_objects(num_ids)
+    print("Created %d objects in %.3fs" % (num_ids, time.time() - t))
+
+    t = time.time()
+    bpy.ops.wm.save_as_mainfile(filepath=filepath, compress=False)
+    print("Saved in %.3fs" % (time.time() - t))
+
+    t = time.time()
+    bpy.ops.wm.open_mainfile(filepath=filepath, load_ui=False)
+    print("Loaded in %.3fs" % (time.time() - t))
+
+    check_objects(num_ids)
+
+    os.remove(filepath)
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except:
+        import traceback
+        traceback.print_exc()
+        sys.exit(1)
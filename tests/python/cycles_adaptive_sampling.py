@@ -0,0 +1,116 @@
+# Apache License, Version 2.0
+
+# ./blender.bin --background -noaudio --factory-startup --python tests/python/cycles_adaptive_sampling.py -- --verbose
+#
+# Render a glossy sphere in front of a uniform world with and without adaptive sampling.
+# Stopping pixels early must not change the converged image, only its noise.
+
+import math
+import os
+import tempfile
+import unittest
+
+import bmesh
+import bpy
+
+
+def create_scene():
+    scene = bpy.context.scene
+    for ob in list(bpy.data.objects):
+        bpy.data.objects.remove(ob)
+
+    world = bpy.data.worlds.new("World")
+    world.use_nodes = True
+    world.node_tree.nodes["Background"].inputs["Color"].default_value = (0.5, 0.5, 0.5, 1.0)
+    scene.world = world
+
+    mat = bpy.data.materials.new("Glossy")
+    mat.use_nodes = True
+    nodes = mat.node_tree.nodes
+    shader = nodes.new("ShaderNodeBsdfGlossy")
+    shader.inputs["Roughness"].default_value = 0.3
+    mat.node_tree.links.new(shader.outputs[0], nodes["Material Output"].inputs["Surface"])
+
+    mesh = bpy.data.meshes.new("Sphere")
+    bm = bmesh.new()
+    bmesh.ops.create_uvsphere(bm, u_segments=32, v_segments=16, diameter=1.0)
+    bm.to_mesh(mesh)
+    bm.free()
+    mesh.materials.append(mat)
+    scene.master_collection.objects.link(bpy.data.objects.new("Sphere", mesh))
+
+    lamp = bpy.data.lamps.new("Sun", 'SUN')
+    lamp.shadow_soft_size = 0.2
+    ob = bpy.data.objects.new("Sun", lamp)
+    ob.rotation_euler = (math.radians(40.0), 0.0, math.radians(30.0))
+    scene.master_collection.objects.link(ob)
+
+    camera = bpy.data.objects.new("Camera", bpy.data.cameras.new("Camera"))
+    camera.location = (0.0, -6.0, 0.0)
+    camera.rotation_euler = (math.radians(90.0), 0.0, 0.0)
+    scene.master_collection.objects.link(camera)
+    scene.camera = camera
+
+    scene.render.engine = 'CYCLES'
+    scene.render.resolution_x = 64
+    scene.render.resolution_y = 48
+    scene.render.resolution_percentage = 100
+    scene.render.tile_x = 16
+    scene.render.tile_y = 16
+    scene.render.image_settings.file_format = 'OPEN_EXR'
+    scene.cycles.device = 'CPU'
+    scene.cycles.progressive = 'PATH'
+    scene.cycles.samples = 128
+    scene.cycles.adaptive_threshold = 0.01
+
+
+class AdaptiveSamplingTest(unittest.TestCase):
+
+    def setUp(self):
+        self._tempdir = tempfile.TemporaryDirectory()
+        create_scene()
+
+    def tearDown(self):
+        bpy.ops.wm.read_factory_settings()
+        self._tempdir.cleanup()
+
+    def render(self, use_adaptive_sampling):
+        scene = bpy.context.scene
+        scene.cycles.use_adaptive_sampling = use_adaptive_sampling
+        scene.render.filepath = os.path.join(self._tempdir.name, "render_%d.exr" % use_adaptive_sampling)
+
+        bpy.ops.render.render(write_still=True)
+
+        image = bpy.data.images.load(scene.render.filepath)
+        pixels = image.pixels[:]
+        bpy.data.images.remove(image)
+        # alpha is ignored
+        return [pixels[i] + pixels[i + 1] + pixels[i + 2] for i in range(0, len(pixels), 4)]
+
+    def compare(self):
+        values_fixed = self.render(False)
+        values_adaptive = self.render(True)
+
+        self.assertEqual(len(values_fixed), len(values_adaptive))
+        # pixels that stopped early are still normalized by their own number of samples
+        for value in values_adaptive:
+            self.assertTrue(math.isfinite(value))
+            self.assertGreaterEqual(value, 0.0)
+        mean_fixed = sum(values_fixed) / len(values_fixed)
+        mean_adaptive = sum(values_adaptive) / len(values_adaptive)
+        self.assertGreater(mean_fixed, 0.1)
+        self.assertAlmostEqual(mean_adaptive, mean_fixed, delta=0.02 * mean_fixed)
+
+    def test_mean(self):
+        self.compare()
+
+    def test_mean_denoised(self):
+        # the denoiser reads the variance passes of pixels that stopped early
+        bpy.context.scene.view_layers.active.cycles.use_denoising = True
+        self.compare()
+
+
+if __name__ == '__main__':
+    import sys
+    sys.argv = [__file__] + (sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else [])
+    unittest.main()
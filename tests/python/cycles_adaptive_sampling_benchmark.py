@@ -0,0 +1,140 @@
+# Apache License, Version 2.0
+
+# Benchmark render time and noise of Cycles with and without adaptive sampling.
+#
+# ./blender.bin --background -noaudio --factory-startup \
+#     --python tests/python/cycles_adaptive_sampling_benchmark.py -- --samples=256 --threshold=0.01
+#
+# The scene is a small glossy sphere lit by a sun lamp in front of a uniform world, so most
+# of the image converges after few samples. Noise is estimated from two renders with
+# different seeds.
+#
+# With --denoise the render layer is denoised too, which reads the variance passes of pixels
+# that stopped early.
+
+import math
+import os
+import sys
+import tempfile
+import time
+
+import bpy
+
+
+def create_scene():
+    scene = bpy.context.scene
+    for ob in list(bpy.data.objects):
+        bpy.data.objects.remove(ob)
+
+    world = bpy.data.worlds.new("World")
+    world.use_nodes = True
+    world.node_tree.nodes["Background"].inputs["Color"].default_value = (0.5, 0.5, 0.5, 1.0)
+    scene.world = world
+
+    mat = bpy.data.materials.new("Glossy")
+    mat.use_nodes = True
+    nodes = mat.node_tree.nodes
+    shader = nodes.new("ShaderNodeBsdfGlossy")
+    shader.inputs["Roughness"].default_value = 0.3
+    mat.node_tree.links.new(shader.outputs[0], nodes["Material Output"].inputs["Surface"])
+
+    bpy.ops.mesh.primitive_uv_sphere_add(segments=64, ring_count=32, size=1.0)
+    sphere = bpy.context.object
+    sphere.data.materials.append(mat)
+
+    lamp = bpy.data.lamps.new("Sun", 'SUN')
+    lamp.shadow_soft_size = 0.2
+    ob = bpy.data.objects.new("Sun", lamp)
+    ob.rotation_euler = (math.radians(40.0), 0.0, math.radians(30.0))
+    scene.master_collection.objects.link(ob)
+
+    camera = bpy.data.objects.new("Camera", bpy.data.cameras.new("Camera"))
+    camera.location = (0.0, -12.0, 0.0)
+    camera.rotation_euler = (math.radians(90.0), 0.0, 0.0)
+    scene.master_collection.objects.link(camera)
+    scene.camera = camera
+
+
+def render(filepath, use_adaptive_sampling, seed):
+    scene = bpy.context.scene
+    scene.cycles.use_adaptive_sampling = use_adaptive_sampling
+    scene.cycles.seed = seed
+    scene.render.filepath = filepath
+
+    t = time.time()
+    bpy.ops.render.render(write_still=True)
+    render_time = time.time() - t
+
+    image = bpy.data.images.load(filepath)
+    pixels = image.pixels[:]
+    bpy.data.images.remove(image)
+    os.remove(filepath)
+
+    # luminance-ish, alpha is ignored
+    values = [pixels[i] + pixels[i + 1] + pixels[i + 2] for i in range(0, len(pixels), 4)]
+    return values, render_time
+
+
+def main():
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    samples = 256
+    threshold = 0.01
+    use_denoising = False
+    for arg in argv:
+        if arg.startswith("--samples="):
+            samples = int(arg[len("--samples="):])
+        elif arg.startswith("--threshold="):
+            threshold = float(arg[len("--threshold="):])
+        elif arg == "--denoise":
+            use_denoising = True
+
+    create_scene()
+
+    scene = bpy.context.scene
+    scene.render.engine = 'CYCLES'
+    scene.render.resolution_x = 320
+    scene.render.resolution_y = 240
+    scene.render.resolution_percentage = 100
+    scene.render.tile_x = 32
+    scene.render.tile_y = 32
+    scene.render.image_settings.file_format = 'OPEN_EXR'
+    scene.cycles.device = 'CPU'
+    scene.cycles.progressive = 'PATH'
+    scene.cycles.samples = samples
+    scene.cycles.adaptive_threshold = threshold
+    scene.view_layers.active.cycles.use_denoising = use_denoising
+
+    results = {}
+    for use_adaptive_sampling in (False, True):
+        filepath = os.path.join(tempfile.gettempdir(),
+                                "cycles_adaptive_sampling_benchmark_%d.exr" % use_adaptive_sampling)
+        a, time_a = render(filepath, use_adaptive_sampling, 0)
+        b, time_b = render(filepath, use_adaptive_sampling, 1)
+
+        mean = sum(a + b) / (len(a) + len(b))
+        # difference of two independent renders has twice the variance of one
+        rms = math.sqrt(sum((x - y) ** 2 for x, y in zip(a, b)) / len(a) / 2.0)
+        results[use_adaptive_sampling] = (mean, rms, (time_a + time_b) / 2.0)
+
+    if use_denoising:
+        print("denoised")
+    for use_adaptive_sampling in (False, True):
+        mean, rms, render_time = results[use_adaptive_sampling]
+        print("%-10s mean %8.4f, time %7.3fs, noise %8.5f" % (
+            "adaptive" if use_adaptive_sampling else "fixed", mean, render_time, rms))
+
+    (mean_fixed, rms_fixed, time_fixed), (mean_adaptive, rms_adaptive, time_adaptive) = results[False], results[True]
+    if time_adaptive > 0.0:
+        print("Speedup: %.2fx" % (time_fixed / time_adaptive))
+
+    # stopping early must not change the converged image, only its noise
+    assert abs(mean_adaptive - mean_fixed) <= 0.02 * mean_fixed, "mean differs: %f %f" % (mean_fixed, mean_adaptive)
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except:
+        import traceback
+        traceback.print_exc()
+        sys.exit(1)
@@ -0,0 +1,129 @@
+# Apache License, Version 2.0
+
+# ./blender.bin --background -noaudio --factory-startup --python tests/python/cycles_light_tree.py -- --verbose
+#
+# Render a ground plane lit by lamps of very different strengths and an emissive quad,
+# picking lights with the light tree and with the flat distribution. Both converge to
+# the same image, only the noise differs.
+
+import math
+import os
+import random
+import tempfile
+import unittest
+
+import bpy
+
+
+def create_material(name, strength):
+    mat = bpy.data.materials.new(name)
+    mat.use_nodes = True
+    nodes = mat.node_tree.nodes
+    if strength > 0.0:
+        shader = nodes.new("ShaderNodeEmission")
+        shader.inputs["Strength"].default_value = strength
+        mat.node_tree.links.new(shader.outputs[0], nodes["Material Output"].inputs["Surface"])
+    return mat
+
+
+def create_lamp(scene, name, lamp_type, strength, location):
+    lamp = bpy.data.lamps.new(name, lamp_type)
+    lamp.shadow_soft_size = 0.1
+    lamp.use_nodes = True
+    lamp.node_tree.nodes["Emission"].inputs["Strength"].default_value = strength
+    ob = bpy.data.objects.new(name, lamp)
+    ob.location = location
+    scene.master_collection.objects.link(ob)
+    return ob
+
+
+def create_scene(integrator):
+    scene = bpy.context.scene
+    for ob in list(bpy.data.objects):
+        bpy.data.objects.remove(ob)
+
+    size = 4.0
+    mesh = bpy.data.meshes.new("Ground")
+    mesh.from_pydata([(-size, -size, 0.0), (size, -size, 0.0), (size, size, 0.0), (-size, size, 0.0)],
+                     [], [(0, 1, 2, 3)])
+    mesh.materials.append(create_material("Ground", 0.0))
+    scene.master_collection.objects.link(bpy.data.objects.new("Ground", mesh))
+
+    mesh = bpy.data.meshes.new("Emitter")
+    mesh.from_pydata([(-0.3, -0.3, 1.0), (-0.3, 0.3, 1.0), (0.3, 0.3, 1.0), (0.3, -0.3, 1.0)],
+                     [], [(0, 1, 2, 3)])
+    mesh.materials.append(create_material("Emitter", 5.0))
+    scene.master_collection.objects.link(bpy.data.objects.new("Emitter", mesh))
+
+    # strengths span several orders of magnitude, so they matter for picking lamps,
+    # one lamp does not emit at all
+    rng = random.Random(0)
+    for i, strength in enumerate((0.0, 1.0, 10.0, 100.0, 1000.0, 5.0, 50.0, 500.0)):
+        location = (rng.uniform(-size, size), rng.uniform(-size, size), rng.uniform(0.5, 2.0))
+        create_lamp(scene, "Lamp%d" % i, 'POINT', strength, location)
+    sun = create_lamp(scene, "Sun", 'SUN', 0.5, (0.0, 0.0, 5.0))
+    sun.rotation_euler = (math.radians(30.0), 0.0, 0.0)
+
+    camera = bpy.data.objects.new("Camera", bpy.data.cameras.new("Camera"))
+    camera.location = (0.0, 0.0, 8.0)
+    scene.master_collection.objects.link(camera)
+    scene.camera = camera
+
+    scene.world = None
+    scene.render.engine = 'CYCLES'
+    scene.render.resolution_x = 64
+    scene.render.resolution_y = 64
+    scene.render.resolution_percentage = 100
+    scene.render.image_settings.file_format = 'OPEN_EXR'
+    scene.cycles.device = 'CPU'
+    scene.cycles.progressive = integrator
+    scene.cycles.samples = 256
+    scene.cycles.aa_samples = 64
+    scene.cycles.max_bounces = 1
+
+
+class LightTreeTest(unittest.TestCase):
+
+    def setUp(self):
+        self._tempdir = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        bpy.ops.wm.read_factory_settings()
+        self._tempdir.cleanup()
+
+    def render(self, use_light_tree):
+        scene = bpy.context.scene
+        scene.cycles.use_light_tree = use_light_tree
+        scene.render.filepath = os.path.join(self._tempdir.name, "render_%d.exr" % use_light_tree)
+
+        bpy.ops.render.render(write_still=True)
+
+        image = bpy.data.images.load(scene.render.filepath)
+        pixels = image.pixels[:]
+        bpy.data.images.remove(image)
+        # alpha is ignored
+        return [pixels[i] + pixels[i + 1] + pixels[i + 2] for i in range(0, len(pixels), 4)]
+
+    def compare(self, integrator):
+        create_scene(integrator)
+        values_flat = self.render(False)
+        values_tree = self.render(True)
+
+        self.assertEqual(len(values_flat), len(values_tree))
+        mean_flat = sum(values_flat) / len(values_flat)
+        mean_tree = sum(values_tree) / len(values_tree)
+        # the scene must actually be lit
+        self.assertGreater(mean_flat, 0.01)
+        self.assertAlmostEqual(mean_tree, mean_flat, delta=0.05 * mean_flat)
+
+    def test_path(self):
+        self.compare('PATH')
+
+    def test_branched_path(self):
+        self.compare('BRANCHED_PATH')
+
+
+if __name__ == '__main__':
+    import sys
+    sys.argv = [__file__] + (sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else [])
+    unittest.main()
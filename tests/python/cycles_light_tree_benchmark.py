@@ -0,0 +1,181 @@
+# Apache License, Version 2.0
+
+# Benchmark convergence of Cycles with many lights, with and without the light tree.
+#
+# ./blender.bin --background -noaudio --factory-startup \
+#     --python tests/python/cycles_light_tree_benchmark.py -- --lights=10000 --samples=16
+#
+# The scene is a ground plane lit by small emissive quads and point lamps scattered above it.
+# Noise is estimated from two renders with different seeds, and scaled to equal render time
+# since noise decreases with the square root of the number of samples.
+#
+# Both integrators are tested, --integrator=PATH or --integrator=BRANCHED_PATH tests only one.
+# Branched path samples all lamps at every vertex, so it uses --branched-lights lights.
+
+import math
+import os
+import random
+import sys
+import tempfile
+import time
+
+import bpy
+
+
+def create_material(name, emission):
+    mat = bpy.data.materials.new(name)
+    mat.use_nodes = True
+    nodes = mat.node_tree.nodes
+    output = nodes["Material Output"]
+    if emission:
+        shader = nodes.new("ShaderNodeEmission")
+        shader.inputs["Strength"].default_value = 20.0
+    else:
+        shader = nodes["Diffuse BSDF"]
+    mat.node_tree.links.new(shader.outputs[0], output.inputs["Surface"])
+    return mat
+
+
+def create_scene(num_lights):
+    scene = bpy.context.scene
+    for ob in list(bpy.data.objects):
+        bpy.data.objects.remove(ob)
+
+    rng = random.Random(0)
+    size = 20.0
+
+    # ground plane
+    mesh = bpy.data.meshes.new("Ground")
+    mesh.from_pydata([(-size, -size, 0.0), (size, -size, 0.0), (size, size, 0.0), (-size, size, 0.0)],
+                     [], [(0, 1, 2, 3)])
+    mesh.materials.append(create_material("Ground", False))
+    scene.master_collection.objects.link(bpy.data.objects.new("Ground", mesh))
+
+    # half of the lights are emissive quads facing in random directions, in a single mesh
+    num_quads = num_lights // 2
+    verts = []
+    faces = []
+    for i in range(num_quads):
+        x, y, z = rng.uniform(-size, size), rng.uniform(-size, size), rng.uniform(0.5, 2.0)
+        theta, phi = rng.uniform(0.0, math.pi), rng.uniform(0.0, 2.0 * math.pi)
+        u = (math.cos(phi) * 0.05, math.sin(phi) * 0.05, 0.0)
+        v = (-math.sin(phi) * math.cos(theta) * 0.05, math.cos(phi) * math.cos(theta) * 0.05, math.sin(theta) * 0.05)
+        for su, sv in ((-1, -1), (1, -1), (1, 1), (-1, 1)):
+            verts.append((x + su * u[0] + sv * v[0], y + su * u[1] + sv * v[1], z + su * u[2] + sv * v[2]))
+        faces.append((i * 4, i * 4 + 1, i * 4 + 2, i * 4 + 3))
+    mesh = bpy.data.meshes.new("Emitters")
+    mesh.from_pydata(verts, [], faces)
+    mesh.materials.append(create_material("Emitters", True))
+    scene.master_collection.objects.link(bpy.data.objects.new("Emitters", mesh))
+
+    # other half are small point lamps sharing the same data
+    lamp = bpy.data.lamps.new("Lamp", 'POINT')
+    lamp.shadow_soft_size = 0.02
+    lamp.use_nodes = True
+    lamp.node_tree.nodes["Emission"].inputs["Strength"].default_value = 2.0
+    for i in range(num_lights - num_quads):
+        ob = bpy.data.objects.new("Lamp%05d" % i, lamp)
+        ob.location = (rng.uniform(-size, size), rng.uniform(-size, size), rng.uniform(0.5, 2.0))
+        scene.master_collection.objects.link(ob)
+
+    camera = bpy.data.objects.new("Camera", bpy.data.cameras.new("Camera"))
+    camera.location = (0.0, -size * 1.2, size * 0.6)
+    camera.rotation_euler = (math.radians(65.0), 0.0, 0.0)
+    scene.master_collection.objects.link(camera)
+    scene.camera = camera
+
+
+def render(filepath, use_light_tree, seed):
+    scene = bpy.context.scene
+    scene.cycles.use_light_tree = use_light_tree
+    scene.cycles.seed = seed
+    scene.render.filepath = filepath
+
+    t = time.time()
+    bpy.ops.render.render(write_still=True)
+    render_time = time.time() - t
+
+    image = bpy.data.images.load(filepath)
+    pixels = image.pixels[:]
+    bpy.data.images.remove(image)
+    os.remove(filepath)
+
+    # luminance-ish, alpha is ignored
+    values = [pixels[i] + pixels[i + 1] + pixels[i + 2] for i in range(0, len(pixels), 4)]
+    return values, render_time
+
+
+def benchmark(integrator, num_lights, samples):
+    create_scene(num_lights)
+
+    scene = bpy.context.scene
+    scene.render.engine = 'CYCLES'
+    scene.render.resolution_x = 160
+    scene.render.resolution_y = 120
+    scene.render.resolution_percentage = 100
+    scene.render.image_settings.file_format = 'OPEN_EXR'
+    scene.cycles.device = 'CPU'
+    scene.cycles.progressive = integrator
+    scene.cycles.samples = samples
+    scene.cycles.aa_samples = samples
+    scene.cycles.max_bounces = 1
+    # branched path only, lamps and mesh lights are then sampled separately of the tree
+    scene.cycles.sample_all_lights_direct = True
+    scene.cycles.sample_all_lights_indirect = True
+
+    print("%s, %d lights:" % (integrator, num_lights))
+
+    results = {}
+    for use_light_tree in (False, True):
+        filepath = os.path.join(tempfile.gettempdir(), "cycles_light_tree_benchmark_%d.exr" % use_light_tree)
+        a, time_a = render(filepath, use_light_tree, 0)
+        b, time_b = render(filepath, use_light_tree, 1)
+
+        mean = sum(a + b) / (len(a) + len(b))
+        # difference of two independent renders has twice the variance of one
+        rms = math.sqrt(sum((x - y) ** 2 for x, y in zip(a, b)) / len(a) / 2.0)
+        results[use_light_tree] = (mean, rms, (time_a + time_b) / 2.0)
+
+    time_ref = results[False][2]
+    for use_light_tree in (False, True):
+        mean, rms, render_time = results[use_light_tree]
+        print("%-10s mean %8.4f, time %7.3fs, noise %8.5f, noise at equal time %8.5f" % (
+            "tree" if use_light_tree else "flat", mean, render_time, rms,
+            rms * math.sqrt(render_time / time_ref)))
+
+    (mean_flat, rms_flat, time_flat), (mean_tree, rms_tree, time_tree) = results[False], results[True]
+    if rms_tree > 0.0:
+        print("Efficiency: %.2fx" % ((rms_flat ** 2 * time_flat) / (rms_tree ** 2 * time_tree)))
+
+    # both converge to the same image, only noise differs
+    assert abs(mean_tree - mean_flat) <= 0.05 * mean_flat, "%s mean differs: %f %f" % (
+        integrator, mean_flat, mean_tree)
+
+
+def main():
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    num_lights = 10000
+    num_branched_lights = 200
+    samples = 16
+    integrators = ('PATH', 'BRANCHED_PATH')
+    for arg in argv:
+        if arg.startswith("--lights="):
+            num_lights = int(arg[len("--lights="):])
+        elif arg.startswith("--branched-lights="):
+            num_branched_lights = int(arg[len("--branched-lights="):])
+        elif arg.startswith("--samples="):
+            samples = int(arg[len("--samples="):])
+        elif arg.startswith("--integrator="):
+            integrators = (arg[len("--integrator="):],)
+
+    for integrator in integrators:
+        benchmark(integrator, num_lights if integrator == 'PATH' else num_branched_lights, samples)
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except:
+        import traceback
+        traceback.print_exc()
+        sys.exit(1)
@@ -0,0 +1,132 @@
+# Apache License, Version 2.0
+
+# ./blender.bin --background -noaudio --factory-startup --python tests/python/cycles_shader_sort.py -- --verbose
+#
+# Render cubes with different materials in a checker pattern, integrating camera rays in order
+# of their shader and in pixel order. Paths only run in a different order, so every pixel must
+# come out the same.
+
+import os
+import tempfile
+import unittest
+
+import bpy
+
+
+NUM_MATERIALS = 6
+
+
+def create_material(index):
+    mat = bpy.data.materials.new("Material%d" % index)
+    mat.use_nodes = True
+    nodes = mat.node_tree.nodes
+    links = mat.node_tree.links
+
+    # alternate between a few shader types so the programs actually differ
+    kind = index % 3
+    if kind == 0:
+        shader = nodes["Diffuse BSDF"]
+        noise = nodes.new("ShaderNodeTexNoise")
+        noise.inputs["Scale"].default_value = 5.0 + index
+        links.new(noise.outputs["Color"], shader.inputs["Color"])
+    elif kind == 1:
+        shader = nodes.new("ShaderNodeBsdfGlossy")
+        shader.inputs["Roughness"].default_value = 0.1 + 0.05 * index
+    else:
+        shader = nodes.new("ShaderNodeEmission")
+        shader.inputs["Strength"].default_value = 0.5 * index
+    links.new(shader.outputs[0], nodes["Material Output"].inputs["Surface"])
+    return mat
+
+
+def create_scene():
+    scene = bpy.context.scene
+    for ob in list(bpy.data.objects):
+        bpy.data.objects.remove(ob)
+
+    world = bpy.data.worlds.new("World")
+    world.use_nodes = True
+    world.node_tree.nodes["Background"].inputs["Color"].default_value = (0.5, 0.5, 0.5, 1.0)
+    scene.world = world
+
+    # one mesh of cubes, materials assigned per face in a checker pattern
+    size = 6
+    verts = []
+    faces = []
+    material_indices = []
+    for i in range(size):
+        for j in range(size):
+            x, y = i - size / 2.0, j - size / 2.0
+            base = len(verts)
+            for dx, dy, dz in ((0, 0, 0), (0.9, 0, 0), (0.9, 0.9, 0), (0, 0.9, 0),
+                               (0, 0, 0.9), (0.9, 0, 0.9), (0.9, 0.9, 0.9), (0, 0.9, 0.9)):
+                verts.append((x + dx, y + dy, dz))
+            for face in ((0, 3, 2, 1), (4, 5, 6, 7), (0, 1, 5, 4),
+                         (1, 2, 6, 5), (2, 3, 7, 6), (3, 0, 4, 7)):
+                faces.append(tuple(base + v for v in face))
+                material_indices.append((i + j * 5) % NUM_MATERIALS)
+
+    mesh = bpy.data.meshes.new("Cubes")
+    mesh.from_pydata(verts, [], faces)
+    for i in range(NUM_MATERIALS):
+        mesh.materials.append(create_material(i))
+    for poly, material_index in zip(mesh.polygons, material_indices):
+        poly.material_index = material_index
+    scene.master_collection.objects.link(bpy.data.objects.new("Cubes", mesh))
+
+    camera = bpy.data.objects.new("Camera", bpy.data.cameras.new("Camera"))
+    camera.location = (0.0, 0.0, 10.0)
+    scene.master_collection.objects.link(camera)
+    scene.camera = camera
+
+    scene.render.engine = 'CYCLES'
+    scene.render.resolution_x = 64
+    scene.render.resolution_y = 64
+    scene.render.resolution_percentage = 100
+    scene.render.tile_x = 32
+    scene.render.tile_y = 32
+    scene.render.image_settings.file_format = 'OPEN_EXR'
+    scene.cycles.device = 'CPU'
+    scene.cycles.progressive = 'PATH'
+    scene.cycles.samples = 4
+
+
+class ShaderSortTest(unittest.TestCase):
+
+    def setUp(self):
+        self._tempdir = tempfile.TemporaryDirectory()
+        create_scene()
+        # debug flags are only synced with this debug value
+        bpy.app.debug_value = 256
+
+    def tearDown(self):
+        bpy.app.debug_value = 0
+        bpy.ops.wm.read_factory_settings()
+        self._tempdir.cleanup()
+
+    def render(self, use_shader_sort):
+        scene = bpy.context.scene
+        scene.cycles.debug_use_cpu_shader_sort = use_shader_sort
+        scene.render.filepath = os.path.join(self._tempdir.name, "render_%d.exr" % use_shader_sort)
+
+        bpy.ops.render.render(write_still=True)
+
+        image = bpy.data.images.load(scene.render.filepath)
+        pixels = image.pixels[:]
+        bpy.data.images.remove(image)
+        return pixels
+
+    def test_same_pixels(self):
+        pixels_unsorted = self.render(False)
+        pixels_sorted = self.render(True)
+
+        self.assertEqual(len(pixels_unsorted), len(pixels_sorted))
+        self.assertGreater(max(pixels_unsorted), 0.1)
+        max_diff = max(abs(a - b) for a, b in zip(pixels_unsorted, pixels_sorted))
+        self.assertLessEqual(max_diff, 1e-5)
+
+
+if __name__ == '__main__':
+    import sys
+    sys.argv = [__file__] + (sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else [])
+    unittest.main()
@@ -0,0 +1,156 @@
+# Apache License, Version 2.0
+
+# Benchmark render time of Cycles on the CPU with and without sorting camera rays by shader.
+#
+# ./blender.bin --background -noaudio --factory-startup \
+#     --python tests/python/cycles_shader_sort_benchmark.py -- --materials=16 --samples=16
+#
+# The scene is a grid of small cubes with materials of different node setups assigned in a
+# checker pattern, so neighbouring pixels rarely share a shader. Time spent in traversal and
+# shading is printed to the log with --debug-cycles.
+
+import os
+import sys
+import tempfile
+import time
+
+import bpy
+
+
+def create_material(index):
+    mat = bpy.data.materials.new("Material%03d" % index)
+    mat.use_nodes = True
+    nodes = mat.node_tree.nodes
+    links = mat.node_tree.links
+    output = nodes["Material Output"]
+
+    # alternate between a few shader types so the programs actually differ
+    kind = index % 3
+    if kind == 0:
+        shader = nodes["Diffuse BSDF"]
+        noise = nodes.new("ShaderNodeTexNoise")
+        noise.inputs["Scale"].default_value = 5.0 + index
+        links.new(noise.outputs["Color"], shader.inputs["Color"])
+    elif kind == 1:
+        shader = nodes.new("ShaderNodeBsdfGlossy")
+        shader.inputs["Roughness"].default_value = 0.1 + 0.02 * index
+    else:
+        shader = nodes.new("ShaderNodeBsdfPrincipled")
+        voronoi = nodes.new("ShaderNodeTexVoronoi")
+        voronoi.inputs["Scale"].default_value = 3.0 + index
+        links.new(voronoi.outputs["Color"], shader.inputs["Base Color"])
+    links.new(shader.outputs[0], output.inputs["Surface"])
+    return mat
+
+
+def create_scene(num_materials):
+    scene = bpy.context.scene
+    for ob in list(bpy.data.objects):
+        bpy.data.objects.remove(ob)
+
+    world = bpy.data.worlds.new("World")
+    world.use_nodes = True
+    world.node_tree.nodes["Background"].inputs["Color"].default_value = (0.5, 0.5, 0.5, 1.0)
+    scene.world = world
+
+    materials = [create_material(i) for i in range(num_materials)]
+
+    # one mesh of cubes, materials assigned per face in a checker pattern
+    size = 16
+    verts = []
+    faces = []
+    material_indices = []
+    for i in range(size):
+        for j in range(size):
+            x, y = i - size / 2.0, j - size / 2.0
+            base = len(verts)
+            for dx, dy, dz in ((0, 0, 0), (0.9, 0, 0), (0.9, 0.9, 0), (0, 0.9, 0),
+                               (0, 0, 0.9), (0.9, 0, 0.9), (0.9, 0.9, 0.9), (0, 0.9, 0.9)):
+                verts.append((x + dx, y + dy, dz))
+            for face in ((0, 3, 2, 1), (4, 5, 6, 7), (0, 1, 5, 4),
+                         (1, 2, 6, 5), (2, 3, 7, 6), (3, 0, 4, 7)):
+                faces.append(tuple(base + v for v in face))
+                material_indices.append((i + j * 7) % num_materials)
+
+    mesh = bpy.data.meshes.new("Cubes")
+    mesh.from_pydata(verts, [], faces)
+    for mat in materials:
+        mesh.materials.append(mat)
+    for poly, material_index in zip(mesh.polygons, material_indices):
+        poly.material_index = material_index
+    scene.master_collection.objects.link(bpy.data.objects.new("Cubes", mesh))
+
+    camera = bpy.data.objects.new("Camera", bpy.data.cameras.new("Camera"))
+    camera.location = (0.0, 0.0, 20.0)
+    scene.master_collection.objects.link(camera)
+    scene.camera = camera
+
+
+def render(filepath, use_shader_sort):
+    scene = bpy.context.scene
+    scene.cycles.debug_use_cpu_shader_sort = use_shader_sort
+    scene.render.filepath = filepath
+
+    t = time.time()
+    bpy.ops.render.render(write_still=True)
+    render_time = time.time() - t
+
+    image = bpy.data.images.load(filepath)
+    pixels = image.pixels[:]
+    bpy.data.images.remove(image)
+    os.remove(filepath)
+
+    return pixels, render_time
+
+
+def main():
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    num_materials = 16
+    samples = 16
+    for arg in argv:
+        if arg.startswith("--materials="):
+            num_materials = int(arg[len("--materials="):])
+        elif arg.startswith("--samples="):
+            samples = int(arg[len("--samples="):])
+
+    create_scene(num_materials)
+
+    # debug flags are only synced with this debug value
+    bpy.app.debug_value = 256
+
+    scene = bpy.context.scene
+    scene.render.engine = 'CYCLES'
+    scene.render.resolution_x = 320
+    scene.render.resolution_y = 320
+    scene.render.resolution_percentage = 100
+    scene.render.tile_x = 64
+    scene.render.tile_y = 64
+    scene.render.image_settings.file_format = 'OPEN_EXR'
+    scene.cycles.device = 'CPU'
+    scene.cycles.progressive = 'PATH'
+    scene.cycles.samples = samples
+    scene.cycles.debug_use_cpu_timing = True
+
+    results = {}
+    for use_shader_sort in (False, True):
+        filepath = os.path.join(tempfile.gettempdir(), "cycles_shader_sort_benchmark_%d.exr" % use_shader_sort)
+        results[use_shader_sort] = render(filepath, use_shader_sort)
+
+    (pixels_unsorted, time_unsorted), (pixels_sorted, time_sorted) = results[False], results[True]
+    print("unsorted time %7.3fs" % time_unsorted)
+    print("sorted   time %7.3fs" % time_sorted)
+    if time_sorted > 0.0:
+        print("Speedup: %.2fx" % (time_unsorted / time_sorted))
+
+    # paths only run in a different order, every pixel must come out the same
+    max_diff = max(abs(a - b) for a, b in zip(pixels_unsorted, pixels_sorted))
+    assert max_diff <= 1e-5, "images differ by %f" % max_diff
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except:
+        import traceback
+        traceback.print_exc()
+        sys.exit(1)
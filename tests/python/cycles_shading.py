@@ -0,0 +1,128 @@
+# Apache License, Version 2.0
+
+# ./blender.bin --background -noaudio --factory-startup --python tests/python/cycles_shading.py -- --verbose
+#
+# Render a plane with an emission shader of which many inputs are constant values, mixed by
+# the texture coordinate across the plane. Every pixel is compared against the value the
+# node setup computes, so constant node inputs must reach the nodes reading them.
+
+import os
+import tempfile
+import unittest
+
+import bpy
+
+
+RESOLUTION = 32
+
+COLOR1 = (0.2, 0.4, 0.6)
+COLOR2 = (0.9, 0.7, 0.1)
+FAC_SCALE = 0.5
+FAC_OFFSET = 0.25
+STRENGTH = 2.0
+
+
+def expected_color(u):
+    fac = u * FAC_SCALE + FAC_OFFSET
+    return [STRENGTH * (a * (1.0 - fac) + b * fac) for a, b in zip(COLOR1, COLOR2)]
+
+
+def create_material():
+    mat = bpy.data.materials.new("Shading")
+    mat.use_nodes = True
+    nodes = mat.node_tree.nodes
+    links = mat.node_tree.links
+    nodes.remove(nodes["Diffuse BSDF"])
+
+    # nodes with linked inputs are not constant folded, their other inputs stay constant values
+    coord = nodes.new("ShaderNodeTexCoord")
+    separate = nodes.new("ShaderNodeSeparateXYZ")
+    links.new(coord.outputs["Generated"], separate.inputs["Vector"])
+
+    scale = nodes.new("ShaderNodeMath")
+    scale.operation = 'MULTIPLY'
+    scale.inputs[1].default_value = FAC_SCALE
+    links.new(separate.outputs["X"], scale.inputs[0])
+
+    offset = nodes.new("ShaderNodeMath")
+    offset.operation = 'ADD'
+    offset.inputs[1].default_value = FAC_OFFSET
+    links.new(scale.outputs[0], offset.inputs[0])
+
+    mix = nodes.new("ShaderNodeMixRGB")
+    mix.inputs["Color1"].default_value = COLOR1 + (1.0,)
+    mix.inputs["Color2"].default_value = COLOR2 + (1.0,)
+    links.new(offset.outputs[0], mix.inputs["Fac"])
+
+    emission = nodes.new("ShaderNodeEmission")
+    emission.inputs["Strength"].default_value = STRENGTH
+    links.new(mix.outputs["Color"], emission.inputs["Color"])
+    links.new(emission.outputs["Emission"], nodes["Material Output"].inputs["Surface"])
+
+    return mat
+
+
+def create_scene():
+    scene = bpy.context.scene
+    for ob in list(bpy.data.objects):
+        bpy.data.objects.remove(ob)
+
+    mesh = bpy.data.meshes.new("Plane")
+    mesh.from_pydata([(-1, -1, 0), (1, -1, 0), (1, 1, 0), (-1, 1, 0)], [], [(0, 1, 2, 3)])
+    mesh.materials.append(create_material())
+    scene.master_collection.objects.link(bpy.data.objects.new("Plane", mesh))
+
+    camera_data = bpy.data.cameras.new("Camera")
+    camera_data.type = 'ORTHO'
+    camera_data.ortho_scale = 2.0
+    camera = bpy.data.objects.new("Camera", camera_data)
+    camera.location = (0.0, 0.0, 1.0)
+    scene.master_collection.objects.link(camera)
+    scene.camera = camera
+
+    scene.world = None
+    scene.render.engine = 'CYCLES'
+    scene.render.resolution_x = RESOLUTION
+    scene.render.resolution_y = RESOLUTION
+    scene.render.resolution_percentage = 100
+    scene.render.image_settings.file_format = 'OPEN_EXR'
+    scene.cycles.device = 'CPU'
+    scene.cycles.progressive = 'PATH'
+    scene.cycles.samples = 4
+    # all samples at the pixel center, so the expected value is exact
+    scene.cycles.pixel_filter_type = 'GAUSSIAN'
+    scene.cycles.filter_width = 0.01
+
+
+class ShadingTest(unittest.TestCase):
+
+    def setUp(self):
+        self._tempdir = tempfile.TemporaryDirectory()
+        create_scene()
+
+    def tearDown(self):
+        bpy.ops.wm.read_factory_settings()
+        self._tempdir.cleanup()
+
+    def test_constant_inputs(self):
+        scene = bpy.context.scene
+        scene.render.filepath = os.path.join(self._tempdir.name, "render.exr")
+        bpy.ops.render.render(write_still=True)
+
+        image = bpy.data.images.load(scene.render.filepath)
+        pixels = image.pixels[:]
+        bpy.data.images.remove(image)
+        self.assertEqual(len(pixels), RESOLUTION * RESOLUTION * 4)
+
+        for y in range(RESOLUTION):
+            for x in range(RESOLUTION):
+                expected = expected_color((x + 0.5) / RESOLUTION)
+                color = pixels[(y * RESOLUTION + x) * 4:(y * RESOLUTION + x) * 4 + 3]
+                for a, b in zip(color, expected):
+                    self.assertAlmostEqual(a, b, delta=1e-3, msg="pixel %d %d" % (x, y))
+
+
+if __name__ == '__main__':
+    import sys
+    sys.argv = [__file__] + (sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else [])
+    unittest.main()
@@ -0,0 +1,122 @@
+# Apache License, Version 2.0
+
+# Benchmark shading throughput of Cycles on the CPU.
+#
+# ./blender.bin --background -noaudio --factory-startup \
+#     --python tests/python/cycles_shading_benchmark.py -- --samples=64
+#
+# The camera only sees a plane with a node setup typical for production shaders: texture
+# coordinates mapped into noise textures, mixed into the color of a principled BSDF with most
+# inputs left at constant values. Bounces are disabled so most of the time is spent in shader
+# evaluation. Shading samples per second are printed, to compare builds with each other.
+
+import sys
+import time
+
+import bpy
+
+
+def create_material():
+    mat = bpy.data.materials.new("Shading")
+    mat.use_nodes = True
+    nodes = mat.node_tree.nodes
+    links = mat.node_tree.links
+
+    nodes.remove(nodes["Diffuse BSDF"])
+    bsdf = nodes.new("ShaderNodeBsdfPrincipled")
+    bsdf.inputs["Roughness"].default_value = 0.35
+    bsdf.inputs["Specular"].default_value = 0.6
+    bsdf.inputs["Clearcoat"].default_value = 0.2
+    links.new(bsdf.outputs[0], nodes["Material Output"].inputs["Surface"])
+
+    coord = nodes.new("ShaderNodeTexCoord")
+    mapping = nodes.new("ShaderNodeMapping")
+    mapping.scale = (4.0, 4.0, 4.0)
+    links.new(coord.outputs["Object"], mapping.inputs["Vector"])
+
+    noise = nodes.new("ShaderNodeTexNoise")
+    noise.inputs["Scale"].default_value = 8.0
+    noise.inputs["Detail"].default_value = 4.0
+    links.new(mapping.outputs["Vector"], noise.inputs["Vector"])
+
+    voronoi = nodes.new("ShaderNodeTexVoronoi")
+    voronoi.inputs["Scale"].default_value = 3.0
+    links.new(mapping.outputs["Vector"], voronoi.inputs["Vector"])
+
+    mix = nodes.new("ShaderNodeMixRGB")
+    mix.blend_type = 'MULTIPLY'
+    links.new(noise.outputs["Fac"], mix.inputs["Fac"])
+    links.new(noise.outputs["Color"], mix.inputs["Color1"])
+    links.new(voronoi.outputs["Color"], mix.inputs["Color2"])
+    links.new(mix.outputs["Color"], bsdf.inputs["Base Color"])
+
+    ramp = nodes.new("ShaderNodeValToRGB")
+    links.new(voronoi.outputs["Fac"], ramp.inputs["Fac"])
+    links.new(ramp.outputs["Alpha"], bsdf.inputs["Metallic"])
+
+    return mat
+
+
+def create_scene():
+    scene = bpy.context.scene
+    for ob in list(bpy.data.objects):
+        bpy.data.objects.remove(ob)
+
+    world = bpy.data.worlds.new("World")
+    world.use_nodes = True
+    world.node_tree.nodes["Background"].inputs["Color"].default_value = (0.8, 0.8, 0.8, 1.0)
+    scene.world = world
+
+    mesh = bpy.data.meshes.new("Plane")
+    mesh.from_pydata([(-1.0, -1.0, 0.0), (1.0, -1.0, 0.0), (1.0, 1.0, 0.0), (-1.0, 1.0, 0.0)],
+                     [], [(0, 1, 2, 3)])
+    mesh.materials.append(create_material())
+    scene.master_collection.objects.link(bpy.data.objects.new("Plane", mesh))
+
+    camera = bpy.data.objects.new("Camera", bpy.data.cameras.new("Camera"))
+    camera.data.type = 'ORTHO'
+    camera.data.ortho_scale = 1.5
+    camera.location = (0.0, 0.0, 5.0)
+    scene.master_collection.objects.link(camera)
+    scene.camera = camera
+
+
+def main():
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    samples = 64
+    for arg in argv:
+        if arg.startswith("--samples="):
+            samples = int(arg[len("--samples="):])
+
+    create_scene()
+
+    scene = bpy.context.scene
+    scene.render.engine = 'CYCLES'
+    scene.render.resolution_x = 256
+    scene.render.resolution_y = 256
+    scene.render.resolution_percentage = 100
+    scene.cycles.device = 'CPU'
+    scene.cycles.progressive = 'PATH'
+    scene.cycles.samples = samples
+    scene.cycles.max_bounces = 0
+
+    # first render includes shader compilation and BVH build
+    scene.cycles.samples = 1
+    bpy.ops.render.render()
+    scene.cycles.samples = samples
+
+    t = time.time()
+    bpy.ops.render.render()
+    render_time = time.time() - t
+
+    num_samples = scene.render.resolution_x * scene.render.resolution_y * samples
+    print("time %7.3fs, %.2f M shading samples/s" % (render_time, num_samples / render_time * 1e-6))
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except:
+        import traceback
+        traceback.print_exc()
+        sys.exit(1)
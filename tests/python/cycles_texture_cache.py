@@ -0,0 +1,124 @@
+# Apache License, Version 2.0
+
+# ./blender.bin --background -noaudio --factory-startup --python tests/python/cycles_texture_cache.py -- --verbose
+#
+# Render an image textured plane with images read on demand from the texture cache,
+# and with images loaded as a whole, the results must match.
+
+import os
+import tempfile
+import unittest
+
+import bpy
+
+
+TEXTURE_SIZE = 64
+
+
+def create_texture(filepath):
+    # all pixels differ, so a lookup of the wrong pixel or scanline order shows
+    image = bpy.data.images.new("Texture", TEXTURE_SIZE, TEXTURE_SIZE, float_buffer=True)
+    pixels = []
+    for y in range(TEXTURE_SIZE):
+        for x in range(TEXTURE_SIZE):
+            pixels += [x / TEXTURE_SIZE, y / TEXTURE_SIZE, ((x * 7 + y * 13) % 32) / 32.0, 1.0]
+    image.pixels = pixels
+    image.filepath_raw = filepath
+    image.file_format = 'OPEN_EXR'
+    image.save()
+    bpy.data.images.remove(image)
+
+
+def create_scene(texture_filepath, interpolation):
+    scene = bpy.context.scene
+    for ob in list(bpy.data.objects):
+        bpy.data.objects.remove(ob)
+
+    # emission only, the render is the texture as seen by the camera
+    mat = bpy.data.materials.new("Material")
+    mat.use_nodes = True
+    nodes = mat.node_tree.nodes
+    links = mat.node_tree.links
+    nodes.remove(nodes["Diffuse BSDF"])
+    emission = nodes.new("ShaderNodeEmission")
+    texture = nodes.new("ShaderNodeTexImage")
+    texture.image = bpy.data.images.load(texture_filepath)
+    texture.interpolation = interpolation
+    links.new(texture.outputs["Color"], emission.inputs["Color"])
+    links.new(emission.outputs["Emission"], nodes["Material Output"].inputs["Surface"])
+
+    mesh = bpy.data.meshes.new("Plane")
+    mesh.from_pydata([(-1, -1, 0), (1, -1, 0), (1, 1, 0), (-1, 1, 0)], [], [(0, 1, 2, 3)])
+    mesh.uv_layers.new()
+    for loop, uv in zip(mesh.uv_layers.active.data, ((0, 0), (1, 0), (1, 1), (0, 1))):
+        loop.uv = uv
+    mesh.materials.append(mat)
+    scene.master_collection.objects.link(bpy.data.objects.new("Plane", mesh))
+
+    camera_data = bpy.data.cameras.new("Camera")
+    camera_data.type = 'ORTHO'
+    camera_data.ortho_scale = 2.0
+    camera = bpy.data.objects.new("Camera", camera_data)
+    camera.location = (0.0, 0.0, 1.0)
+    scene.master_collection.objects.link(camera)
+    scene.camera = camera
+
+    scene.world = None
+    scene.render.engine = 'CYCLES'
+    scene.render.resolution_x = TEXTURE_SIZE * 2
+    scene.render.resolution_y = TEXTURE_SIZE * 2
+    scene.render.resolution_percentage = 100
+    scene.render.image_settings.file_format = 'OPEN_EXR'
+    scene.cycles.device = 'CPU'
+    scene.cycles.progressive = 'PATH'
+    scene.cycles.samples = 4
+    scene.cycles.use_texture_auto_convert = False
+
+
+class TextureCacheTest(unittest.TestCase):
+
+    def setUp(self):
+        self._tempdir = tempfile.TemporaryDirectory()
+        self.texture_filepath = os.path.join(self._tempdir.name, "texture.exr")
+        create_texture(self.texture_filepath)
+
+    def tearDown(self):
+        bpy.ops.wm.read_factory_settings()
+        self._tempdir.cleanup()
+
+    def render(self, texture_cache_size):
+        scene = bpy.context.scene
+        scene.cycles.texture_cache_size = texture_cache_size
+        scene.render.filepath = os.path.join(self._tempdir.name, "render_%d.exr" % texture_cache_size)
+
+        bpy.ops.render.render(write_still=True)
+
+        image = bpy.data.images.load(scene.render.filepath)
+        pixels = image.pixels[:]
+        bpy.data.images.remove(image)
+        return pixels
+
+    def compare(self, interpolation, tolerance):
+        create_scene(self.texture_filepath, interpolation)
+        pixels_loaded = self.render(0)
+        pixels_cached = self.render(16)
+
+        self.assertEqual(len(pixels_loaded), len(pixels_cached))
+        # the texture must actually be visible
+        self.assertGreater(max(pixels_loaded), 0.5)
+        max_diff = max(abs(a - b) for a, b in zip(pixels_loaded, pixels_cached))
+        self.assertLessEqual(max_diff, tolerance)
+
+    def test_closest(self):
+        # same pixels are looked up, only rounding of the coordinates may differ at pixel edges,
+        # which averages out over the camera samples
+        self.compare('Closest', 0.1)
+
+    def test_linear(self):
+        self.compare('Linear', 0.02)
+
+
+if __name__ == '__main__':
+    import sys
+    sys.argv = [__file__] + (sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else [])
+    unittest.main()